@@ -0,0 +1,247 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#include <mpi.h>
+#include "aggregator.h"
+#include "mpifxcorr.h"
+#include "alert.h"
+
+Aggregator::Aggregator(int id, int ncores, const int * cids, int maxresultlength, int nslots, MPI_Comm rcomm)
+  : mpiid(id), numcores(ncores), maxresultlength(maxresultlength), numslots(nslots), return_comm(rcomm)
+{
+  numfinished = 0;
+  numreceived = 0;
+  numforwarded = 0;
+  busytime = 0.0;
+  waittime = 0.0;
+
+  coreids = new int[numcores];
+  latest = new int*[numcores];
+  finished = new bool[numcores];
+  for(int i=0;i<numcores;i++)
+  {
+    coreids[i] = cids[i];
+    latest[i] = new int[2];
+    latest[i][0] = -1;
+    latest[i][1] = -1;
+    finished[i] = false;
+  }
+  slots = new aggregateslot[numslots];
+  for(int i=0;i<numslots;i++)
+  {
+    slots[i].inuse = false;
+    slots[i].header = new int[HEADER_LENGTH];
+    slots[i].resultlength = 0;
+    slots[i].results = vectorAlloc_cf32(maxresultlength);
+  }
+  receiveheader = new int[HEADER_LENGTH];
+  receivebuffer = vectorAlloc_cf32(maxresultlength);
+  estimatedbytes = ((long long)numslots + 1)*maxresultlength*sizeof(cf32);
+}
+
+Aggregator::~Aggregator()
+{
+  for(int i=0;i<numcores;i++)
+    delete [] latest[i];
+  delete [] latest;
+  delete [] coreids;
+  delete [] finished;
+  for(int i=0;i<numslots;i++)
+  {
+    delete [] slots[i].header;
+    vectorFree(slots[i].results);
+  }
+  delete [] slots;
+  delete [] receiveheader;
+  vectorFree(receivebuffer);
+}
+
+void Aggregator::execute()
+{
+  int oldest;
+
+  cinfo << startl << "Aggregator " << mpiid << " is combining the results of " << numcores << " cores, starting with MPI id " << coreids[0] << endl;
+
+  while(numfinished < numcores)
+  {
+    receiveResult();
+    forwardCompletedSlots();
+  }
+
+  //every Core has finished, so whatever is left is complete: send it in time order
+  do
+  {
+    oldest = -1;
+    for(int i=0;i<numslots;i++)
+    {
+      if(slots[i].inuse && (oldest < 0 || isEarlier(slots[i].header[0], slots[i].header[3], slots[oldest].header[0], slots[oldest].header[3])))
+        oldest = i;
+    }
+    if(oldest >= 0)
+      forwardSlot(oldest);
+  } while(oldest >= 0);
+  MPI_Send(receiveheader, 0, MPI_INT, fxcorr::MANAGERID, CR_TERMINATE, return_comm);
+
+  cinfo << startl << "Aggregator " << mpiid << " combined " << numreceived << " results into " << numforwarded << " sent to the FxManager; it was busy for " << busytime << " s and waited " << waittime << " s" << endl;
+}
+
+void Aggregator::receiveResult()
+{
+  MPI_Status mpistatus;
+  int source, coreindex, slotindex, count, status;
+  double t0;
+  aggregateslot * slot;
+
+  //a Core's header is always followed by its result, which is received straight away, so the first message
+  //waiting from any Core is always a header (or its termination notice)
+  t0 = MPI_Wtime();
+  MPI_Recv(receiveheader, HEADER_LENGTH, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, return_comm, &mpistatus);
+  source = mpistatus.MPI_SOURCE;
+  coreindex = -1;
+  for(int i=0;i<numcores;i++)
+  {
+    if(coreids[i] == source)
+      coreindex = i;
+  }
+  if(coreindex < 0)
+  {
+    csevere << startl << "Aggregator " << mpiid << " received a message from MPI id " << source << ", which is not in its group - ignoring it" << endl;
+    waittime += MPI_Wtime() - t0;
+    return;
+  }
+  if(mpistatus.MPI_TAG == CR_TERMINATE)
+  {
+    finished[coreindex] = true;
+    numfinished++;
+    waittime += MPI_Wtime() - t0;
+    return;
+  }
+  MPI_Recv(receivebuffer, maxresultlength*2, MPI_FLOAT, source, MPI_ANY_TAG, return_comm, &mpistatus);
+  waittime += MPI_Wtime() - t0;
+
+  t0 = MPI_Wtime();
+  numreceived++;
+  latest[coreindex][0] = receiveheader[0];
+  latest[coreindex][1] = receiveheader[3];
+  forwardCompletedSlots(); //free up any slots this Core has just moved past before claiming one
+  if(mpistatus.MPI_TAG != CR_VALIDVIS)
+  {
+    cwarn << startl << "Invalid data was received by aggregator " << mpiid << " from core " << source << " regarding scan " << receiveheader[0] << ", offset " << receiveheader[1] << " seconds - it will be ignored" << endl;
+    busytime += MPI_Wtime() - t0;
+    return;
+  }
+  MPI_Get_count(&mpistatus, MPI_FLOAT, &count);
+  count /= 2;
+
+  slotindex = findSlot(receiveheader[0], receiveheader[3]);
+  slot = &(slots[slotindex]);
+  if(slot->header[4] == 0) //the first result for this integration
+  {
+    for(int i=0;i<HEADER_LENGTH-1;i++)
+      slot->header[i] = receiveheader[i];
+    slot->resultlength = count;
+    status = vectorCopy_cf32(receivebuffer, slot->results, count);
+  }
+  else
+  {
+    if(count != slot->resultlength)
+      csevere << startl << "Aggregator " << mpiid << " received a result of length " << count << " for scan " << receiveheader[0] << ", integration " << receiveheader[3] << ", which already has results of length " << slot->resultlength << endl;
+    status = vectorAdd_cf32_I(receivebuffer, slot->results, (count < slot->resultlength)?count:slot->resultlength);
+  }
+  if(status != vecNoErr)
+    csevere << startl << "Error in aggregator " << mpiid << " adding results!!!" << endl;
+  slot->header[4] += receiveheader[4];
+  busytime += MPI_Wtime() - t0;
+}
+
+int Aggregator::findSlot(int scan, int integration)
+{
+  int freeslot = -1;
+  int oldest = -1;
+
+  for(int i=0;i<numslots;i++)
+  {
+    if(!slots[i].inuse)
+    {
+      if(freeslot < 0)
+        freeslot = i;
+      continue;
+    }
+    if(slots[i].header[0] == scan && slots[i].header[3] == integration)
+      return i;
+    if(oldest < 0 || isEarlier(slots[i].header[0], slots[i].header[3], slots[oldest].header[0], slots[oldest].header[3]))
+      oldest = i;
+  }
+  if(freeslot < 0)
+  {
+    //a Core has fallen well behind the rest of its group.  Its remaining results for the oldest integration will
+    //simply arrive at the FxManager as a second, partial, sum
+    cwarn << startl << "Aggregator " << mpiid << " has all " << numslots << " slots in use - sending the partial sum for scan " << slots[oldest].header[0] << ", integration " << slots[oldest].header[3] << " early" << endl;
+    forwardSlot(oldest);
+    freeslot = oldest;
+  }
+  slots[freeslot].inuse = true;
+  slots[freeslot].header[0] = scan;
+  slots[freeslot].header[3] = integration;
+  slots[freeslot].header[4] = 0;
+
+  return freeslot;
+}
+
+void Aggregator::forwardSlot(int slotindex)
+{
+  aggregateslot * slot = &(slots[slotindex]);
+
+  MPI_Send(slot->header, HEADER_LENGTH, MPI_INT, fxcorr::MANAGERID, CR_AGGREGATEHEADER, return_comm);
+  MPI_Send(slot->results, slot->resultlength*2, MPI_FLOAT, fxcorr::MANAGERID, CR_VALIDVIS, return_comm);
+  slot->inuse = false;
+  numforwarded++;
+}
+
+void Aggregator::forwardCompletedSlots()
+{
+  bool complete;
+
+  //each Core's results arrive in time order, so once every Core still running has sent a result for a later
+  //integration, nothing more can arrive for this one
+  for(int i=0;i<numslots;i++)
+  {
+    if(!slots[i].inuse)
+      continue;
+    complete = true;
+    for(int c=0;c<numcores;c++)
+    {
+      if(!finished[c] && !isEarlier(slots[i].header[0], slots[i].header[3], latest[c][0], latest[c][1]))
+      {
+        complete = false;
+        break;
+      }
+    }
+    if(complete)
+      forwardSlot(i);
+  }
+}
+// vim: shiftwidth=2:softtabstop=2:expandtab
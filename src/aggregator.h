@@ -0,0 +1,143 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <mpi.h>
+#include "architecture.h"
+
+/**
+@class Aggregator
+@brief Combines the results of a group of Cores for each integration, so the FxManager receives and adds one result per group
+
+Without aggregation every Core sends its full result for each subintegration to the FxManager, which adds them all into
+its Visibility buffer on a single MPI process.  With an aggregation tier (mpifxcorr -a), each Core instead sends its result
+to the Aggregator for its group, preceded by a short header, and only a zero length notice (which the FxManager still
+uses to schedule the next subintegration) to the FxManager.  The Aggregator sums the results that fall into the same
+integration and forwards the sum, with the number of subintegrations it contains, once every Core in the group has moved
+on to a later integration.  Partial sums are always safe to forward, since the FxManager simply adds them and counts their
+subintegrations, so when the Aggregator runs out of slots it forwards the oldest sum early.
+
+Both headers are HEADER_LENGTH ints: scan, seconds and nanoseconds of a subintegration in the integration (used by the
+FxManager to find the Visibility), the index of the integration within the scan (filled in by the FxManager when it
+sends the subintegration to a Core), and the number of subintegrations summed.
+
+@author The DiFX developers
+*/
+class Aggregator{
+public:
+ /**
+  * Constructor: Allocates the accumulation slots
+  * @param id The Aggregator's MPI id
+  * @param ncores The number of Cores in this Aggregator's group
+  * @param cids Array containing the MPI ids of each Core in the group
+  * @param maxresultlength The longest result (in complex values) any Core can send
+  * @param nslots The number of integrations that can be accumulated at once
+  * @param rcomm An MPI_Comm object used for communicating with the Cores and FxManager
+  */
+  Aggregator(int id, int ncores, const int * cids, int maxresultlength, int nslots, MPI_Comm rcomm);
+  ~Aggregator();
+
+ /**
+  * Receives and combines results until every Core in the group has finished, then forwards whatever remains and tells
+  * the FxManager this Aggregator is done
+  */
+  void execute();
+
+ /**
+  * Returns the estimated number of bytes used by the Aggregator
+  * @return Estimated memory size of the Aggregator (bytes)
+  */
+  inline long long getEstimatedBytes() const { return estimatedbytes; }
+
+ /**
+  * Returns the Aggregator that serves a given Core, so groups are contiguous and differ in size by at most one
+  * @param coreindex The index of the Core (0 for the first Core)
+  * @param numcores The total number of Cores
+  * @param numaggregators The total number of Aggregators
+  * @return The index of the Aggregator
+  */
+  static inline int getAggregatorIndex(int coreindex, int numcores, int numaggregators)
+    { return (int)(((long long)coreindex*numaggregators)/numcores); }
+
+  ///The number of ints in the header preceding each result sent to or from an Aggregator
+  static const int HEADER_LENGTH = 5;
+
+private:
+  ///One integration being accumulated
+  typedef struct {
+    bool inuse;
+    int * header;
+    int resultlength;
+    cf32 * results;
+  } aggregateslot;
+
+ /**
+  * Receives one header and result (or a termination notice) from a Core in the group and adds the result to its slot
+  */
+  void receiveResult();
+
+ /**
+  * Returns the slot accumulating the given integration, claiming a free one (forwarding the oldest if none are free)
+  * @param scan The scan of the integration
+  * @param integration The index of the integration within the scan
+  * @return The index of the slot
+  */
+  int findSlot(int scan, int integration);
+
+ /**
+  * Forwards the sum in a slot to the FxManager and frees the slot
+  * @param slotindex The slot to forward
+  */
+  void forwardSlot(int slotindex);
+
+ /**
+  * Forwards every slot that no Core in the group can contribute to any more
+  */
+  void forwardCompletedSlots();
+
+ /**
+  * Whether one integration comes before another
+  */
+  static inline bool isEarlier(int scan1, int integration1, int scan2, int integration2)
+    { return scan1 < scan2 || (scan1 == scan2 && integration1 < integration2); }
+
+  int mpiid, numcores, maxresultlength, numslots, numfinished;
+  long long estimatedbytes;
+  MPI_Comm return_comm;
+  int * coreids;
+  int ** latest; //[core][scan, integration] of the last result received from each Core
+  bool * finished;
+  aggregateslot * slots;
+  int * receiveheader;
+  cf32 * receivebuffer;
+  double busytime, waittime;
+  long long numreceived, numforwarded;
+};
+
+#endif
+// vim: shiftwidth=2:softtabstop=2:expandtab
@@ -972,21 +972,21 @@ Mode* Configuration::getMode(int configindex, int datastreamindex)
     case LBAVSOP:
       if(stream.numbits != 2)
         cerror << startl << "All LBASTD Modes must have 2 bit sampling - overriding input specification!!!" << endl;
-      return new LBAMode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, 2/*bits*/, stream.filterbank, stream.filterbank, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs, LBAMode::vsopunpackvalues);
+      return new LBAMode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, 2/*bits*/, stream.filterbank, stream.linear2circular, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs, LBAMode::vsopunpackvalues);
       break;
     case LBA8BIT:
       if(stream.numbits != 8) {
         cerror << startl << "8BIT LBA mode must have 8 bits! aborting" << endl;
         return NULL;
       }
-      return new LBA8BitMode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, 8/*bits*/, stream.filterbank, stream.filterbank, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs);
+      return new LBA8BitMode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, 8/*bits*/, stream.filterbank, stream.linear2circular, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs);
       break;
     case LBA16BIT:
       if(stream.numbits != 16) {
         cerror << startl << "16BIT LBA mode must have 16 bits! aborting" << endl;
         return NULL;
       }
-      return new LBA16BitMode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, 16/*bits*/, stream.filterbank, stream.filterbank, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs);
+      return new LBA16BitMode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, 16/*bits*/, stream.filterbank, stream.linear2circular, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs);
       break;
     case MKIV:
     case VLBA:
@@ -1006,7 +1006,7 @@ Mode* Configuration::getMode(int configindex, int datastreamindex)
         framesamples *= getDNumMuxThreads(configindex, datastreamindex);
         framebytes = (framebytes - VDIF_HEADER_BYTES)*getDNumMuxThreads(configindex, datastreamindex) + VDIF_HEADER_BYTES; // Assumed INTERLACED is never legacy
       }
-      return new Mk5Mode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, stream.numbits, stream.sampling, stream.tcomplex, stream.filterbank, stream.filterbank, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs, framebytes, framesamples, stream.format);
+      return new Mk5Mode(this, configindex, datastreamindex, streamrecbandchan, streamchanstoaverage, conf.blockspersend, guardsamples, stream.numrecordedfreqs, streamrecbandwidth, stream.recordedfreqclockoffsets, stream.recordedfreqclockoffsetsdelta, stream.recordedfreqphaseoffset, stream.recordedfreqlooffsets, stream.numrecordedbands, stream.numzoombands, stream.numbits, stream.sampling, stream.tcomplex, stream.filterbank, stream.linear2circular, conf.fringerotationorder, conf.arraystridelen[datastreamindex], conf.writeautocorrs, framebytes, framesamples, stream.format);
 
       break;
     default:
@@ -1296,7 +1296,7 @@ bool Configuration::populateRecordBandIndicies()
 
 void Configuration::processCommon(istream * input)
 {
-  string line;
+  string line, key;
 
   getinputline(input, &calcfilename, "CALC FILENAME");
   getinputline(input, &coreconffilename, "CORE CONF FILENAME");
@@ -1334,13 +1334,47 @@ void Configuration::processCommon(istream * input)
     outformat = DIFX;
   }
   getinputline(input, &outputfilename, "OUTPUT FILENAME");
+  coreringlength = DEFAULT_CORE_RING_LENGTH;
+  if(peekinputkeyval(input, "CORE RING LENGTH", &key, &line)) //optional
+  {
+    coreringlength = atoi(line.c_str());
+    if(coreringlength < 2)
+    {
+      if(mpiid == 0) //only write one copy of this error message
+        cfatal << startl << "Invalid value for CORE RING LENGTH: " << line << " (must be at least 2)" << endl;
+      consistencyok = false;
+    }
+  }
+  //online spectral kurtosis RFI excision, in sigma: 0 (the default) turns each test off
+  rfiskthreshold = 0.0;
+  rfifftthreshold = 0.0;
+  if(peekinputkeyval(input, "RFI SK THRESHOLD", &key, &line)) //optional
+  {
+    rfiskthreshold = atof(line.c_str());
+    if(rfiskthreshold < 0.0)
+    {
+      if(mpiid == 0) //only write one copy of this error message
+        cfatal << startl << "Invalid value for RFI SK THRESHOLD: " << line << " (must not be negative)" << endl;
+      consistencyok = false;
+    }
+  }
+  if(peekinputkeyval(input, "RFI FFT THRESHOLD", &key, &line)) //optional
+  {
+    rfifftthreshold = atof(line.c_str());
+    if(rfifftthreshold < 0.0)
+    {
+      if(mpiid == 0) //only write one copy of this error message
+        cfatal << startl << "Invalid value for RFI FFT THRESHOLD: " << line << " (must not be negative)" << endl;
+      consistencyok = false;
+    }
+  }
 
   commonread = true;
 }
 
 bool Configuration::processConfig(istream * input)
 {
-  string line;
+  string line, key;
   int arraystridelenfrominputfile;
 
   maxnumpulsarbins = 0;
@@ -1388,6 +1422,35 @@ bool Configuration::processConfig(istream * input)
     configs[i].numbufferedffts = atoi(line.c_str());
     if(configs[i].numbufferedffts > maxnumbufferedffts)
       maxnumbufferedffts = configs[i].numbufferedffts;
+    //the RFI tests work on the window of buffered FFTs, and would quietly do nothing with too few of them
+    if(rfiskthreshold > 0.0 && configs[i].numbufferedffts < Mode::RFI_MIN_SK_FFTS)
+    {
+      if(mpiid == 0) //only write one copy of this error message
+        cfatal << startl << "RFI SK THRESHOLD is set but config " << configs[i].name << " has NUM BUFFERED FFTS " << configs[i].numbufferedffts << " - the kurtosis test needs at least " << Mode::RFI_MIN_SK_FFTS << endl;
+      consistencyok = false;
+    }
+    if(rfifftthreshold > 0.0 && configs[i].numbufferedffts < Mode::RFI_MIN_POWER_FFTS)
+    {
+      if(mpiid == 0) //only write one copy of this error message
+        cfatal << startl << "RFI FFT THRESHOLD is set but config " << configs[i].name << " has NUM BUFFERED FFTS " << configs[i].numbufferedffts << " - the power test needs at least " << Mode::RFI_MIN_POWER_FFTS << endl;
+      consistencyok = false;
+    }
+    configs[i].spectraprec = FLOAT32SPECTRA;
+    if(peekinputkeyval(input, "SPECTRA PRECISION", &key, &line)) //optional
+    {
+      if(line == "FLOAT32")
+        configs[i].spectraprec = FLOAT32SPECTRA;
+      else if(line == "FLOAT16")
+        configs[i].spectraprec = FLOAT16SPECTRA;
+      else if(line == "INT8")
+        configs[i].spectraprec = INT8SPECTRA;
+      else
+      {
+        if(mpiid == 0) //only write one copy of this error message
+          cfatal << startl << "Unknown SPECTRA PRECISION " << line << " (case sensitive choices are FLOAT32, FLOAT16 and INT8)" << endl;
+        consistencyok = false;
+      }
+    }
     getinputline(input, &line, "WRITE AUTOCORRS");
     configs[i].writeautocorrs = ((line == "TRUE") || (line == "T") || (line == "true") || (line == "t"))?true:false;
     getinputline(input, &line, "PULSAR BINNING");
@@ -1395,6 +1458,12 @@ bool Configuration::processConfig(istream * input)
     if(configs[i].pulsarbin)
     {
       getinputline(input, &configs[i].pulsarconfigfilename, "PULSAR CONFIG FILE");
+      if(configs[i].spectraprec != FLOAT32SPECTRA)
+      {
+        if(mpiid == 0) //only write one copy of this error message
+          cwarn << startl << "Reduced SPECTRA PRECISION is not supported with pulsar binning - config " << configs[i].name << " will use FLOAT32" << endl;
+        configs[i].spectraprec = FLOAT32SPECTRA;
+      }
     }
     getinputline(input, &line, "PHASED ARRAY");
     configs[i].phasedarray = ((line == "TRUE") || (line == "T") || (line == "true") || (line == "t"))?true:false;
@@ -1597,7 +1666,7 @@ bool Configuration::processDatastreamTable(istream * input)
       return false;
     }
     if (mpiid==0 && datastreamtable[i].filterbank)
-      cwarn << startl << "Filterbank channelization requested but not yet supported!!!" << endl;
+      cinfo << startl << "Datastream " << i << " will be channelised with a " << Mode::FILTERBANK_TAPS << " tap polyphase filterbank" << endl;
 
     getinputkeyval(input, &key, &line);
     if(key.find("TCAL FREQUENCY") != string::npos) {
@@ -2769,6 +2838,13 @@ bool Configuration::consistencyCheck()
       } while (!(fabs(nsaccumulate - int(nsaccumulate+0.5)) < Mode::TINY));
       cdebug << startl << "NS accumulate is " << nsaccumulate << " and max geom slip is " << model->getMaxRate(dsdata->modelfileindex)*configs[i].subintns*0.000001 << ", maxnsslip is " << dsdata->maxnsslip << endl;
       nsaccumulate += model->getMaxRate(dsdata->modelfileindex)*configs[i].subintns*0.000001;
+      //a polyphase filterbank window reaches past the end of the last FFT in the subint
+      if(dsdata->filterbank) {
+        int fftsamples = 2*freqtable[dsdata->recordedfreqtableindices[0]].numchannels;
+        if(dsdata->sampling == COMPLEX)
+          fftsamples /= 2;
+        nsaccumulate += ((Mode::FILTERBANK_TAPS-1)*fftsamples/2)*samplens;
+      }
       if(nsaccumulate > dsdata->maxnsslip)
         dsdata->maxnsslip = int(nsaccumulate + 0.99);
       if(dsdata->maxnsslip > globalmaxnsslip)
@@ -3464,6 +3540,29 @@ void Configuration::getinputkeyval(istream * input, std::string * key, std::stri
   *key = key->substr(0, key->find_first_of(':'));
 }
 
+bool Configuration::peekinputkeyval(istream * input, const std::string& expectedkey, std::string * key, std::string * val) const
+{
+  string line;
+  streampos startpos = input->tellg();
+
+  getline(*input, line);
+  while(line.length() > 0 && line.at(0) == COMMENT_CHAR) // a comment
+    getline(*input, line);
+  if(input->fail() || line.find_first_of(':') == string::npos || expectedkey.compare(line.substr(0, expectedkey.length())) != 0)
+  {
+    //not the key we were after, so put the line back
+    input->clear();
+    input->seekg(startpos);
+    return false;
+  }
+  int keylength = line.find_first_of(':') + 1;
+  if(keylength < DEFAULT_KEY_LENGTH)
+    keylength = DEFAULT_KEY_LENGTH;
+  *key = line.substr(0, line.find_first_of(':'));
+  *val = (keylength < (int)line.length())?line.substr(keylength):"";
+  return true;
+}
+
 void Configuration::getinputline(istream * input, std::string * line, std::string startofheader, bool verbose) const
 {
   if(input->eof())
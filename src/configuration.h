@@ -74,6 +74,9 @@ public:
   /// For certain FILE data types (e.g., VDIF), can influence peeking / seeking on open
   enum filechecklevel {FILECHECKNONE, FILECHECKSEEK, FILECHECKUNKNOWN};
 
+  /// Precision in which the station spectra are held for cross-multiplication
+  enum spectraprecision {FLOAT32SPECTRA, FLOAT16SPECTRA, INT8SPECTRA};
+
   /// Constant for the TCP window size for monitoring
   static int MONITOR_TCP_WINDOWBYTES;
 
@@ -110,6 +113,9 @@ public:
   inline void setObsCode(string ocode) { obscode = ocode; }
   inline long long getEstimatedBytes() const { return estimatedbytes; }
   inline int getVisBufferLength() const { return visbufferlength; }
+  inline int getCoreRingLength() const { return coreringlength; }
+  inline double getRFISKThreshold() const { return rfiskthreshold; }
+  inline double getRFIFFTThreshold() const { return rfifftthreshold; }
   inline bool consistencyOK() const { return consistencyok; }
   inline bool anyUsbXLsb(int configindex) const { return configs[configindex].anyusbxlsb; }
   inline bool phasedArrayOn(int configindex) const { return configs[configindex].phasedarray; }
@@ -117,6 +123,7 @@ public:
   inline int getXmacStrideLength(int configindex) const { return configs[configindex].xmacstridelen; }
   inline int getRotateStrideLength(int configindex) const { return configs[configindex].rotatestridelen; }
   inline int getNumBufferedFFTs(int configindex) const { return configs[configindex].numbufferedffts; }
+  inline spectraprecision getSpectraPrecision(int configindex) const { return configs[configindex].spectraprec; }
   inline int getThreadResultLength(int configindex) const { return configs[configindex].threadresultlength; }
   inline int getCoreResultLength(int configindex) const { return configs[configindex].coreresultlength; }
   inline long long getMaxThreadResultLength() const { return maxthreadresultlength; }
@@ -749,6 +756,7 @@ private:
     int xmacstridelen;
     int rotatestridelen;
     int numbufferedffts;
+    spectraprecision spectraprec;
     bool writeautocorrs;
     bool pulsarbin;
     bool phasedarray;
@@ -1031,16 +1039,19 @@ private:
   /// Constant for the default number of channels for visibilities sent to monitor (STA or LTA)
   static const int DEFAULT_MONITOR_NUMCHANNELS = 32;
 
+  /// Number of subintegrations each Core buffers if CORE RING LENGTH is not given in the input file
+  static const int DEFAULT_CORE_RING_LENGTH = 4;
+
   const int mpiid;
   MPI_Comm mpicomm;
   const bool enableMpi;
   char header[MAX_KEY_LENGTH];
   bool commonread, configread, datastreamread, freqread, ruleread, baselineread;
   bool consistencyok, commandthreadinitialised, commandthreadfailed, dumpsta, dumplta, dumpkurtosis;
-  int visbufferlength, databufferfactor, numdatasegments;
+  int visbufferlength, coreringlength, databufferfactor, numdatasegments;
   int numdatastreams, numbaselines, numcoreconfs;
   int executeseconds, startmjd, startseconds, startns;
-  double restartseconds;
+  double restartseconds, rfiskthreshold, rfifftthreshold;
   int maxnumchannels, maxnumpulsarbins;
   long long maxthreadresultlength, maxcoreresultlength;
   int maxnumbufferedffts, mtu;
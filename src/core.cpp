@@ -30,8 +30,8 @@
 #include "alert.h"
 #include "config.h"
 
-Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
-  : mpiid(id), config(conf), return_comm(rcomm)
+Core::Core(int id, Configuration * conf, int * dids, int aid, MPI_Comm rcomm)
+  : mpiid(id), aggregatorid(aid), config(conf), return_comm(rcomm)
 {
   int status, perr;
   double guardratio, maxguardratio;
@@ -49,6 +49,7 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   maxthreadresultlength = config->getMaxThreadResultLength();
   maxcoreresultlength = config->getMaxCoreResultLength();
   numprocessthreads = config->getCNumProcessThreads(mpiid - numdatastreams - fxcorr::FIRSTTELESCOPEID);
+  receiveringlength = config->getCoreRingLength();
   currentconfigindex = 0;
   numreceived = 0;
   startmjd = config->getStartMJD();
@@ -76,10 +77,10 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   }
   databytes += overheadbytes;
 
-  //allocate the send/receive circular buffer (length RECEIVE_RING_LENGTH)
+  //allocate the send/receive circular buffer (length receiveringlength)
   controllength = config->getMaxBlocksPerSend() + 4;
-  procslots = new processslot[RECEIVE_RING_LENGTH];
-  for(int i=0;i<RECEIVE_RING_LENGTH;i++)
+  procslots = new processslot[receiveringlength];
+  for(int i=0;i<receiveringlength;i++)
   {
     procslots[i].results = vectorAlloc_cf32(maxcoreresultlength);
     procslots[i].floatresults = (f32*)procslots[i].results;
@@ -88,18 +89,20 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
     if(status != vecNoErr)
       csevere << startl << "Error trying to zero results in core " << mpiid << ", processing slot " << i << endl;
     procslots[i].resultsvalid = CR_VALIDVIS;
+    procslots[i].resultssending = false;
     procslots[i].configindex = currentconfigindex;
     procslots[i].threadresultlength = config->getThreadResultLength(currentconfigindex);
     procslots[i].coreresultlength = config->getCoreResultLength(currentconfigindex);
-    procslots[i].slotlocks = new pthread_mutex_t[numprocessthreads];
+    procslots[i].chunkqueues = new u64[numprocessthreads*CHUNK_QUEUE_STRIDE];
+    procslots[i].numchunks = 0;
+    procslots[i].chunkblocks = 0;
+    procslots[i].xcintervalsperchunk = 0;
+    procslots[i].phasecentredelaylength = 0;
+    procslots[i].phasecentredelays = 0;
+    procslots[i].threadsfinished = numprocessthreads; //free to be received into
     procslots[i].viscopylocks = new pthread_mutex_t*[config->getFreqTableLength()];
     for(int j=0;j<config->getFreqTableLength();j++)
       procslots[i].viscopylocks[j] = new pthread_mutex_t[numbaselines];
-    for(int j=0;j<numprocessthreads;j++) {
-      perr = pthread_mutex_init(&(procslots[i].slotlocks[j]), NULL);
-      if(perr != 0)
-        csevere << startl << "Problem initialising processthread " << j << " lock in slot " << i << "(" << perr << ")" << endl;
-    }
     for(int j=0;j<config->getFreqTableLength();j++)
     {
       for(int k=0;k<numbaselines;k++) {
@@ -123,6 +126,7 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
     procslots[i].datalengthbytes = new int[numdatastreams];
     procslots[i].databuffer = new u8*[numdatastreams];
     procslots[i].controlbuffer = new s32*[numdatastreams];
+    procslots[i].recvrequests = new MPI_Request[2*numdatastreams];
     procslots[i].keepprocessing = true;
     procslots[i].numpulsarbins = config->getNumPulsarBins(currentconfigindex);
     procslots[i].scrunchoutput = config->scrunchOutputOn(currentconfigindex);
@@ -133,6 +137,9 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
       procslots[i].controlbuffer[j] = vectorAlloc_s32(controllength);
       estimatedbytes += databytes;
       estimatedbytes += controllength*4;
+      //the buffers and sources never change, so the receives are set up once and restarted for every subint
+      MPI_Recv_init(procslots[i].databuffer[j], databytes, MPI_UNSIGNED_CHAR, dids[j], CR_PROCESSDATA, MPI_COMM_WORLD, &(procslots[i].recvrequests[j]));
+      MPI_Recv_init(procslots[i].controlbuffer[j], controllength, MPI_INT, dids[j], CR_PROCESSCONTROL, MPI_COMM_WORLD, &(procslots[i].recvrequests[numdatastreams + j]));
     }
   }
 
@@ -142,16 +149,29 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   processconds = new pthread_cond_t[numprocessthreads];
   processthreadinitialised = new bool[numprocessthreads];
   threadbytes = new long long[numprocessthreads];
+  threadbusytime = new double[numprocessthreads];
+  threadidletime = new double[numprocessthreads];
+  threadchunksstolen = new long long[numprocessthreads];
   for(int i=0;i<numprocessthreads;i++)
   {
     pthread_cond_init(&processconds[i], NULL);
     processthreadinitialised[i] = false;
     threadbytes[i] = 8*maxthreadresultlength;
-  }
+    threadbusytime[i] = 0.0;
+    threadidletime[i] = 0.0;
+    threadchunksstolen[i] = 0;
+  }
+  numslotsready = 0;
+  datawaittime = 0.0;
+  processwaittime = 0.0;
+  sendwaittime = 0.0;
+  perr = pthread_mutex_init(&slotstatelock, NULL);
+  if(perr != 0)
+    csevere << startl << "Problem initialising slot state lock (" << perr << ")" << endl;
+  pthread_cond_init(&slotreadycond, NULL);
+  pthread_cond_init(&slotfinishedcond, NULL);
 
   //initialise the MPI communication objects
-  datarequests = new MPI_Request[numdatastreams];
-  controlrequests = new MPI_Request[numdatastreams];
   msgstatuses = new MPI_Status[numdatastreams];
 
   //copy the datastream ids
@@ -163,34 +183,42 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   difxMessageInitBinary();
 }
 
-const int Core::RECEIVE_RING_LENGTH = 4;
 const double Core::MINIMUM_FILTERBANK_WEIGHT = 0.333;
+const int Core::XMAC_TILE_LENGTH = 128;
+const int Core::CHUNKS_PER_THREAD = 4;
+const int Core::CHUNK_QUEUE_STRIDE = 8;
+const int Core::MIN_VECTOR_BIN_RUN = 8;
+const int Core::ARENA_ALIGNMENT = 64;
 
 Core::~Core()
 {
-  for(int i=0;i<RECEIVE_RING_LENGTH;i++)
+  for(int i=0;i<receiveringlength;i++)
   {
     for(int j=0;j<numdatastreams;j++)
     {
       vectorFree(procslots[i].databuffer[j]);
       vectorFree(procslots[i].controlbuffer[j]);
     }
-    delete [] procslots[i].slotlocks;
+    delete [] procslots[i].chunkqueues;
+    if(procslots[i].phasecentredelays)
+      vectorFree(procslots[i].phasecentredelays);
     for(int j=0;j<config->getFreqTableLength();j++)
       delete [] procslots[i].viscopylocks[j];
     delete [] procslots[i].viscopylocks;
     delete [] procslots[i].datalengthbytes;
     delete [] procslots[i].databuffer;
     delete [] procslots[i].controlbuffer;
+    delete [] procslots[i].recvrequests;
     vectorFree(procslots[i].results);
   }
   delete [] threadbytes;
+  delete [] threadbusytime;
+  delete [] threadidletime;
+  delete [] threadchunksstolen;
   delete [] processthreads;
   delete [] processconds;
   delete [] processthreadinitialised;
   delete [] procslots;
-  delete [] datarequests;
-  delete [] controlrequests;
   delete [] msgstatuses;
   delete [] datastreamids;
 }
@@ -198,8 +226,10 @@ Core::~Core()
 
 void Core::execute()
 {
-  int perr, status, lastconfigindex, adjust, countdown, tounlock;
+  int perr, lastconfigindex, numunsent, index;
   bool terminate;
+  double busy, idle, minbusyfraction, maxbusyfraction;
+  long long stolen, totalstolen;
   processthreadinfo * threadinfos = new processthreadinfo[numprocessthreads];
   pthread_attr_t attr;
 
@@ -207,17 +237,9 @@ void Core::execute()
   numreceived = 0;
   cverbose << startl << "Core " << mpiid << " has started executing!!! Numprocessthreads is " << numprocessthreads << endl;
 
-  //get the lock for the first slot, one per thread
-  for(int i=0;i<numprocessthreads;i++)
-  {
-    perr = pthread_mutex_lock(&(procslots[numreceived].slotlocks[i]));
-    if(perr != 0)
-      csevere << startl << "Error in Core " << mpiid << " attempt to lock mutex" << numreceived << " of thread " << i << endl;
-  }
-
   //cverbose << startl << "Core about to fill up receive ring buffer" << endl;
-  //start off by filling up the data and control buffers for all slots
-  for(int i=0;i<RECEIVE_RING_LENGTH-1;i++)
+  //start off by filling up the data and control buffers for all slots but one
+  for(int i=0;i<receiveringlength-1;i++)
   {
     if(!terminate)
       numreceived += receivedata(numreceived, &terminate);
@@ -227,41 +249,17 @@ void Core::execute()
   if(numreceived == 0) //such a short job, I had nothing to do!
   {
     cinfo << startl << "Received no data before being told to shut down - shutting down quietly..." << endl;
-    //unlock the mutex that is held, and simply return
-    for(int i=0;i<numprocessthreads;i++)
-    {
-      perr = pthread_mutex_unlock(&(procslots[0].slotlocks[i]));
-      if(perr != 0)
-        csevere << startl << "Error in main thread attempting to unlock mutex " << 0 << "/" << i << " when shutting down an unused Core node!" << endl;
-    }
+    if(aggregatorid >= 0)
+      MPI_Send(procslots[0].aggregateheader, 0, MPI_INT, aggregatorid, CR_TERMINATE, return_comm);
     delete [] threadinfos;
     return;
   }
-  else if (numreceived < RECEIVE_RING_LENGTH-1) //didn't get a full buffer before job ended. Proceed with caution
+  else if (numreceived < receiveringlength-1) //didn't get a full buffer before job ended. Proceed with caution
   {
     cinfo << startl << "Processing buffer was not completely filled before job termination - ensuring all subintegrations are safely processed" << endl;
-    //unlock the held mutex and instead lock the last one, where we should have made it to
-    for(int i=0;i<numprocessthreads;i++)
-    {
-      perr = pthread_mutex_unlock(&(procslots[numreceived].slotlocks[i]));
-      if(perr != 0)
-        csevere << startl << "Error in main thread attempting to unlock mutex " << numreceived << "/" << i << " when shutting down an underused Core node!" << endl;
-      perr = pthread_mutex_lock(&(procslots[RECEIVE_RING_LENGTH-1].slotlocks[i]));
-      if(perr != 0)
-        csevere << startl << "Error in main thread attempting to lock mutex " << RECEIVE_RING_LENGTH-1 << " of thread " << i << " during startup" << endl;
-    }
-  }
-
-  //also lock the second last slot, to keep any cheeky thread from getting round the entire
-  //RECEIVE_RING before we wake back up
-  for(int i=0;i<numprocessthreads;i++)
-  {
-    perr = pthread_mutex_lock(&(procslots[RECEIVE_RING_LENGTH-2].slotlocks[i]));
-    if(perr != 0)
-      csevere << startl << "Error in main thread attempting to lock mutex " << RECEIVE_RING_LENGTH-2 << " of thread " << i << " during startup" << endl;
   }
 
-  //now we have the lock on the last two slots in the ring.  Launch processthreads
+  //Launch processthreads
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
   for(int i=0;i<numprocessthreads;i++)
@@ -274,95 +272,69 @@ void Core::execute()
   }
   pthread_attr_destroy(&attr);
 
-  //wait til they are all initialised (and hence have a lock of their own)
+  //wait til they are all initialised (and hence have allocated their memory)
+  perr = pthread_mutex_lock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "Error in main thread attempting to lock slot state mutex during startup" << endl;
   for(int i=0;i<numprocessthreads;i++)
   {
     while(!processthreadinitialised[i])
     {
-      perr = pthread_cond_wait(&processconds[i], &(procslots[RECEIVE_RING_LENGTH-1].slotlocks[i]));
+      perr = pthread_cond_wait(&processconds[i], &slotstatelock);
       if (perr != 0)
         csevere << startl << "Error waiting on processthreadinitialised condition!!!!" << endl;
     }
   }
-
-  //now we definitely have our lock back on the last slot in the buffer,
-  //release that supplementary lock (2nd last in buffer)
-  for(int i=0;i<numprocessthreads;i++)
-  {
-    perr = pthread_mutex_unlock(&(procslots[RECEIVE_RING_LENGTH-2].slotlocks[i]));
-    if(perr != 0)
-      csevere << startl << "Error in main thread attempting to lock mutex " << RECEIVE_RING_LENGTH-2 << " of thread " << i << " during startup" << endl;
-  }
+  perr = pthread_mutex_unlock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "Error in main thread attempting to unlock slot state mutex during startup" << endl;
 
   cverbose << startl << "Estimated memory usage by Core is now " << getEstimatedBytes()/(1024.0*1024.0) << " MB" << endl;
   lastconfigindex = procslots[0].configindex;
   while(!terminate) //the data is valid, so keep processing
   {
     //increment and receive some more data
-    numreceived += receivedata(numreceived % RECEIVE_RING_LENGTH, &terminate);
+    numreceived += receivedata(numreceived % receiveringlength, &terminate);
 
     //send off a message if we are back at the start of the buffer
-//    if(numreceived % RECEIVE_RING_LENGTH == 0)
-//      cverbose << startl << "CORE: " << numreceived-(numcomplete+1) << " unprocessed segments, 1 being processed, and " << RECEIVE_RING_LENGTH-(numreceived-numcomplete) << " to be sent" << endl;
+//    if(numreceived % receiveringlength == 0)
+//      cverbose << startl << "CORE: " << numreceived-(numcomplete+1) << " unprocessed segments, 1 being processed, and " << receiveringlength-(numreceived-numcomplete) << " to be sent" << endl;
 
     if(terminate)
       break;
 
-    //send the results back
-    MPI_Ssend(procslots[numreceived%RECEIVE_RING_LENGTH].results, procslots[numreceived%RECEIVE_RING_LENGTH].coreresultlength*2, MPI_FLOAT, fxcorr::MANAGERID, procslots[numreceived%RECEIVE_RING_LENGTH].resultsvalid, return_comm);
-    if(procslots[numreceived%RECEIVE_RING_LENGTH].configindex != lastconfigindex)
+    //wait for the oldest slot to be finished with, then start sending the results back
+    //(the send is completed, and the results zeroed, when this slot is next received into)
+    index = numreceived%receiveringlength;
+    waitforslotfinished(index);
+    sendresults(index);
+    if(procslots[index].configindex != lastconfigindex)
     {
       cverbose << startl << "After config change, estimated memory usage by Core is " << getEstimatedBytes()/(1024.0*1024.0) << " MB" << endl;
     }
-
-    //zero the results buffer for this slot and set the status back to valid
-    status = vectorZero_cf32(procslots[numreceived%RECEIVE_RING_LENGTH].results, procslots[numreceived%RECEIVE_RING_LENGTH].coreresultlength);
-    if(status != vecNoErr)
-      csevere << startl << "Error trying to zero results in Core!!!" << endl;
-    procslots[numreceived%RECEIVE_RING_LENGTH].resultsvalid = CR_VALIDVIS;
   }
 
-  tounlock = numreceived % RECEIVE_RING_LENGTH;
-  if(numreceived < RECEIVE_RING_LENGTH-1)
-    tounlock = RECEIVE_RING_LENGTH-1; //adjusted lock in the case of a short job
-
-  //Run through the shutdown sequence
-  for(int i=0;i<numprocessthreads;i++)
+  //ensure all the results we have sitting around have been sent
+  numunsent = (numreceived < receiveringlength-1)?numreceived:receiveringlength-1;
+  for(int i=numreceived-numunsent;i<numreceived;i++)
   {
-    //Unlock the mutex we are currently holding for this thread
-    perr = pthread_mutex_unlock(&(procslots[tounlock].slotlocks[i]));
-    if(perr != 0)
-      csevere << startl << "Error in Core " << mpiid << " attempt to unlock mutex" << tounlock << " of thread " << i << endl;
+//    cinfo << startl << "Core " << mpiid << " about to send final values from section " << i%receiveringlength << endl;
+    index = i%receiveringlength;
+    waitforslotfinished(index);
+    sendresults(index);
   }
+  for(int i=0;i<receiveringlength;i++)
+    completeresultsend(i);
 
-  adjust = 0;
-  countdown = RECEIVE_RING_LENGTH-1;
-  if(numreceived < RECEIVE_RING_LENGTH-1) {
-    adjust = (RECEIVE_RING_LENGTH-1)-numreceived;
-    countdown = numreceived;
-  }
+  //let the Aggregator know there will be nothing more from this Core
+  if(aggregatorid >= 0)
+    MPI_Send(procslots[0].aggregateheader, 0, MPI_INT, aggregatorid, CR_TERMINATE, return_comm);
 
-  //ensure all the results we have sitting around have been sent
-  for(int i=1;i<RECEIVE_RING_LENGTH;i++)
+  //release the persistent receives while MPI is still running (they are all inactive by now)
+  for(int i=0;i<receiveringlength;i++)
   {
-    if(countdown == 0)
-      break;
-
-//    cinfo << startl << "Core " << mpiid << " about to send final values from section " << i << endl;
-    for(int j=0;j<numprocessthreads;j++)
-    {
-      //Lock and unlock first to ensure the threads have finished working on this slot
-      perr = pthread_mutex_lock(&(procslots[(numreceived+i+adjust) % RECEIVE_RING_LENGTH].slotlocks[j]));
-      if(perr != 0)
-        csevere << startl << "Error in Core " << mpiid << " attempt to unlock mutex" << (numreceived+i+adjust) % RECEIVE_RING_LENGTH << " of thread " << j << endl;
-      perr = pthread_mutex_unlock(&(procslots[(numreceived+i+adjust) % RECEIVE_RING_LENGTH].slotlocks[j]));
-      if(perr != 0)
-        csevere << startl << "Error in Core " << mpiid << " attempt to unlock mutex" << (numreceived+i+adjust) % RECEIVE_RING_LENGTH << " of thread " << j << endl;
-    }
-    //send the results
-    MPI_Ssend(procslots[(numreceived+i+adjust)%RECEIVE_RING_LENGTH].results, procslots[(numreceived+i+adjust)%RECEIVE_RING_LENGTH].coreresultlength*2, MPI_FLOAT, fxcorr::MANAGERID, procslots[(numreceived+i+adjust)%RECEIVE_RING_LENGTH].resultsvalid, return_comm);
-
-    countdown--;
+    for(int j=0;j<2*numdatastreams;j++)
+      MPI_Request_free(&(procslots[i].recvrequests[j]));
   }
 
 //  cinfo << startl << "CORE " << mpiid << " is about to join the processthreads" << endl;
@@ -376,6 +348,25 @@ void Core::execute()
   }
   delete [] threadinfos;
 
+  //summarise how evenly the work was shared between the threads
+  minbusyfraction = 1.0;
+  maxbusyfraction = 0.0;
+  totalstolen = 0;
+  for(int i=0;i<numprocessthreads;i++)
+  {
+    getThreadUtilisation(i, busy, idle, stolen);
+    if(busy + idle > 0.0)
+    {
+      if(busy/(busy + idle) < minbusyfraction)
+        minbusyfraction = busy/(busy + idle);
+      if(busy/(busy + idle) > maxbusyfraction)
+        maxbusyfraction = busy/(busy + idle);
+    }
+    totalstolen += stolen;
+  }
+  cinfo << startl << "Core " << mpiid << " processthreads were busy between " << 100.0*minbusyfraction << "% and " << 100.0*maxbusyfraction << "% of the time; " << totalstolen << " chunks were stolen" << endl;
+  cinfo << startl << "Core " << mpiid << " main thread (ring length " << receiveringlength << ") waited " << datawaittime << " s for data, " << processwaittime << " s for processthreads and " << sendwaittime << " s for result sends" << endl;
+
 //  cinfo << startl << "CORE " << mpiid << " terminating" << endl;
 }
 
@@ -395,11 +386,27 @@ long long Core::getEstimatedBytes()
   return toreturn;
 }
 
+void Core::getMainThreadWaits(double & datawait, double & processwait, double & sendwait)
+{
+  datawait = datawaittime;
+  processwait = processwaittime;
+  sendwait = sendwaittime;
+}
+
+void Core::getThreadUtilisation(int threadid, double & busyseconds, double & idleseconds, long long & chunksstolen)
+{
+  busyseconds = threadbusytime[threadid];
+  idleseconds = threadidletime[threadid];
+  chunksstolen = threadchunksstolen[threadid];
+}
+
 void Core::loopprocess(int threadid)
 {
-  int perr, numprocessed, startblock, numblocks, lastconfigindex, numpolycos, maxchan, maxpolycos, stadumpchannels, strideplussteplen, maxrotatestrideplussteplength, maxxmaclength, slen;
-  double sec;
-  bool pulsarbin, somepulsarbin, somescrunch, dumpingsta, nowdumpingsta;
+  int perr, numprocessed, index, chunk, startblock, numblocks, blockspersend, lastconfigindex, numpolycos, maxchan, maxpolycos, stadumpchannels, maxxmaclength, minxmaclength, maxbufferedffts, maxphasecentres, maxshiftvectors;
+  int kurtosisblocks, kurtosisstart, kurtosisend;
+  double sec, t0, blockns;
+  long long chunksprocessed;
+  bool pulsarbin, somepulsarbin, dumpingsta, nowdumpingsta, stolen;
   processslot * currentslot;
   Polyco ** polycos=0;
   Polyco * currentpolyco=0;
@@ -407,8 +414,6 @@ void Core::loopprocess(int threadid)
   threadscratchspace * scratchspace = new threadscratchspace;
   scratchspace->shifterrorcount = 0;
   scratchspace->threadcrosscorrs = vectorAlloc_cf32(maxthreadresultlength);
-  scratchspace->baselineweight = new f32***[config->getFreqTableLength()];
-  scratchspace->baselineshiftdecorr = new f32**[config->getFreqTableLength()];
   if(scratchspace->threadcrosscorrs == NULL) {
     cfatal << startl << "Could not allocate thread cross corr space (tried to allocate " << maxthreadresultlength/(1024*1024) << " MB)!!! Aborting." << endl;
     MPI_Abort(MPI_COMM_WORLD, 1);
@@ -416,33 +421,73 @@ void Core::loopprocess(int threadid)
 
   scratchspace->pulsarscratchspace=0;
   scratchspace->pulsaraccumspace=0;
+  scratchspace->bins = 0;
+  scratchspace->binruns = 0;
+  scratchspace->configarena = 0;
+  scratchspace->configarenabytes = 0;
   scratchspace->starecordbuffer = 0;
 
   pulsarbin = false;
   somepulsarbin = false;
-  somescrunch = false;
   dumpingsta = false;
   maxpolycos = 0;
   maxchan = config->getMaxNumChannels();
-  slen = config->getRotateStrideLength(0);
-  maxrotatestrideplussteplength = slen + maxchan/slen;
   maxxmaclength = config->getXmacStrideLength(0);
+  minxmaclength = maxxmaclength;
+  maxbufferedffts = config->getNumBufferedFFTs(0);
+  maxphasecentres = config->getMaxPhaseCentres(0);
+  maxshiftvectors = 4*(config->pulsarBinOn(0)?config->getNumPulsarBins(0):1);
   for(int i=1;i<config->getNumConfigs();i++)
   {
-    slen = config->getRotateStrideLength(i);
-    strideplussteplen = slen + maxchan/slen;
-    if(strideplussteplen > maxrotatestrideplussteplength)
-      maxrotatestrideplussteplength = strideplussteplen;
     if(config->getXmacStrideLength(i) > maxxmaclength)
       maxxmaclength = config->getXmacStrideLength(i);
+    if(config->getXmacStrideLength(i) < minxmaclength)
+      minxmaclength = config->getXmacStrideLength(i);
+    if(config->getNumBufferedFFTs(i) > maxbufferedffts)
+      maxbufferedffts = config->getNumBufferedFFTs(i);
+    if(config->getMaxPhaseCentres(i) > maxphasecentres)
+      maxphasecentres = config->getMaxPhaseCentres(i);
+    if(config->pulsarBinOn(i) && 4*config->getNumPulsarBins(i) > maxshiftvectors)
+      maxshiftvectors = 4*config->getNumPulsarBins(i);
   }
-  scratchspace->chanfreqs = vectorAlloc_f64(maxrotatestrideplussteplength);
-  scratchspace->rotator = vectorAlloc_cf32(maxrotatestrideplussteplength);
   scratchspace->rotated = vectorAlloc_cf32(maxchan);
   scratchspace->channelsums = vectorAlloc_cf32(maxchan);
-  scratchspace->argument = vectorAlloc_f32(3*maxrotatestrideplussteplength);
-  // FIXME: explicitly calculate "28" below.
-  threadbytes[threadid] += 16*maxchan + 28*maxrotatestrideplussteplength;
+  threadbytes[threadid] += 16*maxchan;
+
+  //the engine for shifting to multiple phase centres, with its delays and per polarisation product (and bin) pointers
+  scratchspace->uvshifter = 0;
+  scratchspace->shiftdelays = 0;
+  scratchspace->shiftvis = 0;
+  scratchspace->shiftout = 0;
+  if(maxphasecentres > 1)
+  {
+    scratchspace->uvshifter = new UVShifter(maxphasecentres, maxxmaclength, maxchan/minxmaclength);
+    scratchspace->shiftdelays = vectorAlloc_f64(maxphasecentres);
+    scratchspace->shiftvis = new const cf32*[maxshiftvectors*(maxchan/minxmaclength)];
+    scratchspace->shiftout = new cf32*[maxshiftvectors];
+    threadbytes[threadid] += 8*(UVShifter::PHASE_CENTRE_BLOCK+1)*maxxmaclength + 8*UVShifter::PHASE_CENTRE_BLOCK*(maxchan/minxmaclength) + 24*maxphasecentres + sizeof(cf32*)*maxshiftvectors*(maxchan/minxmaclength + 1);
+  }
+
+  //pointer tables for the tiled xmac - at most 4 polarisation products per baseline
+  scratchspace->xmacvis1 = new const cf32*[numbaselines*4*maxbufferedffts];
+  scratchspace->xmacvis2 = new const cf32*[numbaselines*4*maxbufferedffts];
+  scratchspace->xmacaccumulators = new cf32*[numbaselines*4];
+  threadbytes[threadid] += sizeof(cf32*)*numbaselines*4*(2*maxbufferedffts + 1);
+  scratchspace->xmacpackedvis1 = 0;
+  scratchspace->xmacpackedvis2 = 0;
+  scratchspace->xmacscales1 = 0;
+  scratchspace->xmacscales2 = 0;
+  for(int i=0;i<config->getNumConfigs();i++)
+  {
+    if(config->getSpectraPrecision(i) != Configuration::FLOAT32SPECTRA && scratchspace->xmacpackedvis1 == 0)
+    {
+      scratchspace->xmacpackedvis1 = new const u8*[numbaselines*4*maxbufferedffts];
+      scratchspace->xmacpackedvis2 = new const u8*[numbaselines*4*maxbufferedffts];
+      scratchspace->xmacscales1 = new const f32*[numbaselines*4];
+      scratchspace->xmacscales2 = new const f32*[numbaselines*4];
+      threadbytes[threadid] += sizeof(u8*)*numbaselines*4*(2*maxbufferedffts + 2);
+    }
+  }
 
   //work out whether we'll need to do any pulsar binning, and work out the maximum # channels (and # polycos if applicable)
   for(int i=0;i<config->getNumConfigs();i++)
@@ -450,7 +495,6 @@ void Core::loopprocess(int threadid)
     if(config->pulsarBinOn(i))
     {
       somepulsarbin = true;
-      somescrunch = somescrunch || config->scrunchOutputOn(i);
       numpolycos = config->getNumPolycos(i);
       if(numpolycos > maxpolycos)
         maxpolycos = numpolycos;
@@ -459,50 +503,56 @@ void Core::loopprocess(int threadid)
 
   //create the necessary pulsar scratch space if required
   if(somepulsarbin)
-  {
     scratchspace->pulsarscratchspace = vectorAlloc_cf32(maxxmaclength);
-    if(somescrunch) //need separate accumulation space
-    {
-      scratchspace->pulsaraccumspace = new cf32******[config->getFreqTableLength()];
-    }
-    createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), procslots[0].configindex, -1, threadid); //don't need to delete old space
-  }
 
-  //create the baselineweight and xmacstrideoffset arrays
-  allocateConfigSpecificThreadArrays(scratchspace->baselineweight, scratchspace->baselineshiftdecorr, procslots[0].configindex, -1, threadid); //don't need to delete old space
+  //lay out the baseline weights and the pulsar bin and accumulation space for the first config
+  allocateConfigSpecificThreadSpace(scratchspace, procslots[0].configindex, threadid);
 
   //set to first configuration and set up, creating Modes, Polycos etc
   lastconfigindex = procslots[0].configindex;
   modes = new Mode*[numdatastreams];
   if(somepulsarbin)
     polycos = new Polyco*[maxpolycos];
-  updateconfig(lastconfigindex, lastconfigindex, threadid, startblock, numblocks, numpolycos, pulsarbin, modes, polycos, true);
+  updateconfig(lastconfigindex, lastconfigindex, threadid, numpolycos, pulsarbin, modes, polycos, true);
   numprocessed = 0;
-//  cinfo << startl << "Core thread id " << threadid << " will be processing from block " << startblock << ", length " << numblocks << endl;
+  chunksprocessed = 0;
 
-  //lock the end section
-  perr = pthread_mutex_lock(&(procslots[RECEIVE_RING_LENGTH-1].slotlocks[threadid]));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex " << RECEIVE_RING_LENGTH-1 << endl;
-
-  //grab the lock we really want, unlock the end section and signal the main thread we're ready to go
-  perr = pthread_mutex_lock(&(procslots[0].slotlocks[threadid]));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex 0" << endl; 
-  perr = pthread_mutex_unlock(&(procslots[RECEIVE_RING_LENGTH-1].slotlocks[threadid]));
+  //signal the main thread we're ready to go
+  perr = pthread_mutex_lock(&slotstatelock);
   if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << RECEIVE_RING_LENGTH-1 << endl;
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock slot state mutex" << endl;
   processthreadinitialised[threadid] = true;
   perr = pthread_cond_signal(&processconds[threadid]);
   if(perr != 0)
     csevere << startl << "Core processthread " << mpiid << "/" << threadid << " error trying to signal main thread to wake up!!!" << endl;
+  perr = pthread_mutex_unlock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock slot state mutex" << endl;
   if(threadid == 0)
     cinfo << startl << "Core " << mpiid << " PROCESSTHREAD " << threadid+1 << "/" << numprocessthreads << " is about to start processing" << endl;
 
   //while valid, process data
-  while(procslots[(numprocessed)%RECEIVE_RING_LENGTH].keepprocessing)
+  while(true)
   {
-    currentslot = &(procslots[numprocessed%RECEIVE_RING_LENGTH]);
+    //wait for the next slot in sequence to arrive
+    t0 = MPI_Wtime();
+    waitforslot(numprocessed);
+    threadidletime[threadid] += MPI_Wtime() - t0;
+    index = numprocessed%receiveringlength;
+    currentslot = &(procslots[index]);
+    if(!currentslot->keepprocessing)
+      break;
+
+    //if the configuration changes from the last segment to this one, change our setup accordingly
+    if(currentslot->configindex != lastconfigindex)
+    {
+      cinfo << startl << "Core " << mpiid << " threadid " << threadid << ": changing config to " << currentslot->configindex << endl;
+      updateconfig(lastconfigindex, currentslot->configindex, threadid, numpolycos, pulsarbin, modes, polycos, false);
+      cinfo << startl << "Core " << mpiid << " threadid " << threadid << ": config changed successfully - pulsarbin is now " << pulsarbin << endl;
+      allocateConfigSpecificThreadSpace(scratchspace, currentslot->configindex, threadid);
+      lastconfigindex = currentslot->configindex;
+    }
+
     if(pulsarbin)
     {
       sec = double(startseconds + model->getScanStartSec(currentslot->offsets[0], startmjd, startseconds) + currentslot->offsets[1]) + ((double)currentslot->offsets[2])/1000000000.0;
@@ -535,30 +585,59 @@ void Core::loopprocess(int threadid)
       dumpingsta = nowdumpingsta;
     }
 
-    //process our section of responsibility for this time range
-    processdata(numprocessed++ % RECEIVE_RING_LENGTH, threadid, startblock, numblocks, modes, currentpolyco, scratchspace);
+    //the kurtosis accumulates over every chunk this thread takes, giving one record per thread per slot
+    if(scratchspace->dumpkurtosis)
+    {
+      for(int j=0;j<numdatastreams;j++)
+        modes[j]->zeroKurtosis();
+    }
+    kurtosisblocks = 0;
 
-    if(threadid == 0)
-      numcomplete++;
+    //work through our own queue of chunks for this time range, then help out the other threads
+    blockspersend = config->getBlocksPerSend(currentslot->configindex);
+    while((chunk = takechunk(index, threadid, stolen)) >= 0)
+    {
+      startblock = chunk*currentslot->chunkblocks;
+      numblocks = currentslot->chunkblocks;
+      if(startblock + numblocks > blockspersend)
+        numblocks = blockspersend - startblock;
+      if(kurtosisblocks == 0 || startblock < kurtosisstart)
+        kurtosisstart = startblock;
+      if(kurtosisblocks == 0 || startblock + numblocks > kurtosisend)
+        kurtosisend = startblock + numblocks;
+      kurtosisblocks += numblocks;
+      t0 = MPI_Wtime();
+      processdata(index, threadid, startblock, numblocks, modes, currentpolyco, scratchspace);
+      threadbusytime[threadid] += MPI_Wtime() - t0;
+      chunksprocessed++;
+      if(stolen)
+        threadchunksstolen[threadid]++;
+    }
+    if(scratchspace->dumpkurtosis && kurtosisblocks > 0)
+    {
+      blockns = ((double)(config->getSubintNS(currentslot->configindex)))/((double)blockspersend);
+      averageAndSendKurtosis(index, threadid, 0.5*(kurtosisstart + kurtosisend)*blockns, (kurtosisend - kurtosisstart)*blockns, kurtosisblocks, modes, scratchspace);
+    }
 
-    currentslot = &(procslots[numprocessed%RECEIVE_RING_LENGTH]);
-    //if the configuration changes from this segment to the next, change our setup accordingly
-    if(currentslot->configindex != lastconfigindex)
+    //let the main thread know if we were the last one working on this slot
+    if(__sync_add_and_fetch(&(currentslot->threadsfinished), 1) == numprocessthreads)
     {
-      cinfo << startl << "Core " << mpiid << " threadid " << threadid << ": changing config to " << currentslot->configindex << endl;
-      updateconfig(lastconfigindex, currentslot->configindex, threadid, startblock, numblocks, numpolycos, pulsarbin, modes, polycos, false);
-      cinfo << startl << "Core " << mpiid << " threadid " << threadid << ": config changed successfully - pulsarbin is now " << pulsarbin << endl;
-      createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), currentslot->configindex, lastconfigindex, threadid);
-      allocateConfigSpecificThreadArrays(scratchspace->baselineweight, scratchspace->baselineshiftdecorr, currentslot->configindex, lastconfigindex, threadid);
-      lastconfigindex = currentslot->configindex;
+      perr = pthread_mutex_lock(&slotstatelock);
+      if(perr != 0)
+        csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock slot state mutex" << endl;
+      pthread_cond_signal(&slotfinishedcond);
+      perr = pthread_mutex_unlock(&slotstatelock);
+      if(perr != 0)
+        csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock slot state mutex" << endl;
     }
+
+    if(threadid == 0)
+      numcomplete++;
+    numprocessed++;
   }
 
-  //fallen out of loop, so must be finished.  Unlock held mutex
+  //fallen out of loop, so must be finished
 //  cinfo << startl << "PROCESS " << mpiid << "/" << threadid << " process thread about to free resources and exit" << endl;
-  perr = pthread_mutex_unlock(&(procslots[numprocessed % RECEIVE_RING_LENGTH].slotlocks[threadid]));
-  if (perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << (numprocessed)%RECEIVE_RING_LENGTH << endl;
 
   //free resources
   for(int j=0;j<numdatastreams;j++)
@@ -573,42 +652,54 @@ void Core::loopprocess(int threadid)
     }
     delete [] polycos;
     vectorFree(scratchspace->pulsarscratchspace);
-    createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), -1,
-    procslots[(numprocessed+1)%RECEIVE_RING_LENGTH].configindex, threadid);
-    if(somescrunch)
-    {
-      delete [] scratchspace->pulsaraccumspace;
-    }
   }
+  allocateConfigSpecificThreadSpace(scratchspace, -1, threadid);
   vectorFree(scratchspace->threadcrosscorrs);
-  vectorFree(scratchspace->chanfreqs);
-  vectorFree(scratchspace->rotator);
   vectorFree(scratchspace->rotated);
   vectorFree(scratchspace->channelsums);
-  vectorFree(scratchspace->argument);
+  if(scratchspace->uvshifter)
+  {
+    delete scratchspace->uvshifter;
+    vectorFree(scratchspace->shiftdelays);
+    delete [] scratchspace->shiftvis;
+    delete [] scratchspace->shiftout;
+  }
+  delete [] scratchspace->xmacvis1;
+  delete [] scratchspace->xmacvis2;
+  delete [] scratchspace->xmacaccumulators;
+  if(scratchspace->xmacpackedvis1)
+  {
+    delete [] scratchspace->xmacpackedvis1;
+    delete [] scratchspace->xmacpackedvis2;
+    delete [] scratchspace->xmacscales1;
+    delete [] scratchspace->xmacscales2;
+  }
   if(scratchspace->starecordbuffer != 0) {
     free(scratchspace->starecordbuffer);
   }
   delete scratchspace;
 
-  cinfo << startl << "PROCESS " << mpiid << "/" << threadid << " process thread exiting!!!" << endl;
+  cinfo << startl << "PROCESS " << mpiid << "/" << threadid << " process thread exiting!!! Busy for " << threadbusytime[threadid] << " s and idle for " << threadidletime[threadid] << " s, processed " << chunksprocessed << " chunks of which " << threadchunksstolen[threadid] << " were stolen" << endl;
 }
 
 int Core::receivedata(int index, bool * terminate)
 {
   MPI_Status mpistatus;
-  int perr;
+  double t0;
 
   if(*terminate)
     return 0; //don't try to read, we've already finished
 
   //Get the instructions on the time offset from the FxManager node
-  MPI_Recv(&(procslots[index].offsets), 3, MPI_INT, fxcorr::MANAGERID, MPI_ANY_TAG, return_comm, &mpistatus);
+  t0 = MPI_Wtime();
+  MPI_Recv(&(procslots[index].offsets), 4, MPI_INT, fxcorr::MANAGERID, MPI_ANY_TAG, return_comm, &mpistatus);
+  datawaittime += MPI_Wtime() - t0;
   if(mpistatus.MPI_TAG == CR_TERMINATE)
   {
     *terminate = true;
 //    cinfo << startl << "Core " << mpiid << " has received a terminate signal!!!" << endl;
     procslots[index].keepprocessing = false;
+    publishslot();
     return 0; //note return here!!!
   }
 
@@ -630,38 +721,396 @@ int Core::receivedata(int index, bool * terminate)
     procslots[index].pulsarbin = config->pulsarBinOn(currentconfigindex);
   }
 
-  //now grab the data and delay info from the individual datastreams
-  for(int i=0;i<numdatastreams;i++)
-  {
-    //cinfo << startl << "Core is about to post receive request for datastream " << i << endl;
-    //get data
-    MPI_Irecv(procslots[index].databuffer[i], databytes, MPI_UNSIGNED_CHAR, datastreamids[i], CR_PROCESSDATA, MPI_COMM_WORLD, &datarequests[i]);
-    //also receive the offsets and rates
-    MPI_Irecv(procslots[index].controlbuffer[i], controllength, MPI_INT, datastreamids[i], CR_PROCESSCONTROL, MPI_COMM_WORLD, &controlrequests[i]);
-  }
+  //now grab the data and delay info from the individual datastreams, using the receives set up for this slot
+  MPI_Startall(2*numdatastreams, procslots[index].recvrequests);
+
+  //while the data arrives, make sure the last results from this slot have gone and clear them
+  completeresultsend(index);
 
   //wait for everything to arrive, store the length of the messages
-  MPI_Waitall(numdatastreams, datarequests, msgstatuses);
+  t0 = MPI_Wtime();
+  MPI_Waitall(numdatastreams, procslots[index].recvrequests, msgstatuses);
   for(int i=0;i<numdatastreams;i++)
     MPI_Get_count(&(msgstatuses[i]), MPI_UNSIGNED_CHAR, &(procslots[index].datalengthbytes[i]));
-  MPI_Waitall(numdatastreams, controlrequests, msgstatuses);
+  MPI_Waitall(numdatastreams, &(procslots[index].recvrequests[numdatastreams]), msgstatuses);
+  datawaittime += MPI_Wtime() - t0;
 
-  //lock the next slot, unlock the one we just finished with
+  //carve the slot up into chunks and hand it over to the process threads
+  queueslotchunks(index);
+  calculatephasecentredelays(index);
+  publishslot();
+
+  return 1;
+}
+
+void Core::queueslotchunks(int index)
+{
+  int blockspersend, numBufferedFFTs, maxxcblocks, chunkstart, chunkend;
+  double blockns;
+  processslot * slot = &(procslots[index]);
+
+  blockspersend = config->getBlocksPerSend(slot->configindex);
+  numBufferedFFTs = config->getNumBufferedFFTs(slot->configindex);
+
+  //aim for a few chunks per thread, each a whole number of buffered FFT loops
+  slot->chunkblocks = blockspersend/(numprocessthreads*CHUNKS_PER_THREAD);
+  if(slot->chunkblocks%numBufferedFFTs != 0)
+    slot->chunkblocks += numBufferedFFTs - slot->chunkblocks%numBufferedFFTs;
+  if(slot->chunkblocks < numBufferedFFTs)
+    slot->chunkblocks = numBufferedFFTs;
+
+  //where possible, don't let a chunk boundary split a cross-correlation averaging interval
+  blockns = ((double)(config->getSubintNS(slot->configindex)))/((double)blockspersend);
+  maxxcblocks = ((int)(model->getMaxNSBetweenXCAvg(slot->offsets[0])/blockns));
+  maxxcblocks -= maxxcblocks%numBufferedFFTs;
+  if(maxxcblocks > 0 && maxxcblocks < slot->chunkblocks && slot->chunkblocks%maxxcblocks != 0)
+    slot->chunkblocks += maxxcblocks - slot->chunkblocks%maxxcblocks;
+  slot->numchunks = (blockspersend + slot->chunkblocks - 1)/slot->chunkblocks;
+
+  //deal the chunks out to the threads in contiguous runs
   for(int i=0;i<numprocessthreads;i++)
   {
-    perr = pthread_mutex_lock(&(procslots[(index+1)%RECEIVE_RING_LENGTH].slotlocks[i]));
-    if(perr != 0)
-      csevere << startl << "CORE " << mpiid << " error trying lock mutex " << (index+1)%RECEIVE_RING_LENGTH << endl;
+    chunkstart = (i*slot->numchunks)/numprocessthreads;
+    chunkend = ((i+1)*slot->numchunks)/numprocessthreads;
+    slot->chunkqueues[i*CHUNK_QUEUE_STRIDE] = (((u64)chunkend) << 32) | ((u64)chunkstart);
   }
+  slot->threadsfinished = 0;
+}
 
-  for(int i=0;i<numprocessthreads;i++)
+void Core::calculatephasecentredelays(int index)
+{
+  int blockspersend, numBufferedFFTs, maxxcblocks, numphasecentres, startblock, numblocks, intervalblocks, antennaindex, tablelength;
+  double blockns, nsoffset;
+  f64 * delays;
+  processslot * slot = &(procslots[index]);
+
+  numphasecentres = model->getNumPhaseCentres(slot->offsets[0]);
+  if(numphasecentres <= 1)
+    return; //no uv shifting to be done
+
+  //the averaging intervals are laid out exactly as processdata will step through them, chunk by chunk
+  blockspersend = config->getBlocksPerSend(slot->configindex);
+  numBufferedFFTs = config->getNumBufferedFFTs(slot->configindex);
+  blockns = ((double)(config->getSubintNS(slot->configindex)))/((double)blockspersend);
+  maxxcblocks = ((int)(model->getMaxNSBetweenXCAvg(slot->offsets[0])/blockns));
+  maxxcblocks -= maxxcblocks%numBufferedFFTs;
+  if(maxxcblocks == 0)
+    maxxcblocks = numBufferedFFTs;
+  slot->xcintervalsperchunk = (slot->chunkblocks + maxxcblocks - 1)/maxxcblocks;
+
+  tablelength = slot->numchunks*slot->xcintervalsperchunk*numdatastreams*(numphasecentres+1)*2;
+  if(tablelength > slot->phasecentredelaylength)
   {
-    perr = pthread_mutex_unlock(&(procslots[index].slotlocks[i]));
-    if(perr != 0)
-      csevere << startl << "CORE " << mpiid << " error trying unlock mutex " << index << endl;
+    if(slot->phasecentredelays)
+      vectorFree(slot->phasecentredelays);
+    slot->phasecentredelays = vectorAlloc_f64(tablelength);
+    estimatedbytes += 8*(tablelength - slot->phasecentredelaylength);
+    slot->phasecentredelaylength = tablelength;
   }
 
-  return 1;
+  for(int c=0;c<slot->numchunks;c++)
+  {
+    startblock = c*slot->chunkblocks;
+    numblocks = slot->chunkblocks;
+    if(startblock + numblocks > blockspersend)
+      numblocks = blockspersend - startblock;
+    for(int x=0;x<slot->xcintervalsperchunk;x++)
+    {
+      intervalblocks = numblocks - x*maxxcblocks;
+      if(intervalblocks <= 0)
+        break;
+      if(intervalblocks > maxxcblocks)
+        intervalblocks = maxxcblocks;
+      nsoffset = (startblock+x*maxxcblocks+((double)intervalblocks)/2.0)*blockns;
+      delays = &(slot->phasecentredelays[(c*slot->xcintervalsperchunk + x)*numdatastreams*(numphasecentres+1)*2]);
+      for(int i=0;i<numdatastreams;i++)
+      {
+        antennaindex = config->getDModelFileIndex(slot->configindex, i);
+        //validity range aribitrarily set to 1us (approximately the tangent)
+        for(int s=0;s<=numphasecentres;s++)
+        {
+          model->calculateDelayInterpolator(slot->offsets[0], slot->offsets[1] + double(slot->offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antennaindex, s, 1, delays);
+          delays += 2;
+        }
+      }
+    }
+  }
+}
+
+void Core::getdifferentialdelay(int index, int xcinterval, int baseline, int phasecentre, double * differentialdelay)
+{
+  int numphasecentres, ds1index, ds2index;
+  double applieddelay1, applieddelay2;
+  const f64 * intervaldelays;
+  const f64 * pointingcentredelay1approx;
+  const f64 * pointingcentredelay2approx;
+  const f64 * phasecentredelay1;
+  const f64 * phasecentredelay2;
+
+  numphasecentres = model->getNumPhaseCentres(procslots[index].offsets[0]);
+  ds1index = config->getBDataStream1Index(procslots[index].configindex, baseline);
+  ds2index = config->getBDataStream2Index(procslots[index].configindex, baseline);
+  intervaldelays = &(procslots[index].phasecentredelays[xcinterval*numdatastreams*(numphasecentres+1)*2]);
+  pointingcentredelay1approx = &(intervaldelays[ds1index*(numphasecentres+1)*2]);
+  pointingcentredelay2approx = &(intervaldelays[ds2index*(numphasecentres+1)*2]);
+  phasecentredelay1 = &(pointingcentredelay1approx[(phasecentre+1)*2]);
+  phasecentredelay2 = &(pointingcentredelay2approx[(phasecentre+1)*2]);
+
+  //work out the correct delay (and rate of delay) for this phase centre
+  applieddelay1 = phasecentredelay1[1] - pointingcentredelay1approx[1];
+  applieddelay2 = phasecentredelay2[1] - pointingcentredelay2approx[1];
+  //make correction for geometric rate over the shifted sample range
+  applieddelay1 += applieddelay1*pointingcentredelay1approx[0];
+  applieddelay2 += applieddelay2*pointingcentredelay2approx[0];
+  differentialdelay[1] = applieddelay2 - applieddelay1;
+  differentialdelay[0] = phasecentredelay2[0] + pointingcentredelay1approx[0] - (phasecentredelay1[0] + pointingcentredelay2approx[0]);
+}
+
+int Core::takechunk(int index, int threadid, bool & stolen)
+{
+  u64 oldword, newword;
+  unsigned int head, tail;
+  int victim;
+  volatile u64 * queue;
+
+  //take from the front of our own queue first
+  stolen = false;
+  queue = &(procslots[index].chunkqueues[threadid*CHUNK_QUEUE_STRIDE]);
+  while(true)
+  {
+    oldword = *queue;
+    head = (unsigned int)(oldword & 0xFFFFFFFFULL);
+    tail = (unsigned int)(oldword >> 32);
+    if(head >= tail)
+      break;
+    newword = (((u64)tail) << 32) | ((u64)(head+1));
+    if(__sync_bool_compare_and_swap(queue, oldword, newword))
+      return head;
+  }
+
+  //our queue is empty - steal from the back of somebody else's
+  for(int i=1;i<numprocessthreads;i++)
+  {
+    victim = (threadid+i)%numprocessthreads;
+    queue = &(procslots[index].chunkqueues[victim*CHUNK_QUEUE_STRIDE]);
+    while(true)
+    {
+      oldword = *queue;
+      head = (unsigned int)(oldword & 0xFFFFFFFFULL);
+      tail = (unsigned int)(oldword >> 32);
+      if(head >= tail)
+        break;
+      newword = (((u64)(tail-1)) << 32) | ((u64)head);
+      if(__sync_bool_compare_and_swap(queue, oldword, newword))
+      {
+        stolen = true;
+        return tail-1;
+      }
+    }
+  }
+
+  return -1; //nothing left anywhere
+}
+
+void Core::publishslot()
+{
+  int perr;
+
+  perr = pthread_mutex_lock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "CORE " << mpiid << " error trying lock slot state mutex" << endl;
+  __sync_add_and_fetch(&numslotsready, 1);
+  perr = pthread_cond_broadcast(&slotreadycond);
+  if(perr != 0)
+    csevere << startl << "CORE " << mpiid << " error trying to wake the process threads" << endl;
+  perr = pthread_mutex_unlock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "CORE " << mpiid << " error trying unlock slot state mutex" << endl;
+}
+
+void Core::waitforslot(int slotnumber)
+{
+  int perr;
+
+  //cheap check first - usually the data is already there
+  if(__sync_fetch_and_add(&numslotsready, 0) > slotnumber)
+    return;
+
+  perr = pthread_mutex_lock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "CORE " << mpiid << " error trying lock slot state mutex" << endl;
+  while(numslotsready <= slotnumber)
+    pthread_cond_wait(&slotreadycond, &slotstatelock);
+  perr = pthread_mutex_unlock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "CORE " << mpiid << " error trying unlock slot state mutex" << endl;
+}
+
+void Core::waitforslotfinished(int index)
+{
+  int perr;
+  double t0;
+
+  if(__sync_fetch_and_add(&(procslots[index].threadsfinished), 0) == numprocessthreads)
+    return;
+
+  t0 = MPI_Wtime();
+  perr = pthread_mutex_lock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "CORE " << mpiid << " error trying lock slot state mutex" << endl;
+  while(procslots[index].threadsfinished < numprocessthreads)
+    pthread_cond_wait(&slotfinishedcond, &slotstatelock);
+  perr = pthread_mutex_unlock(&slotstatelock);
+  if(perr != 0)
+    csevere << startl << "CORE " << mpiid << " error trying unlock slot state mutex" << endl;
+  processwaittime += MPI_Wtime() - t0;
+}
+
+void Core::sendresults(int index)
+{
+  int perr;
+
+  if(aggregatorid < 0)
+  {
+    perr = MPI_Isend(procslots[index].results, procslots[index].coreresultlength*2, MPI_FLOAT, fxcorr::MANAGERID, procslots[index].resultsvalid, return_comm, &(procslots[index].resultsrequest));
+  }
+  else
+  {
+    //the results go to the Aggregator, after a header saying which integration they belong to, and the FxManager
+    //just hears that this subintegration is finished so it can send another
+    for(int i=0;i<4;i++)
+      procslots[index].aggregateheader[i] = procslots[index].offsets[i];
+    procslots[index].aggregateheader[4] = 1;
+    MPI_Isend(procslots[index].aggregateheader, Aggregator::HEADER_LENGTH, MPI_INT, aggregatorid, CR_AGGREGATEHEADER, return_comm, &(procslots[index].aggregaterequests[0]));
+    perr = MPI_Isend(procslots[index].results, procslots[index].coreresultlength*2, MPI_FLOAT, aggregatorid, procslots[index].resultsvalid, return_comm, &(procslots[index].resultsrequest));
+    MPI_Isend(procslots[index].results, 0, MPI_FLOAT, fxcorr::MANAGERID, procslots[index].resultsvalid, return_comm, &(procslots[index].aggregaterequests[1]));
+  }
+  if(perr != MPI_SUCCESS)
+    csevere << startl << "CORE " << mpiid << " error trying to send results from slot " << index << endl;
+  procslots[index].resultssending = true;
+}
+
+void Core::completeresultsend(int index)
+{
+  int status;
+  double t0;
+  MPI_Status mpistatus;
+
+  if(!procslots[index].resultssending)
+    return;
+
+  t0 = MPI_Wtime();
+  MPI_Wait(&(procslots[index].resultsrequest), &mpistatus);
+  if(aggregatorid >= 0)
+    MPI_Waitall(2, procslots[index].aggregaterequests, MPI_STATUSES_IGNORE);
+  sendwaittime += MPI_Wtime() - t0;
+  procslots[index].resultssending = false;
+
+  //zero the results buffer for this slot and set the status back to valid
+  status = vectorZero_cf32(procslots[index].results, procslots[index].coreresultlength);
+  if(status != vecNoErr)
+    csevere << startl << "Error trying to zero results in Core!!!" << endl;
+  procslots[index].resultsvalid = CR_VALIDVIS;
+}
+
+int Core::xmacTiled(const cf32 * const * vis1, const cf32 * const * vis2, cf32 * const * accumulators, int numproducts, int numffts, int length, int tilelength)
+{
+  //the number of channels held in registers while all the FFTs are accumulated
+  const int blocklength = 16;
+  int status, tilestart, tileend, c;
+  f32 re[blocklength], im[blocklength];
+  const f32 * src1;
+  const f32 * src2;
+  cf32 * accumulator;
+
+  //within each tile of channels, every product is worked through a block of channels at a time.  The
+  //block is accumulated over all of the FFTs before being written back, so the accumulators are read
+  //and written once per call rather than once per FFT, and the station spectra for the tile are still
+  //in cache when the next product that uses them comes along.  For any one channel the additions happen
+  //in the same order as the simple baseline loop, so the results agree with it to within rounding (not
+  //bit for bit: that loop may go through IPP, and either may be compiled to fused multiply-adds)
+  for(tilestart=0;tilestart<length;tilestart+=tilelength)
+  {
+    tileend = tilestart + tilelength;
+    if(tileend > length)
+      tileend = length;
+    for(int p=0;p<numproducts;p++)
+    {
+      accumulator = accumulators[p];
+      for(c=tilestart;c+blocklength<=tileend;c+=blocklength)
+      {
+        for(int i=0;i<blocklength;i++)
+        {
+          re[i] = accumulator[c+i].re;
+          im[i] = accumulator[c+i].im;
+        }
+        for(int k=0;k<numffts;k++)
+        {
+          src1 = (const f32*)(vis1[p*numffts + k] + c);
+          src2 = (const f32*)(vis2[p*numffts + k] + c);
+          for(int i=0;i<blocklength;i++)
+          {
+            re[i] += src1[2*i]*src2[2*i] + src1[2*i+1]*src2[2*i+1];
+            im[i] += src1[2*i+1]*src2[2*i] - src1[2*i]*src2[2*i+1];
+          }
+        }
+        for(int i=0;i<blocklength;i++)
+        {
+          accumulator[c+i].re = re[i];
+          accumulator[c+i].im = im[i];
+        }
+      }
+      if(c < tileend) //leftover channels at the end of the tile
+      {
+        for(int k=0;k<numffts;k++)
+        {
+          status = vectorAddProductConj_cf32(&(vis1[p*numffts + k][c]), &(vis2[p*numffts + k][c]), &(accumulator[c]), tileend - c);
+          if(status != vecNoErr)
+            return status;
+        }
+      }
+    }
+  }
+
+  return vecNoErr;
+}
+
+int Core::xmacTiledPacked(const u8 * const * vis1, const u8 * const * vis2, const f32 * const * scales1, const f32 * const * scales2, cf32 * const * accumulators, Configuration::spectraprecision precision, int numproducts, int numffts, int length, int tilelength)
+{
+  int status, tilestart, tilechannels;
+
+  //the same tiling as xmacTiled; the kernel holds each block of channels in registers while it sums over the
+  //FFTs (exactly, in integers, for INT8), and scales the sum by both stations' channel scales only once
+  for(tilestart=0;tilestart<length;tilestart+=tilelength)
+  {
+    tilechannels = tilelength;
+    if(tilestart + tilechannels > length)
+      tilechannels = length - tilestart;
+    for(int p=0;p<numproducts;p++)
+    {
+      if(precision == Configuration::FLOAT16SPECTRA)
+        status = vectorXmacScaled_cf16(&(vis1[p*numffts]), &(vis2[p*numffts]), numffts, tilestart, scales1[p] + tilestart, scales2[p] + tilestart, accumulators[p] + tilestart, tilechannels);
+      else
+        status = vectorXmacScaled_cs8(&(vis1[p*numffts]), &(vis2[p*numffts]), numffts, tilestart, scales1[p] + tilestart, scales2[p] + tilestart, accumulators[p] + tilestart, tilechannels);
+      if(status != vecNoErr)
+        return status;
+    }
+  }
+
+  return vecNoErr;
+}
+
+void Core::calculatebinruns(const s32 * bins, s32 * binruns, int numchannels, int stridelength)
+{
+  int strideend;
+
+  for(int start=0;start<numchannels;start+=stridelength)
+  {
+    strideend = (start+stridelength < numchannels)?start+stridelength:numchannels;
+    binruns[strideend-1] = 1;
+    for(int c=strideend-2;c>=start;c--)
+      binruns[c] = (bins[c+1] == bins[c])?binruns[c+1]+1:1;
+  }
 }
 
 void Core::processdata(int index, int threadid, int startblock, int numblocks, Mode ** modes, Polyco * currentpolyco, threadscratchspace * scratchspace)
@@ -672,8 +1121,10 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
   int xcblockcount, maxxcblocks, xcshiftcount;
   int acblockcount, maxacblocks, acshiftcount;
   int freqchannels;
-  int xmacstridelength, xmacpasses, xmacstart, destbin, destchan, localfreqindex;
+  int xmacstridelength, xmacpasses, xmacstart, destbin, binrunlength, localfreqindex;
+  int numxmacproducts, numpolproducts, ds1bandindex, ds2bandindex;
   int dsfreqindex;
+  Configuration::spectraprecision spectraprecision;
   char papol;
   double offsetmins, blockns;
   f32 bweight;
@@ -686,12 +1137,13 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
   int fftsize;
   int numBufferedFFTs;
   float weight1, weight2;
-#endif
   int perr;
+#endif
 
 //following statement used to cut all all processing for "Neutered DiFX"
 #ifndef NEUTERED_DIFX
   xmacstridelength = config->getXmacStrideLength(procslots[index].configindex);
+  spectraprecision = config->getSpectraPrecision(procslots[index].configindex);
   binloop = 1;
   if(procslots[index].pulsarbin && !procslots[index].scrunchoutput)
     binloop = procslots[index].numpulsarbins;
@@ -710,8 +1162,6 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     modes[j]->setData(procslots[index].databuffer[j], procslots[index].datalengthbytes[j], procslots[index].controlbuffer[j][0], procslots[index].controlbuffer[j][1], procslots[index].controlbuffer[j][2]);
     modes[j]->setOffsets(procslots[index].offsets[0], procslots[index].offsets[1], procslots[index].offsets[2]);
     modes[j]->setDumpKurtosis(scratchspace->dumpkurtosis);
-    if(scratchspace->dumpkurtosis)
-      modes[j]->zeroKurtosis();
     
     //reset pcal
     if(config->getDPhaseCalIntervalMHz(procslots[index].configindex, j) > 0)
@@ -808,6 +1258,12 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
         modes[j]->process(i, fftsubloop);
         numfftsprocessed++;
       }
+      //blank RFI over the window of buffered FFTs, before anything is cross-multiplied
+      if(modes[j]->rfiExcisionOn())
+        modes[j]->exciseRFI(numfftsprocessed);
+      //and then pack them to reduced precision, if that is what gets cross-multiplied
+      if(modes[j]->packedSpectraOn())
+        modes[j]->packSpectra(numfftsprocessed);
     }
 
     //if necessary, work out the pulsar bins
@@ -818,6 +1274,11 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
         i = fftloop*numBufferedFFTs + fftsubloop + startblock;
         offsetmins = ((double)i)*blockns/60000000000.0;
         currentpolyco->getBins(offsetmins, scratchspace->bins[fftsubloop]);
+        for(int f=0;f<config->getFreqTableLength();f++)
+        {
+          if(config->isFrequencyUsed(procslots[index].configindex, f))
+            calculatebinruns(scratchspace->bins[fftsubloop][f], scratchspace->binruns[fftsubloop][f], config->getFNumChannels(f), xmacstridelength);
+        }
       }
     }
 
@@ -885,41 +1346,90 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
         {
           xmacstart = x*xmacstridelength;
 
-          //do the cross multiplication - gets messy for the pulsar binning
-          for(int j=0;j<numbaselines;j++)
+          if(!procslots[index].pulsarbin)
           {
-            //get the localfreqindex for this frequency
-            localfreqindex = config->getBLocalFreqIndex(procslots[index].configindex, j, f);
-            if(localfreqindex >= 0)
+            //not pulsar binning, so gather the spectra for every baseline and polarisation product in
+            //this stride and cross multiply accumulate them a tile of channels at a time.  That way each
+            //station spectrum is pulled into cache once per tile, rather than once per baseline
+            numxmacproducts = 0;
+            for(int j=0;j<numbaselines;j++)
             {
-              //get the two modes that contribute to this baseline
-              ds1index = config->getBOrderedDataStream1Index(procslots[index].configindex, j);
-	      ds2index = config->getBOrderedDataStream2Index(procslots[index].configindex, j);
-	      m1 = modes[ds1index];
-	      m2 = modes[ds2index];
-
-              //do the baseline-based processing for this batch of FFT chunks
-              for(int fftsubloop=0;fftsubloop<numBufferedFFTs;fftsubloop++)
+              localfreqindex = config->getBLocalFreqIndex(procslots[index].configindex, j, f);
+              if(localfreqindex >= 0)
               {
-	        i = fftloop*numBufferedFFTs + fftsubloop + startblock;
-	        if(i >= startblock+numblocks)
-		  break; //may not have to fully complete last fftloop
-
-                //add the desired results into the resultsbuffer, for each polarisation pair [and pulsar bin]
-                //loop through each polarisation for this frequency
-                for(int p=0;p<config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex);p++)
+                m1 = modes[config->getBOrderedDataStream1Index(procslots[index].configindex, j)];
+                m2 = modes[config->getBOrderedDataStream2Index(procslots[index].configindex, j)];
+                numpolproducts = config->getBNumPolProducts(procslots[index].configindex, j, localfreqindex);
+                for(int p=0;p<numpolproducts;p++)
                 {
-                  //get the appropriate arrays to multiply
-                  vis1 = &(m1->getFreqs(config->getBDataStream1BandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop)[xmacstart]);
-                  vis2 = &(m2->getConjugatedFreqs(config->getBDataStream2BandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop)[xmacstart]);
-
-                  weight1 = m1->getDataWeight(config->getBDataStream1RecordBandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop);
-                  weight2 = m2->getDataWeight(config->getBDataStream2RecordBandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop);
+                  ds1bandindex = config->getBDataStream1BandIndex(procslots[index].configindex, j, localfreqindex, p);
+                  ds2bandindex = config->getBDataStream2BandIndex(procslots[index].configindex, j, localfreqindex, p);
+                  if(spectraprecision == Configuration::FLOAT32SPECTRA)
+                  {
+                    for(int fftsubloop=0;fftsubloop<numfftsprocessed;fftsubloop++)
+                    {
+                      scratchspace->xmacvis1[numxmacproducts*numfftsprocessed + fftsubloop] = &(m1->getFreqs(ds1bandindex, fftsubloop)[xmacstart]);
+                      scratchspace->xmacvis2[numxmacproducts*numfftsprocessed + fftsubloop] = &(m2->getFreqs(ds2bandindex, fftsubloop)[xmacstart]);
+                    }
+                  }
+                  else
+                  {
+                    for(int fftsubloop=0;fftsubloop<numfftsprocessed;fftsubloop++)
+                    {
+                      scratchspace->xmacpackedvis1[numxmacproducts*numfftsprocessed + fftsubloop] = m1->getPackedFreqs(ds1bandindex, fftsubloop, xmacstart);
+                      scratchspace->xmacpackedvis2[numxmacproducts*numfftsprocessed + fftsubloop] = m2->getPackedFreqs(ds2bandindex, fftsubloop, xmacstart);
+                    }
+                    scratchspace->xmacscales1[numxmacproducts] = m1->getPackedScales(ds1bandindex) + xmacstart;
+                    scratchspace->xmacscales2[numxmacproducts] = m2->getPackedScales(ds2bandindex) + xmacstart;
+                  }
+                  scratchspace->xmacaccumulators[numxmacproducts] = &(scratchspace->threadcrosscorrs[resultindex+p*xmacstridelength]);
+                  numxmacproducts++;
+                }
+                resultindex += numpolproducts*xmacstridelength;
+              }
+            }
+            if(spectraprecision == Configuration::FLOAT32SPECTRA)
+              status = xmacTiled(scratchspace->xmacvis1, scratchspace->xmacvis2, scratchspace->xmacaccumulators, numxmacproducts, numfftsprocessed, xmacstridelength, XMAC_TILE_LENGTH);
+            else
+              status = xmacTiledPacked(scratchspace->xmacpackedvis1, scratchspace->xmacpackedvis2, scratchspace->xmacscales1, scratchspace->xmacscales2, scratchspace->xmacaccumulators, spectraprecision, numxmacproducts, numfftsprocessed, xmacstridelength, XMAC_TILE_LENGTH);
+            if(status != vecNoErr)
+              csevere << startl << "Error trying to xmac frequency " << f << " stride " << x << ", status " << status << endl;
+          }
+          else
+          {
+            //pulsar binning - do the cross multiplication into scratch space and then scatter into the bins
+            for(int j=0;j<numbaselines;j++)
+            {
+              //get the localfreqindex for this frequency
+              localfreqindex = config->getBLocalFreqIndex(procslots[index].configindex, j, f);
+              if(localfreqindex >= 0)
+              {
+                //get the two modes that contribute to this baseline
+                ds1index = config->getBOrderedDataStream1Index(procslots[index].configindex, j);
+                ds2index = config->getBOrderedDataStream2Index(procslots[index].configindex, j);
+                m1 = modes[ds1index];
+                m2 = modes[ds2index];
+
+                //do the baseline-based processing for this batch of FFT chunks
+                for(int fftsubloop=0;fftsubloop<numBufferedFFTs;fftsubloop++)
+                {
+                  i = fftloop*numBufferedFFTs + fftsubloop + startblock;
+                  if(i >= startblock+numblocks)
+                    break; //may not have to fully complete last fftloop
 
-                  if(procslots[index].pulsarbin)
+                  //add the desired results into the resultsbuffer, for each polarisation pair [and pulsar bin]
+                  //loop through each polarisation for this frequency
+                  for(int p=0;p<config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex);p++)
                   {
+                    //get the appropriate arrays to multiply
+                    vis1 = &(m1->getFreqs(config->getBDataStream1BandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop)[xmacstart]);
+                    vis2 = &(m2->getFreqs(config->getBDataStream2BandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop)[xmacstart]);
+
+                    weight1 = m1->getDataWeight(config->getBDataStream1RecordBandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop);
+                    weight2 = m2->getDataWeight(config->getBDataStream2RecordBandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop);
+
                     //multiply into scratch space
-                    status = vectorMul_cf32(vis1, vis2, scratchspace->pulsarscratchspace, xmacstridelength);
+                    status = vectorMulConj_cf32(vis1, vis2, scratchspace->pulsarscratchspace, xmacstridelength);
                     if(status != vecNoErr)
                       csevere << startl << "Error trying to xmac baseline " << j << " frequency " << localfreqindex << " polarisation product " << p << ", status " << status << endl;
 
@@ -927,47 +1437,39 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
                     if(procslots[index].scrunchoutput)
                     {
                       bweight = weight1*weight2/freqchannels;
-                      destchan = xmacstart;
-                      for(int l=0;l<xmacstridelength;l++)
+                      //add each run of channels that fall in the same bin in one go
+                      for(int l=0;l<xmacstridelength;l+=binrunlength)
                       {
                         //the first zero (the source slot) is because we are limiting to one pulsar ephemeris for now
-                        destbin = scratchspace->bins[fftsubloop][f][destchan];
-                        scratchspace->pulsaraccumspace[f][x][j][0][p][destbin][l].re += scratchspace->pulsarscratchspace[l].re;
-                        scratchspace->pulsaraccumspace[f][x][j][0][p][destbin][l].im += scratchspace->pulsarscratchspace[l].im;
-                        scratchspace->baselineweight[f][0][j][p] += bweight*binweights[destbin];
-                        destchan++;
+                        destbin = scratchspace->bins[fftsubloop][f][xmacstart+l];
+                        binrunlength = scratchspace->binruns[fftsubloop][f][xmacstart+l];
+                        status = accumulatebinrun(&(scratchspace->pulsarscratchspace[l]), &(scratchspace->pulsaraccumspace[f][x][j][0][p][destbin][l]), binrunlength);
+                        if(status != vecNoErr)
+                          csevere << startl << "Error trying to accumulate pulsar bin " << destbin << " for baseline " << j << " frequency " << localfreqindex << ", status " << status << endl;
+                        scratchspace->baselineweight[f][0][j][p] += bweight*binweights[destbin]*binrunlength;
                       }
                     }
                     else
                     {
                       bweight = weight1*weight2/freqchannels;
-                      destchan = xmacstart;
-                      for(int l=0;l<xmacstridelength;l++)
+                      for(int l=0;l<xmacstridelength;l+=binrunlength)
                       {
-                        destbin = scratchspace->bins[fftsubloop][f][destchan];
-                        //cindex = resultindex + (scratchspace->bins[freqindex][destchan]*config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex) + p)*(freqchannels+1) + destchan;
+                        destbin = scratchspace->bins[fftsubloop][f][xmacstart+l];
+                        binrunlength = scratchspace->binruns[fftsubloop][f][xmacstart+l];
                         cindex = resultindex + (destbin*config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex) + p)*xmacstridelength + l;
-                        scratchspace->threadcrosscorrs[cindex].re += scratchspace->pulsarscratchspace[l].re;
-                        scratchspace->threadcrosscorrs[cindex].im += scratchspace->pulsarscratchspace[l].im;
-                        scratchspace->baselineweight[f][destbin][j][p] += bweight;
-                        destchan++;
+                        status = accumulatebinrun(&(scratchspace->pulsarscratchspace[l]), &(scratchspace->threadcrosscorrs[cindex]), binrunlength);
+                        if(status != vecNoErr)
+                          csevere << startl << "Error trying to accumulate pulsar bin " << destbin << " for baseline " << j << " frequency " << localfreqindex << ", status " << status << endl;
+                        scratchspace->baselineweight[f][destbin][j][p] += bweight*binrunlength;
                       }
                     }
                   }
-                  else
-                  {
-                    //not pulsar binning, so this is nice and simple - just cross multiply accumulate
-                    status = vectorAddProduct_cf32(vis1, vis2, &(scratchspace->threadcrosscorrs[resultindex+p*xmacstridelength]), xmacstridelength);
-
-                    if(status != vecNoErr)
-                      csevere << startl << "Error trying to xmac baseline " << j << " frequency " << localfreqindex << " polarisation product " << p << ", status " << status << endl;
-                  }
                 }
+                if(!procslots[index].scrunchoutput)
+                  resultindex += config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex)*procslots[index].numpulsarbins*xmacstridelength;
+                else
+                  resultindex += config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex)*xmacstridelength;
               }
-	      if(procslots[index].pulsarbin && !procslots[index].scrunchoutput)
-	        resultindex += config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex)*procslots[index].numpulsarbins*xmacstridelength;
-              else
-	        resultindex += config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex)*xmacstridelength;
             }
           }
         }
@@ -978,7 +1480,7 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     if(xcblockcount == maxxcblocks)
     {
       //shift/average and then lock results and copy data
-      uvshiftAndAverage(index, threadid, (startblock+xcshiftcount*maxxcblocks+((double)maxxcblocks)/2.0)*blockns, maxxcblocks*blockns, currentpolyco, scratchspace);
+      uvshiftAndAverage(index, threadid, (startblock+xcshiftcount*maxxcblocks+((double)maxxcblocks)/2.0)*blockns, maxxcblocks*blockns, (startblock/procslots[index].chunkblocks)*procslots[index].xcintervalsperchunk + xcshiftcount, currentpolyco, scratchspace);
       //reset the xcblockcount, increment xcshiftcount
       xcblockcount = 0;
       xcshiftcount++;
@@ -1046,14 +1548,11 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
   }
 
   if(xcblockcount != 0) {
-    uvshiftAndAverage(index, threadid, (startblock+xcshiftcount*maxxcblocks+((double)xcblockcount)/2.0)*blockns, xcblockcount*blockns, currentpolyco, scratchspace);
+    uvshiftAndAverage(index, threadid, (startblock+xcshiftcount*maxxcblocks+((double)xcblockcount)/2.0)*blockns, xcblockcount*blockns, (startblock/procslots[index].chunkblocks)*procslots[index].xcintervalsperchunk + xcshiftcount, currentpolyco, scratchspace);
   }
   if(acblockcount != 0) {
     averageAndSendAutocorrs(index, threadid, (startblock+acshiftcount*maxacblocks+((double)acblockcount)/2.0)*blockns, acblockcount*blockns, modes, scratchspace);
   }
-  if(scratchspace->dumpkurtosis) {
-    averageAndSendKurtosis(index, threadid, (startblock + numblocks/2.0)*blockns, numblocks*blockns, numblocks, modes, scratchspace);
-  }
 
   //lock the bweight copylock, so we're the only one adding to the result array (baseline weight section)
   perr = pthread_mutex_lock(&(procslots[index].bweightcopylock));
@@ -1109,16 +1608,6 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
 
 //end the cutout of processing in "Neutered DiFX"
 #endif
-
-  //grab the next slot lock
-  perr = pthread_mutex_lock(&(procslots[(index+1)%RECEIVE_RING_LENGTH].slotlocks[threadid]));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex " << (index+1)%RECEIVE_RING_LENGTH << endl;
-
-  //unlock the one we had
-  perr = pthread_mutex_unlock(&(procslots[index].slotlocks[threadid]));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << index << endl;
 }
 
 void Core::copyPCalTones(int index, int threadid, Mode ** modes)
@@ -1421,7 +1910,7 @@ void Core::averageAndSendKurtosis(int index, int threadid, double nsoffset, doub
   delete [] valid;
 }
 
-void Core::uvshiftAndAverage(int index, int threadid, double nsoffset, double nswidth, Polyco * currentpolyco, threadscratchspace * scratchspace)
+void Core::uvshiftAndAverage(int index, int threadid, double nsoffset, double nswidth, int xcinterval, Polyco * currentpolyco, threadscratchspace * scratchspace)
 {
   int status, startbaselinefreq, atbaselinefreq, startbaseline, startfreq, endbaseline;
   int localfreqindex, baselinefreqs;
@@ -1519,7 +2008,7 @@ void Core::uvshiftAndAverage(int index, int threadid, double nsoffset, double ns
     {
       for(int i=startbaseline;i<numbaselines;i++)
       {
-        uvshiftAndAverageBaselineFreq(index, threadid, nsoffset, nswidth, scratchspace, f, i);
+        uvshiftAndAverageBaselineFreq(index, threadid, nsoffset, nswidth, xcinterval, scratchspace, f, i);
       }
       startbaseline = 0;
     }
@@ -1532,13 +2021,13 @@ void Core::uvshiftAndAverage(int index, int threadid, double nsoffset, double ns
     {
       for(int i=0;i<numbaselines;i++)
       {
-        uvshiftAndAverageBaselineFreq(index, threadid, nsoffset, nswidth, scratchspace, f, i);
+        uvshiftAndAverageBaselineFreq(index, threadid, nsoffset, nswidth, xcinterval, scratchspace, f, i);
       }
     }
   }
   for(int i=0;i<endbaseline;i++)
   {
-    uvshiftAndAverageBaselineFreq(index, threadid, nsoffset, nswidth, scratchspace, startfreq, i);
+    uvshiftAndAverageBaselineFreq(index, threadid, nsoffset, nswidth, xcinterval, scratchspace, startfreq, i);
   }
 
   //clear the thread cross-corr results
@@ -1583,28 +2072,20 @@ void Core::uvshiftAndAverage(int index, int threadid, double nsoffset, double ns
   }
 }
 
-void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffset, double nswidth, threadscratchspace * scratchspace, int freqindex, int baseline)
+void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffset, double nswidth, int xcinterval, threadscratchspace * scratchspace, int freqindex, int baseline)
 {
-  int status, perr, threadbinloop, threadindex, threadstart, numstrides;
-  int localfreqindex, freqchannels, coreindex, coreoffset, corebinloop, channelinc, rotatorlength, dest;
-  int antenna1index, antenna2index;
-  int rotatestridelen, rotatesperstride, xmacstridelen, xmaccopylen, stridestoaverage, averagesperstride, averagelength;
-  double bandwidth, lofrequency, channelbandwidth, stepbandwidth;
-  double applieddelay, applieddelay1, applieddelay2, turns, edgeturns;
+  int status, perr, threadbinloop, threadindex, threadstart, numphasecentres, numpolproducts, numvectors, numxmacstrides;
+  int localfreqindex, freqchannels, coreindex, coreoffset, corebinloop, channelinc, dest;
+  int xmacstridelen, xmaccopylen, stridestoaverage, averagesperstride, averagelength;
+  double channelbandwidth;
   double delaywindow, maxphasechange, timesmeardecorr, delaydecorr;
-  double pointingcentredelay1approx[2];
-  double pointingcentredelay2approx[2];
-  double ** phasecentredelay1 = 0;
-  double ** phasecentredelay2 = 0;
-  double ** differentialdelay = 0;
+  double differentialdelay[2];
   cf32* srcpointer;
   cf32 meanresult;
 
-  applieddelay = 0.0;
   delaywindow = config->getFNumChannels(freqindex)/(config->getFreqTableBandwidth(freqindex)); //max lag (plus and minus)
   localfreqindex = config->getBLocalFreqIndex(procslots[index].configindex, baseline, freqindex);
   xmacstridelen = config->getXmacStrideLength(procslots[index].configindex);
-  rotatestridelen = config->getRotateStrideLength(procslots[index].configindex);
   threadbinloop = 1;
   corebinloop = 1;
   if(procslots[index].pulsarbin)
@@ -1614,80 +2095,17 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
 
   if (localfreqindex<0) return;
 
-  //allocate space for the phase centre delays if necessary, and calculate pointing centre delays
-  if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1)
-  {
-    phasecentredelay1 = new double*[model->getNumPhaseCentres(procslots[index].offsets[0])];
-    phasecentredelay2 = new double*[model->getNumPhaseCentres(procslots[index].offsets[0])];
-    differentialdelay = new double*[model->getNumPhaseCentres(procslots[index].offsets[0])];
-    for(int i=0;i<model->getNumPhaseCentres(procslots[index].offsets[0]);i++)
-    {
-      phasecentredelay1[i] = new double[2];
-      phasecentredelay2[i] = new double[2];
-      differentialdelay[i] = new double[2];
-    }
-
-    antenna1index = config->getDModelFileIndex(procslots[index].configindex, config->getBDataStream1Index(procslots[index].configindex, baseline));
-    antenna2index = config->getDModelFileIndex(procslots[index].configindex, config->getBDataStream2Index(procslots[index].configindex, baseline));
-
-    //get the pointing centre interpolator, validity range aribitrarily set to 1us (approximately the tangent)
-    model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna1index, 0, 1, pointingcentredelay1approx);
-    model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna2index, 0, 1, pointingcentredelay2approx);
-    for(int s=0;s<model->getNumPhaseCentres(procslots[index].offsets[0]);s++)
-    {
-      model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna1index, s+1, 1, phasecentredelay1[s]);
-      model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna2index, s+1, 1, phasecentredelay2[s]);
-
-      //work out the correct delay (and rate of delay) for this phase centre
-      applieddelay1 = phasecentredelay1[s][1] - pointingcentredelay1approx[1];
-      applieddelay2 = phasecentredelay2[s][1] - pointingcentredelay2approx[1];
-      //make correction for geometric rate over the shifted sample range
-      applieddelay1 += applieddelay1*pointingcentredelay1approx[0];
-      applieddelay2 += applieddelay2*pointingcentredelay2approx[0];
-      //cout << "Applied delay is " << applieddelay2 - applieddelay1 << ", correction is " << applieddelay2 - applieddelay1 - saveddelay << endl;
-      differentialdelay[s][1] = applieddelay2 - applieddelay1;
-      differentialdelay[s][0] = phasecentredelay2[s][0] + pointingcentredelay1approx[0] - (phasecentredelay1[s][0] + pointingcentredelay2approx[0]);
-      //cout << "Differential delay [" << s << "][1] = " << differentialdelay[s][1] << endl;
-      //cout << "Differential delay [" << s << "][0] = " << differentialdelay[s][0] << " since antenna 1 delays were " << phasecentredelay1[s][0] << ", " << pointingcentredelay1approx[0] << ", and antenna 2 delays were " << phasecentredelay2[s][0] << ", " << pointingcentredelay2approx[0] << endl;
-      //cout << "DD (ant 1) was " << phasecentredelay1[s][0] - pointingcentredelay1approx[0] << ", (ant 2) was " << phasecentredelay2[s][0] - pointingcentredelay2approx[0] << endl;
-    }
-  }
-
   freqchannels = config->getFNumChannels(freqindex);
   channelinc = config->getFChannelsToAverage(freqindex);
-  bandwidth = config->getFreqTableBandwidth(freqindex);
-  lofrequency = config->getFreqTableFreq(freqindex);
   stridestoaverage = channelinc/xmacstridelen;
-  rotatesperstride = xmacstridelen/rotatestridelen;
   if(stridestoaverage == 0)
     stridestoaverage = 1;
   averagesperstride = xmacstridelen/channelinc;
   if(averagesperstride == 0)
     averagesperstride = 1;
   averagelength = xmacstridelen/averagesperstride;
-  numstrides = freqchannels/xmacstridelen;
-  channelbandwidth = bandwidth/double(freqchannels);
-  rotatorlength = rotatestridelen+numstrides*rotatesperstride;
-  stepbandwidth = rotatestridelen*channelbandwidth;
-  if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1)
-  {
-    if(config->getFreqTableLowerSideband(freqindex))
-    {
-      for(int c=0;c<rotatestridelen;c++)
-        scratchspace->chanfreqs[c] = -(rotatestridelen-(c+1))*channelbandwidth;
-      for(int c=0;c<numstrides*rotatesperstride;c++)
-        scratchspace->chanfreqs[rotatestridelen+c] = -(numstrides*rotatesperstride-(c+1))*stepbandwidth;
-    }
-    else
-    {
-      for(int c=0;c<rotatestridelen;c++) {
-        scratchspace->chanfreqs[c] = c*channelbandwidth;
-      }
-      for(int c=0;c<numstrides*rotatesperstride;c++) {
-        scratchspace->chanfreqs[rotatestridelen+c] = c*stepbandwidth;
-      }
-    }
-  }
+  numpolproducts = config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex);
+  numphasecentres = model->getNumPhaseCentres(procslots[index].offsets[0]);
 
   coreindex = config->getCoreResultBaselineOffset(procslots[index].configindex, freqindex, baseline);
 
@@ -1696,47 +2114,50 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
   if(perr != 0)
     csevere << startl << "PROCESSTHREAD " << threadid << " error trying lock copy mutex for frequency table entry " << freqindex << ", baseline " << baseline << "!!!" << endl;
 
-  //actually do the rotation (if necessary), averaging (if necessary) and copying
-  for(int s=0;s<model->getNumPhaseCentres(procslots[index].offsets[0]);s++)
+  if(numphasecentres > 1)
   {
-    if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1)
+    //shift every polarisation product (and bin) to all the phase centres at once
+    for(int s=0;s<numphasecentres;s++)
+    {
+      getdifferentialdelay(index, xcinterval, baseline, s, differentialdelay);
+      scratchspace->shiftdelays[s] = differentialdelay[1];
+    }
+    channelbandwidth = config->getFreqTableBandwidth(freqindex)/double(freqchannels);
+    scratchspace->uvshifter->setPhaseCentres(scratchspace->shiftdelays, numphasecentres, config->getFreqTableFreq(freqindex), channelbandwidth, freqchannels, config->getFreqTableLowerSideband(freqindex));
+    numxmacstrides = config->getNumXmacStrides(procslots[index].configindex, freqindex);
+    numvectors = threadbinloop*numpolproducts;
+    threadstart = config->getThreadResultFreqOffset(procslots[index].configindex, freqindex) + config->getThreadResultBaselineOffset(procslots[index].configindex, freqindex, baseline);
+    for(int x=0;x<numxmacstrides;x++)
     {
-      //work out the correct rotator for this frequency and phase centre
-      //cout << "phasecentredelay1[" << s << "] is " << phasecentredelay1[s][1] << endl;
-      //cout << "phasecentredelay2[" << s << "] is " << phasecentredelay2[s][1] << endl;
-      //cout << "pointingcentredelay1 is " << pointingcentredelay1 << endl;
-      //cout << "pointingcentredelay2 is " << pointingcentredelay2 << endl;
-      //applieddelay1 = phasecentredelay1[s][1] - pointingcentredelay1approx[1];
-      //applieddelay2 = phasecentredelay2[s][1] - pointingcentredelay2approx[1];
-      //make correction for geometric rate over the shifted sample range
-      //applieddelay1 += applieddelay1*pointingcentredelay1approx[0];
-      //applieddelay2 += applieddelay2*pointingcentredelay2approx[0];
-      //cout << "Applied delay is " << applieddelay2 - applieddelay1 << ", correction is " << applieddelay2 - applieddelay1 - saveddelay << endl;
-      //applieddelay = applieddelay2 - applieddelay1;
-      applieddelay = differentialdelay[s][1];
-      if(fabs(applieddelay) > 1.0e-20)
+      threadindex = threadstart+x*config->getCompleteStrideLength(procslots[index].configindex, freqindex);
+      for(int b=0;b<threadbinloop;b++)
       {
-        edgeturns = applieddelay*lofrequency;
-        edgeturns -= floor(edgeturns);
-        for(int r=0;r<rotatestridelen;r++)
-        {
-          turns = applieddelay*scratchspace->chanfreqs[r] + edgeturns;
-          scratchspace->argument[r] = (turns-floor(turns))*TWO_PI;
-        }
-        for(int r=rotatestridelen;r<rotatorlength;r++)
+        for(int k=0;k<numpolproducts;k++)
         {
-          turns = applieddelay*scratchspace->chanfreqs[r];
-          scratchspace->argument[r] = (turns-floor(turns))*TWO_PI;
+          if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
+            scratchspace->shiftvis[x*numvectors + b*numpolproducts + k] = scratchspace->pulsaraccumspace[freqindex][x][baseline][0][k][b];
+          else
+            scratchspace->shiftvis[x*numvectors + b*numpolproducts + k] = &(scratchspace->threadcrosscorrs[threadindex]);
+          threadindex += xmacstridelen;
         }
-        status = vectorSinCos_f32(scratchspace->argument, &(scratchspace->argument[rotatorlength]), &(scratchspace->argument[2*rotatorlength]), rotatorlength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in phase shift, sin/cos!!!" << status << endl;
-        status = vectorRealToComplex_f32(&(scratchspace->argument[2*rotatorlength]), &(scratchspace->argument[rotatorlength]), scratchspace->rotator, rotatorlength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in phase shift, real to complex!!!" << status << endl;
       }
     }
-
+    for(int b=0;b<threadbinloop;b++)
+    {
+      for(int k=0;k<numpolproducts;k++)
+      {
+        if(corebinloop > 1)
+          coreoffset = ((b*numpolproducts+k)*freqchannels)/channelinc;
+        else
+          coreoffset = (k*freqchannels)/channelinc;
+        scratchspace->shiftout[b*numpolproducts + k] = &(procslots[index].results[coreindex+coreoffset]);
+      }
+    }
+    scratchspace->uvshifter->shiftAndAverage(numxmacstrides, xmacstridelen, channelinc, scratchspace->shiftvis, scratchspace->shiftout, numvectors, corebinloop*numpolproducts*freqchannels/channelinc);
+  }
+  else
+  {
+    //just average (if necessary) and copy
     threadstart = config->getThreadResultFreqOffset(procslots[index].configindex, freqindex) + config->getThreadResultBaselineOffset(procslots[index].configindex, freqindex, baseline);
     //cout << "Threadstart is " << threadstart << " since threadresultfreqoffset is " << config->getThreadResultFreqOffset(procslots[index].configindex, freqindex) << endl;
     for(int x=0;x<config->getNumXmacStrides(procslots[index].configindex, freqindex);x++)
@@ -1744,38 +2165,16 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
       threadindex = threadstart+x*config->getCompleteStrideLength(procslots[index].configindex, freqindex);
       for(int b=0;b<threadbinloop;b++)
       {
-        for(int k=0;k<config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex);k++)
+        for(int k=0;k<numpolproducts;k++)
         {
           if(corebinloop > 1)
-            coreoffset = ((b*config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex)+k)*freqchannels + x*xmacstridelen)/channelinc;
+            coreoffset = ((b*numpolproducts+k)*freqchannels + x*xmacstridelen)/channelinc;
           else
             coreoffset = (k*freqchannels + x*xmacstridelen)/channelinc;
-          if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1 && fabs(applieddelay) > 1.0e-20)
-          {
-            if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
-              srcpointer = scratchspace->pulsaraccumspace[freqindex][x][baseline][0][k][b];
-            else
-              srcpointer = &(scratchspace->threadcrosscorrs[threadindex]);
-            //cout << "About to rotate from threadindex " << threadindex << " (cf max thread result length " << config->getMaxThreadResultLength() << ") for which the 10th offset re value is " << scratchspace->threadcrosscorrs[threadindex+10].re << endl;
-            for(int r=0;r<rotatesperstride;r++)
-            {
-              //atrotate = (r + x*rotatesperstride)*rotatestridelength;
-              status = vectorMul_cf32(scratchspace->rotator, &(srcpointer[r*rotatestridelen]), &(scratchspace->rotated[r*rotatestridelen]), rotatestridelen);
-              if(status != vecNoErr)
-                csevere << startl << "Error in phase shift, multiplication1!!!" << status << endl;
-              status = vectorMulC_cf32_I(scratchspace->rotator[rotatestridelen+r+x*rotatesperstride], &(scratchspace->rotated[r*rotatestridelen]), rotatestridelen);
-              if(status != vecNoErr)
-                csevere << startl << "Error in phase shift, multiplication2!!!" << status << endl;
-            }
-            srcpointer = scratchspace->rotated;
-          }
+          if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
+            srcpointer = scratchspace->pulsaraccumspace[freqindex][x][baseline][0][k][b];
           else
-          {
-            if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
-              srcpointer = scratchspace->pulsaraccumspace[freqindex][x][baseline][0][k][b];
-            else
-              srcpointer = &(scratchspace->threadcrosscorrs[threadindex]);
-          }
+            srcpointer = &(scratchspace->threadcrosscorrs[threadindex]);
 
           //now average (or just copy) from the designated pointer to the main result buffer
           if(channelinc == 1) //this frequency is not averaged
@@ -1804,7 +2203,6 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
         }
       }
     }
-    coreindex += corebinloop*config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex)*freqchannels/channelinc;
   }
 
   //unlock the mutex for this segment of the copying
@@ -1819,9 +2217,10 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
     {
       timesmeardecorr = 1.0;
       delaydecorr = 1.0;
-      if(fabs(differentialdelay[s][0]) > 1e-18)
+      getdifferentialdelay(index, xcinterval, baseline, s, differentialdelay);
+      if(fabs(differentialdelay[0]) > 1e-18)
       {
-        maxphasechange  = TWO_PI*differentialdelay[s][0]*(nswidth/1000.0)*config->getFreqTableFreq(freqindex);
+        maxphasechange  = TWO_PI*differentialdelay[0]*(nswidth/1000.0)*config->getFreqTableFreq(freqindex);
         timesmeardecorr = sin(maxphasechange/2.0) / (maxphasechange/2.0);
         if(timesmeardecorr < 0.0) {
           // use Brian Kernighan's bit counting trick to see if shifterrorcount is a power of two, print only the first few and then increasingly less
@@ -1831,12 +2230,12 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
           scratchspace->shifterrorcount++;
         }
       }
-      if(fabs(differentialdelay[s][1]) > 1e-18)
+      if(fabs(differentialdelay[1]) > 1e-18)
       {
-        //maxphasechange  = TWO_PI*differentialdelay[s][1]*config->getFreqTableBandwidth(freqindex)/config->getFNumChannels(freqindex);
+        //maxphasechange  = TWO_PI*differentialdelay[1]*config->getFreqTableBandwidth(freqindex)/config->getFNumChannels(freqindex);
         //cout << "BW smearing: max phase change is " << maxphasechange << endl;
         //bwsmeardecorr   = sin(maxphasechange/2.0) / (maxphasechange/2.0);
-        delaydecorr     = 1.0 - fabs(differentialdelay[s][1] / delaywindow);
+        delaydecorr     = 1.0 - fabs(differentialdelay[1] / delaywindow);
         if(delaydecorr < 0.0) {
           // use Brian Kernighan's bit counting trick to see if shifterrorcount is a power of two, print only the first few and then increasingly less
           if(scratchspace->shifterrorcount < 10 || (scratchspace->shifterrorcount & (scratchspace->shifterrorcount-1)) == 0)
@@ -1844,255 +2243,216 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
           delaydecorr = 0;
           scratchspace->shifterrorcount++;
         }
-        //cout << "1.0 - Time smear decorr is " << 1.0-timesmeardecorr << ", 1.0 - bw smear decorr is " << 1.0-bwsmeardecorr << ", 1.0 - delaydecorr is " << 1.0-delaydecorr << "(diff. delay is " << differentialdelay[s][1] << ", delay window is " << delaywindow << ")" << endl;
+        //cout << "1.0 - Time smear decorr is " << 1.0-timesmeardecorr << ", 1.0 - bw smear decorr is " << 1.0-bwsmeardecorr << ", 1.0 - delaydecorr is " << 1.0-delaydecorr << "(diff. delay is " << differentialdelay[1] << ", delay window is " << delaywindow << ")" << endl;
       }
       //scratchspace->baselineshiftdecorr[freqindex][baseline][s] += nswidth*timesmeardecorr*bwsmeardecorr*delaydecorr;
       scratchspace->baselineshiftdecorr[freqindex][baseline][s] += nswidth*timesmeardecorr*delaydecorr;
     }
   }
+}
 
-  //free the phasecentredelay vectors if necessary
-  if(phasecentredelay1)
-  {
-    for(int i=0;i<model->getNumPhaseCentres(procslots[index].offsets[0]);i++)
-    {
-      delete [] phasecentredelay1[i];
-      delete [] phasecentredelay2[i];
-      delete [] differentialdelay[i];
-    }
-    delete [] phasecentredelay1;
-    delete [] phasecentredelay2;
-    delete [] differentialdelay;
-  }
+size_t Core::arenaBytes(size_t bytes)
+{
+  return ((bytes + ARENA_ALIGNMENT - 1)/ARENA_ALIGNMENT)*ARENA_ALIGNMENT;
 }
 
-void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins, int newconfigindex, int oldconfigindex, int threadid)
+void * Core::carveArena(u8 * arena, size_t & offset, size_t bytes)
 {
-  int status, freqchannels, localfreqindex;
+  void * carved = arena + offset;
 
-  cdebug << startl << "Just entering Core::createPulsarVaryingSpace" << endl;
-  if(oldconfigindex >= 0 && config->pulsarBinOn(oldconfigindex))
+  offset += arenaBytes(bytes);
+  return carved;
+}
+
+void Core::configArenaBytes(int configindex, size_t & pointerbytes, size_t & databytes)
+{
+  int localfreqindex, binloop, numpolproducts, xmacstrides;
+  bool pulsarbin = config->pulsarBinOn(configindex);
+  bool scrunch = pulsarbin && config->scrunchOutputOn(configindex);
+  int numbins = config->getNumPulsarBins(configindex);
+  int numbufferedffts = config->getNumBufferedFFTs(configindex);
+  int maxphasecentres = config->getMaxPhaseCentres(configindex);
+  int xmaclength = config->getXmacStrideLength(configindex);
+
+  //must carve out exactly what allocateConfigSpecificThreadSpace does
+  binloop = (pulsarbin && !scrunch)?numbins:1;
+  pointerbytes = 2*arenaBytes(sizeof(void*)*config->getFreqTableLength());
+  databytes = 0;
+  if(pulsarbin)
   {
-    cdebug << startl << "Going to delete the old bins..." << endl;
-    for(int i=0;i<config->getNumBufferedFFTs(oldconfigindex);i++)
+    pointerbytes += 2*arenaBytes(sizeof(void*)*numbufferedffts) + 2*numbufferedffts*arenaBytes(sizeof(void*)*config->getFreqTableLength());
+    for(int f=0;f<config->getFreqTableLength();f++)
     {
-      for(int f=0;f<config->getFreqTableLength();f++)
-      {
-        if(config->isFrequencyUsed(oldconfigindex, f))
-	{
-	  freqchannels = config->getFNumChannels(f);
-	  vectorFree((*bins)[i][f]);
-          threadbytes[threadid] -= 4*freqchannels;
-	}
-      }
-      delete [] (*bins)[i];
+      if(config->isFrequencyUsed(configindex, f))
+        databytes += 2*numbufferedffts*arenaBytes(sizeof(s32)*config->getFNumChannels(f));
     }
-    delete [] *bins;
-    cdebug << startl << "Finished deleting old bins..." << endl;
-    if(config->scrunchOutputOn(oldconfigindex))
+  }
+  if(scrunch)
+    pointerbytes += arenaBytes(sizeof(void*)*config->getFreqTableLength());
+  for(int f=0;f<config->getFreqTableLength();f++)
+  {
+    if(!config->isFrequencyUsed(configindex, f))
+      continue;
+    pointerbytes += arenaBytes(sizeof(void*)*binloop) + binloop*arenaBytes(sizeof(void*)*numbaselines);
+    if(maxphasecentres > 1)
+      pointerbytes += arenaBytes(sizeof(void*)*numbaselines);
+    xmacstrides = config->getNumXmacStrides(configindex, f);
+    if(scrunch)
+      pointerbytes += arenaBytes(sizeof(void*)*xmacstrides) + xmacstrides*arenaBytes(sizeof(void*)*numbaselines);
+    for(int j=0;j<numbaselines;j++)
     {
-      cdebug << startl << "Going to delete old acc space" << endl;
-      //need to delete the old pulsar accumulation space/bin space
-      for(int f=0;f<config->getFreqTableLength();f++)
+      localfreqindex = config->getBLocalFreqIndex(configindex, j, f);
+      if(localfreqindex < 0)
+        continue;
+      numpolproducts = config->getBNumPolProducts(configindex, j, localfreqindex);
+      databytes += binloop*arenaBytes(sizeof(f32)*numpolproducts);
+      if(maxphasecentres > 1)
+        databytes += arenaBytes(sizeof(f32)*maxphasecentres);
+      if(scrunch)
       {
-        if(config->isFrequencyUsed(oldconfigindex, f))
-        {
-          freqchannels = config->getFNumChannels(f);
-	  for(int x=0;x<config->getNumXmacStrides(oldconfigindex, f);x++)
-          {
-            for(int i=0;i<numbaselines;i++)
-            {
-              localfreqindex = config->getBLocalFreqIndex(oldconfigindex, i, f);
-              if(localfreqindex >= 0)
-              {
-                for(int s=0;s<1;s++) //forced to single pulsar ephemeris for now
-                {
-                  for(int j=0;j<config->getBNumPolProducts(oldconfigindex,i,localfreqindex);j++)
-                  {
-                    for(int k=0;k<config->getNumPulsarBins(oldconfigindex);k++)
-                    {
-                      threadbytes[threadid] -= 8*freqchannels;
-                      vectorFree(pulsaraccumspace[f][x][i][s][j][k]);
-                    }
-                    delete [] pulsaraccumspace[f][x][i][s][j];
-                  }
-                  delete [] pulsaraccumspace[f][x][i][s];
-                }
-              }
-              delete [] pulsaraccumspace[f][x][i];
-            }
-            delete [] pulsaraccumspace[f][x];
-          }
-          delete [] pulsaraccumspace[f];
-	}
+        pointerbytes += xmacstrides*(arenaBytes(sizeof(void*)) + arenaBytes(sizeof(void*)*numpolproducts) + numpolproducts*arenaBytes(sizeof(void*)*numbins));
+        databytes += ((size_t)xmacstrides)*numpolproducts*numbins*arenaBytes(sizeof(cf32)*xmaclength);
       }
     }
   }
-  cdebug << startl << "Finished deleting old pulsar scratch space" << endl;
-  if(newconfigindex >= 0 && config->pulsarBinOn(newconfigindex))
+}
+
+void Core::allocateConfigSpecificThreadSpace(threadscratchspace * scratchspace, int newconfigindex, int threadid)
+{
+  int localfreqindex, binloop, numbins, numbufferedffts, numpolproducts, maxphasecentres, xmaclength, status;
+  bool pulsarbin, scrunch;
+  size_t pointerbytes, databytes, pointeroffset, dataoffset, accumbytes;
+  u8 * arena;
+
+  if(newconfigindex < 0)
   {
-    *bins = new s32**[config->getNumBufferedFFTs(newconfigindex)];
-    for(int i=0;i<config->getNumBufferedFFTs(newconfigindex);i++)
+    //finished with the arena altogether
+    if(scratchspace->configarena != 0)
     {
-      (*bins)[i] = new s32*[config->getFreqTableLength()];
-      for(int f=0;f<config->getFreqTableLength();f++)
-      {
-        if(config->isFrequencyUsed(newconfigindex, f))
-	{
-	  freqchannels = config->getFNumChannels(f);
-          (*bins)[i][f] = vectorAlloc_s32(freqchannels);
-	  threadbytes[threadid] += 4*freqchannels;
-	}
-      }
+      vectorFree(scratchspace->configarena);
+      threadbytes[threadid] -= scratchspace->configarenabytes;
+    }
+    scratchspace->configarena = 0;
+    scratchspace->configarenabytes = 0;
+    return;
+  }
+
+  //only go back to the allocator if the new config needs more space than any config before it
+  configArenaBytes(newconfigindex, pointerbytes, databytes);
+  if(pointerbytes + databytes > scratchspace->configarenabytes)
+  {
+    if(scratchspace->configarena != 0)
+    {
+      vectorFree(scratchspace->configarena);
+      threadbytes[threadid] -= scratchspace->configarenabytes;
+    }
+    scratchspace->configarenabytes = pointerbytes + databytes;
+    scratchspace->configarena = vectorAlloc_u8(scratchspace->configarenabytes);
+    if(scratchspace->configarena == NULL) {
+      cfatal << startl << "Could not allocate thread scratch space (tried to allocate " << scratchspace->configarenabytes/(1024*1024) << " MB) - I must abort!" << endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
     }
-    if(config->scrunchOutputOn(newconfigindex))
+    threadbytes[threadid] += scratchspace->configarenabytes;
+  }
+
+  //lay the pointer tables out at the start of the arena and the arrays they point to after them
+  arena = scratchspace->configarena;
+  pointeroffset = 0;
+  dataoffset = pointerbytes;
+  pulsarbin = config->pulsarBinOn(newconfigindex);
+  scrunch = pulsarbin && config->scrunchOutputOn(newconfigindex);
+  numbins = config->getNumPulsarBins(newconfigindex);
+  numbufferedffts = config->getNumBufferedFFTs(newconfigindex);
+  maxphasecentres = config->getMaxPhaseCentres(newconfigindex);
+  xmaclength = config->getXmacStrideLength(newconfigindex);
+  binloop = (pulsarbin && !scrunch)?numbins:1;
+
+  scratchspace->baselineweight = (f32****)carveArena(arena, pointeroffset, sizeof(f32***)*config->getFreqTableLength());
+  scratchspace->baselineshiftdecorr = (f32***)carveArena(arena, pointeroffset, sizeof(f32**)*config->getFreqTableLength());
+  scratchspace->bins = 0;
+  scratchspace->binruns = 0;
+  if(pulsarbin)
+  {
+    scratchspace->bins = (s32***)carveArena(arena, pointeroffset, sizeof(s32**)*numbufferedffts);
+    scratchspace->binruns = (s32***)carveArena(arena, pointeroffset, sizeof(s32**)*numbufferedffts);
+    for(int i=0;i<numbufferedffts;i++)
     {
-      //need to create a new pulsar accumulation space
+      scratchspace->bins[i] = (s32**)carveArena(arena, pointeroffset, sizeof(s32*)*config->getFreqTableLength());
+      scratchspace->binruns[i] = (s32**)carveArena(arena, pointeroffset, sizeof(s32*)*config->getFreqTableLength());
       for(int f=0;f<config->getFreqTableLength();f++)
       {
         if(config->isFrequencyUsed(newconfigindex, f))
         {
-          pulsaraccumspace[f] = new cf32*****[config->getNumXmacStrides(newconfigindex, f)];
-          for(int x=0;x<config->getNumXmacStrides(newconfigindex, f);x++)
-          {
-            pulsaraccumspace[f][x] = new cf32****[numbaselines];
-            for(int i=0;i<numbaselines;i++)
-            {
-              localfreqindex = config->getBLocalFreqIndex(newconfigindex, i, f);
-              if(localfreqindex >= 0)
-              {
-                pulsaraccumspace[f][x][i] = new cf32***[1]; //just 1 source for now!
-                //for(int s=0;s<config->getMaxPhaseCentres(newconfigindex);s++)
-                for(int s=0;s<1;s++) //forced to single pulsar ephemeris for now
-                {
-                  pulsaraccumspace[f][x][i][s] = new cf32**[config->getBNumPolProducts(newconfigindex,i,localfreqindex)];
-                  for(int j=0;j<config->getBNumPolProducts(newconfigindex,i,localfreqindex);j++)
-                  {
-                    pulsaraccumspace[f][x][i][s][j] = new cf32*[config->getNumPulsarBins(newconfigindex)];
-                    for(int k=0;k<config->getNumPulsarBins(newconfigindex);k++)
-                    {
-                      pulsaraccumspace[f][x][i][s][j][k] = vectorAlloc_cf32(config->getXmacStrideLength(newconfigindex));
-                      if(pulsaraccumspace[f][x][i][s][j][k] == NULL) {
-                        cfatal << startl << "Could not allocate pulsar scratch space (out of memory?) - I must abort!" << endl;
-                        MPI_Abort(MPI_COMM_WORLD, 1);
-                      }
-                      threadbytes[threadid] += 8*config->getXmacStrideLength(newconfigindex);
-                      status = vectorZero_cf32(pulsaraccumspace[f][x][i][s][j][k], config->getXmacStrideLength(newconfigindex));
-                      if(status != vecNoErr)
-                        csevere << startl << "Error trying to zero pulsaraccumspace!!!" << endl;
-                    }
-                  }
-                }
-              }
-            }
-          }
+          scratchspace->bins[i][f] = (s32*)carveArena(arena, dataoffset, sizeof(s32)*config->getFNumChannels(f));
+          scratchspace->binruns[i][f] = (s32*)carveArena(arena, dataoffset, sizeof(s32)*config->getFNumChannels(f));
         }
       }
     }
   }
-  cdebug << startl << "Finished allocating new pulsar scratch space" << endl;
-}
+  scratchspace->pulsaraccumspace = 0;
+  if(scrunch)
+    scratchspace->pulsaraccumspace = (cf32*******)carveArena(arena, pointeroffset, sizeof(cf32******)*config->getFreqTableLength());
 
-void Core::allocateConfigSpecificThreadArrays(f32 **** baselineweight, f32 *** baselineshiftdecorr, int newconfigindex, int oldconfigindex, int threadid)
-{
-  int localfreqindex, binloop;
-
-  if(oldconfigindex >= 0)
+  for(int f=0;f<config->getFreqTableLength();f++)
   {
-    binloop = 1;
-    if(config->pulsarBinOn(oldconfigindex) && !config->scrunchOutputOn(oldconfigindex))
-      binloop = config->getNumPulsarBins(oldconfigindex);
-    for(int i=0;i<config->getFreqTableLength();i++)
+    if(!config->isFrequencyUsed(newconfigindex, f))
+      continue;
+    scratchspace->baselineweight[f] = (f32***)carveArena(arena, pointeroffset, sizeof(f32**)*binloop);
+    for(int b=0;b<binloop;b++)
+      scratchspace->baselineweight[f][b] = (f32**)carveArena(arena, pointeroffset, sizeof(f32*)*numbaselines);
+    if(maxphasecentres > 1)
+      scratchspace->baselineshiftdecorr[f] = (f32**)carveArena(arena, pointeroffset, sizeof(f32*)*numbaselines);
+    for(int j=0;j<numbaselines;j++)
     {
-      if(config->isFrequencyUsed(oldconfigindex, i))
-      {
-        for(int b=0;b<binloop;b++)
-        {
-          for(int j=0;j<numbaselines;j++)
-          {
-            localfreqindex = config->getBLocalFreqIndex(oldconfigindex, j, i);
-            if(localfreqindex > 0)
-            {
-              threadbytes[threadid] -= 4*config->getBNumPolProducts(oldconfigindex, j, localfreqindex);
-              vectorFree(baselineweight[i][b][j]);
-            }
-            delete [] baselineweight[i][b];
-          }
-          delete [] baselineweight[i];
-        }
-        if(config->getMaxPhaseCentres(oldconfigindex) > 1)
-        {
-          for(int j=0;j<numbaselines;j++)
-          {
-            localfreqindex = config->getBLocalFreqIndex(oldconfigindex, j, i);
-            if(localfreqindex > 0)
-            {
-              threadbytes[threadid] -= 4*config->getMaxPhaseCentres(oldconfigindex);
-              vectorFree(baselineshiftdecorr[i][j]);
-            }
-            delete [] baselineshiftdecorr[i];
-          }
-        }
-      }
+      localfreqindex = config->getBLocalFreqIndex(newconfigindex, j, f);
+      if(localfreqindex < 0)
+        continue;
+      numpolproducts = config->getBNumPolProducts(newconfigindex, j, localfreqindex);
+      for(int b=0;b<binloop;b++)
+        scratchspace->baselineweight[f][b][j] = (f32*)carveArena(arena, dataoffset, sizeof(f32)*numpolproducts);
+      if(maxphasecentres > 1)
+        scratchspace->baselineshiftdecorr[f][j] = (f32*)carveArena(arena, dataoffset, sizeof(f32)*maxphasecentres);
     }
-  }
 
-  if(newconfigindex >= 0)
-  {
-    binloop = 1;
-    if(config->pulsarBinOn(newconfigindex) && !config->scrunchOutputOn(newconfigindex))
-      binloop = config->getNumPulsarBins(newconfigindex);
-    for(int i=0;i<config->getFreqTableLength();i++)
+    if(scrunch)
     {
-      if(config->isFrequencyUsed(newconfigindex, i))
+      //the accumulators of all the bins of a polarisation product follow one another
+      scratchspace->pulsaraccumspace[f] = (cf32******)carveArena(arena, pointeroffset, sizeof(cf32*****)*config->getNumXmacStrides(newconfigindex, f));
+      for(int x=0;x<config->getNumXmacStrides(newconfigindex, f);x++)
       {
-        //allocate the baselineweight array
-        baselineweight[i] = new f32**[binloop];
-        for(int b=0;b<binloop;b++)
-        {
-          baselineweight[i][b] = new f32*[numbaselines];
-          for(int j=0;j<numbaselines;j++)
-          {
-            localfreqindex = config->getBLocalFreqIndex(newconfigindex, j, i);
-            if(localfreqindex >= 0)
-            {
-              threadbytes[threadid] += 4*config->getBNumPolProducts(newconfigindex, j, localfreqindex);
-              baselineweight[i][b][j] = vectorAlloc_f32(config->getBNumPolProducts(newconfigindex, j, localfreqindex));
-            }
-          }
-        }
-        if(config->getMaxPhaseCentres(newconfigindex) > 1)
+        scratchspace->pulsaraccumspace[f][x] = (cf32*****)carveArena(arena, pointeroffset, sizeof(cf32****)*numbaselines);
+        for(int i=0;i<numbaselines;i++)
         {
-          //allocate the baselineshiftdecorr array
-          baselineshiftdecorr[i] = new f32*[numbaselines];
-          for(int j=0;j<numbaselines;j++)
+          localfreqindex = config->getBLocalFreqIndex(newconfigindex, i, f);
+          if(localfreqindex < 0)
+            continue;
+          numpolproducts = config->getBNumPolProducts(newconfigindex, i, localfreqindex);
+          scratchspace->pulsaraccumspace[f][x][i] = (cf32****)carveArena(arena, pointeroffset, sizeof(cf32***)); //just 1 source for now!
+          for(int s=0;s<1;s++) //forced to single pulsar ephemeris for now
           {
-            localfreqindex = config->getBLocalFreqIndex(newconfigindex, j, i);
-            if(localfreqindex >= 0)
+            scratchspace->pulsaraccumspace[f][x][i][s] = (cf32***)carveArena(arena, pointeroffset, sizeof(cf32**)*numpolproducts);
+            for(int j=0;j<numpolproducts;j++)
             {
-              threadbytes[threadid] += 4*config->getMaxPhaseCentres(newconfigindex);
-              baselineshiftdecorr[i][j] = vectorAlloc_f32(config->getMaxPhaseCentres(newconfigindex));
+              scratchspace->pulsaraccumspace[f][x][i][s][j] = (cf32**)carveArena(arena, pointeroffset, sizeof(cf32*)*numbins);
+              accumbytes = numbins*arenaBytes(sizeof(cf32)*xmaclength);
+              status = vectorZero_u8(arena + dataoffset, accumbytes);
+              if(status != vecNoErr)
+                csevere << startl << "Error trying to zero pulsaraccumspace!!!" << endl;
+              for(int k=0;k<numbins;k++)
+                scratchspace->pulsaraccumspace[f][x][i][s][j][k] = (cf32*)carveArena(arena, dataoffset, sizeof(cf32)*xmaclength);
             }
           }
         }
       }
     }
   }
+  if(pointeroffset != pointerbytes || dataoffset != pointerbytes + databytes)
+    csevere << startl << "Thread " << threadid << " laid out " << pointeroffset << "/" << dataoffset - pointerbytes << " bytes of config scratch pointers/data, but sized them as " << pointerbytes << "/" << databytes << endl;
 }
 
-void Core::updateconfig(int oldconfigindex, int configindex, int threadid, int & startblock, int & numblocks, int & numpolycos, bool & pulsarbin, Mode ** modes, Polyco ** polycos, bool first)
+void Core::updateconfig(int oldconfigindex, int configindex, int threadid, int & numpolycos, bool & pulsarbin, Mode ** modes, Polyco ** polycos, bool first)
 {
   Polyco ** currentpolycos;
-  int blockspersend = config->getBlocksPerSend(configindex);
-  startblock = 0;
-  numblocks = 0;
-
-  //figure out what section we are responsible for
-  for(int i=0;i<=threadid;i++)
-  {
-    startblock += numblocks;
-    numblocks = blockspersend/numprocessthreads + ((i < blockspersend%numprocessthreads)?1:0);
-  }
 
   if(!first) //need to delete the old stuff
   {
@@ -31,6 +31,8 @@
 #include "datastream.h"
 #include "configuration.h"
 #include "mode.h"
+#include "uvshifter.h"
+#include "aggregator.h"
 #include "difxmessage.h"
 #include <pthread.h>
 
@@ -40,7 +42,8 @@
 
 This class provides the framework for doing the actual correlation, accepting baseband data from all telescopes, using Mode objects
 to do the station-based processing and then performing the cross-multiplication and accumulation.  The accumulated visibilities
-are then sent back to the FxManager.  An allocatable number of processing threads time-division multiplex the work. 
+are then sent back to the FxManager.  An allocatable number of processing threads share the work: each subintegration is divided into
+chunks of FFT blocks which are queued across the threads, and threads which run out of work steal chunks from the others' queues.
 
 @author Adam Deller
 */
@@ -51,13 +54,16 @@ public:
   * @param conf The configuration object, containing all information about the duration and setup of this correlation
   * @param dids Array containing the MPI ids of each Datastream
   * @param id The Core's MPI id
-  * @param rcomm An MPI_Comm object used for communicating to the FxManager only
+  * @param aid The MPI id of the Aggregator results are sent to, or -1 to send them straight to the FxManager
+  * @param rcomm An MPI_Comm object used for communicating to the FxManager (and Aggregator) only
   */
-  Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm);
+  Core(int id, Configuration * conf, int * dids, int aid, MPI_Comm rcomm);
   ~Core();
 
  /**
-  * Until told to terminate, sits in a loop receiving raw data from the Datastreams into the circular buffer and processing it
+  * Until told to terminate, sits in a loop receiving raw data from the Datastreams into the circular buffer and processing it.
+  * The buffer holds CORE RING LENGTH subintegrations (from the input file); results are sent back without blocking and the
+  * send is only completed when its slot is needed again
   */
   void execute();
 
@@ -67,12 +73,115 @@ public:
   */
   long long getEstimatedBytes();
 
-  /// The number of elements in the send/receive circular buffer
-  static const int RECEIVE_RING_LENGTH;
+ /**
+  * Returns how a processing thread has spent its time since it started
+  * @param threadid The processing thread
+  * @param busyseconds Set to the time spent processing FFT block chunks (seconds)
+  * @param idleseconds Set to the time spent waiting for data to process (seconds)
+  * @param chunksstolen Set to the number of chunks this thread took from the other threads' queues
+  */
+  void getThreadUtilisation(int threadid, double & busyseconds, double & idleseconds, long long & chunksstolen);
+
+  /**
+   * Returns how the main thread has spent its time waiting, so stalls in the send/receive pipeline can be located
+   * @param datawait Set to the time spent waiting for instructions and raw data to arrive (seconds)
+   * @param processwait Set to the time spent waiting for the processing threads to finish a slot (seconds)
+   * @param sendwait Set to the time spent waiting for result sends to the FxManager to complete (seconds)
+   */
+  void getMainThreadWaits(double & datawait, double & processwait, double & sendwait);
 
   /// The minimum weight for filterbank STA data to be sent
   static const double MINIMUM_FILTERBANK_WEIGHT;
 
+  /// The number of channels cross-multiplied as a block by xmacTiled
+  static const int XMAC_TILE_LENGTH;
+
+  /// The number of chunks of FFT blocks each processing thread is initially queued per subintegration
+  static const int CHUNKS_PER_THREAD;
+
+ /**
+  * Cross-multiplies and accumulates a set of baseline/polarisation products over several buffered FFTs.  The channel
+  * axis is worked through in tiles, so each tile of station spectra is loaded once for all the products that use it
+  * and each accumulator tile stays in cache while all of the FFTs are added into it
+  * @param vis1 The first station spectra, indexed [product*numffts + fft]
+  * @param vis2 The second station spectra, conjugated as they are multiplied, indexed as for vis1
+  * @param accumulators The accumulation destination for each product
+  * @param numproducts The number of baseline/polarisation products
+  * @param numffts The number of buffered FFTs to accumulate for each product
+  * @param length The number of channels in each spectrum
+  * @param tilelength The number of channels to process as a block
+  * @return vecNoErr on success, otherwise the status of the failing vector operation
+  */
+  static int xmacTiled(const cf32 * const * vis1, const cf32 * const * vis2, cf32 * const * accumulators, int numproducts, int numffts, int length, int tilelength);
+
+ /**
+  * As xmacTiled, for station spectra packed to reduced precision (Mode::packBandSpectra).  Each tile of a product is
+  * summed over the FFTs, then multiplied by the channel scales of both stations into the accumulator
+  * @param vis1 The first station packed spectra (cf16 or cs8), indexed [product*numffts + fft]
+  * @param vis2 The second station packed spectra, conjugated as they are multiplied, indexed as for vis1
+  * @param scales1 The channel scales of the first station spectra, for each product
+  * @param scales2 The channel scales of the second station spectra, for each product
+  * @param accumulators The accumulation destination for each product
+  * @param precision FLOAT16SPECTRA or INT8SPECTRA
+  * @param numproducts The number of baseline/polarisation products
+  * @param numffts The number of buffered FFTs to accumulate for each product
+  * @param length The number of channels in each spectrum
+  * @param tilelength The number of channels to process as a block
+  * @return vecNoErr on success, otherwise the status of the failing vector operation
+  */
+  static int xmacTiledPacked(const u8 * const * vis1, const u8 * const * vis2, const f32 * const * scales1, const f32 * const * scales2, cf32 * const * accumulators, Configuration::spectraprecision precision, int numproducts, int numffts, int length, int tilelength);
+
+  /// Every array laid out in a thread's config arena starts a multiple of this many bytes (a cache line) into it
+  static const int ARENA_ALIGNMENT;
+
+ /**
+  * Rounds a size up to a whole number of arena alignment units
+  * @param bytes The size to round up
+  * @return The space taken up in an arena by an array of that size
+  */
+  static size_t arenaBytes(size_t bytes);
+
+ /**
+  * Takes the next aligned array from an arena
+  * @param arena The start of the arena
+  * @param offset The offset of the next free byte in the arena, advanced past the array
+  * @param bytes The size of the array
+  * @return The start of the array
+  */
+  static void * carveArena(u8 * arena, size_t & offset, size_t bytes);
+
+  /// Runs of channels in the same pulsar bin shorter than this are added channel by channel rather than as a vector
+  static const int MIN_VECTOR_BIN_RUN;
+
+ /**
+  * Works out, for every channel, how many channels from it onwards fall in the same pulsar bin, stopping at the end of
+  * its xmac stride.  Done once per FFT and frequency, the runs are then used for every baseline and polarisation product
+  * @param bins The pulsar bin of each channel
+  * @param binruns Set to the length of the run of channels in the same bin starting at each channel
+  * @param numchannels The number of channels
+  * @param stridelength The xmac stride length; runs never cross a stride boundary
+  */
+  static void calculatebinruns(const s32 * bins, s32 * binruns, int numchannels, int stridelength);
+
+ /**
+  * Adds a run of cross-multiplied channels into the accumulator of their pulsar bin
+  * @param src The cross-multiplied channels
+  * @param dest The accumulator for the bin, at the first channel of the run
+  * @param length The number of channels in the run
+  * @return vecNoErr on success, otherwise the status of the failing vector operation
+  */
+  static inline int accumulatebinrun(const cf32 * src, cf32 * dest, int length)
+  {
+    if(length >= MIN_VECTOR_BIN_RUN)
+      return vectorAdd_cf32_I(src, dest, length);
+    for(int i=0;i<length;i++)
+    {
+      dest[i].re += src[i].re;
+      dest[i].im += src[i].im;
+    }
+    return vecNoErr;
+  }
+
 protected:
  /** 
   * Launches a new processing thread, which will work on a portion of the time slice every time an element in the circular buffer is processed
@@ -81,6 +190,9 @@ protected:
   static void * launchNewProcessThread(void * tdata);
 
 private:
+  /// The spacing of the per-thread chunk queues in a slot, in u64s, so that each sits on its own cache line
+  static const int CHUNK_QUEUE_STRIDE;
+
   /// Structure containing all the information necessary to describe one element in the circular send/receive buffer, and all the necessary space to
   /// store data and results
   typedef struct {
@@ -92,14 +204,25 @@ private:
     int threadresultlength;
     int coreresultlength;
     int * datalengthbytes;
+    MPI_Request * recvrequests; //persistent receives into this slot: data from each datastream, then control from each datastream
     int resultsvalid;
+    MPI_Request resultsrequest;
+    MPI_Request aggregaterequests[2]; //with an Aggregator: the header to it, and the notice to the FxManager
+    int aggregateheader[Aggregator::HEADER_LENGTH]; //scan, seconds, nanoseconds, integration, number of subints (see Aggregator)
+    bool resultssending; //an MPI_Isend of results is outstanding, so results must not be touched
     int configindex;
-    int offsets[3]; //0=scan, 1=seconds, 2=nanoseconds
+    int offsets[4]; //0=scan, 1=seconds, 2=nanoseconds, 3=integration within the scan
     bool keepprocessing;
     int numpulsarbins;
     bool pulsarbin;
     bool scrunchoutput;
-    pthread_mutex_t * slotlocks;
+    int chunkblocks;
+    int numchunks;
+    int xcintervalsperchunk;
+    int phasecentredelaylength;
+    f64 * phasecentredelays; //[xcinterval][datastream][phase centre, 0 = pointing centre][rate, delay], only filled for multi-field correlation
+    volatile u64 * chunkqueues; //[thread*CHUNK_QUEUE_STRIDE]: first (low 32 bits) and end (high 32 bits) chunk still queued
+    volatile int threadsfinished; //the slot can be reused once every thread has finished with it
     pthread_mutex_t ** viscopylocks;
     pthread_mutex_t autocorrcopylock;
     pthread_mutex_t bweightcopylock;
@@ -109,17 +232,28 @@ private:
 
   ///Structure containing all of the pointers to scratch space for a single thread
   typedef struct {
+    u8 * configarena; //holds everything below that varies with config, in computed layout; reused while big enough
+    size_t configarenabytes;
     f32 **** baselineweight; //[freq][pulsarbin][baseline][pol]
     f32 *** baselineshiftdecorr; //[freq][baseline][phasecentre]
     cf32 * threadcrosscorrs;
     s32 *** bins; //[fftsubloop][freq][channel]
+    s32 *** binruns; //[fftsubloop][freq][channel]
     cf32* pulsarscratchspace;
+    const cf32 ** xmacvis1; //[product*numffts + fft]
+    const cf32 ** xmacvis2; //[product*numffts + fft]
+    cf32 ** xmacaccumulators; //[product]
+    const u8 ** xmacpackedvis1; //[product*numffts + fft], only if some config uses reduced precision spectra
+    const u8 ** xmacpackedvis2; //[product*numffts + fft]
+    const f32 ** xmacscales1; //[product]
+    const f32 ** xmacscales2; //[product]
     cf32******* pulsaraccumspace; //[freq][stride][baseline][source][polproduct][bin][channel]
-    f64 * chanfreqs;
     cf32 * rotated;
-    cf32 * rotator;
     cf32 * channelsums;
-    f32 * argument;
+    UVShifter * uvshifter; //only for multiple phase centres
+    f64 * shiftdelays; //[phasecentre]
+    const cf32 ** shiftvis; //[bin*polproduct]
+    cf32 ** shiftout; //[bin*polproduct]
     int shifterrorcount;
     DifxMessageSTARecord * starecordbuffer;
     bool dumpsta;
@@ -133,28 +267,26 @@ private:
   } processthreadinfo;
 
  /**
-  * Allocates or deallocates the required scratch space for pulsar binning which varies with config
-  * @param pulsaraccumspace The array of scratch space [freq][xmacstride][baseline][src][pol][bin][chan]
-  * @param bins Pointer to the array for bins
-  * @param newconfigindex The index of the config which is to be used
-  * @param oldconfigindex The index of the config which was previously being used
-  * @param threadid The thread for which this will be done
+  * Works out how much of a thread's config arena the given config needs
+  * @param configindex The index of the config
+  * @param pointerbytes Set to the bytes needed for the pointer tables
+  * @param databytes Set to the bytes needed for the arrays the pointer tables point to
   */
-  void createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins, int newconfigindex, int oldconfigindex, int threadid);
+  void configArenaBytes(int configindex, size_t & pointerbytes, size_t & databytes);
 
  /**
-  * Allocates or deallocates the required space for thread-specific arrays which vary in size with config
-  * @param baselineweight The array for baseline weights [freq][bin][baseline][pol]
-  * @param baselineshiftdecorr The array for baseline shift decorrelation corrections [freq][baseline][phasecentre]
-  * @param newconfigindex The index of the config which is to be used
-  * @param oldconfigindex The index of the config which was previously being used
+  * Lays out the thread scratch space which varies with config (the baseline weights and shift decorrelation corrections,
+  * and the pulsar bins and accumulation space) in the thread's config arena, growing the arena first if it is too small
+  * @param scratchspace The thread's scratch space, whose config specific pointers are set
+  * @param newconfigindex The index of the config which is to be used, or -1 to free the arena
   * @param threadid The thread for which this will be done
   */
-  void allocateConfigSpecificThreadArrays(f32 **** baselineweight, f32 *** baselineshiftdecorr, int newconfigindex, int oldconfigindex, int threadid);
+  void allocateConfigSpecificThreadSpace(threadscratchspace * scratchspace, int newconfigindex, int threadid);
 
  /**
-  * While the correlation is continuing, processes the given thread's share of the next element in the send/receive circular buffer
-  * @param threadid The id of the thread which is doing the processing, which tells us which section of the time slice this call will process
+  * While the correlation is continuing, works through each element of the send/receive circular buffer in turn, processing chunks
+  * from this thread's queue and then any it can steal from the other threads
+  * @param threadid The id of the thread which is doing the processing, which tells us which chunk queue is its own
   */
   void loopprocess(int threadid);
 
@@ -167,17 +299,81 @@ private:
   int receivedata(int index, bool * terminate);
 
  /**
-  * Processes a single thread's section of a single subintegration
+  * Processes one chunk of FFT blocks from a single subintegration, adding the results into the slot
   * @param index The index in the circular send/receive buffer to be processed
   * @param threadid The id of the thread which is doing the processing
-  * @param startblock The first FFT block which is this thread's responsibility
-  * @param numblocks The number of FFT blocks which this thread will take care of
+  * @param startblock The first FFT block of the chunk
+  * @param numblocks The number of FFT blocks in the chunk
   * @param modes The Mode objects which handle the station-based processing
   * @param currentpolyco The correct Polyco object for this time slice - null if not pulsar binning
   * @param scratchspace Space for all of the intermediate results for this thread
   */
   void processdata(int index, int threadid, int startblock, int numblocks, Mode ** modes, Polyco * currentpolyco, threadscratchspace * scratchspace);
 
+ /**
+  * Divides the FFT blocks of a freshly received slot into chunks and queues them evenly across the processing threads
+  * @param index The index in the circular send/receive buffer
+  */
+  void queueslotchunks(int index);
+
+ /**
+  * For multi-field correlation, evaluates the delay model once per antenna (datastream) for the pointing centre and every
+  * phase centre at the midpoint of every cross-correlation averaging interval of a freshly queued slot.  The table is then
+  * shared read-only by all processing threads, rather than each thread recalculating it for every baseline and frequency
+  * @param index The index in the circular send/receive buffer
+  */
+  void calculatephasecentredelays(int index);
+
+ /**
+  * Works out the differential delay and delay rate between the two antennas of a baseline for one phase centre, relative
+  * to the pointing centre, from the slot's phase centre delay table
+  * @param index The index in the circular send/receive buffer
+  * @param xcinterval The cross-correlation averaging interval within the slot
+  * @param baseline The baseline
+  * @param phasecentre The phase centre (0 is the first phase centre, not the pointing centre)
+  * @param differentialdelay Filled with the differential delay rate [0] and delay in us [1]
+  */
+  void getdifferentialdelay(int index, int xcinterval, int baseline, int phasecentre, double * differentialdelay);
+
+ /**
+  * Takes the next chunk of FFT blocks for this thread: from the front of its own queue, or failing that from the
+  * back of another thread's queue.  Lock free - each queue is a single word updated by compare-and-swap
+  * @param index The index in the circular send/receive buffer being processed
+  * @param threadid The id of the thread looking for work
+  * @param stolen Set true if the chunk came from another thread's queue
+  * @return The chunk number, or -1 if no chunks remain queued for this slot
+  */
+  int takechunk(int index, int threadid, bool & stolen);
+
+ /**
+  * Marks the next slot in sequence as ready to be processed and wakes any waiting processing threads (main thread)
+  */
+  void publishslot();
+
+ /**
+  * Blocks until the given slot sequence number has been received (processing threads)
+  * @param slotnumber The sequence number (not ring index) of the slot
+  */
+  void waitforslot(int slotnumber);
+
+ /**
+  * Blocks until every processing thread has finished with the given slot (main thread)
+  * @param index The index in the circular send/receive buffer
+  */
+  void waitforslotfinished(int index);
+
+ /**
+  * Starts a non-blocking send of the results in a slot back to the FxManager (main thread)
+  * @param index The index in the circular send/receive buffer
+  */
+  void sendresults(int index);
+
+ /**
+  * If a results send is outstanding for a slot, waits for it to complete then zeros the slot's results ready for reuse (main thread)
+  * @param index The index in the circular send/receive buffer
+  */
+  void completeresultsend(int index);
+
  /**
   * Averages the autocorrelations down, sends off STA dumps down a socket if required and copies to coreresults
   * @param index The index in the circular send/receive buffer to be processed
@@ -190,7 +386,10 @@ private:
   void averageAndSendAutocorrs(int index, int threadid, double nsoffset, double nswidth, Mode ** modes, threadscratchspace * scratchspace);
 
  /**
-  * Averages the kurtosis down and sends off as a series of STA dumps down a socket
+  * Averages the kurtosis down and sends off as a series of STA dumps down a socket.  Called once per thread per
+  * subintegration, after the thread has taken its last chunk, so each record covers every FFT the thread processed
+  * (about 1/numprocessthreads of the subintegration, as before chunks were stolen); with stealing those chunks need
+  * not be contiguous, so the record's time range is the span from the first to the end of the last
   * @param index The index in the circular send/receive buffer to be processed
   * @param threadid The id of the thread which is doing the processing
   * @param nsoffset The offset from start of subintegration
@@ -215,10 +414,11 @@ private:
   * @param threadid The id of the thread which is doing the processing
   * @param nsoffset The offset from start of subintegration (for calculating UV shifts)
   * @param nswidth The width of the time range covered by this uv shift, in ns
+  * @param xcinterval The index of this cross-correlation averaging interval in the slot's phase centre delay table
   * @param currentpolyco The correct Polyco object for this time slice - null if not pulsar binning
   * @param scratchspace Space for all of the intermediate results for this thread
   */
-  void uvshiftAndAverage(int index, int threadid, double nsoffset, double nswidth, Polyco * currentpolyco, threadscratchspace * scratchspace);
+  void uvshiftAndAverage(int index, int threadid, double nsoffset, double nswidth, int xcinterval, Polyco * currentpolyco, threadscratchspace * scratchspace);
 
  /**
   * Does any uvshifting necessary and averages down in frequency into the coreresults
@@ -226,34 +426,32 @@ private:
   * @param threadid The id of the thread which is doing the processing
   * @param nsoffset The offset from start of subintegration (for calculating UV shifts)
   * @param nswidth  The width of the chunk of data in nanoseconds (for calculating UV shifts)
+  * @param xcinterval The index of this cross-correlation averaging interval in the slot's phase centre delay table
   * @param scratchspace Space for all of the intermediate results for this thread
   * @param freqindex The frequency (from the frequency table) to process
   * @param baseline The baseline to process
   */
-  void uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffset, double nswidth, threadscratchspace * scratchspace, int freqindex, int baseline);
+  void uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffset, double nswidth, int xcinterval, threadscratchspace * scratchspace, int freqindex, int baseline);
 
  /**
   * Updates all the parameters for processing thread when the configuration changes
   * @param oldconfigindex The index of the configuration we are changing from
   * @param configindex The index of the configuration we are changing to
   * @param threadid The thread for which we are setting the parameters
-  * @param startblock The FFT block which the thread will start processing at for the new configuration
-  * @param numblocks The number of FFT blocks which the thread will process for the new configuration
   * @param numpolycos The number of Polycos which are associated with this configuration (if it is a pulsar binning configuration)
   * @param pulsarbin Whether this configuration is does pulsar binning or not
   * @param modes The Mode objects that will be used to do the station-based processing for this configuration
   * @param polycos The polyco objects to be used with this configuration (null if not pulsar binning)
   * @param first Whether this is the first time the config has been updated (ie do the arrays exist already and need to be deallocated)
   */
-  void updateconfig(int oldconfigindex, int configindex, int threadid, int & startblock, int & numblocks, int & numpolycos, bool & pulsarbin, Mode ** modes, Polyco ** polycos, bool first);
+  void updateconfig(int oldconfigindex, int configindex, int threadid, int & numpolycos, bool & pulsarbin, Mode ** modes, Polyco ** polycos, bool first);
 
-  int mpiid;
+  int mpiid, aggregatorid;
   Configuration * config;
   MPI_Comm return_comm;
-  MPI_Request * datarequests;
-  MPI_Request * controlrequests;
   MPI_Status * msgstatuses;
   int numdatastreams, numbaselines, databytes, controllength, numreceived, numcomplete, currentconfigindex, numprocessthreads, maxthreadresultlength;
+  int receiveringlength;
   long long maxcoreresultlength;
   int startmjd, startseconds;
   long long estimatedbytes;
@@ -263,6 +461,14 @@ private:
   pthread_t * processthreads;
   pthread_cond_t * processconds;
   bool * processthreadinitialised;
+  pthread_mutex_t slotstatelock;
+  pthread_cond_t slotreadycond;
+  pthread_cond_t slotfinishedcond;
+  volatile int numslotsready;
+  double * threadbusytime;
+  double * threadidletime;
+  long long * threadchunksstolen;
+  double datawaittime, processwaittime, sendwaittime;
   Model * model;
 };
 
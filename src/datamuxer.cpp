@@ -25,8 +25,10 @@
 //
 //============================================================================
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include "datamuxer.h"
+#include "muxpool.h"
 #include "vdifio.h"
 #include "alert.h"
 #include "config.h"
@@ -46,6 +48,196 @@
 #define PRAGMA_OMP(args) /**/                                                            
 #endif                      
 
+#if defined(__SSE2__) && !defined(WORDS_BIGENDIAN)
+#define CORNERTURN_SSE2
+#include <emmintrin.h>
+#endif
+
+typedef void (*SIMDCornerTurner)(const u8 * const * threadpayloads, u8 * outputpayload, int payloadbytes);
+
+#ifdef CORNERTURN_SSE2
+/* SIMD corner turners, generated for each power of two number of threads from 2 to 64 and each
+ * sample size of 1, 2, 4, 8, 16 or 32 bits (a complex sample counts as one sample of twice the
+ * size of its parts).  The output is the threads' samples interleaved, one sample from each thread
+ * per time step, exactly as cornerturn_generic produces it.  Each pass takes 16 bytes from every
+ * thread:
+ *  - for samples smaller than a byte, the threads are first taken in groups of as many threads as
+ *    there are samples in a byte, and within each byte column of a group the samples are transposed
+ *    by swapping them between registers, leaving register i of the group holding time step i of
+ *    each byte column for the group's threads.  Each of these registers then becomes a stream of
+ *    whole output bytes;
+ *  - the streams of bytes (or 16 or 32 bit samples) are then interleaved by log2(threads) rounds
+ *    of unpacks, each round interleaving the first half of the registers with the second half;
+ *  - when there are fewer threads than samples in a byte, the bytes of each time step are instead
+ *    interleaved first and their samples then perfectly shuffled within the few bytes of the step.
+ * The payload must be a whole number of 8 byte words, as VDIF requires; a trailing 8 bytes are
+ * done as a half pass.
+ */
+static inline int lowsamplemask(int j, int bits)
+{
+  // within each byte, the samples whose index within the byte has bit j clear
+  int mask = 0;
+
+  for(int c=0;c<8/bits;c++) {
+    if(!(c & j))
+      mask |= ((1 << bits) - 1) << (c*bits);
+  }
+
+  return mask;
+}
+
+static inline void swapsamples(__m128i & lo, __m128i & hi, __m128i mask, int shift)
+{
+  // exchanges the samples of hi picked out by mask with the samples shift bits higher up in lo
+  __m128i t = _mm_and_si128(_mm_xor_si128(_mm_srli_epi64(lo, shift), hi), mask);
+
+  hi = _mm_xor_si128(hi, t);
+  lo = _mm_xor_si128(lo, _mm_slli_epi64(t, shift));
+}
+
+static inline __m128i shufflesamples(__m128i x, __m128i mask, int shift)
+{
+  // exchanges the bits picked out by mask with the bits shift places above them
+  __m128i t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, shift)), mask);
+
+  return _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, shift)));
+}
+
+template <int ELEMENTBYTES> struct SampleUnpack;
+template <> struct SampleUnpack<1>
+{
+  static inline __m128i lo(__m128i a, __m128i b) { return _mm_unpacklo_epi8(a, b); }
+  static inline __m128i hi(__m128i a, __m128i b) { return _mm_unpackhi_epi8(a, b); }
+};
+template <> struct SampleUnpack<2>
+{
+  static inline __m128i lo(__m128i a, __m128i b) { return _mm_unpacklo_epi16(a, b); }
+  static inline __m128i hi(__m128i a, __m128i b) { return _mm_unpackhi_epi16(a, b); }
+};
+template <> struct SampleUnpack<4>
+{
+  static inline __m128i lo(__m128i a, __m128i b) { return _mm_unpacklo_epi32(a, b); }
+  static inline __m128i hi(__m128i a, __m128i b) { return _mm_unpackhi_epi32(a, b); }
+};
+
+template <int NT, int BITS>
+static void sse2CornerTurn(const u8 * const * threadpayloads, u8 * outputpayload, int payloadbytes)
+{
+  const int samplesperbyte = (BITS < 8)?8/BITS:1;
+  const int elementbytes = (BITS < 8)?1:BITS/8;
+  const int numgroups = (NT >= samplesperbyte)?NT/samplesperbyte:1;
+  __m128i in[NT], out[NT], transposemask[3], shufflemask[4];
+  int shuffleshift[4], numshuffles = 0, numstores;
+
+  for(int k=0;k<3;k++)
+    transposemask[k] = _mm_set1_epi8((char)lowsamplemask(1 << k, (BITS < 8)?BITS:8));
+  if(BITS < 8 && NT < samplesperbyte) {
+    // perfect shuffle of the 2 (or 4) bytes of each time step, down to the sample size
+    static const int shuffle16masks[3] = {0x00F0, 0x0C0C, 0x2222};
+    static const int shuffle32masks[4] = {0x0000FF00, 0x00F000F0, 0x0C0C0C0C, 0x22222222};
+    for(int s=(NT == 2)?4:8,k=0;s>=BITS;s/=2,k++) {
+      shufflemask[numshuffles] = (NT == 2)?_mm_set1_epi16((short)shuffle16masks[k]):_mm_set1_epi32(shuffle32masks[k]);
+      shuffleshift[numshuffles++] = s;
+    }
+  }
+
+  for(int b=0;b<payloadbytes;b+=16) {
+    bool half = (payloadbytes - b < 16);
+
+    for(int i=0;i<NT;i++)
+      in[i] = (half)?_mm_loadl_epi64((const __m128i *)(threadpayloads[i] + b)):_mm_loadu_si128((const __m128i *)(threadpayloads[i] + b));
+
+    if(BITS < 8 && NT >= samplesperbyte) {
+      // transpose the samples of each byte column of each group of threads, then make each time
+      // step of each group a stream of output bytes, ordered as they are in the output
+      for(int k=0;(1 << k)<samplesperbyte;k++) {
+        for(int g=0;g<NT;g+=samplesperbyte) {
+          for(int i=0;i<samplesperbyte;i++) {
+            if(!(i & (1 << k)))
+              swapsamples(in[g + i], in[g + i + (1 << k)], transposemask[k], (1 << k)*BITS);
+          }
+        }
+      }
+      for(int g=0;g<numgroups;g++) {
+        for(int i=0;i<samplesperbyte;i++)
+          out[i*numgroups + g] = in[g*samplesperbyte + i];
+      }
+    }
+    else {
+      for(int i=0;i<NT;i++)
+        out[i] = in[i];
+    }
+
+    // interleave the streams
+    for(int n=1;n<NT;n*=2) {
+      for(int i=0;i<NT;i++)
+        in[i] = out[i];
+      for(int i=0;i<NT/2;i++) {
+        out[2*i]   = SampleUnpack<elementbytes>::lo(in[i], in[i + NT/2]);
+        out[2*i+1] = SampleUnpack<elementbytes>::hi(in[i], in[i + NT/2]);
+      }
+    }
+
+    for(int k=0;k<numshuffles;k++) {
+      for(int i=0;i<NT;i++)
+        out[i] = shufflesamples(out[i], shufflemask[k], shuffleshift[k]);
+    }
+    if(BITS < 8 && NT == 4 && samplesperbyte == 8) {
+      // four 1 bit threads need a second perfect shuffle of each 32 bit time step
+      for(int k=0;k<numshuffles;k++) {
+        for(int i=0;i<NT;i++)
+          out[i] = shufflesamples(out[i], shufflemask[k], shuffleshift[k]);
+      }
+    }
+
+    // a half pass fills just the first half of the output registers
+    numstores = (half)?NT/2:NT;
+    for(int i=0;i<numstores;i++)
+      _mm_storeu_si128((__m128i *)(outputpayload + b*NT + 16*i), out[i]);
+  }
+}
+
+template <int BITS>
+static SIMDCornerTurner sse2CornerTurner(int numthreads)
+{
+  switch(numthreads) {
+    case 2:  return sse2CornerTurn<2, BITS>;
+    case 4:  return sse2CornerTurn<4, BITS>;
+    case 8:  return sse2CornerTurn<8, BITS>;
+    case 16: return sse2CornerTurn<16, BITS>;
+    case 32: return sse2CornerTurn<32, BITS>;
+    case 64: return sse2CornerTurn<64, BITS>;
+    default: return 0;
+  }
+}
+#endif
+
+/**
+ * Picks the SIMD corner turner for a layout
+ * @param numthreads The number of threads being muxed
+ * @param samplebits The number of bits in each (real or complex) sample
+ * @param payloadbytes The number of bytes of data in each input frame
+ * @return The corner turner, or 0 if there is none for this layout
+ */
+static SIMDCornerTurner simdCornerTurner(int numthreads, int samplebits, int payloadbytes)
+{
+#ifdef CORNERTURN_SSE2
+  if(payloadbytes % 8 != 0)
+    return 0;
+  switch(samplebits) {
+    case 1:  return sse2CornerTurner<1>(numthreads);
+    case 2:  return sse2CornerTurner<2>(numthreads);
+    case 4:  return sse2CornerTurner<4>(numthreads);
+    case 8:  return sse2CornerTurner<8>(numthreads);
+    case 16: return sse2CornerTurner<16>(numthreads);
+    case 32: return sse2CornerTurner<32>(numthreads);
+    default: return 0;
+  }
+#else
+  return 0;
+#endif
+}
+
 DataMuxer::DataMuxer(const Configuration * conf, int dsindex, int id, int nthreads, int sbytes)
   : config(conf), datastreamindex(dsindex), mpiid(id), numthreads(nthreads), segmentbytes(sbytes)
 {
@@ -103,20 +295,37 @@ double DataMuxer::getMaxThreadBufferFree()
   return maxfree;
 }
 
-VDIFMuxer::VDIFMuxer(const Configuration * conf, int dsindex, int id, int nthreads, int iframebytes, int rframes, int fpersec, int bitspersamp, int * tmap)
+VDIFMuxer::VDIFMuxer(const Configuration * conf, int dsindex, int id, int nthreads, int iframebytes, int rframes, int fpersec, int bitspersamp, int * tmap, bool iscomplex)
   : DataMuxer(conf, dsindex, id, nthreads, iframebytes*rframes), inputframebytes(iframebytes), readframes(rframes), framespersecond(fpersec), bitspersample(bitspersamp)
 {
   cinfo << startl << "VDIFMuxer: framespersecond is " << framespersecond << ", iframebytes is " << inputframebytes << endl;
   cinfo << startl << "VDIFMuxer: readframes is " << readframes << endl;
+  //a complex sample is corner turned as one unit, so its real and imaginary parts stay together
+  samplebits = (iscomplex)?2*bitspersample:bitspersample;
   outputframebytes = (inputframebytes-VDIF_HEADER_BYTES)*numthreads + VDIF_HEADER_BYTES;
   processframenumber = 0;
   numthreadbufframes = readframes * DEMUX_BUFFER_FACTOR / numthreads;
-  activemask = (1<<bitspersample) - 1;
+  activemask = (samplebits >= 32)?0xFFFFFFFF:(1u<<samplebits) - 1;
   threadindexmap = new int[numthreads];
+  threadindexlookup = new int[VDIF_MAX_THREAD_ID+1];
   bufferframefull = new bool*[numthreads];
-  threadwords = new unsigned int[numthreads];
+  turnprocessindex = new int[readframes/numthreads + 1];
+  turnoutputframe = new int[readframes/numthreads + 1];
+  numturns = 0;
+  turnoutputbuffer = 0;
+  simdkernel = 0;
+  muxpool = MuxPool::acquireShared();
+  if(muxpool) {
+    cinfo << startl << "VDIFMuxer: corner turning with " << muxpool->getNumThreads() << " threads" << endl;
+  }
+  for(int i=0;i<=VDIF_MAX_THREAD_ID;i++)
+    threadindexlookup[i] = -1;
   for(int i=0;i<numthreads;i++) {
     threadindexmap[i] = tmap[i];
+    if(tmap[i] >= 0 && tmap[i] <= VDIF_MAX_THREAD_ID)
+      threadindexlookup[tmap[i]] = i;
+    else
+      cerror << startl << "VDIFMuxer: threadId " << tmap[i] << " is out of range - no frames will be taken for output thread " << i << endl;
     bufferframefull[i] = new bool[numthreadbufframes];
     for(int j=0;j<numthreadbufframes;j++)
       bufferframefull[i][j] = false;
@@ -129,7 +338,10 @@ VDIFMuxer::~VDIFMuxer()
     delete [] bufferframefull[i];
   }
   delete [] bufferframefull;
-  delete [] threadwords;
+  delete [] turnprocessindex;
+  delete [] turnoutputframe;
+  MuxPool::releaseShared(muxpool);
+  delete [] threadindexlookup;
   delete [] threadindexmap;
 }
 
@@ -145,6 +357,9 @@ void VDIFMuxer::resetcounters()
 
 bool VDIFMuxer::initialise()
 {
+  const char * turnerenv;
+  bool allowsimd;
+
   //check the size of an int
   if (sizeof(int) != 4) {
     cfatal << startl << "Int size is " << sizeof(int) << " bytes - VDIFMuxer assumes 4 byte ints - I must abort!" << endl;
@@ -157,37 +372,45 @@ bool VDIFMuxer::initialise()
   refframemjd = getVDIFFrameMJD(header);
   refframesecond = getVDIFFrameSecond(header);
   refframenumber = getVDIFFrameNumber(header);
-  samplesperframe = ((inputframebytes-VDIF_HEADER_BYTES)*8)/bitspersample;
+  samplesperframe = ((inputframebytes-VDIF_HEADER_BYTES)*8)/samplebits;
   wordsperinputframe = (inputframebytes-VDIF_HEADER_BYTES)/4;
   wordsperoutputframe = wordsperinputframe*numthreads;
   samplesperinputword = samplesperframe/wordsperinputframe;
   samplesperoutputword = samplesperinputword/numthreads;
-  if(samplesperoutputword == 0) {
-    cfatal << startl << "Too many threads/too high bit resolution - can't fit one complete timestep in a 32 bit word! Aborting." << endl;
-    return false;
+  //DIFX_VDIF_CORNERTURN can be set to "generic" or "nosimd" to narrow the choice, for testing
+  cornerturn = 0;
+  turnerenv = getenv("DIFX_VDIF_CORNERTURN");
+  allowsimd = (turnerenv == 0 || strcmp(turnerenv, "nosimd") != 0);
+  if(turnerenv != 0 && strcmp(turnerenv, "generic") == 0) {
+    cinfo << startl << "DIFX_VDIF_CORNERTURN is set: using the generic VDIF corner turner" << endl;
+    cornerturn = &VDIFMuxer::cornerturn_generic;
   }
 #ifdef WORDS_BIGENDIAN
   // For big endian (non-intel), different, yet to be implemented, corner turners are needed
   // It is not even clear this generic one works for big endian...
   cornerturn = &VDIFMuxer::cornerturn_generic;
 #else
-  if (numthreads == 1) {
+  else if (numthreads == 1) {
     cinfo << startl << "Using optimized VDIF corner turner: cornerturn_1thread" << endl;
     cornerturn = &VDIFMuxer::cornerturn_1thread;
   }
-  else if (numthreads == 2 && bitspersample == 2) {
+  else if (allowsimd && (simdkernel = simdCornerTurner(numthreads, samplebits, inputframebytes-VDIF_HEADER_BYTES)) != 0) {
+    cinfo << startl << "Using SIMD VDIF corner turner for " << numthreads << " threads of " << samplebits << " bit samples" << endl;
+    cornerturn = &VDIFMuxer::cornerturn_simd;
+  }
+  else if (numthreads == 2 && samplebits == 2) {
     cinfo << startl << "Using optimized VDIF corner turner: cornerturn_2thread_2bit" << endl;
     cornerturn = &VDIFMuxer::cornerturn_2thread_2bit;
   }
-  else if (numthreads == 4 && bitspersample == 2) {
+  else if (numthreads == 4 && samplebits == 2) {
     cinfo << startl << "Using optimized VDIF corner turner: cornerturn_4thread_2bit" << endl;
     cornerturn = &VDIFMuxer::cornerturn_4thread_2bit;
   }
-  else if (numthreads == 8 && bitspersample == 2) {
+  else if (numthreads == 8 && samplebits == 2) {
     cinfo << startl << "Using optimized VDIF corner turner: cornerturn_8thread_2bit" << endl;
     cornerturn = &VDIFMuxer::cornerturn_8thread_2bit;
   }
-  else if (numthreads == 16 && bitspersample == 2) {
+  else if (numthreads == 16 && samplebits == 2) {
     cinfo << startl << "Using optimized VDIF corner turner: cornerturn_16thread_2bit" << endl;
     cornerturn = &VDIFMuxer::cornerturn_16thread_2bit;
   }
@@ -196,6 +419,10 @@ bool VDIFMuxer::initialise()
     cornerturn = &VDIFMuxer::cornerturn_generic;
   }
 #endif
+  if(cornerturn == &VDIFMuxer::cornerturn_generic && samplesperoutputword == 0) {
+    cfatal << startl << "Too many threads/too high bit resolution - can't fit one complete timestep in a 32 bit word! Aborting." << endl;
+    return false;
+  }
 
   return true;
 }
@@ -254,6 +481,7 @@ void VDIFMuxer::cornerturn_generic(u8 * outputbuffer, int processindex, int outp
 {
   unsigned int copyword;
   unsigned int * outputwordptr;
+  unsigned int threadwords[32]; //a time step fits in a 32 bit word, so no more threads than this
   
   //loop over all the samples and copy them in
   copyword = 0;
@@ -265,7 +493,7 @@ void VDIFMuxer::cornerturn_generic(u8 * outputbuffer, int processindex, int outp
       copyword = 0;
       for(int k=0;k<samplesperoutputword;k++) {
         for(int l=0;l<numthreads;l++) {
-          copyword |= ((threadwords[l] >> ((j*samplesperoutputword + k)*bitspersample)) & (activemask)) << (k*numthreads + l)*bitspersample;
+          copyword |= ((threadwords[l] >> ((j*samplesperoutputword + k)*samplebits)) & (activemask)) << (k*numthreads + l)*samplebits;
         }
       }
       *outputwordptr = copyword;
@@ -286,6 +514,17 @@ void VDIFMuxer::cornerturn_1thread(u8 * outputbuffer, int processindex, int outp
 }
 
 
+void VDIFMuxer::cornerturn_simd(u8 * outputbuffer, int processindex, int outputframecount)
+{
+  const u8 * threadpayloads[64]; //the most threads there is a SIMD corner turner for; local, so frames can be turned concurrently
+
+  for(int i=0;i<numthreads;i++)
+    threadpayloads[i] = threadbuffers[i] + processindex*inputframebytes + VDIF_HEADER_BYTES;
+
+  simdkernel(threadpayloads, outputbuffer + outputframecount*outputframebytes + VDIF_HEADER_BYTES, inputframebytes - VDIF_HEADER_BYTES);
+}
+
+
 void VDIFMuxer::cornerturn_2thread_2bit(u8 * outputbuffer, int processindex, int outputframecount)
 {
   // Efficiently handle the special case of 2 threads of 2-bit data.
@@ -685,6 +924,7 @@ int VDIFMuxer::multiplex(u8 * outputbuffer)
   bool foundframe;
 
   outputframecount = 0;
+  numturns = 0;
   lastskipframes = skipframes;
 
   //loop over one read's worth of data
@@ -701,7 +941,14 @@ int VDIFMuxer::multiplex(u8 * outputbuffer)
       setVDIFThreadID(header, 0);
 
       // call the corner turning function.  gotta love this syntax!
-      (this->*cornerturn)(outputbuffer, processindex, outputframecount);
+      // with a pool the turns are saved up and shared out below, the thread buffers being untouched until the next deinterlace
+      if(muxpool) {
+        turnprocessindex[numturns] = processindex;
+        turnoutputframe[numturns] = outputframecount;
+        numturns++;
+      }
+      else
+        (this->*cornerturn)(outputbuffer, processindex, outputframecount);
 
       outputframecount++;
     }
@@ -758,16 +1005,29 @@ int VDIFMuxer::multiplex(u8 * outputbuffer)
     }
     processframenumber++;
   }
+
+  //each thread of the pool turns a contiguous run of output frames
+  if(numturns > 0) {
+    turnoutputbuffer = outputbuffer;
+    muxpool->run(VDIFMuxer::cornerturnPart, this, (numturns < muxpool->getNumThreads())?numturns:muxpool->getNumThreads());
+  }
   
   return outputframecount*outputframebytes;
 }
 
+void VDIFMuxer::cornerturnPart(void * arg, int part, int numparts)
+{
+  VDIFMuxer * muxer = (VDIFMuxer *)arg;
+
+  for(int i=muxer->numturns*part/numparts;i<muxer->numturns*(part+1)/numparts;i++)
+    (muxer->*(muxer->cornerturn))(muxer->turnoutputbuffer, muxer->turnprocessindex[i], muxer->turnoutputframe[i]);
+}
+
 bool VDIFMuxer::deinterlace(int validbytes)
 {
   int framethread, framebytes, framemjd, framesecond, framenumber;
   int frameoffset, frameindex, threadindex;
   long long currentframenumber;
-  bool found;
   double bufferratio;
   vdif_header * inputptr;
 
@@ -787,18 +1047,9 @@ bool VDIFMuxer::deinterlace(int validbytes)
       return false;
     }
 
-//EFFICIENCY: make map from threadId [0 to 1023] to local threadindex [0 to nChan-1]
-
     //check that this thread is wanted
-    found = false;
-    for(int j=0;j<numthreads;j++) {
-      if(threadindexmap[j] == framethread) {
-        found = true;
-        threadindex = j;
-        break;
-      }
-    }
-    if(!found) {
+    threadindex = threadindexlookup[framethread];
+    if(threadindex < 0) {
       cdebug << startl << "Skipping packet from threadId " << framethread << ", numthreads is " << numthreads << ", mapping is " << endl;
       for(int j=0;j<numthreads;j++)
         cdebug << startl << threadindexmap[j] << endl;
@@ -29,6 +29,8 @@
 
 #include "configuration.h"
 
+class MuxPool;
+
 /**
 @class DataMuxer
 @brief Provides scratch space for muxing of data from multiple threads (consisting of sequential interleaved frames) into a single thread
@@ -166,10 +168,11 @@ public:
   * @param iframebytes The size of an input VDIF frame in bytes (including header)
   * @param rframes The number of frames to read at a time
   * @param fpersec The number of frames expected per second
-  * @param bitspersamp The number of bits per sample
+  * @param bitspersamp The number of bits per sample (per component, for complex samples)
   * @param tmap Array containing mapping from origin threadIds to position in output single-thread file
+  * @param iscomplex True if the samples are complex, in which case the real and imaginary parts of a sample are kept together
   */
-  VDIFMuxer(const Configuration * conf, int dsindex, int id, int nthreads, int iframebytes, int rframes, int fpersec, int bitspersamp, int * tmap);
+  VDIFMuxer(const Configuration * conf, int dsindex, int id, int nthreads, int iframebytes, int rframes, int fpersec, int bitspersamp, int * tmap, bool iscomplex = false);
 
   virtual ~VDIFMuxer();
 
@@ -224,17 +227,25 @@ protected:
 
   ///other variables
   int  *  threadindexmap;     // [numthreads]
-  unsigned int * threadwords; // [numthreads]
+  int  *  threadindexlookup;  // [VDIF_MAX_THREAD_ID+1], local thread index for each threadId, or -1 if not wanted
   bool ** bufferframefull;    // [numthreads][numbufferframes]
-  int inputframebytes, outputframebytes, readframes, framespersecond, bitspersample, numthreadbufframes;
+  int  *  turnprocessindex;   // [readframes/numthreads], the buffer frames left to corner turn by the pool...
+  int  *  turnoutputframe;    // [readframes/numthreads] ...and the output frames they go to
+  int numturns;
+  u8 * turnoutputbuffer;
+  MuxPool * muxpool;          // the process's shared pool; null unless DIFX_MUX_THREADS asks for more than one thread
+  int inputframebytes, outputframebytes, readframes, framespersecond, bitspersample, samplebits, numthreadbufframes;
   int refframemjd, refframesecond, refframenumber;
   int samplesperframe, wordsperinputframe, wordsperoutputframe, samplesperinputword, samplesperoutputword;
   unsigned int copyword, activemask;
   long long processframenumber;
   void (VDIFMuxer::*cornerturn)(u8 * outputbuffer, int processindex, int outputframecount);
+  void (*simdkernel)(const u8 * const * threadpayloads, u8 * outputpayload, int payloadbytes);
 
 private:
+  static void cornerturnPart(void * arg, int part, int numparts);
   void cornerturn_generic(u8 * outputbuffer, int processindex, int outputframecount);
+  void cornerturn_simd(u8 * outputbuffer, int processindex, int outputframecount);
   void cornerturn_1thread(u8 * outputbuffer, int processindex, int outputframecount);
   void cornerturn_2thread_2bit(u8 * outputbuffer, int processindex, int outputframecount);
   void cornerturn_4thread_2bit(u8 * outputbuffer, int processindex, int outputframecount);
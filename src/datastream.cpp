@@ -124,7 +124,7 @@ DataStream::~DataStream()
 
 void DataStream::initialise()
 {
-  int status, currentconfigindex, currentoverflowbytes, overflowbytes = 0;
+  int status, currentconfigindex;
   int maxbytes = config->getMaxDataBytes(streamnum);
 
   if ((uint64_t)maxbytes*databufferfactor>4294967296LL) { // Will overflow 32bit int
@@ -140,19 +140,15 @@ void DataStream::initialise()
 
   //cinfo << startl << "******DATASTREAM " << mpiid << ": Initialise. bufferbytes=" << bufferbytes << "  numdatasegments=" << numdatasegments << "  readbytes=" << readbytes << endl;
 
-  for(int i=0;i<config->getNumConfigs();i++) {
-    currentoverflowbytes = int((((long long)config->getDataBytes(i,streamnum))*((long long)(config->getSubintNS(i) + config->getGuardNS(i))))/config->getSubintNS(i));
-    if(currentoverflowbytes > overflowbytes)
-      overflowbytes = currentoverflowbytes;
-  }
-  cinfo << startl << "About to allocate " << bufferbytes << " + " << overflowbytes << " bytes in datastream databuffer" << endl;
-  databuffer = vectorAlloc_u8(bufferbytes + overflowbytes + 4); // a couple extra for mark5 case
-  estimatedbytes += bufferbytes + overflowbytes + 8;
+  //sends that wrap around the end of databuffer go out in place as two pieces, so no overflow area is needed past the end
+  cinfo << startl << "About to allocate " << bufferbytes << " bytes in datastream databuffer" << endl;
+  databuffer = vectorAlloc_u8(bufferbytes + 4); // a couple extra for mark5 case
+  estimatedbytes += bufferbytes + 8;
   if(databuffer == NULL) {
-    cfatal << startl << "Datastream " << mpiid << " could not allocate databuffer (length " << bufferbytes + overflowbytes << ") - aborting!!!" << endl;
+    cfatal << startl << "Datastream " << mpiid << " could not allocate databuffer (length " << bufferbytes << ") - aborting!!!" << endl;
     MPI_Abort(MPI_COMM_WORLD, 1);
   }
-  vectorZero_u8(databuffer, bufferbytes + overflowbytes + 4);
+  vectorZero_u8(databuffer, bufferbytes + 4);
   tempbuf = 0;
   tempbytes = 0;
   int mindatabytes = config->getDataBytes(0, streamnum);
@@ -259,8 +255,10 @@ void DataStream::execute()
   controlstatuses = new MPI_Status[maxsendspersegment];
   MPI_Request msgrequest;
   MPI_Status msgstatus;
+  MPI_Datatype wrappedtype;
   int targetcore, status, action, startpos, bufferremaining, perr;
   int receiveinfo[4];
+  int blocklengths[2], blockoffsets[2];
   time_t currentseconds, lastseconds;
 
   lastseconds = time(NULL);
@@ -302,27 +300,30 @@ void DataStream::execute()
       //(waits until all sends in the zone have been received, then reads, and calculates the control array values)
       startpos = calculateControlParams(activescan, activesec, activens);
 
-      //ensure that if we need to wrap around the end of the array the overflow is copied back
-      bufferremaining = bufferbytes - startpos;
-      if(bufferremaining < bufferinfo[atsegment].sendbytes)
-      {
-        status = vectorCopy_u8(databuffer, &databuffer[bufferbytes], bufferinfo[atsegment].sendbytes - bufferremaining);
-        if(status != vecNoErr)
-          csevere << startl << "Error copying in the DataStream data buffer!!!" << endl;
-      }
-
       if(bufferinfo[atsegment].controlbuffer[bufferinfo[atsegment].numsent][1] == Mode::INVALID_SUBINT)
       {
         //bad or no data, don't waste time sending full length of junk
         MPI_Issend(&databuffer[startpos], 1, MPI_UNSIGNED_CHAR, targetcore, CR_PROCESSDATA, MPI_COMM_WORLD, &(bufferinfo[atsegment].datarequests[bufferinfo[atsegment].numsent]));
-        MPI_Issend(bufferinfo[atsegment].controlbuffer[bufferinfo[atsegment].numsent], bufferinfo[atsegment].controllength, MPI_INT, targetcore, CR_PROCESSCONTROL, MPI_COMM_WORLD, &(bufferinfo[atsegment].controlrequests[bufferinfo[atsegment].numsent]));
       }
       else
       {
-        //data is ok
-        MPI_Issend(&databuffer[startpos], bufferinfo[atsegment].sendbytes, MPI_UNSIGNED_CHAR, targetcore, CR_PROCESSDATA, MPI_COMM_WORLD, &(bufferinfo[atsegment].datarequests[bufferinfo[atsegment].numsent]));
-        MPI_Issend(bufferinfo[atsegment].controlbuffer[bufferinfo[atsegment].numsent], bufferinfo[atsegment].controllength, MPI_INT, targetcore, CR_PROCESSCONTROL, MPI_COMM_WORLD, &(bufferinfo[atsegment].controlrequests[bufferinfo[atsegment].numsent]));
+        //data is ok - if it wraps around the end of the array, send the tail and the start in place rather than copying the start to the end
+        bufferremaining = bufferbytes - startpos;
+        if(bufferremaining < bufferinfo[atsegment].sendbytes)
+        {
+          blocklengths[0] = bufferremaining;
+          blocklengths[1] = bufferinfo[atsegment].sendbytes - bufferremaining;
+          blockoffsets[0] = startpos;
+          blockoffsets[1] = 0;
+          MPI_Type_indexed(2, blocklengths, blockoffsets, MPI_UNSIGNED_CHAR, &wrappedtype);
+          MPI_Type_commit(&wrappedtype);
+          MPI_Issend(databuffer, 1, wrappedtype, targetcore, CR_PROCESSDATA, MPI_COMM_WORLD, &(bufferinfo[atsegment].datarequests[bufferinfo[atsegment].numsent]));
+          MPI_Type_free(&wrappedtype); //only marks it for deletion, the pending send keeps it alive
+        }
+        else
+          MPI_Issend(&databuffer[startpos], bufferinfo[atsegment].sendbytes, MPI_UNSIGNED_CHAR, targetcore, CR_PROCESSDATA, MPI_COMM_WORLD, &(bufferinfo[atsegment].datarequests[bufferinfo[atsegment].numsent]));
       }
+      MPI_Issend(bufferinfo[atsegment].controlbuffer[bufferinfo[atsegment].numsent], bufferinfo[atsegment].controllength, MPI_INT, targetcore, CR_PROCESSCONTROL, MPI_COMM_WORLD, &(bufferinfo[atsegment].controlrequests[bufferinfo[atsegment].numsent]));
 
       bufferinfo[atsegment].numsent++;
       if(bufferinfo[atsegment].numsent >= maxsendspersegment) //can occur at the start when many come from segment 0
@@ -68,12 +68,16 @@ using namespace std;
 const string FxManager::CIRCULAR_POL_NAMES[4] = {"RR", "LL", "RL", "LR"};
 const string FxManager::LL_CIRCULAR_POL_NAMES[4] = {"LL", "RR", "LR", "RL"};
 const string FxManager::LINEAR_POL_NAMES[4] = {"XX", "YY", "XY", "YX"};
+const int FxManager::DEFAULT_WRITE_BUFFERS = 4;
+const int FxManager::MAX_DEFAULT_WRITE_THREADS = 4;
 
-FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, int id, MPI_Comm rcomm, bool mon, char * hname, int port, int monitor_skip)
-  : config(conf), return_comm(rcomm), numcores(ncores), mpiid(id), visibilityconfigok(true), monitor(mon), hostname(hname), monitor_skip(monitor_skip), monitorport(port)
+FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, int naggregators, int * aids, int id, MPI_Comm rcomm, bool mon, char * hname, int port, int monitor_skip)
+  : config(conf), return_comm(rcomm), numcores(ncores), numaggregators(naggregators), mpiid(id), visibilityconfigok(true), monitor(mon), hostname(hname), monitor_skip(monitor_skip), monitorport(port)
 {
   bool startskip;
-  int perr, minchans, confresultbytes, todiskbufferlen;
+  int perr, minchans, confresultbytes, todiskbufferlen, numwritebuffers, numwritethreads, maxoutputfiles, maxopenfiles;
+  bool directwrite;
+  char * writeenv;
   double headerbloatfactor;
   const string * polnames;
   pthread_attr_t attr;
@@ -140,8 +144,30 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
       todiskbufferlen = int(1.02*confresultbytes*headerbloatfactor); //a little extra margin to be sure
   }
 
-  todiskbuffer = (char*)vectorAlloc_u8(todiskbufferlen);
-  estimatedbytes += todiskbufferlen;
+  //DiFX output is written by background threads from a pool of buffers, so slow storage only stalls the
+  //write thread once every buffer is in flight.  Each output file (phase centre/pulsar bin) gets its own
+  //writer thread by default, up to a limit
+  maxoutputfiles = 1;
+  for(int i=0;i<config->getNumConfigs();i++)
+  {
+    if(config->getMaxPhaseCentres(i)*((config->pulsarBinOn(i) && !config->scrunchOutputOn(i))?config->getNumPulsarBins(i):1) > maxoutputfiles)
+      maxoutputfiles = config->getMaxPhaseCentres(i)*((config->pulsarBinOn(i) && !config->scrunchOutputOn(i))?config->getNumPulsarBins(i):1);
+  }
+  numwritebuffers = DEFAULT_WRITE_BUFFERS;
+  writeenv = getenv("DIFX_WRITE_BUFFERS");
+  if(writeenv != 0 && atoi(writeenv) > 0)
+    numwritebuffers = atoi(writeenv);
+  numwritethreads = (maxoutputfiles < MAX_DEFAULT_WRITE_THREADS)?maxoutputfiles:MAX_DEFAULT_WRITE_THREADS;
+  writeenv = getenv("DIFX_WRITE_THREADS");
+  if(writeenv != 0 && atoi(writeenv) > 0)
+    numwritethreads = atoi(writeenv);
+  writeenv = getenv("DIFX_WRITE_DIRECT");
+  directwrite = (writeenv != 0 && atoi(writeenv) != 0);
+  writeenv = getenv("DIFX_WRITE_MAX_FILES");
+  maxopenfiles = (writeenv != 0)?atoi(writeenv):0;
+  viswriter = new VisWriter(numwritebuffers, todiskbufferlen, numwritethreads, directwrite, maxopenfiles);
+  estimatedbytes += viswriter->getEstimatedBytes();
+  cinfo << startl << "Output will be written from " << numwritebuffers << " buffers of " << todiskbufferlen/1024 << " kB by " << numwritethreads << " writer threads" << (directwrite?" using direct I/O":"") << ", with up to " << viswriter->getMaxOpenFiles() << " files open" << endl;
   datastreamids = new int[numdatastreams];
   coreids = new int[numcores];
   corecounts = new int[numcores];
@@ -152,7 +178,8 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
     corecounts[i] = 0;
     recentcorecounts[i] = 0;
   }
-  coretimes = new int**[Core::RECEIVE_RING_LENGTH];
+  coreringlength = config->getCoreRingLength();
+  coretimes = new int**[coreringlength];
   numsent = new int[numcores];
   extrareceived = new int[numcores];
   for(int i=0;i<numcores;i++)
@@ -161,7 +188,13 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
     extrareceived[i] = 0;
     coreids[i] = cids[i];
   }
-  for(int i=0;i<Core::RECEIVE_RING_LENGTH;i++)
+  numaggregatorsfinished = 0;
+  aggregatorids = new int[numaggregators];
+  for(int i=0;i<numaggregators;i++)
+    aggregatorids[i] = aids[i];
+  if(numaggregators > 0)
+    cinfo << startl << "Results from " << numcores << " cores will be combined by " << numaggregators << " aggregators before accumulation" << endl;
+  for(int i=0;i<coreringlength;i++)
   {
     coretimes[i] = new int*[numcores];
     for(int j=0;j<numcores;j++)
@@ -179,7 +212,7 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
     polnames = LINEAR_POL_NAMES;
   for(int i=0;i<config->getVisBufferLength();i++)
   {
-    visbuffer[i] = new Visibility(config, i, config->getVisBufferLength(), todiskbuffer, todiskbufferlen, config->getExecuteSeconds(), initscan, initsec, initns, polnames);
+    visbuffer[i] = new Visibility(config, i, config->getVisBufferLength(), viswriter, todiskbufferlen, config->getExecuteSeconds(), initscan, initsec, initns, polnames);
     pthread_mutex_init(&(bufferlock[i]), NULL);
     islocked[i] = false;
     if(!visbuffer[i]->configuredOK()) { //problem with finding a polyco, probably
@@ -244,7 +277,7 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
 
 FxManager::~FxManager()
 {
-  for(int i=0;i<Core::RECEIVE_RING_LENGTH;i++)
+  for(int i=0;i<coreringlength;i++)
   {
     for(int j=0;j<numcores;j++)
       delete [] coretimes[i][j];
@@ -254,8 +287,9 @@ FxManager::~FxManager()
   delete [] numsent;
   delete [] datastreamids;
   delete [] coreids;
+  delete [] aggregatorids;
   delete [] extrareceived;
-  vectorFree(todiskbuffer);
+  delete viswriter;
   vectorFree(resultbuffer);
   for(int i=0;i<config->getVisBufferLength();i++)
     delete visbuffer[i];
@@ -307,6 +341,7 @@ void FxManager::execute()
 {
   int perr;
   long long sendcount = 0;
+  MPI_Status mpistatus;
 
   cinfo << startl << "Hello World, I am the FxManager" << endl;
 
@@ -324,6 +359,8 @@ void FxManager::execute()
     senddata[3] = initns; //will be zero for all scans except (maybe) the first
     senddata[2] = initsec; //ditto to initns
     senddata[1] = i;
+    integrationoriginsec = initsec;
+    integrationoriginns = initns;
 
     //do as many sends as we need to for this scan
     while(senddata[2] < model->getScanDuration(i) && (senddata[2]+model->getScanStartSec(i, startmjd, startseconds) < config->getExecuteSeconds()) && !terminatenow) {
@@ -333,7 +370,7 @@ void FxManager::execute()
         if((1000000000-senddata[3]) <= nsincrement/2)
           break;
       }
-      if(sendcount < Core::RECEIVE_RING_LENGTH*numcores) {//still in the "filling up" phase
+      if(sendcount < coreringlength*numcores) {//still in the "filling up" phase
         senddata[0] = coreids[((int)sendcount)%numcores];
         sendData(senddata, ((int)sendcount)%numcores);
       }
@@ -341,7 +378,7 @@ void FxManager::execute()
         receiveData(true);
       }
       sendcount++;
-      if(sendcount == Core::RECEIVE_RING_LENGTH*numcores) //just finished "filling up"
+      if(sendcount == coreringlength*numcores) //just finished "filling up"
         signal(SIGINT, &interrupthandler);
       if(!visibilityconfigok) { //problem with finding a polyco, probably
         cfatal << startl << "Manager aborting correlation due to visibility configuration problem!" << endl;
@@ -358,7 +395,7 @@ void FxManager::execute()
   terminate();
   
   //receive the final data from each core
-  for(int i=0;i<Core::RECEIVE_RING_LENGTH;i++)
+  for(int i=0;i<coreringlength;i++)
   {
     for(int j=0;j<numcores;j++) {
       if(sendcount==0)
@@ -367,6 +404,13 @@ void FxManager::execute()
       sendcount--;
     }
   }
+
+  //and whatever the aggregators were still holding
+  while(numaggregatorsfinished < numaggregators)
+  {
+    MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, return_comm, &mpistatus);
+    receiveAggregatedData(mpistatus.MPI_SOURCE);
+  }
   
   //ensure the thread writes out all waiting visibilities
   keepwriting = false;
@@ -390,6 +434,10 @@ void FxManager::execute()
   if(perr != 0)
     csevere << startl << "Error in closing writethread!!!" << endl;
 
+  //wait for the last visibilities to reach the disk
+  viswriter->flush();
+  cinfo << startl << "Wrote " << viswriter->getBytesWritten()/1048576 << " MB of output; the write thread waited " << viswriter->getStallTime() << " s for storage" << endl;
+
   if (monitor) {
     perr = pthread_join(monthread, NULL);
     if(perr != 0)
@@ -401,17 +449,21 @@ void FxManager::execute()
 
 void FxManager::sendData(int data[], int coreindex)
 {
+  //work out which integration of the scan this falls into (as locateVisIndex would), so that Aggregators can tell
+  //which results to combine without knowing where the integrations start
+  data[4] = (int)((static_cast<s64>(data[2] - integrationoriginsec)*1000000000LL + data[3] - integrationoriginns + nsincrement/2)/static_cast<s64>(inttime*1000000000.0));
+
   //send the command to the Core
-  MPI_Send(&data[1], 3, MPI_INT, coreids[coreindex], CR_RECEIVETIME, return_comm);
+  MPI_Send(&data[1], 4, MPI_INT, coreids[coreindex], CR_RECEIVETIME, return_comm);
 
   for(int j=0;j<numdatastreams;j++)
   {
     //send the commands to the Datastreams
     MPI_Ssend(data, 4, MPI_INT, datastreamids[j], DS_PROCESS, MPI_COMM_WORLD);
   }
-  coretimes[numsent[coreindex]%Core::RECEIVE_RING_LENGTH][coreindex][0] = data[1];
-  coretimes[numsent[coreindex]%Core::RECEIVE_RING_LENGTH][coreindex][1] = data[2];
-  coretimes[numsent[coreindex]%Core::RECEIVE_RING_LENGTH][coreindex][2] = data[3];
+  coretimes[numsent[coreindex]%coreringlength][coreindex][0] = data[1];
+  coretimes[numsent[coreindex]%coreringlength][coreindex][1] = data[2];
+  coretimes[numsent[coreindex]%coreringlength][coreindex][2] = data[3];
   numsent[coreindex]++;
   data[3] += (nsincrement%1000000000);
   data[2] += (nsincrement/1000000000);
@@ -427,32 +479,35 @@ void FxManager::receiveData(bool resend)
 {
   MPI_Status mpistatus;
   int sourcecore, sourceid=0, visindex, perr, infoindex;
-  bool viscomplete;
   double scantime;
   int i, flag, subintscan;
 
-  // Work around MPI_Recv's desire to prioritize receives by MPI rank
-  for(i = 0; i < numcores; i++)
-  {
-      lastsource++;
-      if(lastsource > numcores + numdatastreams)
-      {
-      	lastsource = numdatastreams+1;
-      }
-      MPI_Iprobe(lastsource, MPI_ANY_TAG, return_comm, &flag, &mpistatus);
-      if(flag) break;
-  }
-  if(i == numcores)
-  {
-  	// No core has sent data yet -- wait for first message to come
-  	MPI_Recv(resultbuffer, resultlength*2, MPI_FLOAT, MPI_ANY_SOURCE, MPI_ANY_TAG, return_comm, &mpistatus);
-  }
-  else
+  do
   {
-  	// Receive message from the core that is both ready and has been waiting the longest
-  	MPI_Recv(resultbuffer, resultlength*2, MPI_FLOAT, lastsource, MPI_ANY_TAG, return_comm, &mpistatus);
-  }
+    // Work around MPI_Recv's desire to prioritize receives by MPI rank
+    for(i = 0; i < numcores + numaggregators; i++)
+    {
+        lastsource++;
+        if(lastsource > numcores + numaggregators + numdatastreams)
+        {
+        	lastsource = numdatastreams+1;
+        }
+        MPI_Iprobe(lastsource, MPI_ANY_TAG, return_comm, &flag, &mpistatus);
+        if(flag) break;
+    }
+    if(i == numcores + numaggregators)
+    {
+    	// No core has sent data yet -- wait for first message to come
+    	MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, return_comm, &mpistatus);
+    }
+    // Aggregators come after the cores; their combined results are accumulated while we wait for a core
+    if(mpistatus.MPI_SOURCE > numcores + numdatastreams)
+      receiveAggregatedData(mpistatus.MPI_SOURCE);
+  } while(mpistatus.MPI_SOURCE > numcores + numdatastreams);
 
+  // Receive message from the core that is both ready and has been waiting the longest
+  // (with aggregation this is just a zero length notice that the core has finished a subintegration)
+  MPI_Recv(resultbuffer, resultlength*2, MPI_FLOAT, mpistatus.MPI_SOURCE, MPI_ANY_TAG, return_comm, &mpistatus);
 
   sourcecore = mpistatus.MPI_SOURCE;
   MPI_Get_count(&mpistatus, MPI_FLOAT, &perr);
@@ -465,8 +520,8 @@ void FxManager::receiveData(bool resend)
 
   corecounts[sourceid]++;
   recentcorecounts[sourceid]++;
-  infoindex = (numsent[sourceid]+extrareceived[sourceid])%Core::RECEIVE_RING_LENGTH;
-  if(numsent[sourceid] < Core::RECEIVE_RING_LENGTH)
+  infoindex = (numsent[sourceid]+extrareceived[sourceid])%coreringlength;
+  if(numsent[sourceid] < coreringlength)
     infoindex = extrareceived[sourceid];
   subintscan = coretimes[infoindex][sourceid][0];
   scantime = coretimes[infoindex][sourceid][1] + coretimes[infoindex][sourceid][2]/1000000000.0;
@@ -474,8 +529,8 @@ void FxManager::receiveData(bool resend)
   //put the data in the appropriate slot
   if(mpistatus.MPI_TAG == CR_VALIDVIS) // the data is valid
   {
-    //find where it belongs
-    visindex = locateVisIndex(sourceid);
+    //find where it belongs (with aggregation, the results themselves arrive later, combined, from an Aggregator)
+    visindex = (numaggregators == 0)?locateVisIndex(sourceid):-1;
 
     //immediately get some more data heading to that node
     if(resend)
@@ -488,36 +543,15 @@ void FxManager::receiveData(bool resend)
       //still need to acknowledge that we have received from this core
       extrareceived[sourceid]++;
     }
+    if (numaggregators > 0)
+      return;
     if (visindex < 0)
       cwarn << startl << "Stale data was received from core " << sourceid << " regarding scan " << subintscan << ", time " << scantime << " seconds - it will be ignored!!!" << endl;
     else
     {
       //now store the data - if we have sufficient sub-accumulations received, release this 
       //Visibility so the writing thread can write it out
-      viscomplete = visbuffer[visindex]->addData(resultbuffer);
-      if(viscomplete)
-      {
-        cinfo << startl << "Vis. " << visindex << " to write out time " << visbuffer[visindex]->getTime() << endl;
-        //better make sure we have at least locked the next section
-        if(visindex == newestlockedvis)
-        {
-          newestlockedvis = (newestlockedvis + 1)%config->getVisBufferLength();
-          perr = pthread_mutex_lock(&(bufferlock[newestlockedvis]));
-          if(perr != 0)
-            csevere << startl << "FxManager error trying to lock bufferlock[" << newestlockedvis << "]!!!" << endl;
-          islocked[newestlockedvis] = true;
-        }
-        perr = pthread_mutex_unlock(&(bufferlock[visindex]));
-        if(perr != 0)
-          csevere << startl << "FxManager error trying to unlock bufferlock[" << visindex << "]!!!" << endl;
-        islocked[visindex] = false;
-        if(oldestlockedvis == visindex)
-        {
-          while(!islocked[oldestlockedvis])
-            oldestlockedvis = (oldestlockedvis + 1)%config->getVisBufferLength();
-        }
-        printSummary(visindex);
-      }
+      accumulateResults(visindex, 1);
     }
   }
   else
@@ -533,6 +567,58 @@ void FxManager::receiveData(bool resend)
   }
 }
 
+void FxManager::receiveAggregatedData(int source)
+{
+  MPI_Status mpistatus;
+  int header[Aggregator::HEADER_LENGTH];
+  int visindex;
+
+  MPI_Recv(header, Aggregator::HEADER_LENGTH, MPI_INT, source, MPI_ANY_TAG, return_comm, &mpistatus);
+  if(mpistatus.MPI_TAG == CR_TERMINATE)
+  {
+    numaggregatorsfinished++;
+    return;
+  }
+  MPI_Recv(resultbuffer, resultlength*2, MPI_FLOAT, source, CR_VALIDVIS, return_comm, &mpistatus);
+
+  visindex = locateVisIndex(header[0], header[1], header[2], source);
+  if (visindex < 0)
+    cwarn << startl << "Stale data was received from aggregator " << source << " regarding scan " << header[0] << ", time " << header[1] + header[2]/1000000000.0 << " seconds (" << header[4] << " subintegrations) - it will be ignored!!!" << endl;
+  else
+    accumulateResults(visindex, header[4]);
+}
+
+void FxManager::accumulateResults(int visindex, int numsubints)
+{
+  int perr;
+  bool viscomplete;
+
+  viscomplete = visbuffer[visindex]->addData(resultbuffer, numsubints);
+  if(viscomplete)
+  {
+    cinfo << startl << "Vis. " << visindex << " to write out time " << visbuffer[visindex]->getTime() << endl;
+    //better make sure we have at least locked the next section
+    if(visindex == newestlockedvis)
+    {
+      newestlockedvis = (newestlockedvis + 1)%config->getVisBufferLength();
+      perr = pthread_mutex_lock(&(bufferlock[newestlockedvis]));
+      if(perr != 0)
+        csevere << startl << "FxManager error trying to lock bufferlock[" << newestlockedvis << "]!!!" << endl;
+      islocked[newestlockedvis] = true;
+    }
+    perr = pthread_mutex_unlock(&(bufferlock[visindex]));
+    if(perr != 0)
+      csevere << startl << "FxManager error trying to unlock bufferlock[" << visindex << "]!!!" << endl;
+    islocked[visindex] = false;
+    if(oldestlockedvis == visindex)
+    {
+      while(!islocked[oldestlockedvis])
+        oldestlockedvis = (oldestlockedvis + 1)%config->getVisBufferLength();
+    }
+    printSummary(visindex);
+  }
+}
+
 void FxManager::printSummary(int visindex)
 {
   int minsubints, maxsubints, minsubintindex, maxsubintindex, numvis;
@@ -704,21 +790,25 @@ void FxManager::loopwrite()
 }
 
 int FxManager::locateVisIndex(int coreid)
+{
+  int infoindex;
+
+  infoindex = (numsent[coreid]+extrareceived[coreid]) % coreringlength;
+  if(numsent[coreid] < coreringlength)
+    infoindex = extrareceived[coreid];
+
+  return locateVisIndex(coretimes[infoindex][coreid][0], coretimes[infoindex][coreid][1], coretimes[infoindex][coreid][2], coreids[coreid]);
+}
+
+int FxManager::locateVisIndex(int corescan, int coresec, int corens, int source)
 {
   bool tooold = true;
-  int perr, count, infoindex, vblength;
-  int corescan, coresec, corens;
+  int perr, count, vblength;
   s64 difference; // difference in nanosec
   Visibility * vis;
 
   vblength = config->getVisBufferLength();
-  infoindex = (numsent[coreid]+extrareceived[coreid]) % Core::RECEIVE_RING_LENGTH;
-  if(numsent[coreid] < Core::RECEIVE_RING_LENGTH)
-    infoindex = extrareceived[coreid];
-
-  corescan = coretimes[infoindex][coreid][0];
-  coresec = coretimes[infoindex][coreid][1];
-  corens = coretimes[infoindex][coreid][2] + config->getSubintNS(config->getScanConfigIndex(corescan))/2;
+  corens += config->getSubintNS(config->getScanConfigIndex(corescan))/2;
 
   if((newestlockedvis-oldestlockedvis+vblength)%vblength >= vblength-3) 
   { 
@@ -777,7 +867,7 @@ int FxManager::locateVisIndex(int coreid)
         return newestlockedvis;
     }
     //d'oh - its newer than we can handle - have to drop old data until we catch up
-    cwarn << startl << "Data was received which is too recent (scan " << corescan << ", " << coresec << " sec + " << corens << "ns).  Will force existing data to be dropped until we have caught up coreid="<< coreid << endl;
+    cwarn << startl << "Data was received which is too recent (scan " << corescan << ", " << coresec << " sec + " << corens << "ns).  Will force existing data to be dropped until we have caught up source="<< source << endl;
 
     while(difference > inttime)
     {
@@ -53,6 +53,8 @@ public:
   * @param ncores The number of Cores (processing nodes) to be used in this correlation
   * @param dids Array containing the MPI ids of each Datastream
   * @param cids Array containing the MPI ids of each Core
+  * @param naggregators The number of Aggregators combining Core results before they are sent here (0 for none)
+  * @param aids Array containing the MPI ids of each Aggregator
   * @param id The FXManager's MPI id
   * @param rcomm An MPI_Comm object used for communicating to the Cores only
   * @param mon Whether data is sent to a remote monitor using a socket
@@ -63,7 +65,7 @@ public:
 
   enum monsockStatusType {CLOSED, PENDING, OPENED};
 
-  FxManager(Configuration * conf, int ncores, int * dids, int * cids, int id, MPI_Comm rcomm, bool mon, char * hname, int port, int monitor_skip);
+  FxManager(Configuration * conf, int ncores, int * dids, int * cids, int naggregators, int * aids, int id, MPI_Comm rcomm, bool mon, char * hname, int port, int monitor_skip);
   ~FxManager();
 
  /**
@@ -99,6 +101,8 @@ private:
   static const string CIRCULAR_POL_NAMES[4];
   static const string LL_CIRCULAR_POL_NAMES[4];
   static const string LINEAR_POL_NAMES[4];
+  static const int DEFAULT_WRITE_BUFFERS;
+  static const int MAX_DEFAULT_WRITE_THREADS;
 
   //methods
  /** 
@@ -109,11 +113,26 @@ private:
   void sendData(int data[], int coreindex);
 
  /** 
-  * Receives one short-term accumulated result from a Core, and optionally arranges for some more data to be sent to this Core
+  * Receives one short-term accumulated result from a Core, and optionally arranges for some more data to be sent to this Core.
+  * With aggregation the Core only sends a notice, and any combined results which arrive from Aggregators in the meantime
+  * are accumulated along the way
   * @param resend Whether to call sendData to get more data sent immediately to this Core
   */
   void receiveData(bool resend);
 
+ /** 
+  * Receives one combined result (or the termination notice) from an Aggregator, and accumulates it
+  * @param source The MPI id of the Aggregator
+  */
+  void receiveAggregatedData(int source);
+
+ /** 
+  * Adds the result in resultbuffer to a Visibility, and releases the Visibility for writing if it is now complete
+  * @param visindex The index of the Visibility in the buffer
+  * @param numsubints The number of subintegrations summed in the result
+  */
+  void accumulateResults(int visindex, int numsubints);
+
  /** 
   * Locates the Visibility that the most recent data to have arrived should go to
   * @param coreid The core from which the most recent data was received
@@ -121,6 +140,16 @@ private:
   */
   int locateVisIndex(int coreid);
 
+ /** 
+  * Locates the Visibility that data from a given subintegration should go to
+  * @param corescan The scan of the subintegration
+  * @param coresec The start of the subintegration, in seconds from the start of the scan
+  * @param corens The nanoseconds past coresec of the start of the subintegration
+  * @param source The MPI id the data was received from
+  * @return The index of the correct Visibility in the buffer, or -1 if the data is stale and cannot be stored
+  */
+  int locateVisIndex(int corescan, int coresec, int corens, int source);
+
  /** 
   * Open the files
   */
@@ -148,23 +177,26 @@ private:
   //variables
   Configuration * config;
   MPI_Comm return_comm;
-  int numcores, mpiid, numdatastreams, startmjd, startseconds, initns, initsec, initscan, resultlength, nsincrement, currentconfigindex, newestlockedvis, oldestlockedvis, writesegment;
+  int numcores, numaggregators, numaggregatorsfinished, mpiid, numdatastreams, startmjd, startseconds, initns, initsec, initscan, resultlength, nsincrement, currentconfigindex, newestlockedvis, oldestlockedvis, writesegment;
   long long estimatedbytes;
   double inttime;
   bool keepwriting, circularpols, writethreadinitialised, visibilityconfigok;
-  int senddata[4];
+  int senddata[5]; //core id, scan, seconds, ns, integration within the scan
+  int integrationoriginsec, integrationoriginns; //the start of the first integration of the current scan
   Model * model;
   int * datastreamids;
   int * coreids;
+  int * aggregatorids;
   int * corecounts;
   int * recentcorecounts;
   int * numsent;
   int * extrareceived;
+  int coreringlength; //number of subintegrations buffered by each Core, and hence outstanding per Core
   int *** coretimes;
   bool monitor;
   char * hostname;
   cf32 * resultbuffer;
-  char * todiskbuffer;
+  VisWriter * viswriter;
   Visibility ** visbuffer;
   pthread_mutex_t * bufferlock, startlock;
   bool * islocked;
@@ -36,6 +36,7 @@ Mk5Mode::Mk5Mode(Configuration * conf, int confindex, int dsindex, int recordedb
 
   fanout = config->genMk5FormatName(format, nrecordedbands, recordedbw, nbits, sampling, framebytes, conf->getDDecimationFactor(confindex, dsindex), config->getDAlignmentSeconds(confindex, dsindex), conf->getDNumMuxThreads(confindex, dsindex), formatname);
   invalid = 0;
+  unpacker = 0;
 
   if(fanout < 0)
     initok = false;
@@ -51,6 +52,8 @@ Mk5Mode::Mk5Mode(Configuration * conf, int confindex, int dsindex, int recordedb
       unpacksamples = recordedbandchan*2;
       samplestounpack = recordedbandchan*2;
     }
+    unpacksamples += 2*filterbankleadsamples;
+    samplestounpack += 2*filterbankleadsamples;
     //create the mark5_stream used for unpacking
     mark5stream = new_mark5_stream( new_mark5_stream_unpacker(0), new_mark5_format_generic_from_string(formatname) );
     if(mark5stream == 0)
@@ -75,6 +78,16 @@ Mk5Mode::Mk5Mode(Configuration * conf, int confindex, int dsindex, int recordedb
       {
         this->framesamples = mark5stream->framesamples;
       }
+      //the common VDIF and Mark5B layouts are unpacked natively, sample exact so without granularity padding
+      if(Mk5Unpacker::isSupported(format, nrecordedbands, nbits, sampling) && conf->getDDecimationFactor(confindex, dsindex) == 1)
+      {
+        unpacker = new Mk5Unpacker(format, nrecordedbands, nbits, mark5stream->framebytes, mark5stream->databytes, unpacksamples);
+        samplestounpack = unpacksamples;
+        //and with pre-F fringe rotation they are decoded straight into the rotated FFT input, rather than through
+        //unpackedarrays; phase cal extraction and the filterbank still need the unpacked arrays
+        if(!filterbank && fringerotationorder > 0 && conf->getDPhaseCalIntervalMHz(confindex, dsindex) == 0)
+          fuseddecode = true;
+      }
       if(format == Configuration::INTERLACEDVDIF)
       {
         invalid = new int[nrecordedbands];
@@ -99,6 +112,18 @@ Mk5Mode::~Mk5Mode()
   {
     delete [] invalid;
   }
+  if(unpacker)
+    delete unpacker;
+}
+
+vecStatus Mk5Mode::unpackRotated(int band, int sampleoffset, const cf32 * rotator, cf32 * dest)
+{
+  if(!fuseddecode)
+    return Mode::unpackRotated(band, sampleoffset, rotator, dest);
+
+  unpacker->unpackRotated(data, band, unpackstartsamples + sampleoffset, rotator, dest, fftchannels);
+
+  return vecNoErr;
 }
 
 float Mk5Mode::unpack(int sampleoffset, int subloopindex)
@@ -106,6 +131,18 @@ float Mk5Mode::unpack(int sampleoffset, int subloopindex)
   float goodsamples;
   int mungedoffset = 0;
 
+  if(unpacker)
+  {
+    unpackstartsamples = sampleoffset;
+    //for the fused decode the samples themselves are decoded band by band in unpackRotated; here just check which frames are good
+    if(fuseddecode)
+      goodsamples = unpacker->checkFrames(data, unpackstartsamples, unpacksamples);
+    else
+      goodsamples = unpacker->unpack(data, unpackstartsamples, unpackedarrays, unpacksamples);
+
+    return goodsamples/(float)unpacksamples;
+  }
+
   //work out where to start from
   unpackstartsamples = sampleoffset - (sampleoffset % mark5stream->samplegranularity);
 
@@ -29,6 +29,7 @@
 
 #include <mark5access.h>
 #include "mode.h"
+#include "mk5unpacker.h"
 
 /** 
  @class Mk5Mode 
@@ -74,16 +75,29 @@ class Mk5Mode : public Mode
 
   protected:
  /** 
-   * Uses mark5access library to unpack multiplexed, quantised data into the separate float arrays
+   * Unpacks multiplexed, quantised data into the separate float arrays, natively for the common VDIF
+   * and Mark5B layouts and with the mark5access library otherwise
    * @return The fraction of samples returned
    * @param sampleoffset The offset in number of time samples into the data array
    * @param subloopindex The "subloop" index that is currently being unpacked for (need to know to save weights in the right place)
   */
     virtual float unpack(int sampleoffset, int subloopindex);
 
+ /** 
+   * Decodes the band straight from the packed data into rotated complex samples when fuseddecode is set,
+   * otherwise falls back to Mode::unpackRotated
+   * @param band The index of the recorded band
+   * @param sampleoffset The offset in number of time samples from unpackstartsamples
+   * @param rotator The fringe rotation phasors, fftchannels long
+   * @param dest The array to fill with fftchannels rotated complex samples
+   * @return vecNoErr on success
+  */
+    virtual vecStatus unpackRotated(int band, int sampleoffset, const cf32 * rotator, cf32 * dest);
+
     int framesamples, framebytes, samplestounpack, fanout;
     struct mark5_stream *mark5stream;
     int *invalid; // stores per-band invalid data counts after each unpack (VDIF and CODIF only)
+    Mk5Unpacker * unpacker; // native unpacker for the common VDIF and Mark5B layouts, else NULL
 };
 
 #endif
@@ -0,0 +1,281 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#include <cstring>
+#include "mk5unpacker.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UNPACK_X86
+#include <immintrin.h>
+#define UNPACK_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+//level of the high magnitude 2 bit states, as used by mark5access (OPTIMAL_2BIT_HIGH)
+const f32 Mk5Unpacker::HIGH_MAG_2BIT = 3.316505;
+
+static const u32 MARK5B_SYNC_WORD = 0xABADDEED;
+static const u32 VDIF_INVALID_BIT = 0x80000000;
+
+#ifdef UNPACK_X86
+//Decodes as many groups of 8 samples of one channel as can be read without running off the end of the
+//payload; the levels are picked out of registers with a permute rather than looked up in memory.  When
+//8 samples span few enough bits they are all shifted out of one broadcast word, otherwise each lane
+//gathers its own word.  Returns the number of samples decoded
+UNPACK_AVX2 static int avx2DecodeRun(const u8 * payload, int bit, int bitstep, int nbits, int databytes, const f32 * levels, const cf32 * rotator, void * dest, int nsamples)
+{
+  const __m256i laneoffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(bitstep));
+  const __m256i seven = _mm256_set1_epi32(7);
+  const __m256i mask = _mm256_set1_epi32((1 << nbits) - 1);
+  const __m256i eightbitbias = _mm256_set1_epi32(255);
+  const __m256 eightbitscale = _mm256_set1_ps(1.0/256.0);
+  const __m256 levelslo = _mm256_loadu_ps(levels);
+  const __m256 levelshi = _mm256_loadu_ps(levels + 8);
+  const bool broadcast = (7 + 8*bitstep <= 32);
+  __m256i words, shifts, bits, codes;
+  __m256 v, lo, hi;
+  u32 word;
+  int i;
+
+  for(i=0;i<=nsamples-8;i+=8)
+  {
+    if(((bit + 7*bitstep) >> 3) + 4 > databytes)
+      break;
+    if(broadcast)
+    {
+      memcpy(&word, payload + (bit >> 3), 4);
+      words = _mm256_set1_epi32(word);
+      shifts = _mm256_add_epi32(_mm256_set1_epi32(bit & 7), laneoffsets);
+    }
+    else
+    {
+      bits = _mm256_add_epi32(_mm256_set1_epi32(bit), laneoffsets);
+      words = _mm256_i32gather_epi32((const int *)payload, _mm256_srli_epi32(bits, 3), 1);
+      shifts = _mm256_and_si256(bits, seven);
+    }
+    codes = _mm256_and_si256(_mm256_srlv_epi32(words, shifts), mask);
+    if(nbits == 8) //(2*code - 255)/256, exact in single precision
+      v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_slli_epi32(codes, 1), eightbitbias)), eightbitscale);
+    else if(nbits == 4) //16 levels: pick from the low or high 8 on bit 3 of the code
+      v = _mm256_blendv_ps(_mm256_permutevar8x32_ps(levelslo, codes), _mm256_permutevar8x32_ps(levelshi, codes), _mm256_castsi256_ps(_mm256_slli_epi32(codes, 28)));
+    else
+      v = _mm256_permutevar8x32_ps(levelslo, codes);
+    if(rotator)
+    {
+      lo = _mm256_unpacklo_ps(v, v);
+      hi = _mm256_unpackhi_ps(v, v);
+      _mm256_storeu_ps((f32*)((cf32*)dest + i), _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), _mm256_loadu_ps((const f32*)(rotator + i))));
+      _mm256_storeu_ps((f32*)((cf32*)dest + i + 4), _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), _mm256_loadu_ps((const f32*)(rotator + i + 4))));
+    }
+    else
+      _mm256_storeu_ps((f32*)dest + i, v);
+    bit += 8*bitstep;
+  }
+
+  return i;
+}
+#endif
+
+Mk5Unpacker::Mk5Unpacker(Configuration::dataformat format, int nchan, int nbits, int framebytes, int databytes, int maxsamples)
+  : numchannels(nchan), numbits(nbits), framebytes(framebytes), databytes(databytes)
+{
+  int mask = (1 << nbits) - 1;
+
+  ismark5b = (format == Configuration::MARK5B);
+  payloadoffset = framebytes - databytes;
+  framesamples = databytes*8/(nchan*nbits);
+  firstframe = 0;
+  maxframes = maxsamples/framesamples + 2;
+  framevalid = new bool[maxframes];
+
+  //the levels mark5access decodes to: VDIF is offset binary, Mark5B 2 bit has the sign in the lower bit
+  levels = vectorAlloc_f32(256);
+  for(int l=0;l<256;l++)
+  {
+    switch(nbits) {
+      case 1:
+        levels[l] = (l & 1)?1.0:-1.0;
+        break;
+      case 2:
+        if(ismark5b)
+        {
+          const f32 mark5blevels[4] = {-HIGH_MAG_2BIT, 1.0, -1.0, HIGH_MAG_2BIT};
+          levels[l] = mark5blevels[l & 3];
+        }
+        else
+        {
+          const f32 vdiflevels[4] = {-HIGH_MAG_2BIT, -1.0, 1.0, HIGH_MAG_2BIT};
+          levels[l] = vdiflevels[l & 3];
+        }
+        break;
+      case 4:
+        levels[l] = ((l & 15) - 8)/2.95;
+        break;
+      default:
+        levels[l] = (l*2 - 255)/256.0;
+        break;
+    }
+  }
+
+  //indexed by packed byte*8 + bit offset of the sample within the byte
+  decodelut = vectorAlloc_f32(256*8);
+  for(int b=0;b<256;b++)
+  {
+    for(int shift=0;shift<8;shift++)
+      decodelut[b*8 + shift] = levels[(b >> shift) & mask];
+  }
+}
+
+Mk5Unpacker::~Mk5Unpacker()
+{
+  delete [] framevalid;
+  vectorFree(levels);
+  vectorFree(decodelut);
+}
+
+bool Mk5Unpacker::isSupported(Configuration::dataformat format, int nchan, int nbits, Configuration::datasampling sampling)
+{
+  if(sampling != Configuration::REAL || nchan < 1 || nchan > 16 || (nchan & (nchan - 1)))
+    return false;
+  if(format == Configuration::VDIF)
+    return (nbits == 1 || nbits == 2 || nbits == 4 || nbits == 8);
+  if(format == Configuration::MARK5B)
+    return (nbits == 1 || nbits == 2) && nchan*nbits <= 32;
+  return false;
+}
+
+int Mk5Unpacker::checkFrames(const u8 * data, int startsample, int nsamples)
+{
+  int lastframe, framestart, overlap, goodsamples;
+  const u32 * header;
+
+  goodsamples = 0;
+  firstframe = startsample/framesamples;
+  lastframe = (startsample + nsamples - 1)/framesamples;
+  for(int f=firstframe;f<=lastframe;f++)
+  {
+    header = (const u32 *)(data + (long long)f*framebytes);
+    if(ismark5b)
+      framevalid[f - firstframe] = (header[0] == MARK5B_SYNC_WORD);
+    else
+      framevalid[f - firstframe] = ((header[0] & VDIF_INVALID_BIT) == 0) && (header[0] != MARK5_FILL_PATTERN || header[1] != MARK5_FILL_PATTERN);
+    if(framevalid[f - firstframe])
+    {
+      framestart = f*framesamples;
+      overlap = framesamples;
+      if(framestart < startsample)
+        overlap -= startsample - framestart;
+      if(framestart + framesamples > startsample + nsamples)
+        overlap -= framestart + framesamples - (startsample + nsamples);
+      goodsamples += overlap;
+    }
+  }
+
+  return goodsamples;
+}
+
+int Mk5Unpacker::unpack(const u8 * data, int startsample, f32 ** unpacked, int nsamples)
+{
+  int goodsamples, frame, framesample, run;
+
+  goodsamples = checkFrames(data, startsample, nsamples);
+  for(int c=0;c<numchannels;c++)
+  {
+    frame = firstframe;
+    framesample = startsample - frame*framesamples;
+    for(int done=0;done<nsamples;done+=run)
+    {
+      run = framesamples - framesample;
+      if(run > nsamples - done)
+        run = nsamples - done;
+      if(framevalid[frame - firstframe])
+        decodeRun(data + (long long)frame*framebytes + payloadoffset, c, framesample, 0, unpacked[c] + done, run);
+      else
+        memset(unpacked[c] + done, 0, run*sizeof(f32));
+      frame++;
+      framesample = 0;
+    }
+  }
+
+  return goodsamples;
+}
+
+void Mk5Unpacker::unpackRotated(const u8 * data, int channel, int startsample, const cf32 * rotator, cf32 * dest, int nsamples) const
+{
+  int frame, framesample, run;
+
+  frame = startsample/framesamples;
+  framesample = startsample - frame*framesamples;
+  for(int done=0;done<nsamples;done+=run)
+  {
+    run = framesamples - framesample;
+    if(run > nsamples - done)
+      run = nsamples - done;
+    if(framevalid[frame - firstframe])
+      decodeRun(data + (long long)frame*framebytes + payloadoffset, channel, framesample, rotator + done, dest + done, run);
+    else
+      memset(dest + done, 0, run*sizeof(cf32));
+    frame++;
+    framesample = 0;
+  }
+}
+
+void Mk5Unpacker::decodeRun(const u8 * payload, int channel, int framesample, const cf32 * rotator, void * dest, int nsamples) const
+{
+  int bit, bitstep, i;
+  f32 level;
+
+  bitstep = numchannels*numbits;
+  bit = (framesample*numchannels + channel)*numbits;
+  i = 0;
+#ifdef UNPACK_X86
+  if(simdKernels.level >= SIMD_LEVEL_AVX2)
+  {
+    i = avx2DecodeRun(payload, bit, bitstep, numbits, databytes, levels, rotator, dest, nsamples);
+    bit += i*bitstep;
+  }
+#endif
+  if(rotator)
+  {
+    cf32 * out = (cf32 *)dest;
+    for(;i<nsamples;i++)
+    {
+      level = decodelut[payload[bit >> 3]*8 + (bit & 7)];
+      out[i].re = level*rotator[i].re;
+      out[i].im = level*rotator[i].im;
+      bit += bitstep;
+    }
+  }
+  else
+  {
+    f32 * out = (f32 *)dest;
+    for(;i<nsamples;i++)
+    {
+      out[i] = decodelut[payload[bit >> 3]*8 + (bit & 7)];
+      bit += bitstep;
+    }
+  }
+}
+// vim: shiftwidth=2:softtabstop=2:expandtab
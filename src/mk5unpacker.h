@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef MK5UNPACKER_H
+#define MK5UNPACKER_H
+
+#include "architecture.h"
+#include "configuration.h"
+
+/**
+ @class Mk5Unpacker
+ @brief Native unpacker for the common single thread VDIF and Mark5B layouts
+
+ Decodes real sampled single thread VDIF (1, 2, 4 or 8 bits, 1 to 16 channels) and Mark5B (1 or 2 bits)
+ data without going through mark5access, to the same levels that mark5access produces.  Decoding is
+ sample exact, so unlike mark5access there is no sample granularity to work around.  Frames are checked
+ from their headers (VDIF invalid flag or fill pattern, Mark5B sync word) and samples in bad frames are
+ set to zero, giving the same good sample count as mark5access.  With AVX2 the levels are looked up
+ eight at a time with an in-register permute.
+ @author The DiFX developers
+ */
+class Mk5Unpacker
+{
+  public:
+ /**
+   * Constructor: sets up the level tables for the given layout
+   * @param format The data format type (VDIF or MARK5B)
+   * @param nchan The number of channels interleaved in the data
+   * @param nbits The number of bits per sample
+   * @param framebytes The number of bytes in a frame, including the header
+   * @param databytes The number of payload bytes in a frame
+   * @param maxsamples The largest number of samples (per channel) that will be unpacked at once
+  */
+  Mk5Unpacker(Configuration::dataformat format, int nchan, int nbits, int framebytes, int databytes, int maxsamples);
+
+  ~Mk5Unpacker();
+
+ /**
+   * Whether a layout can be handled by this unpacker
+   * @param format The data format type
+   * @param nchan The number of channels interleaved in the data
+   * @param nbits The number of bits per sample
+   * @param sampling The sampling type (only REAL is handled)
+   * @return True if the layout is supported
+  */
+  static bool isSupported(Configuration::dataformat format, int nchan, int nbits, Configuration::datasampling sampling);
+
+ /**
+   * Checks the headers of the frames covering a range of samples, for use by unpack and unpackRotated
+   * @param data The packed data, starting at the start of a frame
+   * @param startsample The first sample of the range
+   * @param nsamples The number of samples in the range (at most maxsamples)
+   * @return The number of samples in the range that lie in good frames
+  */
+  int checkFrames(const u8 * data, int startsample, int nsamples);
+
+ /**
+   * Unpacks all channels to float arrays, zeroing samples from bad frames
+   * @param data The packed data, starting at the start of a frame
+   * @param startsample The first sample to unpack
+   * @param unpacked The nchan arrays to unpack into
+   * @param nsamples The number of samples to unpack (at most maxsamples)
+   * @return The number of good samples unpacked, as for mark5_unpack_with_offset
+  */
+  int unpack(const u8 * data, int startsample, f32 ** unpacked, int nsamples);
+
+ /**
+   * Decodes one channel and multiplies it by a fringe rotator in the same pass, giving complex samples ready for
+   * the FFT.  The samples must lie within the range given to the last checkFrames call
+   * @param data The packed data, starting at the start of a frame
+   * @param channel The channel to decode
+   * @param startsample The first sample to decode
+   * @param rotator The fringe rotation phasors, nsamples long
+   * @param dest The array to fill with nsamples rotated complex samples
+   * @param nsamples The number of samples to decode
+  */
+  void unpackRotated(const u8 * data, int channel, int startsample, const cf32 * rotator, cf32 * dest, int nsamples) const;
+
+  inline int getFrameSamples() const { return framesamples; }
+
+  ///The high level for 2 bit samples, as used by mark5access
+  static const f32 HIGH_MAG_2BIT;
+
+  private:
+ /**
+   * Decodes a run of samples of one channel from within one frame, optionally multiplying by a rotator
+   * @param payload The payload of the frame
+   * @param channel The channel to decode
+   * @param framesample The index within the frame of the first sample
+   * @param rotator The fringe rotation phasors (NULL to produce real output)
+   * @param dest The real output if rotator is NULL, otherwise the complex output
+   * @param nsamples The number of samples to decode
+  */
+  void decodeRun(const u8 * payload, int channel, int framesample, const cf32 * rotator, void * dest, int nsamples) const;
+
+  bool ismark5b;
+  int numchannels, numbits, framebytes, payloadoffset, databytes, framesamples, firstframe, maxframes;
+  bool * framevalid;
+  f32 * levels;
+  f32 * decodelut;
+};
+
+#endif
+// vim: shiftwidth=2:softtabstop=2:expandtab
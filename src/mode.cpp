@@ -27,6 +27,8 @@
 
 #include <mpi.h>
 #include <iomanip>
+#include <float.h>
+#include <algorithm>
 #include "mode.h"
 #include "math.h"
 #include "architecture.h"
@@ -35,9 +37,16 @@
 
 //using namespace std;
 const float Mode::TINY = 0.000000001;
+const int Mode::FILTERBANK_TAPS = 4;
+const double Mode::ROTATOR_MAX_PHASE_ERROR = 1.0e-7;
+const int Mode::RFI_MIN_SK_FFTS = 8;
+const int Mode::RFI_MIN_POWER_FFTS = 3;
+const f32 Mode::PACKED_INT8_LEVELS_PER_SIGMA = 24.0;
+const int Mode::ROTATOR_RENORM_INTERVAL = 64;
 
 #if (ARCH == GENERIC)
 pthread_mutex_t FFTinitMutex = PTHREAD_MUTEX_INITIALIZER;
+GenFFTPlanEntry * FFTplancache = 0;
 #endif
 
 Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int chanstoavg, int bpersend, int gsamples, int nrecordedfreqs, double recordedbw, double * recordedfreqclkoffs, double * recordedfreqclkoffsdelta, double * recordedfreqphaseoffs, double * recordedfreqlooffs, int nrecordedbands, int nzoombands, int nbits, Configuration::datasampling sampling, Configuration::complextype tcomplex, int unpacksamp, bool fbank, bool linear2circular, int fringerotorder, int arraystridelen, bool cacorrs, double bclock)
@@ -69,6 +78,9 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
     isfft = false;
   }
 
+  //derived modes which can decode packed samples straight into unpackRotated() turn this on
+  fuseddecode = false;
+
 
   dataweight = vectorAlloc_f32(config->getNumBufferedFFTs(confindex));
   for(int i=0;i<config->getNumBufferedFFTs(confindex);++i)
@@ -76,11 +88,50 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
     dataweight[i] = 0.0;
   }
   perbandweights = 0;
+
+  //online RFI excision works on the window of buffered FFTs, after they are all processed
+  rfiskthreshold = config->getRFISKThreshold();
+  rfifftthreshold = config->getRFIFFTThreshold();
+  rfiexcision = (rfiskthreshold > 0.0 || rfifftthreshold > 0.0);
+  rfiweights = 0;
+  rfiwindowweights = 0;
+  rfis1 = 0;
+  rfis2 = 0;
+  rfisk = 0;
+  rfipower = 0;
+  if(rfiexcision)
+  {
+    rfiweights = new f32*[config->getNumBufferedFFTs(confindex)];
+    for(int i=0;i<config->getNumBufferedFFTs(confindex);++i)
+    {
+      rfiweights[i] = new f32[nrecordedbands];
+      for(int b = 0; b < nrecordedbands; ++b)
+        rfiweights[i][b] = 1.0;
+    }
+    rfiwindowweights = vectorAlloc_f32(config->getNumBufferedFFTs(confindex));
+    rfis1 = vectorAlloc_f32(recordedbandchannels);
+    rfis2 = vectorAlloc_f32(recordedbandchannels);
+    rfisk = vectorAlloc_f32(recordedbandchannels);
+    rfipower = vectorAlloc_f32(2*config->getNumBufferedFFTs(confindex));
+    estimatedbytes += sizeof(f32)*(config->getNumBufferedFFTs(confindex)*(nrecordedbands + 3) + 3*recordedbandchannels);
+  }
   model = config->getModel();
   initok = true;
   intclockseconds = int(floor(config->getDClockCoeff(configindex, dsindex, 0)/1000000.0 + 0.5));
   if (usecomplex) fftchannels /=2;
 
+  filterbankwindow = 0;
+  filterbankfolded = 0;
+  filterbanktaps = 1;
+  filterbankleadsamples = 0;
+  if(filterbank)
+  {
+    //the filterbank window is centred on each FFT, so it needs this many extra samples either side
+    filterbanktaps = FILTERBANK_TAPS;
+    filterbankleadsamples = (filterbanktaps-1)*fftchannels/2;
+    unpacksamples += 2*filterbankleadsamples*(usecomplex?2:1); //unpacksamp is in floats for complex data
+  }
+
   numfracstrides = numfrstrides = fftchannels/arraystridelength;
   if (usecomplex) numfracstrides *= 2;
   sampletime = 1.0/(2.0*recordedbandwidth); //microseconds
@@ -166,13 +217,41 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
 
     interpolator = new f64[3];
 
+    //the reduced precision copies of the spectra, if the config cross-multiplies those
+    packedprecision = config->getSpectraPrecision(confindex);
+    packedbytes = (packedprecision == Configuration::FLOAT16SPECTRA)?sizeof(cf16):sizeof(cs8);
+    packedoutputs = 0;
+    packedscales = 0;
+    packedinvscales = 0;
+    packedpower = 0;
+    packedweights = 0;
+    if(packedprecision != Configuration::FLOAT32SPECTRA)
+    {
+      packedoutputs = new u8**[numrecordedbands + numzoombands];
+      packedscales = new f32*[numrecordedbands + numzoombands];
+      packedinvscales = vectorAlloc_f32(recordedbandchannels);
+      packedpower = vectorAlloc_cf32(recordedbandchannels);
+      packedweights = vectorAlloc_f32(config->getNumBufferedFFTs(confindex));
+      estimatedbytes += (sizeof(f32) + sizeof(cf32))*recordedbandchannels + sizeof(f32)*config->getNumBufferedFFTs(confindex);
+    }
+
+    //the single precision spectra are needed even when reduced precision copies are cross-multiplied: the RFI
+    //excision, autocorrelations and pack scales all work on them.  Both are counted in estimatedbytes
     fftoutputs = new cf32**[numrecordedbands + numzoombands];
-    conjfftoutputs = new cf32**[numrecordedbands + numzoombands];
-    estimatedbytes += 4*(numrecordedbands + numzoombands);
+    estimatedbytes += 2*(numrecordedbands + numzoombands);
     for(int j=0;j<numrecordedbands+numzoombands;j++)
     {
       fftoutputs[j] = new cf32*[config->getNumBufferedFFTs(confindex)];
-      conjfftoutputs[j] = new cf32*[config->getNumBufferedFFTs(confindex)];
+      if(packedoutputs)
+      {
+        packedoutputs[j] = new u8*[config->getNumBufferedFFTs(confindex)];
+        packedscales[j] = 0;
+        if(j<numrecordedbands)
+        {
+          packedscales[j] = vectorAlloc_f32(recordedbandchannels);
+          estimatedbytes += sizeof(f32)*recordedbandchannels;
+        }
+      }
       for(int k=0;k<config->getNumBufferedFFTs(confindex);k++)
       {
         if(j<numrecordedbands)
@@ -180,25 +259,31 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
 	  if(fringerotationorder == 0) // post-F
 	  {
 	    fftoutputs[j][k] = vectorAlloc_cf32(recordedbandchannels+1);
-            conjfftoutputs[j][k] = vectorAlloc_cf32(recordedbandchannels+1);
 	  }
 	  else
 	  {
             fftoutputs[j][k] = vectorAlloc_cf32(recordedbandchannels);
-            conjfftoutputs[j][k] = vectorAlloc_cf32(recordedbandchannels);
 	  }
-          estimatedbytes += 2*sizeof(cf32)*recordedbandchannels;
+          estimatedbytes += sizeof(cf32)*recordedbandchannels;
+          if(packedoutputs)
+          {
+            packedoutputs[j][k] = vectorAlloc_u8(packedbytes*recordedbandchannels);
+            estimatedbytes += packedbytes*recordedbandchannels;
+          }
         }
         else
         {
           localfreqindex = config->getDLocalZoomFreqIndex(confindex, dsindex, j-numrecordedbands);
           parentfreqindex = config->getDZoomFreqParentFreqIndex(confindex, dsindex, localfreqindex);
           fftoutputs[j][k] = 0;
-          conjfftoutputs[j][k] = 0;
           for(int l=0;l<numrecordedbands;l++) {
             if(config->getDLocalRecordedFreqIndex(confindex, dsindex, l) == parentfreqindex && config->getDRecordedBandPol(confindex, dsindex, l) == config->getDZoomBandPol(confindex, dsindex, j-numrecordedbands)) {
               fftoutputs[j][k] = &(fftoutputs[l][k][config->getDZoomFreqChannelOffset(confindex, dsindex, localfreqindex)]);
-	      conjfftoutputs[j][k] = &(conjfftoutputs[l][k][config->getDZoomFreqChannelOffset(confindex, dsindex, localfreqindex)]);
+              if(packedoutputs)
+              {
+                packedoutputs[j][k] = packedoutputs[l][k] + packedbytes*config->getDZoomFreqChannelOffset(confindex, dsindex, localfreqindex);
+                packedscales[j] = packedscales[l] + config->getDZoomFreqChannelOffset(confindex, dsindex, localfreqindex);
+              }
             }
           }
           if(fftoutputs[j][k] == 0)
@@ -223,57 +308,15 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
         piecewiserotator = vectorAlloc_cf32(arraystridelength);
         quadpiecerotator = vectorAlloc_cf32(arraystridelength);
         estimatedbytes += 2*8*arraystridelength;
-
-        subquadxval  = vectorAlloc_f64(arraystridelength);
-        subquadphase = vectorAlloc_f64(arraystridelength);
-        subquadarg   = vectorAlloc_f32(arraystridelength);
-        subquadsin   = vectorAlloc_f32(arraystridelength);
-        subquadcos   = vectorAlloc_f32(arraystridelength);
-        estimatedbytes += (8+8+4+4+4)*arraystridelength;
-
-        stepxoffsquared = vectorAlloc_f64(numfrstrides);
-        tempstepxval = vectorAlloc_f64(numfrstrides);
-        estimatedbytes += 16*numfrstrides;
       case 1:
-        subtoff  = vectorAlloc_f64(arraystridelength);
-        subtval  = vectorAlloc_f64(arraystridelength);
-        subxoff  = vectorAlloc_f64(arraystridelength);
-        subxval  = vectorAlloc_f64(arraystridelength);
-        subphase = vectorAlloc_f64(arraystridelength);
-        subarg   = vectorAlloc_f32(arraystridelength);
-        subsin   = vectorAlloc_f32(arraystridelength);
-        subcos   = vectorAlloc_f32(arraystridelength);
-        estimatedbytes += (3*8+3*4)*arraystridelength;
-
-        steptoff  = vectorAlloc_f64(numfrstrides);
-        steptval  = vectorAlloc_f64(numfrstrides);
-        stepxoff  = vectorAlloc_f64(numfrstrides);
-        stepxval  = vectorAlloc_f64(numfrstrides);
-        stepphase = vectorAlloc_f64(numfrstrides);
-        steparg   = vectorAlloc_f32(numfrstrides);
-        stepsin   = vectorAlloc_f32(numfrstrides);
-        stepcos   = vectorAlloc_f32(numfrstrides);
         stepcplx  = vectorAlloc_cf32(numfrstrides);
-        estimatedbytes += (3*8+3*4+8)*numfrstrides;
+        estimatedbytes += 8*numfrstrides;
 
         complexunpacked = vectorAlloc_cf32(fftchannels);
         complexrotator = vectorAlloc_cf32(fftchannels);
         fftd = vectorAlloc_cf32(fftchannels);
         estimatedbytes += 3*sizeof(cf32)*fftchannels;
 
-        for(int i=0;i<arraystridelength;i++) {
-          subxoff[i] = (double(i)/double(fftchannels));
-          subtoff[i] = i*sampletime/1e6;
-        }
-        for(int i=0;i<numfrstrides;i++) {
-          stepxoff[i] = double(i*arraystridelength)/double(fftchannels);
-          steptoff[i] = i*arraystridelength*sampletime/1e6;
-        }
-        if(fringerotationorder == 2) { // Quadratic
-          for(int i=0;i<numfrstrides;i++)
-            stepxoffsquared[i] = stepxoff[i]*stepxoff[i];
-        }
-
         if (isfft) {
           status = vectorInitFFTC_cf32(&pFFTSpecC, order, flag, hint, &fftbuffersize, &fftbuffer);
           if (status != vecNoErr)
@@ -286,6 +329,9 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
         }
         break;
       case 0: //zeroth order interpolation, can do "post-F"
+        fftd = vectorAlloc_cf32(recordedbandchannels+1); //lower sideband FFT output, before flipping
+        estimatedbytes += sizeof(cf32)*(recordedbandchannels+1);
+
         if (isfft) {
           status = vectorInitFFTR_f32(&pFFTSpecR, order, flag, hint, &fftbuffersize, &fftbuffer);
           if (status != vecNoErr)
@@ -300,30 +346,20 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
     }
     estimatedbytes += fftbuffersize;
 
-    subfracsamparg = vectorAlloc_f32(arraystridelength);
-    subfracsampsin = vectorAlloc_f32(arraystridelength);
-    subfracsampcos = vectorAlloc_f32(arraystridelength);
-    subchannelfreqs = vectorAlloc_f32(arraystridelength);
-    ldsbsubchannelfreqs = vectorAlloc_f32(arraystridelength);
-    estimatedbytes += 6*4*arraystridelength;
-    /*cout << "subfracsamparg is " << subfracsamparg << endl;
-    cout << "subfracsampsin is " << subfracsampsin << endl;
-    cout << "subfracsampcos is " << subfracsampcos << endl;
-    cout << "subchannelfreqs is " << subchannelfreqs << endl; */
-    for(int i=0;i<arraystridelength;i++) {
-      subchannelfreqs[i] = (float)((TWO_PI*(i)*recordedbandwidth)/recordedbandchannels);
-      ldsbsubchannelfreqs[i] = (float)((-TWO_PI*(i)*recordedbandwidth)/recordedbandchannels);
+    if(filterbank)
+    {
+      filterbankwindow = vectorAlloc_f32(filterbanktaps*fftchannels*(usecomplex?2:1));
+      filterbankfolded = vectorAlloc_f32(fftchannels*(usecomplex?2:1));
+      estimatedbytes += sizeof(f32)*(filterbanktaps+1)*fftchannels*(usecomplex?2:1);
+      generateFilterbankWindow(filterbankwindow, filterbanktaps, fftchannels, usecomplex?2:1);
     }
 
-    stepfracsamparg = vectorAlloc_f32(numfracstrides/2);
-    stepfracsampsin = vectorAlloc_f32(numfracstrides/2);
-    stepfracsampcos = vectorAlloc_f32(numfracstrides/2);
     stepfracsampcplx = vectorAlloc_cf32(numfracstrides/2);
     stepchannelfreqs = vectorAlloc_f32(numfracstrides/2);
     lsbstepchannelfreqs = vectorAlloc_f32(numfracstrides/2);
     dsbstepchannelfreqs = vectorAlloc_f32(numfracstrides/2);
     ldsbstepchannelfreqs = vectorAlloc_f32(numfracstrides/2);
-    estimatedbytes += (7*2+4)*numfracstrides;
+    estimatedbytes += (4*2+4)*numfracstrides;
 
     for(int i=0;i<numfracstrides/2;i++) {
       stepchannelfreqs[i]     = (float)((TWO_PI*i*arraystridelength*recordedbandwidth)/recordedbandchannels);
@@ -406,7 +442,6 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
     s1 = 0;
     s2 = 0;
     sk = 0;
-    kscratch = 0;
   }
   // Phase cal stuff
   PCal::setMinFrequencyResolution(1e6);
@@ -473,20 +508,51 @@ Mode::~Mode()
   }
   vectorFree(dataweight);
   vectorFree(validflags);
+  if(rfiexcision)
+  {
+    for(int i=0;i<config->getNumBufferedFFTs(configindex);++i)
+    {
+      delete [] rfiweights[i];
+    }
+    delete [] rfiweights;
+    vectorFree(rfiwindowweights);
+    vectorFree(rfis1);
+    vectorFree(rfis2);
+    vectorFree(rfisk);
+    vectorFree(rfipower);
+  }
+  if(filterbankwindow != 0)
+  {
+    vectorFree(filterbankwindow);
+    vectorFree(filterbankfolded);
+  }
   for(int j=0;j<numrecordedbands+numzoombands;j++)
   {
     for(int k=0;k<config->getNumBufferedFFTs(configindex);k++)
     {
       if(j<numrecordedbands) {
         vectorFree(fftoutputs[j][k]);
-        vectorFree(conjfftoutputs[j][k]);
+        if(packedoutputs)
+          vectorFree(packedoutputs[j][k]);
       }
     }
     delete [] fftoutputs[j];
-    delete [] conjfftoutputs[j];
+    if(packedoutputs)
+    {
+      if(j<numrecordedbands)
+        vectorFree(packedscales[j]);
+      delete [] packedoutputs[j];
+    }
   }
   delete [] fftoutputs;
-  delete [] conjfftoutputs;
+  if(packedoutputs)
+  {
+    delete [] packedoutputs;
+    delete [] packedscales;
+    vectorFree(packedinvscales);
+    vectorFree(packedpower);
+    vectorFree(packedweights);
+  }
   delete [] interpolator;
 
   for(int i=0;i<numrecordedbands;i++)
@@ -497,33 +563,7 @@ Mode::~Mode()
     case 2: // Quadratic
       vectorFree(piecewiserotator);
       vectorFree(quadpiecerotator);
-
-      vectorFree(subquadxval);
-      vectorFree(subquadphase);
-      vectorFree(subquadarg);
-      vectorFree(subquadsin);
-      vectorFree(subquadcos);
-
-      vectorFree(stepxoffsquared);
-      vectorFree(tempstepxval);
     case 1:
-      vectorFree(subtoff);
-      vectorFree(subtval);
-      vectorFree(subxoff);
-      vectorFree(subxval);
-      vectorFree(subphase);
-      vectorFree(subarg);
-      vectorFree(subsin);
-      vectorFree(subcos);
-
-      vectorFree(steptoff);
-      vectorFree(steptval);
-      vectorFree(stepxoff);
-      vectorFree(stepxval);
-      vectorFree(stepphase);
-      vectorFree(steparg);
-      vectorFree(stepsin);
-      vectorFree(stepcos);
       vectorFree(stepcplx);
 
       vectorFree(complexunpacked);
@@ -537,6 +577,7 @@ Mode::~Mode()
       }
       break;
     case 0: //zeroth order interpolation, "post-F"
+      vectorFree(fftd);
       if(isfft) {
 	vectorFreeFFTR_f32(pFFTSpecR);
       }
@@ -550,15 +591,7 @@ Mode::~Mode()
   vectorFree(linearunpacked);
   vectorFree(fftbuffer);
 
-  vectorFree(subfracsamparg);
-  vectorFree(subfracsampsin);
-  vectorFree(subfracsampcos);
-  vectorFree(subchannelfreqs);
-  vectorFree(ldsbsubchannelfreqs);
 
-  vectorFree(stepfracsamparg);
-  vectorFree(stepfracsampsin);
-  vectorFree(stepfracsampcos);
   vectorFree(stepfracsampcplx);
   vectorFree(stepchannelfreqs);
   vectorFree(lsbstepchannelfreqs);
@@ -605,7 +638,6 @@ Mode::~Mode()
     delete [] s1;
     delete [] s2;
     delete [] sk;
-    vectorFree(kscratch);
   }
 
   if (linear2circular) {
@@ -613,6 +645,163 @@ Mode::~Mode()
   }
 }
 
+void Mode::generateFilterbankWindow(f32 * window, int taps, int length, int interleave)
+{
+  int windowlength = taps*length;
+  double x, coeff, power;
+  f64 * prototype = vectorAlloc_f64(windowlength);
+
+  //sinc lowpass with a cutoff at the channel spacing, tapered by a Hamming window
+  power = 0.0;
+  for(int i=0;i<windowlength;i++)
+  {
+    x = (i - (windowlength-1)/2.0)/length;
+    coeff = (fabs(x) < TINY)?1.0:sin(0.5*TWO_PI*x)/(0.5*TWO_PI*x);
+    coeff *= 0.54 - 0.46*cos(TWO_PI*i/(windowlength-1));
+    prototype[i] = coeff;
+    power += coeff*coeff;
+  }
+
+  //scale so that noise comes out at the same level as for a plain (rectangular window) FFT
+  for(int i=0;i<windowlength;i++)
+  {
+    for(int j=0;j<interleave;j++)
+      window[i*interleave + j] = prototype[i]*sqrt(length/power);
+  }
+  vectorFree(prototype);
+}
+
+int Mode::filterbankFold(const f32 * window, const f32 * input, int windowstart, f32 * output, int taps, int length)
+{
+  int status, tapstart, skip;
+
+  status = vectorZero_f32(output, length);
+  if(status != vecNoErr)
+    return status;
+  for(int t=0;t<taps;t++)
+  {
+    tapstart = windowstart + t*length;
+    skip = (tapstart < 0)?-tapstart:0; //values before the start of the data count as zero
+    if(skip >= length)
+      continue;
+    status = vectorAddProduct_f32(&(window[t*length + skip]), &(input[tapstart + skip]), &(output[skip]), length - skip);
+    if(status != vecNoErr)
+      return status;
+  }
+
+  return vecNoErr;
+}
+
+void Mode::generateRotator(cf32 * rotator, double startphase, double phasestep, double phasecurve, int length, double maxphaseerror)
+{
+  int resynclength, n, lanelength, renormcount;
+  double phase, t, scale, dre, dim, ddre, ddim;
+  double pre[ROTATOR_LANES], pim[ROTATOR_LANES];
+  const double steperror = 4*DBL_EPSILON; //phase error (radians) that one double precision complex multiply can add
+
+  //The error from a plain recurrence grows linearly with the number of steps, but quadratically when the phase step
+  //is itself being updated by recurrence, so work out how far we can go before an exact resync
+  if(phasecurve == 0.0)
+    t = maxphaseerror/steperror;
+  else
+    t = sqrt(2*maxphaseerror/steperror);
+  resynclength = (t > length)?length:int(t);
+  if(resynclength < ROTATOR_LANES)
+    resynclength = ROTATOR_LANES;
+
+  startphase -= floor(startphase);
+  for(int start=0;start<length;start+=resynclength)
+  {
+    lanelength = (length - start < resynclength)?length - start:resynclength;
+    if(phasecurve == 0.0)
+    {
+      //several interleaved recurrences stepping ROTATOR_LANES values at a time, started from one exact phasor
+      phase = startphase + start*phasestep;
+      phase = TWO_PI*(phase - floor(phase));
+      pre[0] = cos(phase);
+      pim[0] = sin(phase);
+      phase = phasestep - floor(phasestep);
+      dre = cos(TWO_PI*phase);
+      dim = sin(TWO_PI*phase);
+      for(int l=1;l<ROTATOR_LANES;l++)
+      {
+        pre[l] = pre[l-1]*dre - pim[l-1]*dim;
+        pim[l] = pre[l-1]*dim + pim[l-1]*dre;
+      }
+      for(int l=1;l<ROTATOR_LANES;l*=2)
+      {
+        t = dre*dre - dim*dim;
+        dim = 2*dre*dim;
+        dre = t;
+      }
+      renormcount = 0;
+      for(n=0;n+ROTATOR_LANES<=lanelength;n+=ROTATOR_LANES)
+      {
+        for(int l=0;l<ROTATOR_LANES;l++)
+        {
+          rotator[start+n+l].re = (f32)pre[l];
+          rotator[start+n+l].im = (f32)pim[l];
+          t = pre[l]*dre - pim[l]*dim;
+          pim[l] = pre[l]*dim + pim[l]*dre;
+          pre[l] = t;
+        }
+        if(++renormcount == ROTATOR_RENORM_INTERVAL)
+        {
+          //first order correction of the magnitude back to 1
+          for(int l=0;l<ROTATOR_LANES;l++)
+          {
+            scale = 1.5 - 0.5*(pre[l]*pre[l] + pim[l]*pim[l]);
+            pre[l] *= scale;
+            pim[l] *= scale;
+          }
+          renormcount = 0;
+        }
+      }
+      for(int l=0;n+l<lanelength;l++)
+      {
+        rotator[start+n+l].re = (f32)pre[l];
+        rotator[start+n+l].im = (f32)pim[l];
+      }
+    }
+    else
+    {
+      //second order recurrence: the phasor is advanced by a step phasor, which is itself advanced by a constant
+      phase = startphase + start*phasestep + double(start)*double(start)*phasecurve;
+      phase = TWO_PI*(phase - floor(phase));
+      pre[0] = cos(phase);
+      pim[0] = sin(phase);
+      phase = phasestep + (2.0*start + 1.0)*phasecurve;
+      phase = TWO_PI*(phase - floor(phase));
+      dre = cos(phase);
+      dim = sin(phase);
+      phase = 2.0*phasecurve;
+      phase = TWO_PI*(phase - floor(phase));
+      ddre = cos(phase);
+      ddim = sin(phase);
+      for(n=0;n<lanelength;n++)
+      {
+        rotator[start+n].re = (f32)pre[0];
+        rotator[start+n].im = (f32)pim[0];
+        t = pre[0]*dre - pim[0]*dim;
+        pim[0] = pre[0]*dim + pim[0]*dre;
+        pre[0] = t;
+        t = dre*ddre - dim*ddim;
+        dim = dre*ddim + dim*ddre;
+        dre = t;
+        if((n+1)%ROTATOR_RENORM_INTERVAL == 0)
+        {
+          scale = 1.5 - 0.5*(pre[0]*pre[0] + pim[0]*pim[0]);
+          pre[0] *= scale;
+          pim[0] *= scale;
+          scale = 1.5 - 0.5*(dre*dre + dim*dim);
+          dre *= scale;
+          dim *= scale;
+        }
+      }
+    }
+  }
+}
+
 float Mode::unpack(int sampleoffset, int subloopindex)
 {
   int status, leftoversamples, stepin = 0;
@@ -646,14 +835,20 @@ float Mode::unpack(int sampleoffset, int subloopindex)
   return 1.0;
 }
 
+vecStatus Mode::unpackRotated(int band, int sampleoffset, const cf32 * rotator, cf32 * dest)
+{
+  return vectorMul_f32cf32(&(unpackedarrays[band][sampleoffset]), rotator, dest, fftchannels);
+}
+
 void Mode::process(int index, int subloopindex)  //frac sample error is in microseconds 
 {
   double phaserotation, averagedelay, nearestsampletime, starttime, lofreq, walltimesecs, fracwalltime, fftcentre, d0, d1, d2, fraclooffset;
-  f32 phaserotationfloat, fracsampleerror;
-  int status, count, nearestsample, integerdelay, RcpIndex, LcpIndex, intwalltime;
+  double rotatorphase, rotatorstep, quadstep, fracsampphase, fracsampdelay;
+  f32 fracsampleerror;
+  int status, count, nearestsample, firstunpacksample, integerdelay, RcpIndex, LcpIndex, intwalltime;
+  f32* bandsamples;
   cf32* fftptr;
   f32* currentstepchannelfreqs;
-  f32* currentsubchannelfreqs;
   int indices[10];
   bool looff, isfraclooffset;
   //cout << "For Mode of datastream " << datastreamindex << ", index " << index << ", validflags is " << validflags[index/FLAGS_PER_INT] << ", after shift you get " << ((validflags[index/FLAGS_PER_INT] >> (index%FLAGS_PER_INT)) & 0x01) << endl;
@@ -667,6 +862,13 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       perbandweights[subloopindex][b] = 0.0;
     }
   }
+  if(rfiexcision)
+  {
+    for(int b = 0; b < numrecordedbands; ++b)
+    {
+      rfiweights[subloopindex][b] = 1.0;
+    }
+  }
   
   if((datalengthbytes <= 1) || (offsetseconds == INVALID_SUBINT) || (((validflags[index/FLAGS_PER_INT] >> (index%FLAGS_PER_INT)) & 0x01) == 0))
   {
@@ -675,9 +877,6 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       status = vectorZero_cf32(fftoutputs[i][subloopindex], recordedbandchannels);
       if(status != vecNoErr)
         csevere << startl << "Error trying to zero fftoutputs when data is bad!" << endl;
-      status = vectorZero_cf32(conjfftoutputs[i][subloopindex], recordedbandchannels);
-      if(status != vecNoErr)
-        csevere << startl << "Error trying to zero fftoutputs when data is bad!" << endl;
     }
     //cout << "Mode for DS " << datastreamindex << " is bailing out of index " << index << "/" << subloopindex << " which is scan " << currentscan << ", sec " << offsetseconds << ", ns " << offsetns << " because datalengthbytes is " << datalengthbytes << " and validflag was " << ((validflags[index/FLAGS_PER_INT] >> (index%FLAGS_PER_INT)) & 0x01) << endl;
     return; //don't process crap data
@@ -700,7 +899,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
   //cout << "nearestsample for " << datastreamindex << " is " << nearestsample << endl;
   //cout << "bytesperblocknumerator for " << datastreamindex << " is " << bytesperblocknumerator << endl;
   //cout << "bytesperblockdenominator for " << datastreamindex << " is " << bytesperblockdenominator << endl;
-  if(nearestsample < -1 || (((nearestsample + fftchannels)/samplesperblock)*bytesperblocknumerator)/bytesperblockdenominator > datalengthbytes)
+  if(nearestsample < -1 || (((nearestsample + fftchannels + filterbankleadsamples)/samplesperblock)*bytesperblocknumerator)/bytesperblockdenominator > datalengthbytes)
   {
     cerror << startl << "MODE error for datastream " << datastreamindex << " - trying to process data outside range - aborting!!! nearest sample was " << nearestsample << ", the max bytes should be " << datalengthbytes << " and hence last sample should be " << (datalengthbytes*bytesperblockdenominator)/(bytesperblocknumerator*samplesperblock)  << " (fftchannels is " << fftchannels << "), offsetseconds was " << offsetseconds << ", offsetns was " << offsetns << ", index was " << index << ", average delay was " << averagedelay << ", datasec was " << datasec << ", datans was " << datans << ", fftstartmicrosec was " << fftstartmicrosec << endl;
     for(int i=0;i<numrecordedbands;i++)
@@ -708,9 +907,6 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       status = vectorZero_cf32(fftoutputs[i][subloopindex], recordedbandchannels);
       if(status != vecNoErr)
         csevere << startl << "Error trying to zero fftoutputs when data is bad!" << endl;
-      status = vectorZero_cf32(conjfftoutputs[i][subloopindex], recordedbandchannels);
-      if(status != vecNoErr)
-        csevere << startl << "Error trying to zero fftoutputs when data is bad!" << endl;
     }
     return;
   }
@@ -719,9 +915,16 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
     nearestsample = 0;
     dataweight[subloopindex] = unpack(nearestsample, subloopindex);
   }
-  else if(nearestsample < unpackstartsamples || nearestsample > unpackstartsamples + unpacksamples - fftchannels)
-    //need to unpack more data
-    dataweight[subloopindex] = unpack(nearestsample, subloopindex);
+  else
+  {
+    //if filterbanking, the unpacked data must start early enough to cover the start of the window
+    firstunpacksample = nearestsample - filterbankleadsamples;
+    if(firstunpacksample < 0)
+      firstunpacksample = 0;
+    if(firstunpacksample < unpackstartsamples || nearestsample + filterbankleadsamples > unpackstartsamples + unpacksamples - fftchannels)
+      //need to unpack more data
+      dataweight[subloopindex] = unpack(firstunpacksample, subloopindex);
+  }
 
  /*
   * After DiFX-2.4, it is proposed to change the handling of lower sideband and dual sideband data, such
@@ -761,9 +964,6 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       status = vectorZero_cf32(fftoutputs[i][subloopindex], recordedbandchannels);
       if(status != vecNoErr)
         csevere << startl << "Error trying to zero fftoutputs when data is bad!" << endl;
-      status = vectorZero_cf32(conjfftoutputs[i][subloopindex], recordedbandchannels);
-      if(status != vecNoErr)
-        csevere << startl << "Error trying to zero fftoutputs when data is bad!" << endl;
     }
     return;
   }
@@ -800,16 +1000,6 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       b = d0 + (d1 - (a*0.5 + d0))/3.0;
       integerdelay = static_cast<int>(b);
       b -= integerdelay;
-
-      status = vectorMulC_f64(subxoff, a, subxval, arraystridelength);
-      if(status != vecNoErr)
-        csevere << startl << "Error in linearinterpolate, subval multiplication" << endl;
-      status = vectorMulC_f64(stepxoff, a, stepxval, numfrstrides);
-      if(status != vecNoErr)
-        csevere << startl << "Error in linearinterpolate, stepval multiplication" << endl;
-      status = vectorAddC_f64_I(b, subxval, arraystridelength);
-      if(status != vecNoErr)
-        csevere << startl << "Error in linearinterpolate, subval addition!!!" << endl;
       break;
     case 2: //quadratic
       a = interpolator[0];
@@ -817,25 +1007,6 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       c = interpolator[2] + index*interpolator[1] + index*index*interpolator[0];
       integerdelay = int(c);
       c -= integerdelay;
-
-      status = vectorMulC_f64(subxoff, b + a*stepxoff[1], subxval, arraystridelength);
-      if(status != vecNoErr)
-        csevere << startl << "Error in quadinterpolate, subval multiplication" << endl;
-      status = vectorMulC_f64(subxoff, 2*a*stepxoff[1], subquadxval, arraystridelength);
-      if(status != vecNoErr)
-        csevere << startl << "Error in quadinterpolate, subquadval multiplication" << endl;
-      status = vectorMulC_f64(stepxoff, b, stepxval, numfrstrides);
-      if(status != vecNoErr)
-        csevere << startl << "Error in quadinterpolate, stepval multiplication" << endl;
-      status = vectorMulC_f64(stepxoffsquared, a, tempstepxval, numfrstrides);
-      if(status != vecNoErr)
-        csevere << startl << "Error in quadinterpolate, tempstepval multiplication" << endl;
-      status = vectorAdd_f64_I(tempstepxval, stepxval, numfrstrides);
-      if(status != vecNoErr)
-        csevere << startl << "Error in quadinterpolate, stepval addition!!!" << endl;
-      status = vectorAddC_f64_I(c, subxval, arraystridelength);
-      if(status != vecNoErr)
-        csevere << startl << "Error in quadinterpolate, subval addition!!!" << endl;
       break;
   }
 
@@ -848,7 +1019,6 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
     //updated so that Nyquist channel is not accumulated for either USB or LSB data
     //and is excised entirely, so both USB and LSB data start at the same place (no sidebandoffset)
     currentstepchannelfreqs = stepchannelfreqs;
-    currentsubchannelfreqs = subchannelfreqs;
     if(usedouble)
     {
       currentstepchannelfreqs = dsbstepchannelfreqs;
@@ -910,67 +1080,29 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 
    Calculate complexrotator[j]  (for j = 0 to fftchanels-1) as:
 
-   complexrotator[j] = exp( 2 pi i * (A*j + B) )
+   complexrotator[j] = exp( -2 pi i * (A*j + B) )
 
    where:
 
    A = a*lofreq/fftchannels - sampletime*1.0e-6*recordedfreqlooffsets[i]
-   B = b*lofreq/fftchannels + fraclofreq*integerdelay - recordedfreqlooffsets[i]*fracwalltime - fraclooffset*intwalltime
+   B = b*lofreq + fraclofreq*integerdelay - recordedfreqlooffsets[i]*fracwalltime - fraclooffset*intwalltime
 
-   And a, b are computed outside the recordedfreq loop (variable i)
+   And a, b are computed outside the recordedfreq loop (variable i).  The first arraystridelength values and the
+   phasor at the start of each stride are generated by recurrence, and the rest filled in by multiplying them together
 */
 
-        status = vectorMulC_f64(subxval, lofreq, subphase, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in linearinterpolate lofreq sub multiplication!!!" << status << endl;
-        status = vectorMulC_f64(stepxval, lofreq, stepphase, numfrstrides);
-        if(status != vecNoErr)
-          csevere << startl << "Error in linearinterpolate lofreq step multiplication!!!" << status << endl;
-        if(fractionalLoFreq) {
-          status = vectorAddC_f64_I((lofreq-int(lofreq))*double(integerdelay), subphase, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in linearinterpolate lofreq non-integer freq addition!!!" << status << endl;
-        }
+        rotatorphase = b*lofreq;
+        rotatorstep = a*lofreq/fftchannels;
+        if(fractionalLoFreq)
+          rotatorphase += (lofreq-int(lofreq))*double(integerdelay);
         if(looff) {
-          status = vectorMulC_f64(subtoff, -recordedfreqlooffsets[i], subtval, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset calculation (time domain, sub vector)" << status << endl;
-          status = vectorMulC_f64(steptoff, -recordedfreqlooffsets[i], steptval, numfrstrides);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset calculation (time domain, step vector)" << status << endl;
-          status = vectorAdd_f64_I(subtval, subphase, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset addition (time domain, sub vector)" << status << endl;
-          status = vectorAdd_f64_I(steptval, stepphase, numfrstrides);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset addition (time domain, step vector)" << status << endl;
-          status = vectorAddC_f64_I(-recordedfreqlooffsets[i]*fracwalltime, subphase, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset addition (time domain, wallclock offset)" << status << endl;
-          if(isfraclooffset) {
-            status = vectorAddC_f64_I(-fraclooffset*intwalltime, subphase, arraystridelength);
-            if(status != vecNoErr)
-              csevere << startl << "Error in LO offset addition (time domain, frac LO offset wallclock offset)" << status << endl;
-          }
-        }
-        for(int j=0;j<arraystridelength;j++) {
-          subarg[j] = -TWO_PI*(subphase[j] - int(subphase[j]));
-        }
-        for(int j=0;j<numfrstrides;j++) {
-          steparg[j] = -TWO_PI*(stepphase[j] - int(stepphase[j]));
+          rotatorstep -= recordedfreqlooffsets[i]*sampletime/1e6;
+          rotatorphase -= recordedfreqlooffsets[i]*fracwalltime;
+          if(isfraclooffset)
+            rotatorphase -= fraclooffset*intwalltime;
         }
-        status = vectorSinCos_f32(subarg, subsin, subcos, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in sin/cos of sub rotate argument!!!" << endl;
-        status = vectorSinCos_f32(steparg, stepsin, stepcos, numfrstrides);
-        if(status != vecNoErr)
-          csevere << startl << "Error in sin/cos of step rotate argument!!!" << endl;
-        status = vectorRealToComplex_f32(subcos, subsin, complexrotator, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error assembling sub into complex!!!" << endl;
-        status = vectorRealToComplex_f32(stepcos, stepsin, stepcplx, numfrstrides);
-        if(status != vecNoErr)
-          csevere << startl << "Error assembling step into complex!!!" << endl;
+        generateRotator(complexrotator, -rotatorphase, -rotatorstep, 0.0, arraystridelength, ROTATOR_MAX_PHASE_ERROR);
+        generateRotator(stepcplx, 0.0, -rotatorstep*arraystridelength, 0.0, numfrstrides, ROTATOR_MAX_PHASE_ERROR);
         for(int j=1;j<numfrstrides;j++) {
           status = vectorMulC_cf32(complexrotator, stepcplx[j], &complexrotator[j*arraystridelength], arraystridelength);
           if(status != vecNoErr)
@@ -978,67 +1110,25 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
         }
         break;
       case 2: // Quadratic
-        status = vectorMulC_f64(subxval, lofreq, subphase, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in quadinterpolate lofreq sub multiplication!!!" << status << endl;
-        if(fractionalLoFreq) {
-          status = vectorAddC_f64_I((lofreq-int(lofreq))*double(integerdelay), subphase, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in linearinterpolate lofreq non-integer freq addition!!!" << status << endl;
-        }
-        status = vectorMulC_f64(subquadxval, lofreq, subquadphase, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in quadinterpolate lofreq subquad multiplication!!!" << status << endl;
-        status = vectorMulC_f64(stepxval, lofreq, stepphase, numfrstrides);
-        if(status != vecNoErr)
-          csevere << startl << "Error in quadinterpolate lofreq step multiplication!!!" << status << endl;
+        //within stride k the phase is linear, with a gradient that increases by quadstep per sample from one stride
+        //to the next; the stride start phases are quadratic in k
+        rotatorphase = c*lofreq;
+        rotatorstep = (b + a*arraystridelength/double(fftchannels))*lofreq/fftchannels;
+        quadstep = 2*a*lofreq*arraystridelength/(double(fftchannels)*double(fftchannels));
+        if(fractionalLoFreq)
+          rotatorphase += (lofreq-int(lofreq))*double(integerdelay);
         if(looff) {
-          status = vectorMulC_f64(subtoff, -recordedfreqlooffsets[i], subtval, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset calculation (time domain, sub vector)" << status << endl;
-          status = vectorMulC_f64(steptoff, -recordedfreqlooffsets[i], steptval, numfrstrides);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset calculation (time domain, step vector)" << status << endl;
-          status = vectorAdd_f64_I(subtval, subphase, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset addition (time domain, sub vector)" << status << endl;
-          status = vectorAdd_f64_I(steptval, stepphase, numfrstrides);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset addition (time domain, step vector)" << status << endl;
-          status = vectorAddC_f64_I(-recordedfreqlooffsets[i]*fracwalltime, subphase, arraystridelength);
-          if(status != vecNoErr)
-            csevere << startl << "Error in LO offset addition (time domain, wallclock offset)" << status << endl;
-          if(isfraclooffset) {
-            status = vectorAddC_f64_I(-fraclooffset*intwalltime, subphase, arraystridelength);
-            if(status != vecNoErr)
-              csevere << startl << "Error in LO offset addition (time domain, frac LO offset wallclock offset)" << status << endl;
-          }
-        }
-        for(int j=0;j<arraystridelength;j++) {
-          subarg[j] = -TWO_PI*(subphase[j] - int(subphase[j]));
-          subquadarg[j] = -TWO_PI*(subquadphase[j] - int(subquadphase[j]));
+          rotatorstep -= recordedfreqlooffsets[i]*sampletime/1e6;
+          rotatorphase -= recordedfreqlooffsets[i]*fracwalltime;
+          if(isfraclooffset)
+            rotatorphase -= fraclooffset*intwalltime;
         }
-        for(int j=0;j<numfrstrides;j++) {
-          steparg[j] = -TWO_PI*(stepphase[j] - int(stepphase[j]));
-        }
-        status = vectorSinCos_f32(subarg, subsin, subcos, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in sin/cos of sub rotate argument!!!" << endl;
-        status = vectorSinCos_f32(subquadarg, subquadsin, subquadcos, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in sin/cos of subquad rotate argument!!!" << endl;
-        status = vectorSinCos_f32(steparg, stepsin, stepcos, numfrstrides);
-        if(status != vecNoErr)
-          csevere << startl << "Error in sin/cos of step rotate argument!!!" << endl;
-        status = vectorRealToComplex_f32(subcos, subsin, piecewiserotator, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error assembling sub into complex" << endl;
-        status = vectorRealToComplex_f32(subquadcos, subquadsin, quadpiecerotator, arraystridelength);
-        if(status != vecNoErr)
-          csevere << startl << "Error assembling sub into complex" << endl;
-        status = vectorRealToComplex_f32(stepcos, stepsin, stepcplx, numfrstrides);
-        if(status != vecNoErr)
-          csevere << startl << "Error assembling step into complex" << endl;
+        generateRotator(piecewiserotator, -rotatorphase, -rotatorstep, 0.0, arraystridelength, ROTATOR_MAX_PHASE_ERROR);
+        generateRotator(quadpiecerotator, 0.0, -quadstep, 0.0, arraystridelength, ROTATOR_MAX_PHASE_ERROR);
+        rotatorstep = b*lofreq*arraystridelength/fftchannels;
+        if(looff)
+          rotatorstep -= recordedfreqlooffsets[i]*arraystridelength*sampletime/1e6;
+        generateRotator(stepcplx, 0.0, -rotatorstep, -a*lofreq*arraystridelength*arraystridelength/(double(fftchannels)*double(fftchannels)), numfrstrides, ROTATOR_MAX_PHASE_ERROR);
         for(int j=0;j<numfrstrides;j++) {
           status = vectorMulC_cf32(piecewiserotator, stepcplx[j], &complexrotator[j*arraystridelength], arraystridelength);
           if(status != vecNoErr)
@@ -1050,41 +1140,21 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
         break;
     }
 
-    // Note recordedfreqclockoffsetsdata will usually be zero, but avoiding if statement
-    status = vectorMulC_f32(currentsubchannelfreqs, fracsampleerror - recordedfreqclockoffsets[i] + recordedfreqclockoffsetsdelta[i]/2, subfracsamparg, arraystridelength);
-    if(status != vecNoErr) {
-      csevere << startl << "Error in frac sample correction, arg generation (sub)!!!" << status << endl;
-      exit(1);
-    }
-    status = vectorMulC_f32(currentstepchannelfreqs, fracsampleerror - recordedfreqclockoffsets[i] + recordedfreqclockoffsetsdelta[i]/2, stepfracsamparg, numfracstrides/2);
-    if(status != vecNoErr)
-      csevere << startl << "Error in frac sample correction, arg generation (step)!!!" << status << endl;
-
     // For zero-th order (post-F) fringe rotation, calculate the fringe rotation (+ LO offset if necessary)
+    fracsampphase = 0.0;
     if(fringerotationorder == 0) { // do both LO offset and fringe rotation  (post-F)
       phaserotation = (averagedelay-integerdelay)*lofreq;
       if(fractionalLoFreq)
         phaserotation += integerdelay*(lofreq-int(lofreq));
       phaserotation -= walltimesecs*recordedfreqlooffsets[i];
-      phaserotationfloat = (f32)(-TWO_PI*(phaserotation-int(phaserotation)));
-      status = vectorAddC_f32_I(phaserotationfloat, subfracsamparg, arraystridelength);
-      if(status != vecNoErr)
-        csevere << startl << "Error in post-f phase rotation addition (+ maybe LO offset correction), sub!!!" << status << endl;
+      fracsampphase = -(phaserotation-int(phaserotation));
     }
 
-    //create the fractional sample correction array
-    status = vectorSinCos_f32(subfracsamparg, subfracsampsin, subfracsampcos, arraystridelength);
-    if(status != vecNoErr)
-      csevere << startl << "Error in frac sample correction, sin/cos (sub)!!!" << status << endl;
-    status = vectorSinCos_f32(stepfracsamparg, stepfracsampsin, stepfracsampcos, numfracstrides/2);
-    if(status != vecNoErr)
-      csevere << startl << "Error in frac sample correction, sin/cos (sub)!!!" << status << endl;
-    status = vectorRealToComplex_f32(subfracsampcos, subfracsampsin, fracsamprotatorA, arraystridelength);
-    if(status != vecNoErr)
-      csevere << startl << "Error in frac sample correction, real to complex (sub)!!!" << status << endl;
-    status = vectorRealToComplex_f32(stepfracsampcos, stepfracsampsin, stepfracsampcplx, numfracstrides/2);
-    if(status != vecNoErr)
-      csevere << startl << "Error in frac sample correction, real to complex (step)!!!" << status << endl;
+    //create the fractional sample correction array, from the phase gradient across the first stride of channels
+    //and the phasors at the start of each stride.  Note recordedfreqclockoffsetsdelta will usually be zero
+    fracsampdelay = fracsampleerror - recordedfreqclockoffsets[i] + recordedfreqclockoffsetsdelta[i]/2;
+    generateRotator(fracsamprotatorA, fracsampphase, fracsampdelay*recordedbandwidth/recordedbandchannels, 0.0, arraystridelength, ROTATOR_MAX_PHASE_ERROR);
+    generateRotator(stepfracsampcplx, fracsampdelay*currentstepchannelfreqs[0]/TWO_PI, fracsampdelay*arraystridelength*recordedbandwidth/recordedbandchannels, 0.0, numfracstrides/2, ROTATOR_MAX_PHASE_ERROR);
     for(int j=1;j<numfracstrides/2;j++) {
       status = vectorMulC_cf32(fracsamprotatorA, stepfracsampcplx[j], &(fracsamprotatorA[j*arraystridelength]), arraystridelength);
       if(status != vecNoErr)
@@ -1098,40 +1168,9 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 
     // Repeat the post F correction steps if each pol is different
     if (deltapoloffsets) {
-      status = vectorMulC_f32(currentsubchannelfreqs, fracsampleerror - recordedfreqclockoffsets[i] - recordedfreqclockoffsetsdelta[i]/2, subfracsamparg, arraystridelength); 
-      if(status != vecNoErr) {
-	csevere << startl << "Error in frac sample correction, arg generation (sub)!!!" << status << endl;
-	exit(1);
-      }
-      status = vectorMulC_f32(currentstepchannelfreqs, fracsampleerror - recordedfreqclockoffsets[i] - recordedfreqclockoffsetsdelta[i]/2, stepfracsamparg, numfracstrides/2);  //L2C add delay
-      if(status != vecNoErr)
-	csevere << startl << "Error in frac sample correction, arg generation (step)!!!" << status << endl;
-
-      // For zero-th order (post-F) fringe rotation, calculate the fringe rotation (+ LO offset if necessary)
-      if(fringerotationorder == 0) { // do both LO offset and fringe rotation  (post-F)
-	phaserotation = (averagedelay-integerdelay)*lofreq;
-	if(fractionalLoFreq)
-	  phaserotation += integerdelay*(lofreq-int(lofreq));
-	phaserotation -= walltimesecs*recordedfreqlooffsets[i];
-	phaserotationfloat = (f32)(-TWO_PI*(phaserotation-int(phaserotation)));
-	status = vectorAddC_f32_I(phaserotationfloat, subfracsamparg, arraystridelength);
-	if(status != vecNoErr)
-	  csevere << startl << "Error in post-f phase rotation addition (+ maybe LO offset correction), sub!!!" << status << endl;
-      }
-      
-      //create the fractional sample correction array
-      status = vectorSinCos_f32(subfracsamparg, subfracsampsin, subfracsampcos, arraystridelength);
-      if(status != vecNoErr)
-	csevere << startl << "Error in frac sample correction, sin/cos (sub)!!!" << status << endl;
-      status = vectorSinCos_f32(stepfracsamparg, stepfracsampsin, stepfracsampcos, numfracstrides/2);
-      if(status != vecNoErr)
-	csevere << startl << "Error in frac sample correction, sin/cos (sub)!!!" << status << endl;
-      status = vectorRealToComplex_f32(subfracsampcos, subfracsampsin, fracsamprotatorB, arraystridelength); // L2C change pointers
-      if(status != vecNoErr)
-	csevere << startl << "Error in frac sample correction, real to complex (sub)!!!" << status << endl;
-      status = vectorRealToComplex_f32(stepfracsampcos, stepfracsampsin, stepfracsampcplx, numfracstrides/2);
-      if(status != vecNoErr)
-	csevere << startl << "Error in frac sample correction, real to complex (step)!!!" << status << endl;
+      fracsampdelay = fracsampleerror - recordedfreqclockoffsets[i] - recordedfreqclockoffsetsdelta[i]/2;
+      generateRotator(fracsamprotatorB, fracsampphase, fracsampdelay*recordedbandwidth/recordedbandchannels, 0.0, arraystridelength, ROTATOR_MAX_PHASE_ERROR); // L2C change pointers
+      generateRotator(stepfracsampcplx, fracsampdelay*currentstepchannelfreqs[0]/TWO_PI, fracsampdelay*arraystridelength*recordedbandwidth/recordedbandchannels, 0.0, numfracstrides/2, ROTATOR_MAX_PHASE_ERROR);
       for(int j=1;j<numfracstrides/2;j++) {
 	status = vectorMulC_cf32(fracsamprotatorB, stepfracsampcplx[j], &(fracsamprotatorB[j*arraystridelength]), arraystridelength); // L2C change pointers
 	if(status != vecNoErr)
@@ -1150,6 +1189,20 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       if(config->matchingRecordedBand(configindex, datastreamindex, i, j))
       {
         indices[count++] = j;
+
+        //if requested, pass the samples through the polyphase filterbank window before the FFT.  The window is
+        //centred on this FFT; fringe rotation is applied to the folded block, which assumes the fringe phase
+        //changes little over the window span (FILTERBANK_TAPS FFT lengths)
+        if(filterbank)
+        {
+          status = filterbankFold(filterbankwindow, unpackedarrays[j], (nearestsample - filterbankleadsamples - unpackstartsamples)*(usecomplex?2:1), filterbankfolded, filterbanktaps, fftchannels*(usecomplex?2:1));
+          if(status != vecNoErr)
+            csevere << startl << "Error in polyphase filterbank!!!" << status << endl;
+          bandsamples = filterbankfolded;
+        }
+        else
+          bandsamples = &(unpackedarrays[j][(nearestsample - unpackstartsamples)*(usecomplex?2:1)]);
+
         switch(fringerotationorder) {
           case 0: //post-F
             if (usecomplex) {
@@ -1157,18 +1210,18 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
               exit(1);
             }
               
-            fftptr = (config->getDRecordedLowerSideband(configindex, datastreamindex, i))?conjfftoutputs[j][subloopindex]:fftoutputs[j][subloopindex];
+            fftptr = (config->getDRecordedLowerSideband(configindex, datastreamindex, i))?fftd:fftoutputs[j][subloopindex];
 
             //do the fft
             // Chris add C2C fft for complex data
             if(isfft) {
-              status = vectorFFT_RtoC_f32(&(unpackedarrays[j][nearestsample - unpackstartsamples]), (f32*) fftptr, pFFTSpecR, fftbuffer);
+              status = vectorFFT_RtoC_f32(bandsamples, (f32*) fftptr, pFFTSpecR, fftbuffer);
               if (status != vecNoErr)
                 csevere << startl << "Error in FFT!!!" << status << endl;
             //fix the lower sideband if required
             }
             else{
-              status = vectorDFT_RtoC_f32(&(unpackedarrays[j][nearestsample - unpackstartsamples]), (f32*) fftptr, pDFTSpecR, fftbuffer);
+              status = vectorDFT_RtoC_f32(bandsamples, (f32*) fftptr, pDFTSpecR, fftbuffer);
               if (status != vecNoErr)
                 csevere << startl << "Error in DFT!!!" << status << endl;  
             }
@@ -1182,16 +1235,17 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
           case 1: // Linear
           case 2: // Quadratic
             if (usecomplex) {
-              status = vectorMul_cf32(complexrotator, &unpackedcomplexarrays[j][nearestsample - unpackstartsamples], complexunpacked, fftchannels);
+              status = vectorMul_cf32(complexrotator, (cf32*)bandsamples, complexunpacked, fftchannels);
               // The following can be uncommented (and the above commented) if wanting to 'turn off' fringe rotation for testing in the complex case
               //status = vectorCopy_cf32(&unpackedcomplexarrays[j][nearestsample - unpackstartsamples], complexunpacked, fftchannels);
               if (status != vecNoErr)
                 csevere << startl << "Error in complex fringe rotation" << endl;
             } else {
-              status = vectorRealToComplex_f32(&(unpackedarrays[j][nearestsample - unpackstartsamples]), NULL, complexunpacked, fftchannels);
-              if (status != vecNoErr)
-                csevere << startl << "Error in real->complex conversion" << endl;
-              status = vectorMul_cf32_I(complexrotator, complexunpacked, fftchannels);
+              //real to complex conversion and fringe rotation in one pass (straight from the packed data if the mode can)
+              if(filterbank)
+                status = vectorMul_f32cf32(bandsamples, complexrotator, complexunpacked, fftchannels);
+              else
+                status = unpackRotated(j, nearestsample - unpackstartsamples, complexrotator, complexunpacked);
               if(status != vecNoErr)
               	csevere << startl << "Error in fringe rotation!!!" << status << endl;
             }
@@ -1259,21 +1313,9 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 
         if(dumpkurtosis) //do the necessary accumulation
         {
-          status = vectorMagnitude_cf32(fftoutputs[j][subloopindex], kscratch, recordedbandchannels);
-          if(status != vecNoErr)
-            csevere << startl << "Error taking kurtosis magnitude!" << endl;
-          status = vectorSquare_f32_I(kscratch, recordedbandchannels);
-          if(status != vecNoErr)
-            csevere << startl << "Error in first kurtosis square!" << endl;
-          status = vectorAdd_f32_I(kscratch, s1[j], recordedbandchannels);
-          if(status != vecNoErr)
-            csevere << startl << "Error in kurtosis s1 accumulation!" << endl;
-          status = vectorSquare_f32_I(kscratch, recordedbandchannels);
+          status = vectorKurtosisAccumulate_cf32(fftoutputs[j][subloopindex], s1[j], s2[j], recordedbandchannels);
           if(status != vecNoErr)
-            csevere << startl << "Error in second kurtosis square!" << endl;
-          status = vectorAdd_f32_I(kscratch, s2[j], recordedbandchannels);
-          if(status != vecNoErr)
-            csevere << startl << "Error in kurtosis s2 accumulation!" << endl;
+            csevere << startl << "Error in kurtosis accumulation!" << endl;
         }
 
         //do the frac sample correct (+ phase shifting if applicable, + fringe rotate if its post-f)
@@ -1285,14 +1327,9 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 	if(status != vecNoErr)
 	  csevere << startl << "Error in application of frac sample correction!!!" << status << endl;
 
-        //do the conjugation
-        status = vectorConj_cf32(fftoutputs[j][subloopindex], conjfftoutputs[j][subloopindex], recordedbandchannels);
-        if(status != vecNoErr)
-          csevere << startl << "Error in conjugate!!!" << status << endl;
-
-	if (!linear2circular) {
+	if (!linear2circular && !rfiexcision) {
 	  //do the autocorrelation (skipping Nyquist channel)
-	  status = vectorAddProduct_cf32(fftoutputs[j][subloopindex], conjfftoutputs[j][subloopindex], autocorrelations[0][j], recordedbandchannels);
+	  status = vectorAddProductConj_cf32(fftoutputs[j][subloopindex], fftoutputs[j][subloopindex], autocorrelations[0][j], recordedbandchannels);
 	  if(status != vecNoErr)
 	    csevere << startl << "Error in autocorrelation!!!" << status << endl;
 
@@ -1326,17 +1363,12 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 	  
 	  // Rotate Lcp by 90deg
 	  vectorMulC_cf32_I(phasecorrA[i], fftoutputs[LcpIndex][subloopindex], recordedbandchannels);
-	  vectorMulC_cf32_I(phasecorrconjA[i], conjfftoutputs[LcpIndex][subloopindex], recordedbandchannels);
 
 	  // Add and subtract
 	  vectorSub_cf32(fftoutputs[LcpIndex][subloopindex], fftoutputs[RcpIndex][subloopindex], tmpvec, recordedbandchannels);
 	  vectorAdd_cf32_I(fftoutputs[LcpIndex][subloopindex], fftoutputs[RcpIndex][subloopindex], recordedbandchannels);
 	  vectorCopy_cf32(tmpvec, fftoutputs[LcpIndex][subloopindex], recordedbandchannels);
 
-	  vectorSub_cf32(conjfftoutputs[LcpIndex][subloopindex], conjfftoutputs[RcpIndex][subloopindex], tmpvec, recordedbandchannels);
-	  vectorAdd_cf32_I(conjfftoutputs[LcpIndex][subloopindex], conjfftoutputs[RcpIndex][subloopindex], recordedbandchannels);
-	  vectorCopy_cf32(tmpvec, conjfftoutputs[LcpIndex][subloopindex], recordedbandchannels);
-
 	  break; 
       } else if (phasepoloffset) {
 	// Add phase offset to Lcp
@@ -1349,15 +1381,14 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 	  
 	  // Rotate Lcp by phase offset deg
 	  vectorMulC_cf32_I(phasecorrA[i], fftoutputs[LcpIndex][subloopindex], recordedbandchannels);
-	  vectorMulC_cf32_I(phasecorrconjA[i], conjfftoutputs[LcpIndex][subloopindex], recordedbandchannels);
       }
 
-      //if we need to, do the cross-polar autocorrelations
-      if(calccrosspolautocorrs) {
-	status = vectorAddProduct_cf32(fftoutputs[indices[0]][subloopindex], conjfftoutputs[indices[1]][subloopindex], autocorrelations[1][indices[0]], recordedbandchannels);
+      //if we need to, do the cross-polar autocorrelations (after excision, if that is on)
+      if(calccrosspolautocorrs && !rfiexcision) {
+	status = vectorAddProductConj_cf32(fftoutputs[indices[0]][subloopindex], fftoutputs[indices[1]][subloopindex], autocorrelations[1][indices[0]], recordedbandchannels);
 	if(status != vecNoErr)
 	  csevere << startl << "Error in cross-polar autocorrelation!!!" << status << endl;
-	status = vectorAddProduct_cf32(fftoutputs[indices[1]][subloopindex], conjfftoutputs[indices[0]][subloopindex], autocorrelations[1][indices[1]], recordedbandchannels);
+	status = vectorAddProductConj_cf32(fftoutputs[indices[1]][subloopindex], fftoutputs[indices[0]][subloopindex], autocorrelations[1][indices[1]], recordedbandchannels);
 	if(status != vecNoErr)
 	  csevere << startl << "Error in cross-polar autocorrelation!!!" << status << endl;
       
@@ -1375,10 +1406,10 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       }
     }
     
-    if (linear2circular) {// Delay this as it is possible for linear2circular to be active, but just one pol present
+    if (linear2circular && !rfiexcision) {// Delay this as it is possible for linear2circular to be active, but just one pol present
       for (int k=0; k<count; k++) {
 	//do the autocorrelation (skipping Nyquist channel)
-	status = vectorAddProduct_cf32(fftoutputs[indices[k]][subloopindex], conjfftoutputs[indices[k]][subloopindex], autocorrelations[0][indices[k]], recordedbandchannels);
+	status = vectorAddProductConj_cf32(fftoutputs[indices[k]][subloopindex], fftoutputs[indices[k]][subloopindex], autocorrelations[0][indices[k]], recordedbandchannels);
 	if(status != vecNoErr)
 	  csevere << startl << "Error in autocorrelation!!!" << status << endl;
 
@@ -1425,9 +1456,10 @@ void Mode::averageFrequency()
 
 bool Mode::calculateAndAverageKurtosis(int numblocks, int maxchannels)
 {
-  int status, kchanavg;
+  int kchanavg;
   bool nonzero = false;
 
+  kchanavg = (maxchannels < recordedbandchannels)?recordedbandchannels/maxchannels:1;
   for(int i=0;i<numrecordedbands;i++)
   {
     nonzero = false;
@@ -1441,40 +1473,256 @@ bool Mode::calculateAndAverageKurtosis(int numblocks, int maxchannels)
     }
     if(!nonzero)
       continue;
-    status = vectorSquare_f32_I(s1[i], recordedbandchannels);
-    if(status != vecNoErr)
-      cerror << startl << "Problem calculating kurtosis (squaring s1)" << endl;
-    status = vectorMulC_f32_I((f32)numblocks, s2[i], recordedbandchannels);
-    if(status != vecNoErr)
-      cerror << startl << "Problem calculating kurtosis (scaling s2)" << endl;
-    status = vectorDivide_f32(s1[i], s2[i], sk[i], recordedbandchannels);
-    if(status != vecNoErr)
-      cerror << startl << "Problem calculating kurtosis (s2/s1^2)" << endl;
-    status = vectorAddC_f32_I(-1.0, sk[i], recordedbandchannels);
-    if(status != vecNoErr)
-      cerror << startl << "Problem calculating kurtosis (sk - 1)" << endl;
-    status = vectorMulC_f32_I((f32)numblocks/(numblocks - 1.0), sk[i], recordedbandchannels);
-    if(status != vecNoErr)
-      cerror << startl << "Problem calculating kurtosis (sk * numblocks/(numblocks-1))" << endl;
-    status = vectorAddC_f32_I(-1.0, sk[i], recordedbandchannels);
-    if(status != vecNoErr)
-      cerror << startl << "Problem calculating kurtosis (sk - 1)" << endl;
-    if(maxchannels < recordedbandchannels)
+    finaliseKurtosis(s1[i], s2[i], sk[i], recordedbandchannels/kchanavg, kchanavg, numblocks);
+  }
+
+  return nonzero;
+}
+
+void Mode::finaliseKurtosis(const f32 * s1, const f32 * s2, f32 * sk, int numchannels, int kchanavg, int numblocks)
+{
+  f32 sum;
+  f32 n = numblocks;
+  f32 unbias = numblocks/(numblocks - 1.0);
+  f32 scale = 1.0/kchanavg;
+
+  //sk = (n/(n-1))*(n*s2/s1^2 - 1) - 1 for each channel, averaged over kchanavg channels
+  for(int j=0;j<numchannels;j++)
+  {
+    sum = 0.0;
+    for(int k=j*kchanavg;k<(j+1)*kchanavg;k++)
+      sum += unbias*(n*s2[k]/(s1[k]*s1[k]) - 1.0f) - 1.0f;
+    sk[j] = scale*sum;
+  }
+}
+
+int Mode::exciseBandRFI(cf32 ** spectra, f32 * weights, int numffts, int numchannels, f32 skthreshold, f32 fftthreshold, f32 * s1, f32 * s2, f32 * sk, f32 * power, int * blankedchannels)
+{
+  int numvalid, numblankedffts, numblankedchannels;
+  f32 limit, p, sum0, sum1;
+  f32 * sortedpower = &(power[numffts]);
+  const f32 clip = 10.0; //relative channel power which noise exceeds with probability e^-10
+
+  //the kurtosis statistics of every FFT holding data
+  vectorZero_f32(s1, numchannels);
+  vectorZero_f32(s2, numchannels);
+  numvalid = 0;
+  for(int n=0;n<numffts;n++)
+  {
+    if(weights[n] != 0.0)
     {
-      kchanavg = recordedbandchannels/maxchannels;
-      status = vectorMulC_f32_I(1.0/((f32)kchanavg), sk[i], recordedbandchannels);
-      if(status != vecNoErr)
-        cerror << startl << "Problem calculating kurtosis (sk average)" << endl;
-      for(int j=0;j<maxchannels;j++)
+      vectorKurtosisAccumulate_cf32(spectra[n], s1, s2, numchannels);
+      numvalid++;
+    }
+  }
+
+  //blank FFTs much brighter than the median (broadband bursts), and take them out of the statistics.  The power
+  //of each channel is relative to its mean over the window and clipped, so narrowband RFI can't trip this
+  numblankedffts = 0;
+  if(fftthreshold > 0.0 && numvalid >= RFI_MIN_POWER_FFTS)
+  {
+    for(int k=0;k<numchannels;k++)
+      sk[k] = (s1[k] > 0.0)?numvalid/s1[k]:0.0;
+    numvalid = 0;
+    for(int n=0;n<numffts;n++)
+    {
+      if(weights[n] != 0.0)
       {
-        sk[i][j] = sk[i][j*kchanavg];
-        for(int k=1;k<kchanavg;k++)
-          sk[i][j] += sk[i][j*kchanavg + k];
+        sum0 = 0.0;
+        sum1 = 0.0;
+        for(int k=0;k<numchannels-1;k+=2)
+        {
+          p = (spectra[n][k].re*spectra[n][k].re + spectra[n][k].im*spectra[n][k].im)*sk[k];
+          sum0 += (p < clip)?p:clip;
+          p = (spectra[n][k+1].re*spectra[n][k+1].re + spectra[n][k+1].im*spectra[n][k+1].im)*sk[k+1];
+          sum1 += (p < clip)?p:clip;
+        }
+        if(numchannels%2 == 1)
+        {
+          p = (spectra[n][numchannels-1].re*spectra[n][numchannels-1].re + spectra[n][numchannels-1].im*spectra[n][numchannels-1].im)*sk[numchannels-1];
+          sum0 += (p < clip)?p:clip;
+        }
+        power[n] = sum0 + sum1;
+        sortedpower[numvalid++] = power[n];
       }
     }
+    std::nth_element(sortedpower, sortedpower + numvalid/2, sortedpower + numvalid);
+    limit = sortedpower[numvalid/2]*(1.0 + fftthreshold/sqrt((f32)numchannels));
+    for(int n=0;n<numffts;n++)
+    {
+      if(weights[n] != 0.0 && power[n] > limit)
+      {
+        vectorZero_cf32(spectra[n], numchannels);
+        weights[n] = 0.0;
+        numblankedffts++;
+      }
+    }
+    if(numblankedffts > 0 && skthreshold > 0.0)
+    {
+      vectorZero_f32(s1, numchannels);
+      vectorZero_f32(s2, numchannels);
+      for(int n=0;n<numffts;n++)
+      {
+        if(weights[n] != 0.0)
+          vectorKurtosisAccumulate_cf32(spectra[n], s1, s2, numchannels);
+      }
+    }
+    numvalid -= numblankedffts;
   }
 
-  return nonzero;
+  //blank channels whose kurtosis departs from that of noise: positive for intermittent RFI, negative for steady carriers
+  numblankedchannels = 0;
+  if(skthreshold > 0.0 && numvalid >= RFI_MIN_SK_FFTS)
+  {
+    finaliseKurtosis(s1, s2, sk, numchannels, 1, numvalid);
+    limit = skthreshold*2.0/sqrt((f32)numvalid);
+    for(int k=0;k<numchannels;k++)
+    {
+      if(s1[k] > 0.0 && fabs(sk[k]) > limit)
+      {
+        for(int n=0;n<numffts;n++)
+        {
+          if(weights[n] != 0.0)
+          {
+            spectra[n][k].re = 0.0;
+            spectra[n][k].im = 0.0;
+          }
+        }
+        numblankedchannels++;
+      }
+    }
+  }
+
+  if(numblankedchannels > 0)
+  {
+    for(int n=0;n<numffts;n++)
+      weights[n] *= (numchannels - numblankedchannels)/(f32)numchannels;
+  }
+  *blankedchannels = numblankedchannels;
+
+  return numblankedffts;
+}
+
+void Mode::exciseRFI(int numffts)
+{
+  int blankedchannels;
+
+  for(int j=0;j<numrecordedbands;j++)
+  {
+    for(int n=0;n<numffts;n++)
+    {
+      if(dataweight[n] > 0.0 && (perbandweights == 0 || perbandweights[n][j] > 0.0))
+        rfiwindowweights[n] = 1.0;
+      else
+        rfiwindowweights[n] = 0.0;
+    }
+    exciseBandRFI(fftoutputs[j], rfiwindowweights, numffts, recordedbandchannels, rfiskthreshold, rfifftthreshold, rfis1, rfis2, rfisk, rfipower, &blankedchannels);
+    for(int n=0;n<numffts;n++)
+      rfiweights[n][j] = rfiwindowweights[n];
+  }
+
+  for(int n=0;n<numffts;n++)
+  {
+    if(dataweight[n] > 0.0)
+      accumulateAutocorrelations(n);
+  }
+}
+
+void Mode::packBandSpectra(cf32 ** spectra, const f32 * weights, int numffts, int numchannels, Configuration::spectraprecision precision, u8 ** packed, f32 * scales, f32 * invscales, cf32 * power)
+{
+  int numvalid;
+  f32 levels = (precision == Configuration::INT8SPECTRA)?PACKED_INT8_LEVELS_PER_SIGMA:1.0;
+
+  //the power of each channel, as the real part of x*conj(x)
+  vectorZero_cf32(power, numchannels);
+  numvalid = 0;
+  for(int n=0;n<numffts;n++)
+  {
+    if(weights[n] != 0.0)
+    {
+      vectorAddProductConj_cf32(spectra[n], spectra[n], power, numchannels);
+      numvalid++;
+    }
+  }
+
+  //the real and imaginary parts each carry half of the power.  Empty channels pack to zero
+  for(int k=0;k<numchannels;k++)
+  {
+    if(power[k].re > 0.0)
+    {
+      scales[k] = sqrt(power[k].re/(2*numvalid))/levels;
+      invscales[k] = 1.0/scales[k];
+    }
+    else
+    {
+      scales[k] = 0.0;
+      invscales[k] = 0.0;
+    }
+  }
+
+  for(int n=0;n<numffts;n++)
+  {
+    if(precision == Configuration::FLOAT16SPECTRA)
+      vectorPackScaled_cf32cf16(spectra[n], invscales, (cf16*)packed[n], numchannels);
+    else
+      vectorPackScaled_cf32cs8(spectra[n], invscales, (cs8*)packed[n], numchannels);
+  }
+}
+
+void Mode::packSpectra(int numffts)
+{
+  for(int j=0;j<numrecordedbands;j++)
+  {
+    //FFTs that are invalid for this band or were blanked as RFI hold no signal, so must not dilute the scales
+    for(int n=0;n<numffts;n++)
+      packedweights[n] = getDataWeight(j, n);
+    packBandSpectra(fftoutputs[j], packedweights, numffts, recordedbandchannels, packedprecision, packedoutputs[j], packedscales[j], packedinvscales, packedpower);
+  }
+}
+
+void Mode::accumulateAutocorrelations(int subloopindex)
+{
+  int status, count;
+  int indices[10];
+  f32 crossweight;
+
+  for(int i=0;i<numrecordedfreqs;i++)
+  {
+    count = 0;
+    for(int j=0;j<numrecordedbands;j++)
+    {
+      if(config->matchingRecordedBand(configindex, datastreamindex, i, j))
+      {
+        indices[count++] = j;
+
+        //do the autocorrelation (skipping Nyquist channel)
+        status = vectorAddProductConj_cf32(fftoutputs[j][subloopindex], fftoutputs[j][subloopindex], autocorrelations[0][j], recordedbandchannels);
+        if(status != vecNoErr)
+          csevere << startl << "Error in autocorrelation!!!" << status << endl;
+        weights[0][j] += getDataWeight(j, subloopindex);
+      }
+    }
+
+    //as in process(), linear to circular conversion leaves out the cross-polar autocorrelations
+    if(count > 1 && calccrosspolautocorrs && !linear2circular)
+    {
+      status = vectorAddProductConj_cf32(fftoutputs[indices[0]][subloopindex], fftoutputs[indices[1]][subloopindex], autocorrelations[1][indices[0]], recordedbandchannels);
+      if(status != vecNoErr)
+        csevere << startl << "Error in cross-polar autocorrelation!!!" << status << endl;
+      status = vectorAddProductConj_cf32(fftoutputs[indices[1]][subloopindex], fftoutputs[indices[0]][subloopindex], autocorrelations[1][indices[1]], recordedbandchannels);
+      if(status != vecNoErr)
+        csevere << startl << "Error in cross-polar autocorrelation!!!" << status << endl;
+
+      if(perbandweights)
+        crossweight = perbandweights[subloopindex][indices[0]]*perbandweights[subloopindex][indices[1]];
+      else
+        crossweight = dataweight[subloopindex];
+      if(rfiexcision)
+        crossweight *= rfiweights[subloopindex][indices[0]]*rfiweights[subloopindex][indices[1]];
+      weights[1][indices[0]] += crossweight;
+      weights[1][indices[1]] += crossweight;
+    }
+  }
 }
 
 void Mode::zeroAutocorrelations()
@@ -1502,7 +1750,6 @@ void Mode::zeroKurtosis()
     s1 = new f32*[numrecordedbands];
     s2 = new f32*[numrecordedbands];
     sk = new f32*[numrecordedbands];
-    kscratch = vectorAlloc_f32(recordedbandchannels);
     for(int i=0;i<numrecordedbands;i++)
     {
       s1[i] = vectorAlloc_f32(recordedbandchannels);
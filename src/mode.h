@@ -140,6 +140,32 @@ Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int
   */
   bool calculateAndAverageKurtosis(int numblocks, int maxchannels);
 
+ /**
+  * Blanks RFI in the FFTs buffered by the preceding calls to process(), before they are cross-multiplied, using
+  * their spectral kurtosis (exciseBandRFI), then accumulates their autocorrelations, which process() leaves
+  * alone when excision is on.  The data weights returned by getDataWeight are reduced to match
+  * @param numffts The number of buffered FFTs that were processed
+  */
+  void exciseRFI(int numffts);
+
+ /**
+  * @return Whether RFI is excised online (RFI SK THRESHOLD or RFI FFT THRESHOLD set), so exciseRFI must be called
+  */
+  inline bool rfiExcisionOn() const { return rfiexcision; }
+
+ /**
+  * Packs the FFTs buffered by the preceding calls to process() (and any RFI excision) into the reduced precision
+  * copies that Core cross-multiplies, with a scale per channel worked out over the buffered FFTs (packBandSpectra).
+  * Only FFTs with a non-zero weight for the band (getDataWeight, so after any RFI excision) count towards the scales
+  * @param numffts The number of buffered FFTs that were processed
+  */
+  void packSpectra(int numffts);
+
+ /**
+  * @return Whether the spectra are cross-multiplied in reduced precision (SPECTRA PRECISION), so packSpectra must be called
+  */
+  inline bool packedSpectraOn() const { return packedprecision != Configuration::FLOAT32SPECTRA; }
+
  /**
   * Grabs the pointer to an autocorrelation array
   * @param crosspol Whether to return the crosspolarisation autocorrelation for this band
@@ -165,7 +191,7 @@ Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int
   * @param outputband The band index
   * @param subloopindex The index into the number of buffered FFTs that were processed in one batch
   */
-  inline f32 getDataWeight(int outputband, int subloopindex) const { return perbandweights ? perbandweights[subloopindex][outputband] : dataweight[subloopindex]; }
+  inline f32 getDataWeight(int outputband, int subloopindex) const { f32 w = perbandweights ? perbandweights[subloopindex][outputband] : dataweight[subloopindex]; return rfiexcision ? w*rfiweights[subloopindex][outputband] : w; }
 
  /**
   * Gets the expected decorrelation ("van Vleck correction" ) for a given number of bits.
@@ -199,12 +225,20 @@ Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int
   inline cf32* getFreqs(int outputband, int subloopindex) const { return fftoutputs[outputband][subloopindex]; };
 
  /**
-  * Returns a pointer to the FFT'd and conjugated data of the specified product
+  * Returns a pointer into the reduced precision FFT'd data of the specified product, when packedSpectraOn()
   * @param outputband The band to get
   * @param subloopindex The "subloop" index to get the visibilities from
-  * @return Pointer to the conjugate of the FFT'd data (complex 32 bit float)
+  * @param channel The first channel wanted
+  * @return Pointer to the packed data (cf16 or cs8 according to the config's spectra precision)
   */
-  inline const cf32* getConjugatedFreqs(int outputband, int subloopindex) const { return conjfftoutputs[outputband][subloopindex]; }
+  inline const u8* getPackedFreqs(int outputband, int subloopindex, int channel) const { return packedoutputs[outputband][subloopindex] + channel*packedbytes; }
+
+ /**
+  * Returns the per channel scales of the packed data of a band: the packed values times these are the spectra
+  * @param outputband The band to get
+  * @return Pointer to the scales, one per channel
+  */
+  inline const f32* getPackedScales(int outputband) const { return packedscales[outputband]; }
 
  /**
   * Returns the estimated number of bytes used by the Mode
@@ -217,6 +251,111 @@ Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int
   /** Constant for comparing two floats for equality (for freqs and bandwidths etc) */
   static const float TINY;
 
+  /** The number of FFT lengths spanned by the polyphase filterbank window */
+  static const int FILTERBANK_TAPS;
+
+ /**
+  * Fills in a polyphase filterbank prototype window (a Hamming-tapered sinc with its first nulls one channel
+  * away), normalised to the same total power as a single rectangular FFT window
+  * @param window The array to fill, of length taps*length*interleave
+  * @param taps The number of FFT lengths the window spans
+  * @param length The FFT length in samples
+  * @param interleave 1 for real data, 2 to repeat each coefficient for the real and imaginary parts of complex data
+  */
+  static void generateFilterbankWindow(f32 * window, int taps, int length, int interleave);
+
+ /**
+  * Weights taps*length values by the filterbank window and sums the taps into a single block of length values
+  * @param window The filterbank window, as generated by generateFilterbankWindow
+  * @param input The unpacked data
+  * @param windowstart The index into input of the start of the window.  Can be negative, in which case the
+  *                    values before the start of input are treated as zero
+  * @param output The folded block, ready to be FFT'd
+  * @param taps The number of FFT lengths the window spans
+  * @param length The number of values (floats) in one FFT length
+  * @return vecNoErr on success, otherwise the status of the failing vector operation
+  */
+  static int filterbankFold(const f32 * window, const f32 * input, int windowstart, f32 * output, int taps, int length);
+
+  /** The largest phase error (radians) generateRotator may accumulate before resynchronising exactly.  It is fixed at
+      compile time and enforced only through the resync interval, from a worst case error per step; the error is never
+      measured at run time (kernelspeed's rotator test does that offline) */
+  static const double ROTATOR_MAX_PHASE_ERROR;
+
+ /**
+  * Fills a vector with unit phasors exp(2 pi i (startphase + n*phasestep + n*n*phasecurve)), n = 0..length-1, by
+  * complex recurrence in double precision rather than a sin/cos per value.  The recurrence is renormalised every
+  * ROTATOR_RENORM_INTERVAL steps and restarted exactly from sin/cos often enough to stay within maxphaseerror, by a
+  * worst case bound on the error per step rather than any check of the phasors produced
+  * @param rotator The array to fill
+  * @param startphase The phase of the first value (turns)
+  * @param phasestep The linear phase increment per value (turns)
+  * @param phasecurve The quadratic phase coefficient (turns), usually zero
+  * @param length The number of values to generate
+  * @param maxphaseerror The largest tolerable accumulated phase error (radians)
+  */
+  static void generateRotator(cf32 * rotator, double startphase, double phasestep, double phasecurve, int length, double maxphaseerror);
+
+ /**
+  * Turns the spectral kurtosis accumulators into the kurtosis estimate (zero for Gaussian noise), averaged in frequency,
+  * in a single pass
+  * @param s1 The sum over FFTs of the power in each channel
+  * @param s2 The sum over FFTs of the squared power in each channel
+  * @param sk The kurtosis of each averaged channel
+  * @param numchannels The number of averaged channels
+  * @param kchanavg The number of channels averaged into each one
+  * @param numblocks The number of FFTs accumulated
+  */
+  static void finaliseKurtosis(const f32 * s1, const f32 * s2, f32 * sk, int numchannels, int kchanavg, int numblocks);
+
+ /**
+  * Blanks the RFI in a window of spectra from one band.  FFTs whose power, summed over channels after scaling
+  * each channel by its mean over the window and clipping, exceeds the window median by more than fftthreshold
+  * times its expected standard deviation (median/sqrt(numchannels)) are zeroed, then
+  * channels whose spectral kurtosis over the remaining FFTs is more than skthreshold standard deviations
+  * (2/sqrt(FFTs)) from zero are zeroed in every FFT.  The power test needs at least RFI_MIN_POWER_FFTS FFTs holding
+  * data and the kurtosis test at least RFI_MIN_SK_FFTS, and
+  * since the kurtosis of a steady carrier is -1, carriers are only caught with more than 4*skthreshold^2 of them
+  * @param spectra The spectra of each FFT, numchannels long
+  * @param weights On entry non-zero for each FFT holding data; on exit multiplied by the fraction kept
+  * @param numffts The number of FFTs in the window
+  * @param numchannels The number of channels in each spectrum
+  * @param skthreshold The kurtosis threshold in standard deviations, 0 for no channel blanking
+  * @param fftthreshold The power threshold in standard deviations, 0 for no FFT blanking
+  * @param s1 Scratch space, numchannels long
+  * @param s2 Scratch space, numchannels long
+  * @param sk Scratch space, numchannels long
+  * @param power Scratch space, 2*numffts long
+  * @param blankedchannels Set to the number of channels blanked
+  * @return The number of FFTs blanked
+  */
+  static int exciseBandRFI(cf32 ** spectra, f32 * weights, int numffts, int numchannels, f32 skthreshold, f32 fftthreshold, f32 * s1, f32 * s2, f32 * sk, f32 * power, int * blankedchannels);
+
+  /** The fewest FFTs in a window for which exciseBandRFI will use the spectral kurtosis */
+  static const int RFI_MIN_SK_FFTS;
+
+  /** The fewest FFTs in a window for which exciseBandRFI will compare the power of each FFT to the median */
+  static const int RFI_MIN_POWER_FFTS;
+
+ /**
+  * Packs the spectra of one band to reduced precision.  Each channel is scaled by the standard deviation of its
+  * real and imaginary parts over the FFTs holding data: for FLOAT16SPECTRA to keep the values far inside the half
+  * precision range, and for INT8SPECTRA so that the standard deviation spans PACKED_INT8_LEVELS_PER_SIGMA steps
+  * @param spectra The spectra of each FFT, numchannels long
+  * @param weights Non-zero for each FFT holding data
+  * @param numffts The number of FFTs
+  * @param numchannels The number of channels in each spectrum
+  * @param precision FLOAT16SPECTRA or INT8SPECTRA
+  * @param packed Set to the packed spectra (cf16 or cs8), numchannels long for each FFT
+  * @param scales Set to the scale of each channel
+  * @param invscales Scratch space, numchannels long
+  * @param power Scratch space, numchannels long
+  */
+  static void packBandSpectra(cf32 ** spectra, const f32 * weights, int numffts, int numchannels, Configuration::spectraprecision precision, u8 ** packed, f32 * scales, f32 * invscales, cf32 * power);
+
+  /** The quantisation steps per standard deviation of INT8SPECTRA values: beyond 127/this (5.3 sigma) they clip */
+  static const f32 PACKED_INT8_LEVELS_PER_SIGMA;
+
   /**
    * Returns a single pcal result.
    * @param outputband The band to get
@@ -242,6 +381,25 @@ protected:
   *         ie a weight in the range 0.0 to 1.0
   */
   virtual float unpack(int sampleoffset, int subloopindex);
+
+ /** 
+  * Produces the fringe rotated complex samples of one real sampled band, ready for the FFT.  The
+  * default multiplies the samples left in unpackedarrays by the rotator in a single pass; modes which
+  * set fuseddecode instead decode straight from the packed data, and unpack() only weights the data
+  * @param band The index of the recorded band
+  * @param sampleoffset The offset in number of time samples from unpackstartsamples
+  * @param rotator The fringe rotation phasors, fftchannels long
+  * @param dest The array to fill with fftchannels rotated complex samples
+  * @return vecNoErr on success
+  */
+  virtual vecStatus unpackRotated(int band, int sampleoffset, const cf32 * rotator, cf32 * dest);
+
+ /**
+  * Accumulates the autocorrelations (and cross-polarisation autocorrelations) and their weights for one
+  * buffered FFT.  Used in place of the accumulation in process() when RFI excision is on
+  * @param subloopindex The "subloop" index of the FFT
+  */
+  void accumulateAutocorrelations(int subloopindex);
   
   Configuration * config;
   int configindex, datastreamindex, recordedbandchannels, channelstoaverage, blockspersend, guardsamples, fftchannels, numrecordedfreqs, numrecordedbands, numzoombands, numbits, bytesperblocknumerator, bytesperblockdenominator, currentscan, offsetseconds, offsetns, order, flag, fftbuffersize, unpacksamples, unpackstartsamples, datasamples, avgdelsamples;
@@ -254,7 +412,7 @@ protected:
   f32 ** perbandweights;
   int samplesperblock, samplesperlookup, numlookups, flaglength, autocorrwidth;
   int datascan, datasec, datans, datalengthbytes, usecomplex, usedouble;
-  bool filterbank, calccrosspolautocorrs, fractionalLoFreq, initok, isfft, linear2circular;
+  bool filterbank, calccrosspolautocorrs, fractionalLoFreq, initok, isfft, linear2circular, fuseddecode;
   double * recordedfreqclockoffsets;
   double * recordedfreqclockoffsetsdelta;
   double * recordedfreqphaseoffset;
@@ -266,7 +424,6 @@ protected:
   f32 **  unpackedarrays;
   cf32 **  unpackedcomplexarrays;
   cf32*** fftoutputs;
-  cf32*** conjfftoutputs;
   f32 **  weights;
   s32 *   validflags;
   cf32*** autocorrelations;
@@ -290,60 +447,48 @@ protected:
   cf32 ** pcalresults;
   PCal ** extractor;
   
-  f64 * subtoff;
-  f64 * subtval;
-  f64 * subxoff;
-  f64 * subxval;
-  f64 * subphase;
-  f32 * subarg;
-  f32 * subsin;
-  f32 * subcos;
-
-  f64 * steptoff;
-  f64 * steptval;
-  f64 * stepxoff;
-  f64 * stepxval;
-  f64 * stepphase;
-  f32 * steparg;
-  f32 * stepsin;
-  f32 * stepcos;
+  //phasors at the start of each stride, for fringe rotation and fractional sample correction
   cf32 * stepcplx;
-
-  f32 * subchannelfreqs;
-  f32 * ldsbsubchannelfreqs;
-  f32 * subfracsamparg;
-  f32 * subfracsampsin;
-  f32 * subfracsampcos;
-
   f32 * stepchannelfreqs;
   f32 * lsbstepchannelfreqs;
   f32 * dsbstepchannelfreqs;
   f32 * ldsbstepchannelfreqs;
-  f32 * stepfracsamparg;
-  f32 * stepfracsampsin;
-  f32 * stepfracsampcos;
   cf32 * stepfracsampcplx;
 
   //extras necessary for quadratic (order == 2)
   cf32 * piecewiserotator;
   cf32 * quadpiecerotator;
 
-  f64 * subquadxval;
-  f64 * subquadphase;
-  f32 * subquadarg;
-  f32 * subquadsin;
-  f32 * subquadcos;
-
-  f64 * stepxoffsquared;
-  f64 * tempstepxval;
+  //polyphase filterbank variables
+  int filterbanktaps, filterbankleadsamples;
+  f32 * filterbankwindow; //[filterbanktaps*fftchannels] (x2 for complex)
+  f32 * filterbankfolded; //[fftchannels] (x2 for complex)
 
   //kurtosis-specific variables
   bool dumpkurtosis;
-  f32 *  kscratch; //[recordedbandchannels]
   f32 ** s1; //[numrecordedbands][recordedbandchannels]
   f32 ** s2; //[numrecordedbands][recordedbandchannels]
   f32 ** sk; //[numrecordedbands][recordedbandchannels]
 
+  //online RFI excision variables
+  bool rfiexcision;
+  f32 rfiskthreshold, rfifftthreshold;
+  f32 ** rfiweights;      //[numbufferedffts][numrecordedbands], fraction of each FFT kept
+  f32 * rfiwindowweights; //[numbufferedffts]
+  f32 * rfis1;            //[recordedbandchannels]
+  f32 * rfis2;            //[recordedbandchannels]
+  f32 * rfisk;            //[recordedbandchannels]
+  f32 * rfipower;         //[2*numbufferedffts]
+
+  //reduced precision spectra for the cross-multiplication
+  Configuration::spectraprecision packedprecision;
+  int packedbytes;        //per complex value
+  u8 *** packedoutputs;   //[numrecordedbands+numzoombands][numbufferedffts], zoom bands point into their parents
+  f32 ** packedscales;    //[numrecordedbands+numzoombands][recordedbandchannels]
+  f32 * packedinvscales;  //[recordedbandchannels]
+  cf32 * packedpower;     //[recordedbandchannels]
+  f32 * packedweights;    //[numbufferedffts], the weight of each FFT in the band being packed
+
   // Linear to circular conversion
 
   cf32 *phasecorrA, *phasecorrconjA, *phasecorrB, *phasecorrconjB; // 90 degrees + phase correction
@@ -352,6 +497,10 @@ protected:
 private:
   ///Array containing decorrelation percentages for a given number of bits
   static const float decorrelationpercentage[];
+
+  /// The number of interleaved recurrences used by generateRotator, and how often (in steps) they are renormalised
+  static const int ROTATOR_LANES = 8;
+  static const int ROTATOR_RENORM_INTERVAL;
 };
 
 /** 
@@ -37,6 +37,7 @@
 #include "configuration.h"
 #include "fxmanager.h"
 #include "core.h"
+#include "aggregator.h"
 #include "datastream.h"
 #include "mk5.h"
 #include "nativemk5.h"
@@ -258,15 +259,18 @@ static void generateIdentifier(const char *inputfile, char *identifier)
 int main(int argc, char *argv[])
 {
   MPI_Comm world, return_comm;
-  int numprocs, myID, numdatastreams, numcores, perr, perc, prv = -1;
+  int numprocs, myID, numdatastreams, numcores, numaggregators, perr, perc, prv = -1;
+  int coresperaggregator = 0;
   void *prvp = &prv;
   double t1, t2;
   Configuration * config;
   FxManager * manager = 0;
   Core * core = 0;
+  Aggregator * aggregator = 0;
   DataStream * stream = 0;
   int * coreids;
   int * datastreamids;
+  int * aggregatorids;
   bool monitor = false;
   bool nocommandthread = false;
   string monitoropt;
@@ -292,9 +296,9 @@ int main(int argc, char *argv[])
   MPI_Comm_dup(world, &return_comm);
   MPI_Get_processor_name(processor_name, &namelen);
 
-  if(argc < 2 || argc > 5)
+  if(argc < 2 || argc > 6)
   {
-    cerr << "Error: invoke with mpifxcorr <inputfilename> [-M<monhostname>:port[:monitor_skip]] [-rNewStartSec] [--nocommandthread]" << endl;
+    cerr << "Error: invoke with mpifxcorr <inputfilename> [-M<monhostname>:port[:monitor_skip]] [-rNewStartSec] [-aCoresPerAggregator] [--nocommandthread]" << endl;
     MPI_Barrier(world);
     MPI_Finalize();
     return EXIT_FAILURE;
@@ -339,13 +343,17 @@ int main(int argc, char *argv[])
     {
       restartseconds = atof(argv[i] + 2);
     }
+    else if(argv[i][0]=='-' && argv[i][1]=='a')
+    {
+      coresperaggregator = atoi(argv[i] + 2);
+    }
     else if(strcmp(argv[i], "--nocommandthread") == 0)
     {
       nocommandthread = true;
     }
     else
     {
-      cfatal << startl << "Invoke with mpifxcorr <inputfilename> [-M<monhostname>:port[:monitor_skip]] [-rNewStartSec] [--nocommandthread]" << endl;
+      cfatal << startl << "Invoke with mpifxcorr <inputfilename> [-M<monhostname>:port[:monitor_skip]] [-rNewStartSec] [-aCoresPerAggregator] [--nocommandthread]" << endl;
       MPI_Barrier(world);
       MPI_Finalize();
       return EXIT_FAILURE;
@@ -389,6 +397,16 @@ int main(int argc, char *argv[])
   }
   numdatastreams = config->getNumDataStreams();
   numcores = numprocs - (fxcorr::FIRSTTELESCOPEID + numdatastreams);
+  //with -a, one of every coresperaggregator+1 of the remaining processes (the last ones) combines the results of a
+  //group of cores before they go to the manager, so the manager only receives and adds one result per group
+  numaggregators = 0;
+  if(coresperaggregator > 0)
+  {
+    numaggregators = (numcores + coresperaggregator)/(coresperaggregator + 1);
+    if(2*numaggregators > numcores) //never leave an aggregator without a core
+      numaggregators = numcores/2;
+    numcores -= numaggregators;
+  }
   if(numcores < 1)
   {
     cfatal << startl << "Must be invoked with at least " << fxcorr::FIRSTTELESCOPEID + numdatastreams + 1 << " processors (was invoked with " << numprocs << " processors) - aborting!" << endl;
@@ -406,6 +424,10 @@ int main(int argc, char *argv[])
   for(int i=0;i<numdatastreams;i++)
     datastreamids[i] = fxcorr::FIRSTTELESCOPEID + i;
 
+  aggregatorids = new int[numaggregators];
+  for(int i=0;i<numaggregators;i++)
+    aggregatorids[i] = fxcorr::FIRSTTELESCOPEID + numdatastreams + numcores + i;
+
   //wait until everyone has caught up
   MPI_Barrier(world);
   /* 2-Nov-2016 CJP: MPI::Exception is not defined in openmpi on my Mac - C++ bindings may have been removed
@@ -418,7 +440,7 @@ int main(int argc, char *argv[])
     //work out what process we are and run accordingly
     if(myID == fxcorr::MANAGERID) //im the manager
     {
-      manager = new FxManager(config, numcores, datastreamids, coreids, myID, return_comm, monitor, monhostname, port, monitor_skip);
+      manager = new FxManager(config, numcores, datastreamids, coreids, numaggregators, aggregatorids, myID, return_comm, monitor, monhostname, port, monitor_skip);
       MPI_Barrier(world);
       t1 = MPI_Wtime();
       cinfo << startl << "Estimated memory usage by FXManager: " << manager->getEstimatedBytes()/1048576.0 << " MB" << endl;
@@ -469,9 +491,25 @@ int main(int argc, char *argv[])
       cinfo << startl << "Estimated memory usage by Datastream: " << stream->getEstimatedBytes()/1048576.0 << " MB" << endl;
       stream->execute();
     }
+    else if (myID >= fxcorr::FIRSTTELESCOPEID + numdatastreams + numcores) //im an aggregator
+    {
+      int aggregatornum = myID - (fxcorr::FIRSTTELESCOPEID + numdatastreams + numcores);
+      int firstcore = 0;
+      while(Aggregator::getAggregatorIndex(firstcore, numcores, numaggregators) < aggregatornum)
+        firstcore++;
+      int groupcores = 0;
+      while(firstcore + groupcores < numcores && Aggregator::getAggregatorIndex(firstcore + groupcores, numcores, numaggregators) == aggregatornum)
+        groupcores++;
+      aggregator = new Aggregator(myID, groupcores, &(coreids[firstcore]), config->getMaxCoreResultLength(), config->getVisBufferLength(), return_comm);
+      MPI_Barrier(world);
+      cinfo << startl << "Estimated memory usage by Aggregator: " << aggregator->getEstimatedBytes()/1048576.0 << " MB" << endl;
+      aggregator->execute();
+    }
     else //im a processing core
     {
-      core = new Core(myID, config, datastreamids, return_comm);
+      int coreindex = myID - (fxcorr::FIRSTTELESCOPEID + numdatastreams);
+      int aggregatorid = (numaggregators > 0)?aggregatorids[Aggregator::getAggregatorIndex(coreindex, numcores, numaggregators)]:-1;
+      core = new Core(myID, config, datastreamids, aggregatorid, return_comm);
       MPI_Barrier(world);
       cinfo << startl << "Estimated memory usage by Core: " << core->getEstimatedBytes()/1048576.0 << " MB" << endl;
       core->execute();
@@ -502,10 +540,12 @@ int main(int argc, char *argv[])
 
   delete [] coreids;
   delete [] datastreamids;
+  delete [] aggregatorids;
 
   if(manager) delete manager;
   if(stream) delete stream;
   if(core) delete core;
+  if(aggregator) delete aggregator;
 
   //delete config;  	// FIXME!!! Revisit this commented out destructor sometime.
   			// It is currently commented out to prevent hang on exit
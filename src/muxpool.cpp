@@ -0,0 +1,385 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#include <stdlib.h>
+#include "muxpool.h"
+#include "alert.h"
+
+MuxPool * MuxPool::sharedpool = 0;
+int MuxPool::sharedusers = 0;
+pthread_mutex_t MuxPool::sharedlock = PTHREAD_MUTEX_INITIALIZER;
+
+MuxPool::MuxPool(int nthreads)
+  : numthreads(nthreads)
+{
+  int perr;
+  pthread_attr_t attr;
+
+  if(numthreads < 1)
+    numthreads = 1;
+  if(numthreads > MAX_THREADS)
+    numthreads = MAX_THREADS;
+  numparallelmuxes = 0;
+  numserialmuxes = 0;
+  currentfunction = 0;
+  currentarg = 0;
+  currentparts = 0;
+  nextpart = 0;
+  partsdone = 0;
+  generation = 0;
+  keepworking = true;
+  muxconfig = 0;
+  muxparts = new muxpart[numthreads];
+
+  pthread_mutex_init(&calllock, NULL);
+  pthread_mutex_init(&poollock, NULL);
+  pthread_cond_init(&startcond, NULL);
+  pthread_cond_init(&donecond, NULL);
+  //the calling thread does its share, so one fewer worker is needed
+  workerthreads = new pthread_t[numthreads];
+  workerinfos = new workerinfo[numthreads];
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for(int i=1;i<numthreads;i++)
+  {
+    workerinfos[i].pool = this;
+    workerinfos[i].index = i;
+    perr = pthread_create(&(workerthreads[i]), &attr, MuxPool::launchWorker, (void *)(&(workerinfos[i])));
+    if(perr != 0)
+    {
+      csevere << startl << "Error in launching multiplexing thread " << i << "!!!" << endl;
+      numthreads = i;
+      break;
+    }
+  }
+  pthread_attr_destroy(&attr);
+}
+
+MuxPool::~MuxPool()
+{
+  pthread_mutex_lock(&poollock);
+  keepworking = false;
+  pthread_cond_broadcast(&startcond);
+  pthread_mutex_unlock(&poollock);
+  for(int i=1;i<numthreads;i++)
+    pthread_join(workerthreads[i], NULL);
+  pthread_cond_destroy(&donecond);
+  pthread_cond_destroy(&startcond);
+  pthread_mutex_destroy(&poollock);
+  pthread_mutex_destroy(&calllock);
+  delete [] workerinfos;
+  delete [] workerthreads;
+  delete [] muxparts;
+}
+
+int MuxPool::getEnvThreads()
+{
+  const char * threadsenv = getenv("DIFX_MUX_THREADS");
+  int nthreads;
+
+  if(threadsenv == 0)
+    return 1;
+  nthreads = atoi(threadsenv);
+  if(nthreads < 1)
+    return 1;
+
+  return (nthreads > MAX_THREADS)?MAX_THREADS:nthreads;
+}
+
+MuxPool * MuxPool::acquireShared()
+{
+  MuxPool * pool;
+
+  if(getEnvThreads() <= 1)
+    return 0;
+
+  pthread_mutex_lock(&sharedlock);
+  if(sharedpool == 0)
+    sharedpool = new MuxPool(getEnvThreads());
+  sharedusers++;
+  pool = sharedpool;
+  pthread_mutex_unlock(&sharedlock);
+
+  return pool;
+}
+
+void MuxPool::releaseShared(MuxPool * pool)
+{
+  if(pool == 0)
+    return;
+
+  pthread_mutex_lock(&sharedlock);
+  if(pool != sharedpool)
+    csevere << startl << "MuxPool::releaseShared was given a pool that is not the shared one - ignoring!" << endl;
+  else if(--sharedusers == 0)
+  {
+    delete sharedpool;
+    sharedpool = 0;
+  }
+  pthread_mutex_unlock(&sharedlock);
+}
+
+void MuxPool::run(partfunction function, void * arg, int numparts)
+{
+  pthread_mutex_lock(&calllock);
+  runParts(function, arg, numparts);
+  pthread_mutex_unlock(&calllock);
+}
+
+void MuxPool::runParts(partfunction function, void * arg, int numparts)
+{
+  if(numparts <= 0)
+    return;
+
+  if(numthreads == 1 || numparts == 1) {
+    for(int i=0;i<numparts;i++)
+      function(arg, i, numparts);
+    return;
+  }
+
+  pthread_mutex_lock(&poollock);
+  currentfunction = function;
+  currentarg = arg;
+  currentparts = numparts;
+  nextpart = 0;
+  partsdone = 0;
+  generation++;
+  pthread_cond_broadcast(&startcond);
+  pthread_mutex_unlock(&poollock);
+
+  workparts();
+
+  //the last parts may still be running on workers
+  pthread_mutex_lock(&poollock);
+  while(partsdone < currentparts)
+    pthread_cond_wait(&donecond, &poollock);
+  pthread_mutex_unlock(&poollock);
+}
+
+void * MuxPool::launchWorker(void * arg)
+{
+  workerinfo * info = (workerinfo *)arg;
+
+  info->pool->loopwork();
+
+  return 0;
+}
+
+void MuxPool::loopwork()
+{
+  int lastgeneration;
+
+  pthread_mutex_lock(&poollock);
+  lastgeneration = generation;
+  while(true) {
+    while(keepworking && generation == lastgeneration)
+      pthread_cond_wait(&startcond, &poollock);
+    if(!keepworking)
+      break;
+    lastgeneration = generation;
+    pthread_mutex_unlock(&poollock);
+    workparts();
+    pthread_mutex_lock(&poollock);
+  }
+  pthread_mutex_unlock(&poollock);
+}
+
+void MuxPool::workparts()
+{
+  partfunction function;
+  void * arg;
+  int part, numparts;
+
+  while(true) {
+    pthread_mutex_lock(&poollock);
+    if(nextpart >= currentparts) {
+      pthread_mutex_unlock(&poollock);
+      return;
+    }
+    part = nextpart++;
+    numparts = currentparts;
+    function = currentfunction;
+    arg = currentarg;
+    pthread_mutex_unlock(&poollock);
+
+    function(arg, part, numparts);
+
+    pthread_mutex_lock(&poollock);
+    partsdone++;
+    if(partsdone == currentparts)
+      pthread_cond_broadcast(&donecond);
+    pthread_mutex_unlock(&poollock);
+  }
+}
+
+void MuxPool::vdifmuxPart(void * arg, int part, int numparts)
+{
+  MuxPool * pool = (MuxPool *)arg;
+  muxpart * p = &(pool->muxparts[part]);
+
+  p->returnvalue = ::vdifmux(p->dest, p->destSize, p->src, p->srcSize, pool->muxconfig, p->startOutputFrameNumber, &(p->stats));
+}
+
+int MuxPool::findCut(const unsigned char * src, int numframes, const struct vdif_mux * vm, int estimate, int64_t cutframe)
+{
+  int window, first, last, cut;
+  const vdif_header * header;
+  int64_t framenumber;
+
+  //vdifmux copes with frames up to nSort frame times out of place, so no frame that close to the cut may straddle it
+  window = vm->nSort*vm->nThread;
+  first = estimate - 2*window;
+  if(first < 0)
+    first = 0;
+  last = estimate + window;
+  if(last + window >= numframes)
+    return -1; //not enough data after the cut to be sure of it
+
+  cut = -1;
+  for(int i=first;i<numframes;i++) {
+    header = (const vdif_header *)(src + (long long)i*vm->inputFrameSize);
+    if(getVDIFFrameBytes(header) != vm->inputFrameSize)
+      return -1; //interloper or lost sync; vdifmux will have to sort it out
+    framenumber = (int64_t)getVDIFFrameEpochSecOffset(header)*vm->inputFramesPerSecond + getVDIFFrameNumber(header);
+    if(cut < 0) {
+      if(framenumber >= cutframe)
+        cut = i;
+      else if(i >= last)
+        return -1;
+    }
+    else if(i >= cut + window)
+      break;
+    else if(framenumber < cutframe)
+      return -1;
+  }
+  //the frames just before the cut must have been looked at too
+  if(cut < 0 || (cut - window < first && first > 0))
+    return -1;
+
+  return cut;
+}
+
+int MuxPool::vdifmux(unsigned char * dest, int destSize, const unsigned char * src, int srcSize, const struct vdif_mux * vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics * stats)
+{
+  int granule, numgranules, numsrcframes, numparts, lastpart;
+  int outputstart[MAX_THREADS+1], srccut[MAX_THREADS+1];
+  bool ok;
+
+  pthread_mutex_lock(&calllock);
+  granule = (vm->frameGranularity > 1)?vm->frameGranularity:1;
+  numgranules = destSize/vm->outputFrameSize/granule;
+  numsrcframes = srcSize/vm->inputFrameSize;
+  numparts = numthreads;
+  lastpart = numparts - 1;
+
+  //output frames only map one to one onto input frame times without fanout, and the start must be known for that
+  ok = (numparts > 1 && startOutputFrameNumber >= 0 && vm->fanoutFactor <= 1 && (numgranules/numparts)*granule > vm->nSort);
+  outputstart[0] = 0;
+  srccut[0] = 0;
+  for(int i=1;i<numparts && ok;i++) {
+    int boundary = (numgranules*i/numparts)*granule;
+
+    //disorder may leave no clean cut at one output frame but one at a neighbour, so look around a little
+    ok = false;
+    for(int step=0;step*granule<=vm->nSort && !ok;step++) {
+      outputstart[i] = boundary + ((step%2 == 0)?1:-1)*((step+1)/2)*granule;
+      if(outputstart[i] <= outputstart[i-1])
+        continue;
+      srccut[i] = findCut(src, numsrcframes, vm, outputstart[i]*vm->nThread, startOutputFrameNumber + outputstart[i]);
+      ok = (srccut[i] > srccut[i-1]);
+    }
+  }
+
+  if(ok) {
+    muxconfig = vm;
+    for(int i=0;i<numparts;i++) {
+      muxpart * p = &(muxparts[i]);
+
+      p->dest = dest + (long long)outputstart[i]*vm->outputFrameSize;
+      p->src = src + (long long)srccut[i]*vm->inputFrameSize;
+      if(i < lastpart) {
+        p->destSize = (outputstart[i+1] - outputstart[i])*vm->outputFrameSize;
+        //one frame past the cut, so each part sees its range of output frames end as a single call would
+        p->srcSize = (srccut[i+1] - srccut[i] + 1)*vm->inputFrameSize;
+      }
+      else {
+        p->destSize = destSize - outputstart[i]*vm->outputFrameSize;
+        p->srcSize = srcSize - srccut[i]*vm->inputFrameSize;
+      }
+      p->startOutputFrameNumber = startOutputFrameNumber + outputstart[i];
+      resetvdifmuxstatistics(&(p->stats));
+    }
+
+    runParts(MuxPool::vdifmuxPart, this, numparts);
+
+    //every part but the last must have filled its output frames from all of its source frames
+    for(int i=0;i<numparts && ok;i++) {
+      const muxpart * p = &(muxparts[i]);
+
+      ok = (p->returnvalue > 0 && p->stats.startFrameNumber == p->startOutputFrameNumber);
+      if(ok && i < lastpart)
+        ok = (p->stats.destUsed == p->destSize && p->stats.srcUsed >= p->srcSize - vm->inputFrameSize);
+    }
+  }
+
+  if(!ok) {
+    numserialmuxes++;
+    pthread_mutex_unlock(&calllock);
+    return ::vdifmux(dest, destSize, src, srcSize, vm, startOutputFrameNumber, stats);
+  }
+  numparallelmuxes++;
+
+  for(int i=0;i<numparts;i++) {
+    const struct vdif_mux_statistics * s = &(muxparts[i].stats);
+
+    stats->nValidFrame += s->nValidFrame;
+    stats->nInvalidFrame += s->nInvalidFrame;
+    stats->nDiscardedFrame += s->nDiscardedFrame;
+    stats->nWrongThread += s->nWrongThread;
+    stats->nSkippedByte += s->nSkippedByte;
+    stats->nFillByte += s->nFillByte;
+    stats->nDuplicateFrame += s->nDuplicateFrame;
+    stats->bytesProcessed += s->bytesProcessed;
+    stats->nGoodFrame += s->nGoodFrame;
+    stats->nPartialFrame += s->nPartialFrame;
+    stats->nFillerFrame += s->nFillerFrame;
+  }
+  stats->nCall++;
+  stats->srcSize = srcSize;
+  stats->srcUsed = srccut[lastpart]*vm->inputFrameSize + muxparts[lastpart].stats.srcUsed;
+  stats->destSize = destSize;
+  stats->destUsed = outputstart[lastpart]*vm->outputFrameSize + muxparts[lastpart].stats.destUsed;
+  stats->inputFrameSize = muxparts[0].stats.inputFrameSize;
+  stats->outputFrameSize = muxparts[0].stats.outputFrameSize;
+  stats->outputFrameGranularity = muxparts[0].stats.outputFrameGranularity;
+  stats->outputFramesPerSecond = muxparts[0].stats.outputFramesPerSecond;
+  stats->nOutputFrame = outputstart[lastpart] + muxparts[lastpart].stats.nOutputFrame;
+  stats->epoch = muxparts[0].stats.epoch;
+  stats->startFrameNumber = startOutputFrameNumber;
+  pthread_mutex_unlock(&calllock);
+
+  return stats->destUsed;
+}
@@ -0,0 +1,161 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef MUXPOOL_H
+#define MUXPOOL_H
+
+#include <pthread.h>
+#include <vdifio.h>
+
+/**
+@class MuxPool
+@brief A small pool of threads which share the multiplexing of one segment of multi-thread VDIF
+
+The work of a call is split into parts covering contiguous ranges of output time, which the calling
+thread and the pool's worker threads take in turn until all are done; run() only returns once every
+part is finished, so the caller keeps sole use of its buffers outside the call.  Used by VDIFMuxer for
+its corner turns and by VDIFDataStream, through vdifmux(), for libvdifio's multiplexer.  The number of
+threads comes from DIFX_MUX_THREADS (see getEnvThreads).
+
+One pool is shared by everything in the process that multiplexes (see acquireShared), so
+DIFX_MUX_THREADS bounds the threads used however many muxers there are.  Calls from different threads
+take turns: a call holds the pool from start to finish.
+
+Running parts of one vdifmux() on several threads relies on libvdifio's vdifmux being reentrant: it
+keeps no static state, reads only its source and vdif_mux configuration (shared, read only) and writes
+only its own destination range and statistics structure, which are distinct for each part.
+
+@author The DiFX developers
+*/
+class MuxPool{
+public:
+  typedef void (*partfunction)(void * arg, int part, int numparts);
+
+ /**
+  * Constructor: starts the worker threads
+  * @param nthreads The total number of threads doing the work, including the calling thread
+  */
+  MuxPool(int nthreads);
+
+  ~MuxPool();
+
+ /**
+  * Returns the process-wide pool, starting it with getEnvThreads() threads on first use
+  * @return The shared pool, or 0 (no pool wanted) if DIFX_MUX_THREADS asks for just one thread
+  */
+  static MuxPool * acquireShared();
+
+ /**
+  * Gives back the pool returned by acquireShared; it is stopped once every user has given it back
+  * @param pool The pool returned by acquireShared (may be 0)
+  */
+  static void releaseShared(MuxPool * pool);
+
+ /**
+  * Calls function(arg, part, numparts) once for each part from 0 to numparts-1, spread over the pool, and waits for all of them
+  * @param function The function doing one part of the work
+  * @param arg Passed on to function
+  * @param numparts The number of parts the work is split into
+  */
+  void run(partfunction function, void * arg, int numparts);
+
+ /**
+  * A drop-in replacement for libvdifio's vdifmux that muxes disjoint ranges of output frames in parallel.  The source is
+  * cut between frames where all earlier frames belong to earlier output frames and all later ones to later output
+  * frames, found from the frame headers at or within nSort output frames of each boundary; if no such cuts can be found
+  * (unknown start frame, interloper data, disorder beyond nSort frames, too little data) or any part does not fill its
+  * range of output frames and use all of its source, the whole
+  * segment is muxed again by a single call to vdifmux, so the output is always as a single call would leave it.
+  * @param dest, destSize, src, srcSize, vm, startOutputFrameNumber, stats As for vdifmux
+  * @return As for vdifmux
+  */
+  int vdifmux(unsigned char * dest, int destSize, const unsigned char * src, int srcSize, const struct vdif_mux * vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics * stats);
+
+ /**
+  * Accessor methods for the number of threads and counts of vdifmux() calls
+  */
+  inline int getNumThreads() const { return numthreads; }
+  inline long long getNumParallelMuxes() const { return numparallelmuxes; }
+  inline long long getNumSerialMuxes() const { return numserialmuxes; }
+
+ /**
+  * Reads the number of threads to multiplex with from DIFX_MUX_THREADS
+  * @return The number of threads, 1 (no pool wanted) if unset or not a number greater than 1
+  */
+  static int getEnvThreads();
+
+  ///constants
+  static const int MAX_THREADS = 64;
+
+private:
+  typedef struct {
+    MuxPool * pool;
+    int index;
+  } workerinfo;
+
+  static void * launchWorker(void * arg);
+  void runParts(partfunction function, void * arg, int numparts);
+  void loopwork();
+  void workparts();
+  static void vdifmuxPart(void * arg, int part, int numparts);
+  int findCut(const unsigned char * src, int numframes, const struct vdif_mux * vm, int estimate, int64_t cutframe);
+
+  int numthreads;
+  long long numparallelmuxes, numserialmuxes;
+
+  ///held through each run() or vdifmux() call, so callers on different threads take turns
+  pthread_mutex_t calllock;
+
+  ///the pool shared by the process, guarded by sharedlock
+  static MuxPool * sharedpool;
+  static int sharedusers;
+  static pthread_mutex_t sharedlock;
+  pthread_t * workerthreads;
+  workerinfo * workerinfos;
+
+  ///the work in hand, guarded by poollock
+  pthread_mutex_t poollock;
+  pthread_cond_t startcond, donecond;
+  partfunction currentfunction;
+  void * currentarg;
+  int currentparts, nextpart, partsdone, generation;
+  bool keepworking;
+
+  ///the parts of a vdifmux() call
+  typedef struct {
+    unsigned char * dest;
+    const unsigned char * src;
+    int destSize, srcSize, returnvalue;
+    int64_t startOutputFrameNumber;
+    struct vdif_mux_statistics stats;
+  } muxpart;
+
+  const struct vdif_mux * muxconfig;
+  muxpart * muxparts; // [numthreads]
+};
+
+#endif
+// vim: shiftwidth=2:softtabstop=2:expandtab
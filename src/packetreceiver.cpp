@@ -0,0 +1,180 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	// for recvmmsg
+#endif
+#include <cstring>
+#include <cstdlib>
+#include <errno.h>
+#include "packetreceiver.h"
+#include "alert.h"
+
+PacketReceiver::PacketReceiver(int packetsize, int stripbytes, int batchsize) :
+	packetsize(packetsize), stripbytes(stripbytes), batchsize(batchsize)
+{
+	if(packetsize > MaxPacketSize || stripbytes < 0 || stripbytes >= packetsize)
+	{
+		cfatal << startl << "PacketReceiver: cannot receive packets of size " << packetsize << " stripping " << stripbytes << " bytes; MaxPacketSize=" << MaxPacketSize << endl;
+	}
+	if(this->batchsize < 1)
+	{
+		this->batchsize = 1;
+	}
+	payloadsize = packetsize - stripbytes;
+	npackets = nrejected = ncalls = 0;
+
+	// every packet's stripped bytes get their own place, so they can be inspected after the batch if ever needed
+	stripbuffer = new char[this->batchsize*(stripbytes > 0 ? stripbytes : 1)];
+	workbuffer = new char[MaxPacketSize];
+	iovecs = new struct iovec[2*this->batchsize];
+#ifdef __linux__
+	msgs = new struct mmsghdr[this->batchsize];
+	memset(msgs, 0, this->batchsize*sizeof(struct mmsghdr));
+	for(int i = 0; i < this->batchsize; ++i)
+	{
+		if(stripbytes > 0)
+		{
+			iovecs[2*i].iov_base = stripbuffer + i*stripbytes;
+			iovecs[2*i].iov_len = stripbytes;
+			msgs[i].msg_hdr.msg_iov = iovecs + 2*i;
+			msgs[i].msg_hdr.msg_iovlen = 2;
+		}
+		else
+		{
+			msgs[i].msg_hdr.msg_iov = iovecs + 2*i + 1;
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+#endif
+}
+
+PacketReceiver::~PacketReceiver()
+{
+	delete [] stripbuffer;
+	delete [] workbuffer;
+	delete [] iovecs;
+#ifdef __linux__
+	delete [] msgs;
+#endif
+}
+
+unsigned int PacketReceiver::receive(int sock, char *dest, unsigned int bytestoread)
+{
+#ifdef __linux__
+	char *ptr = dest;
+	unsigned int npayloads = bytestoread/payloadsize;
+	unsigned int nplaced = 0;	// payloads in place at the start of dest
+
+	while(nplaced < npayloads)
+	{
+		int nmsg = npayloads - nplaced;
+		int n;
+
+		if(nmsg > batchsize)
+		{
+			nmsg = batchsize;
+		}
+		for(int i = 0; i < nmsg; ++i)
+		{
+			iovecs[2*i+1].iov_base = ptr + i*payloadsize;
+			iovecs[2*i+1].iov_len = payloadsize;
+			msgs[i].msg_hdr.msg_flags = 0;
+		}
+
+		// wait for the first packet (subject to the socket timeout), then take whatever else is already queued
+		n = recvmmsg(sock, msgs, nmsg, MSG_WAITFORONE, 0);
+		++ncalls;
+		if(n <= 0)
+		{
+			if(n < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			// timeout on read?
+			break;
+		}
+
+		char *next = ptr;
+		for(int i = 0; i < n; ++i)
+		{
+			if(msgs[i].msg_len != (unsigned int)packetsize || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+			{
+				++nrejected;
+				continue;
+			}
+			if(next != ptr + i*payloadsize)
+			{
+				// close the gap left by a rejected packet
+				memmove(next, ptr + i*payloadsize, payloadsize);
+			}
+			next += payloadsize;
+		}
+		npackets += (next - ptr)/payloadsize;
+		nplaced += (next - ptr)/payloadsize;
+		ptr = next;
+	}
+
+	return ptr - dest;
+#else
+	return receiveSingle(sock, dest, bytestoread);
+#endif
+}
+
+unsigned int PacketReceiver::receiveSingle(int sock, char *dest, unsigned int bytestoread)
+{
+	char *ptr = dest;
+	char *end = dest + bytestoread - payloadsize;
+	int length;
+
+	while(ptr <= end)
+	{
+		length = recvfrom(sock, workbuffer, MaxPacketSize, 0, 0, 0);
+		++ncalls;
+		if(length <= 0)
+		{
+			if(length < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			// timeout on read?
+			break;
+		}
+		else if(length == packetsize)
+		{
+			memcpy(ptr, workbuffer + stripbytes, payloadsize);
+			ptr += payloadsize;
+			++npackets;
+		}
+		else
+		{
+			++nrejected;
+		}
+	}
+
+	return ptr - dest;
+}
@@ -0,0 +1,86 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef PACKETRECEIVER_H
+#define PACKETRECEIVER_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/* Receives fixed size packets from a datagram or raw socket into a contiguous
+ * buffer, dropping the first stripbytes of each packet (e.g. Ethernet/IP/UDP
+ * headers or a sequence number) and rejecting packets of any other size.
+ *
+ * On Linux each call to recvmmsg() receives up to batchsize packets, each
+ * scattered by two iovecs: the bytes to strip go to a scratch area and the
+ * payload goes straight to its place in the destination buffer, so there is
+ * no intermediate copy.  Packets of the wrong size arrive in place too, so
+ * any good packets after one in the same batch are moved down over it.
+ * Elsewhere, and in receiveSingle(), each packet is received with its own
+ * recvfrom() into a work buffer and copied, as VDIFNetworkDataStream did.
+ */
+
+class PacketReceiver
+{
+public:
+	PacketReceiver(int packetsize, int stripbytes, int batchsize = DefaultBatchSize);
+	~PacketReceiver();
+
+	/* Fills dest with as many whole payloads as fit in bytestoread, stopping
+	 * early only if the socket times out or fails.  Returns the number of
+	 * bytes placed in dest. */
+	unsigned int receive(int sock, char *dest, unsigned int bytestoread);
+
+	/* The same, with one recvfrom() system call and one copy per packet */
+	unsigned int receiveSingle(int sock, char *dest, unsigned int bytestoread);
+
+	int getPacketSize() const { return packetsize; }
+	int getPayloadSize() const { return payloadsize; }
+	long long getNumPackets() const { return npackets; }
+	long long getNumRejected() const { return nrejected; }
+	long long getNumCalls() const { return ncalls; }
+	void resetCounters() { npackets = nrejected = ncalls = 0; }
+
+	static const int DefaultBatchSize = 64;
+	static const int MaxPacketSize = 20000;
+
+private:
+	int packetsize;		// size of every accepted packet
+	int stripbytes;		// bytes dropped from the start of each packet
+	int payloadsize;	// packetsize - stripbytes
+	int batchsize;
+	char *stripbuffer;	// scratch for the stripped bytes of each packet in a batch
+	char *workbuffer;	// for receiveSingle()
+	struct iovec *iovecs;
+#ifdef __linux__
+	struct mmsghdr *msgs;
+#endif
+	long long npackets, nrejected, ncalls;
+};
+
+#endif
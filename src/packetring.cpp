@@ -0,0 +1,492 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include <cstring>
+#include <cstdlib>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "packetring.h"
+#include "alert.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#ifndef PACKET_FANOUT_FLAG_IGNORE_OUTGOING
+#define PACKET_FANOUT_FLAG_IGNORE_OUTGOING 0x4000
+#endif
+#endif
+
+PacketRing::PacketRing(const char *device, int numrings, int blocksize, int numblocks) :
+	numrings(numrings), numopen(0), blocksize(blocksize), numblocks(numblocks), ndropped(0), nfreezes(0)
+{
+	int fanoutid = getpid() & 0xffff;
+
+	dest = 0;
+	fillpos = filllimit = 0;
+	packetsize = stripbytes = 0;
+	generation = numparked = 0;
+	stopdrainers = false;
+	drainerinfos = 0;
+	wakefd = -1;
+	pthread_mutex_init(&drainlock, 0);
+	pthread_cond_init(&startcond, 0);
+	pthread_cond_init(&parkcond, 0);
+
+	if(this->numrings < 1)
+	{
+		this->numrings = 1;
+	}
+	rings = new ring[this->numrings];
+	for(int i = 0; i < this->numrings; ++i)
+	{
+		memset(rings + i, 0, sizeof(ring));
+		rings[i].fd = -1;
+	}
+	for(int i = 0; i < this->numrings; ++i)
+	{
+		if(openRing(rings + i, device, (this->numrings > 1) ? fanoutid : -1) < 0)
+		{
+			return;
+		}
+		++numopen;
+	}
+
+	if(this->numrings > 1)
+	{
+		pthread_attr_t attr;
+
+#ifdef __linux__
+		// signalled by the drainer that fills the destination, so the others needn't wait for their rings to go quiet
+		wakefd = eventfd(0, EFD_NONBLOCK);
+		if(wakefd < 0)
+		{
+			cerror << startl << "PacketRing: Cannot create eventfd: " << strerror(errno) << endl;
+			numopen = 0;
+			return;
+		}
+#endif
+		drainerinfos = new drainerinfo[this->numrings];
+		numparked = this->numrings;	// nothing to do until receive() is called
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+		for(int i = 0; i < this->numrings; ++i)
+		{
+			drainerinfos[i].owner = this;
+			drainerinfos[i].index = i;
+			if(pthread_create(&(rings[i].thread), &attr, PacketRing::launchDrainer, drainerinfos + i) != 0)
+			{
+				cfatal << startl << "PacketRing: cannot create drainer thread " << i << endl;
+			}
+		}
+		pthread_attr_destroy(&attr);
+	}
+}
+
+PacketRing::~PacketRing()
+{
+	if(drainerinfos)
+	{
+		pthread_mutex_lock(&drainlock);
+		stopdrainers = true;
+		++generation;
+		pthread_cond_broadcast(&startcond);
+		pthread_mutex_unlock(&drainlock);
+		for(int i = 0; i < numrings; ++i)
+		{
+			pthread_join(rings[i].thread, 0);
+		}
+		delete [] drainerinfos;
+	}
+	if(wakefd >= 0)
+	{
+		close(wakefd);
+	}
+	for(int i = 0; i < numrings; ++i)
+	{
+#ifdef __linux__
+		if(rings[i].map)
+		{
+			munmap(rings[i].map, rings[i].maplen);
+		}
+#endif
+		if(rings[i].fd >= 0)
+		{
+			close(rings[i].fd);
+		}
+	}
+	delete [] rings;
+	pthread_cond_destroy(&startcond);
+	pthread_cond_destroy(&parkcond);
+	pthread_mutex_destroy(&drainlock);
+}
+
+int PacketRing::openRing(ring *r, const char *device, int fanoutid)
+{
+#ifdef __linux__
+	struct tpacket_req3 req;
+	struct sockaddr_ll sll;
+	struct ifreq ifr;
+	int v;
+
+	// Note: this operation requires root permission or CAP_NET_RAW
+	r->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if(r->fd < 0)
+	{
+		cerror << startl << "PacketRing: Cannot create socket: " << strerror(errno) << endl;
+		return -1;
+	}
+
+	v = TPACKET_V3;
+	if(setsockopt(r->fd, SOL_PACKET, PACKET_VERSION, &v, sizeof(v)) < 0)
+	{
+		cerror << startl << "PacketRing: TPACKET_V3 is not supported: " << strerror(errno) << endl;
+		return -2;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = blocksize;
+	req.tp_block_nr = numblocks;
+	req.tp_frame_size = FrameSize;
+	req.tp_frame_nr = (blocksize/FrameSize)*numblocks;
+	req.tp_retire_blk_tov = BlockTimeoutMs;
+	if(setsockopt(r->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+	{
+		cerror << startl << "PacketRing: Cannot set up a ring of " << numblocks << " blocks of " << blocksize << " bytes: " << strerror(errno) << endl;
+		return -3;
+	}
+	r->maplen = (size_t)blocksize*numblocks;
+	r->map = (char *)mmap(0, r->maplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, r->fd, 0);
+	if(r->map == MAP_FAILED)
+	{
+		// MAP_LOCKED can fail for want of RLIMIT_MEMLOCK; the ring still works without it
+		r->map = (char *)mmap(0, r->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+	}
+	if(r->map == MAP_FAILED)
+	{
+		r->map = 0;
+		cerror << startl << "PacketRing: Cannot map the ring: " << strerror(errno) << endl;
+		return -4;
+	}
+	r->block = 0;
+	r->packetsleft = 0;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, device, IFNAMSIZ - 1);
+	if(ioctl(r->fd, SIOCGIFINDEX, &ifr) == -1)
+	{
+		cerror << startl << "PacketRing: ioctl SIOCGIFINDEX failed on " << device << endl;
+		return -5;
+	}
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_ifindex = ifr.ifr_ifindex;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	if(bind(r->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+	{
+		cerror << startl << "PacketRing: bind failed on " << device << endl;
+		return -6;
+	}
+
+	/* as DataStream::openrawstream: set promisc flag -- sometimes this is needed */
+	ioctl(r->fd, SIOCGIFFLAGS, &ifr);
+	if((ifr.ifr_flags & IFF_PROMISC) == 0)
+	{
+		ifr.ifr_flags |= IFF_PROMISC;
+		ioctl(r->fd, SIOCSIFFLAGS, &ifr);
+	}
+
+#ifdef PACKET_IGNORE_OUTGOING
+	// keep our own transmissions out of the ring (only the loopback interface would show any); Linux >= 4.20
+	v = 1;
+	setsockopt(r->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &v, sizeof(v));
+#endif
+
+	if(fanoutid >= 0)
+	{
+		// the group doesn't inherit PACKET_IGNORE_OUTGOING; older kernels don't know the flag
+		v = fanoutid | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_IGNORE_OUTGOING) << 16);
+		if(setsockopt(r->fd, SOL_PACKET, PACKET_FANOUT, &v, sizeof(v)) < 0)
+		{
+			v = fanoutid | (PACKET_FANOUT_HASH << 16);
+		}
+		else
+		{
+			v = -1;
+		}
+		if(v >= 0 && setsockopt(r->fd, SOL_PACKET, PACKET_FANOUT, &v, sizeof(v)) < 0)
+		{
+			cerror << startl << "PacketRing: Cannot join fanout group " << fanoutid << ": " << strerror(errno) << endl;
+			return -7;
+		}
+	}
+
+	return 0;
+#else
+	cerror << startl << "PacketRing: memory-mapped packet capture currently works only on Linux" << endl;
+
+	return -1;
+#endif
+}
+
+#ifdef __linux__
+PacketRing::drainstatus PacketRing::drain(ring *r)
+{
+	int payloadsize = packetsize - stripbytes;
+
+	for(;;)
+	{
+		struct tpacket_block_desc *bd = (struct tpacket_block_desc *)(r->map + (size_t)r->block*blocksize);
+
+		if(r->packetsleft == 0)
+		{
+			if((bd->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+			{
+				struct pollfd pfd[2];
+				int npfd = 1;
+
+				if(filllimit - fillpos < payloadsize)
+				{
+					return DRAIN_FULL;	// another ring filled the destination
+				}
+
+				// the only system call: wait for the kernel to hand over a block
+				pfd[0].fd = r->fd;
+				pfd[0].events = POLLIN | POLLERR;
+				pfd[0].revents = 0;
+				if(wakefd >= 0)
+				{
+					pfd[1].fd = wakefd;
+					pfd[1].events = POLLIN;
+					pfd[1].revents = 0;
+					++npfd;
+				}
+				if(poll(pfd, npfd, PollTimeoutMs) <= 0 && (bd->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+				{
+					return DRAIN_TIMEOUT;
+				}
+				continue;
+			}
+			__sync_synchronize();	// read the block only after seeing its status
+			r->packetsleft = bd->hdr.bh1.num_pkts;
+			r->packet = (char *)bd + bd->hdr.bh1.offset_to_first_pkt;
+			if(r->packetsleft == 0)
+			{
+				releaseBlock(r);
+				continue;
+			}
+		}
+
+		while(r->packetsleft > 0)
+		{
+			struct tpacket3_hdr *ph = (struct tpacket3_hdr *)(r->packet);
+			const struct sockaddr_ll *sll = (const struct sockaddr_ll *)(r->packet + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+
+			if(sll->sll_pkttype == PACKET_OUTGOING)
+			{
+				// our own transmissions, if PACKET_IGNORE_OUTGOING isn't available
+			}
+			else if(ph->tp_snaplen != (unsigned int)packetsize || ph->tp_len != (unsigned int)packetsize)
+			{
+				++r->nrejected;
+			}
+			else
+			{
+				long pos;
+
+				do
+				{
+					pos = fillpos;
+					if(pos + payloadsize > filllimit)
+					{
+						// this packet starts the next destination
+						if(wakefd >= 0)
+						{
+							uint64_t one = 1;
+
+							if(write(wakefd, &one, sizeof(one)) < 0)
+							{
+								// already signalled
+							}
+						}
+
+						return DRAIN_FULL;
+					}
+				} while(!__sync_bool_compare_and_swap(&fillpos, pos, pos + payloadsize));
+				memcpy(dest + pos, r->packet + ph->tp_mac + stripbytes, payloadsize);
+				++r->npackets;
+			}
+			r->packet += ph->tp_next_offset;
+			--r->packetsleft;
+		}
+		releaseBlock(r);
+	}
+}
+
+void PacketRing::releaseBlock(ring *r)
+{
+	struct tpacket_block_desc *bd = (struct tpacket_block_desc *)(r->map + (size_t)r->block*blocksize);
+
+	__sync_synchronize();	// finish reading the block before the kernel can reuse it
+	bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	r->block = (r->block + 1) % numblocks;
+	r->packetsleft = 0;
+}
+#endif
+
+void *PacketRing::launchDrainer(void *arg)
+{
+	drainerinfo *info = (drainerinfo *)arg;
+
+	info->owner->loopdrain(info->index);
+
+	return 0;
+}
+
+void PacketRing::loopdrain(int index)
+{
+	int lastgeneration = 0;
+
+	pthread_mutex_lock(&drainlock);
+	for(;;)
+	{
+		while(generation == lastgeneration && !stopdrainers)
+		{
+			pthread_cond_wait(&startcond, &drainlock);
+		}
+		if(stopdrainers)
+		{
+			break;
+		}
+		lastgeneration = generation;
+		pthread_mutex_unlock(&drainlock);
+
+#ifdef __linux__
+		drain(rings + index);
+#endif
+
+		pthread_mutex_lock(&drainlock);
+		++numparked;
+		pthread_cond_signal(&parkcond);
+	}
+	pthread_mutex_unlock(&drainlock);
+}
+
+unsigned int PacketRing::receive(char *dest, unsigned int bytestoread, int packetsize, int stripbytes)
+{
+	if(!isOpen() || packetsize <= stripbytes)
+	{
+		return 0;
+	}
+
+	this->dest = dest;
+	this->packetsize = packetsize;
+	this->stripbytes = stripbytes;
+	fillpos = 0;
+	filllimit = bytestoread - bytestoread % (packetsize - stripbytes);
+
+	if(numrings == 1)
+	{
+#ifdef __linux__
+		drain(rings);
+#endif
+	}
+	else
+	{
+		// every drainer fills the destination until it is full or its ring goes quiet
+#ifdef __linux__
+		uint64_t signalled;
+
+		if(read(wakefd, &signalled, sizeof(signalled)) < 0)
+		{
+			// not signalled since the last destination
+		}
+#endif
+		pthread_mutex_lock(&drainlock);
+		numparked = 0;
+		++generation;
+		pthread_cond_broadcast(&startcond);
+		while(numparked < numrings)
+		{
+			pthread_cond_wait(&parkcond, &drainlock);
+		}
+		pthread_mutex_unlock(&drainlock);
+	}
+	updateStatistics();
+
+	return fillpos;
+}
+
+void PacketRing::updateStatistics()
+{
+#ifdef __linux__
+	struct tpacket_stats_v3 stats;
+	socklen_t len;
+
+	for(int i = 0; i < numrings; ++i)
+	{
+		// the kernel resets these counters each time they are read
+		len = sizeof(stats);
+		if(getsockopt(rings[i].fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0)
+		{
+			ndropped += stats.tp_drops;
+			nfreezes += stats.tp_freeze_q_cnt;
+		}
+	}
+#endif
+}
+
+long long PacketRing::getNumPackets() const
+{
+	long long n = 0;
+
+	for(int i = 0; i < numrings; ++i)
+	{
+		n += rings[i].npackets;
+	}
+
+	return n;
+}
+
+long long PacketRing::getNumRejected() const
+{
+	long long n = 0;
+
+	for(int i = 0; i < numrings; ++i)
+	{
+		n += rings[i].nrejected;
+	}
+
+	return n;
+}
@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef PACKETRING_H
+#define PACKETRING_H
+
+#include <pthread.h>
+#include <sys/types.h>
+
+/* Captures raw Ethernet frames through memory-mapped PACKET_RX_RING
+ * (TPACKET_V3) buffers, an alternative to reading a raw socket one packet
+ * per system call.  The kernel fills whole blocks of frames; receive()
+ * copies the payloads of the frames of the wanted size straight from the
+ * ring into the destination and hands each block back when it is done,
+ * so a system call (poll) is only made when no block is ready.
+ *
+ * With more than one ring the sockets join a PACKET_FANOUT_HASH group, so
+ * the NIC's receive queues are spread over the rings with each flow always
+ * going to the same ring, and each ring is drained by its own thread.
+ * Frames of one flow therefore stay in order, while frames of different
+ * flows are interleaved much as they would be on the wire.
+ *
+ * Each ring takes blocksize*numblocks bytes (256 MB by default), mapped
+ * with MAP_LOCKED where RLIMIT_MEMLOCK allows.
+ *
+ * Only Linux is supported; elsewhere isOpen() is always false.
+ */
+
+class PacketRing
+{
+public:
+	PacketRing(const char *device, int numrings = 1, int blocksize = DefaultBlockSize, int numblocks = DefaultNumBlocks);
+	~PacketRing();
+
+	bool isOpen() const { return numopen == numrings && numrings > 0; }
+
+	/* Fills dest with the payloads (all but the first stripbytes) of
+	 * received frames of exactly packetsize bytes, stopping early only if
+	 * no frame arrives on any ring within PollTimeoutMs.  Returns the
+	 * number of bytes placed in dest. */
+	unsigned int receive(char *dest, unsigned int bytestoread, int packetsize, int stripbytes);
+
+	int getNumRings() const { return numrings; }
+	long long getNumPackets() const;
+	long long getNumRejected() const;
+	long long getNumDropped() const { return ndropped; }	// by the kernel, for want of a free block
+	long long getNumFreezes() const { return nfreezes; }	// times the kernel found the ring full
+
+	static const int DefaultBlockSize = 1 << 22;
+	static const int DefaultNumBlocks = 64;
+	static const int MinNumBlocks = 2;		// so the kernel can fill one block while another is read
+	static const int FrameSize = 2048;		// only a sizing hint for TPACKET_V3, frames are packed
+	static const int BlockTimeoutMs = 10;		// a partly filled block is handed over after this long
+	static const int PollTimeoutMs = 100;		// as SO_RCVTIMEO on DataStream::openrawstream sockets
+
+private:
+	typedef struct
+	{
+		int fd;
+		char *map;
+		size_t maplen;
+		int block;		// block being read
+		int packetsleft;	// in that block; 0 if the block isn't ours yet
+		char *packet;		// next packet to look at in that block
+		long long npackets, nrejected;
+		pthread_t thread;
+	} ring;
+
+	typedef struct
+	{
+		PacketRing *owner;
+		int index;
+	} drainerinfo;
+
+	enum drainstatus { DRAIN_FULL, DRAIN_TIMEOUT };
+
+	int openRing(ring *r, const char *device, int fanoutid);
+	drainstatus drain(ring *r);
+	void releaseBlock(ring *r);
+	void updateStatistics();
+	static void *launchDrainer(void *arg);
+	void loopdrain(int index);
+
+	int numrings, numopen, blocksize, numblocks;
+	ring *rings;
+	drainerinfo *drainerinfos;
+	long long ndropped, nfreezes;
+
+	/* the destination currently being filled; space is claimed with an atomic compare and swap */
+	char *dest;
+	volatile long fillpos;
+	long filllimit;
+	int packetsize, stripbytes;
+
+	/* used to hand a destination to the drainer threads when there is more than one ring */
+	pthread_mutex_t drainlock;
+	pthread_cond_t startcond, parkcond;
+	int wakefd;		/* eventfd set when the destination is full */
+	int generation, numparked;
+	bool stopdrainers;
+};
+
+#endif
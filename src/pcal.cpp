@@ -1504,6 +1504,9 @@ uint64_t PCalExtractorDummy::getFinalPCal(cf32* out)
 #include <cstring>
 
 pthread_mutex_t FFTinitMutex = PTHREAD_MUTEX_INITIALIZER; // required by non-ipp compile by architecture.h despite not being used
+#if (ARCH == GENERIC)
+GenFFTPlanEntry * FFTplancache = 0;
+#endif
 
 struct tcase_t {
   long bandwidth, offset, spacing;
@@ -32,12 +32,15 @@
 
 const double Polyco::BIN_TOLERANCE = 0.01;
 const double Polyco::DM_CONSTANT_SECS = 1.0/0.000241;
+const int Polyco::MAX_BIN_LOOKUP_CELLS = 65536;
 
 Polyco::Polyco(string filename, istream * polycofile, int subcount, int confindex, int nbins, int maxchans, double * bphases, double * bweights, double calcmins)
   : configindex(confindex), numbins(nbins), maxchannels(maxchans), numfreqs(-1), calclengthmins(calcmins)
 {
   int status;
   estimatedbytes = 0;
+  numbinlookupcells = 0;
+  binlookup = 0;
 
   //load the polyco file
   readok = loadPolycoFile(filename, polycofile, subcount);
@@ -60,6 +63,8 @@ Polyco::Polyco(string filename, istream * polycofile, int subcount, int confinde
     status = vectorCopy_f64(bweights, binweights, numbins);
     if(status != vecNoErr)
       csevere << startl << "Error copying binweights in Polyco!!" << endl;
+
+    createBinLookup();
   
     cinfo << startl << "Polyco " << subcount << " from file " << filename << " created successfully" << endl;
   }
@@ -84,6 +89,17 @@ Polyco::Polyco(const Polyco & tocopy)
   if(status != vecNoErr)
     csevere << startl << "Error copying binweights in Polyco!!" << endl;
 
+  numbinlookupcells = tocopy.numbinlookupcells;
+  binlookup = 0;
+  if(numbinlookupcells > 0)
+  {
+    binlookup = vectorAlloc_s32(numbinlookupcells);
+    estimatedbytes += 4*numbinlookupcells;
+    status = vectorCopy_s32(tocopy.binlookup, binlookup, numbinlookupcells);
+    if(status != vecNoErr)
+      csevere << startl << "Error copying binlookup in Polyco!!" << endl;
+  }
+
   absolutephases = vectorAlloc_f64(maxchannels);
   estimatedbytes += 8*(maxchannels);
   coefficients = new double[numcoefficients];
@@ -146,6 +162,8 @@ Polyco::~Polyco()
     vectorFree(absolutephases);
     vectorFree(binphases);
     vectorFree(binweights);
+    if(binlookup != 0)
+      vectorFree(binlookup);
 
     if(numfreqs > 0)
     {
@@ -186,7 +204,7 @@ Polyco::~Polyco()
 
 void Polyco::getBins(double offsetmins, int **bins) const
 {
-    int status;
+    int status, cell, count;
     double averagephase, modulophase;
     double dt = dt0 + offsetmins;
 
@@ -209,31 +227,55 @@ void Polyco::getBins(double offsetmins, int **bins) const
         if(status != vecNoErr)
           csevere << startl << "Error!!! Problem adding dmPhaseOffsets to average phase!!!" << endl;
 
-        //now work out the modulophase for each element and thence its bin
+        //now work out the modulophase for each element and thence its bin: the lookup cell gives the number of
+        //breakpoints at or below the start of the cell, leaving only the (normally one at most) within the cell to check
         for(int j=0;j<numchannels[i];j++)
         {
           modulophase = absolutephases[j] - floor(absolutephases[j]);
-          if(modulophase < binphases[0] || modulophase >= binphases[numbins-1])
-          {
-            bins[i][j] = 0;
-            //currentbincounts[0][i][j]++;
-          }
-          else
-          {
-            for(int k=numbins-1;k>0;k--)
-            {
-              if(modulophase < binphases[k] && modulophase >= binphases[k-1])
-              {
-                bins[i][j] = k;
-                //currentbincounts[k][i][j]++;
-              }
-            }
-          }
+          cell = (int)(modulophase*numbinlookupcells);
+          if(cell >= numbinlookupcells)
+            cell = numbinlookupcells-1;
+          count = binlookup[cell];
+          while(count < numbins && binphases[count] <= modulophase)
+            count++;
+          while(count > 0 && binphases[count-1] > modulophase)
+            count--;
+          //below the first breakpoint or at/above the last is bin 0
+          bins[i][j] = (count == numbins)?0:count;
         }
       }
     }
 }
 
+void Polyco::createBinLookup()
+{
+  int count;
+  double minwidth, cellstart;
+
+  //size the cells so that no cell holds more than one breakpoint
+  minwidth = binphases[0] + 1.0 - binphases[numbins-1];
+  for(int i=1;i<numbins;i++)
+  {
+    if(binphases[i] - binphases[i-1] < minwidth)
+      minwidth = binphases[i] - binphases[i-1];
+  }
+  if(minwidth > 2.0/MAX_BIN_LOOKUP_CELLS)
+    numbinlookupcells = 2*(int)ceil(1.0/minwidth);
+  else
+    numbinlookupcells = MAX_BIN_LOOKUP_CELLS;
+
+  binlookup = vectorAlloc_s32(numbinlookupcells);
+  estimatedbytes += 4*numbinlookupcells;
+  count = 0;
+  for(int i=0;i<numbinlookupcells;i++)
+  {
+    cellstart = ((double)i)/numbinlookupcells;
+    while(count < numbins && binphases[count] <= cellstart)
+      count++;
+    binlookup[i] = count;
+  }
+}
+
 bool Polyco::setFrequencyValues(int nfreqs, double * freqs, double * bws, int * nchans, bool * compute)
 {
     double channelfreq;
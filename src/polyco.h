@@ -172,6 +172,9 @@ public:
 
   ///The constant used in converting DM to delay
   static const double DM_CONSTANT_SECS;
+
+  ///The most cells in the phase to bin lookup table
+  static const int MAX_BIN_LOOKUP_CELLS;
   
 protected:
  /**
@@ -180,14 +183,20 @@ protected:
   */
   void calculateDMPhaseOffsets(double offsetmins);
 
+ /**
+  * Builds the table of the number of bin phase breakpoints at or below the start of each equal width phase cell
+  */
+  void createBinLookup();
+
   string pulsarname;
-  int configindex, numbins, maxchannels, numfreqs, observatory, timespan, numcoefficients, mjd;
+  int configindex, numbins, maxchannels, numfreqs, observatory, timespan, numcoefficients, mjd, numbinlookupcells;
   long long estimatedbytes;
   double mjdfraction, dt0, dm, dopplershift, logresidual, refphase, f0, obsfrequency, binaryphase, minbinwidth, calclengthmins;
   bool readok;
   double * coefficients;
   f64 * binphases;
   f64 * binweights;
+  s32 * binlookup;
   f32 * lofrequencies;
   f32 * bandwidths;
   int * numchannels;
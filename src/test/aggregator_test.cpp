@@ -0,0 +1,200 @@
+#include <mpi.h>
+#include <cstdlib>
+#include <iostream>
+#include "architecture.h"
+#include "aggregator.h"
+#include "mpifxcorr.h"
+
+// Runs an Aggregator between emulated Cores and an emulated FxManager, using the same messages as
+// Core::sendresults and FxManager::receiveAggregatedData, and checks that every integration arrives at
+// the manager with exactly the sum of its subintegrations and the right subintegration count.  Subints
+// are dealt out to the cores in turn, as the FxManager does, across two scans.  The second pass gives
+// the Aggregator a single slot, so it is forced to send partial sums early.
+//   mpirun -np 5 ./aggregator_test     (test/aggregator_test.sh does this for make check)
+// Rank 0 is the manager, the last rank the Aggregator and the rest are Cores.
+
+static const int RESULTLENGTH = 1000;
+static const int SUBINTSPERINTEGRATION = 6;
+static const int SUBINTSPERSCAN = 40;    // not a whole number of integrations, so each scan ends with a short one
+static const int NUMSCANS = 2;
+static const int NUMSUBINTS = SUBINTSPERSCAN*NUMSCANS;
+static const int SUBINTNS = 100000000;
+
+static void subintposition(int subint, int * header)
+{
+  int subintinscan = subint%SUBINTSPERSCAN;
+  header[0] = subint/SUBINTSPERSCAN;
+  header[1] = (int)(((long long)subintinscan*SUBINTNS)/1000000000);
+  header[2] = (int)(((long long)subintinscan*SUBINTNS)%1000000000);
+  header[3] = subintinscan/SUBINTSPERINTEGRATION;
+  header[4] = 1;
+}
+
+// small integers, so all the sums are exact
+static void fillresult(int subint, cf32 * result)
+{
+  for(int i=0;i<RESULTLENGTH;i++)
+  {
+    result[i].re = (subint*7 + i)%11;
+    result[i].im = (subint*3 + i)%5 - 2.0;
+  }
+}
+
+static void runcore(int rank, int numcores, int aggregatorid, MPI_Comm comm)
+{
+  cf32 * result = vectorAlloc_cf32(RESULTLENGTH);
+  int header[Aggregator::HEADER_LENGTH];
+
+  for(int s=rank-1;s<NUMSUBINTS;s+=numcores)
+  {
+    subintposition(s, header);
+    fillresult(s, result);
+    MPI_Send(header, Aggregator::HEADER_LENGTH, MPI_INT, aggregatorid, CR_AGGREGATEHEADER, comm);
+    MPI_Send(result, RESULTLENGTH*2, MPI_FLOAT, aggregatorid, CR_VALIDVIS, comm);
+    MPI_Send(result, 0, MPI_FLOAT, fxcorr::MANAGERID, CR_VALIDVIS, comm);
+  }
+  MPI_Send(header, 0, MPI_INT, aggregatorid, CR_TERMINATE, comm);
+  vectorFree(result);
+}
+
+static int runmanager(int numcores, int aggregatorid, MPI_Comm comm)
+{
+  int numintegrations = NUMSCANS*((SUBINTSPERSCAN + SUBINTSPERINTEGRATION - 1)/SUBINTSPERINTEGRATION);
+  cf32 ** received = new cf32*[numintegrations];
+  cf32 ** expected = new cf32*[numintegrations];
+  int * receivedsubints = new int[numintegrations];
+  int * expectedsubints = new int[numintegrations];
+  cf32 * buffer = vectorAlloc_cf32(RESULTLENGTH);
+  int header[Aggregator::HEADER_LENGTH];
+  int integration, notices, messages, failures;
+  bool aggregatordone;
+  MPI_Status mpistatus;
+
+  for(int i=0;i<numintegrations;i++)
+  {
+    received[i] = vectorAlloc_cf32(RESULTLENGTH);
+    expected[i] = vectorAlloc_cf32(RESULTLENGTH);
+    vectorZero_cf32(received[i], RESULTLENGTH);
+    vectorZero_cf32(expected[i], RESULTLENGTH);
+    receivedsubints[i] = 0;
+    expectedsubints[i] = 0;
+  }
+  for(int s=0;s<NUMSUBINTS;s++)
+  {
+    subintposition(s, header);
+    integration = header[0]*(numintegrations/NUMSCANS) + header[3];
+    fillresult(s, buffer);
+    vectorAdd_cf32_I(buffer, expected[integration], RESULTLENGTH);
+    expectedsubints[integration]++;
+  }
+
+  notices = 0;
+  messages = 0;
+  aggregatordone = false;
+  while(notices < NUMSUBINTS || !aggregatordone)
+  {
+    MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &mpistatus);
+    if(mpistatus.MPI_SOURCE != aggregatorid)
+    {
+      MPI_Recv(buffer, RESULTLENGTH*2, MPI_FLOAT, mpistatus.MPI_SOURCE, MPI_ANY_TAG, comm, &mpistatus);
+      notices++;
+      continue;
+    }
+    MPI_Recv(header, Aggregator::HEADER_LENGTH, MPI_INT, aggregatorid, MPI_ANY_TAG, comm, &mpistatus);
+    if(mpistatus.MPI_TAG == CR_TERMINATE)
+    {
+      aggregatordone = true;
+      continue;
+    }
+    MPI_Recv(buffer, RESULTLENGTH*2, MPI_FLOAT, aggregatorid, CR_VALIDVIS, comm, &mpistatus);
+    integration = header[0]*(numintegrations/NUMSCANS) + header[3];
+    vectorAdd_cf32_I(buffer, received[integration], RESULTLENGTH);
+    receivedsubints[integration] += header[4];
+    messages++;
+  }
+
+  failures = 0;
+  for(int i=0;i<numintegrations;i++)
+  {
+    if(receivedsubints[i] != expectedsubints[i])
+    {
+      std::cout << "FAIL: integration " << i << " has " << receivedsubints[i] << " subints, expected " << expectedsubints[i] << std::endl;
+      failures++;
+    }
+    for(int j=0;j<RESULTLENGTH;j++)
+    {
+      if(received[i][j].re != expected[i][j].re || received[i][j].im != expected[i][j].im)
+      {
+        std::cout << "FAIL: integration " << i << " differs at " << j << std::endl;
+        failures++;
+        break;
+      }
+    }
+  }
+  std::cout << "  " << numcores << " cores, " << NUMSUBINTS << " subints, " << numintegrations << " integrations: the manager received " << messages << " combined results" << std::endl;
+
+  for(int i=0;i<numintegrations;i++)
+  {
+    vectorFree(received[i]);
+    vectorFree(expected[i]);
+  }
+  delete [] received;
+  delete [] expected;
+  delete [] receivedsubints;
+  delete [] expectedsubints;
+  vectorFree(buffer);
+
+  return failures;
+}
+
+int main(int argc, char** argv)
+{
+  const int numslots[2] = { 8, 1 };
+  int numprocs, rank, numcores, aggregatorid, failures, totalfailures;
+  int * coreids;
+  MPI_Comm comm;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if(numprocs < 3)
+  {
+    if(rank == 0)
+      std::cout << "Usage: mpirun -np <3 or more> aggregator_test (make check runs it through aggregator_test.sh)" << std::endl;
+    MPI_Finalize();
+    return 77; //skipped, so that a bare run does not count as a pass
+  }
+  MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+  numcores = numprocs - 2;
+  aggregatorid = numprocs - 1;
+  coreids = new int[numcores];
+  for(int i=0;i<numcores;i++)
+    coreids[i] = i + 1;
+
+  totalfailures = 0;
+  for(int p=0;p<2;p++)
+  {
+    failures = 0;
+    if(rank == fxcorr::MANAGERID)
+    {
+      std::cout << numslots[p] << " aggregator slot(s):" << std::endl;
+      failures = runmanager(numcores, aggregatorid, comm);
+    }
+    else if(rank == aggregatorid)
+    {
+      Aggregator aggregator(rank, numcores, coreids, RESULTLENGTH, numslots[p], comm);
+      aggregator.execute();
+    }
+    else
+      runcore(rank, numcores, aggregatorid, comm);
+    totalfailures += failures;
+    MPI_Barrier(comm);
+  }
+
+  delete [] coreids;
+  MPI_Comm_free(&comm);
+  MPI_Finalize();
+  if(rank == fxcorr::MANAGERID)
+    std::cout << ((totalfailures == 0)?"PASS":"FAIL") << std::endl;
+  return (totalfailures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Runs aggregator_test under MPI for make check: a manager, three Cores and an Aggregator.
+# Set MPIRUN to use another launcher (e.g. "mpirun --oversubscribe").
+# Exits 77 (skipped) if no launcher is available.
+
+MPIRUN=${MPIRUN:-mpirun}
+if ! command -v `echo $MPIRUN | cut -d' ' -f1` > /dev/null 2>&1
+then
+	echo "$MPIRUN not found; skipping aggregator_test"
+	exit 77
+fi
+
+exec $MPIRUN -np 5 ./aggregator_test
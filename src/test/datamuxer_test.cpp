@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include "datamuxer.h"
+#include "vdifio.h"
+
+// Muxes multi-thread VDIF through VDIFMuxer for every layout the corner turners cover: 1 to 64 threads
+// of 1, 2, 4, 8 and 16 bit real and complex samples.  Each thread's frames carry random payloads, the
+// threadIds are scattered over the whole threadId range and arrive in the opposite order to the thread
+// map, and one frame is replaced by one from a thread that is not in the map.  The output of the
+// corner turner VDIFMuxer picks is compared sample by sample with the threads' samples interleaved,
+// and, where the layout fits it, byte for byte (headers included) with the output of the generic
+// corner turner (selected by setting DIFX_VDIF_CORNERTURN=generic) and with the output of the same
+// corner turner shared over several threads (DIFX_MUX_THREADS).  The payload is not a whole number
+// of 16 byte words, so the partial pass at the end of each frame is covered too.
+//   ./datamuxer_test
+
+static const int PAYLOADBYTES = 1032;
+static const int FRAMEBYTES = PAYLOADBYTES + VDIF_HEADER_BYTES;
+static const int FRAMESPERSECOND = 1000;
+static const int STARTSECOND = 1000;
+static const int FRAMESPERSEGMENT = 4;    // per thread
+static const int NUMSEGMENTS = 3;
+static const int FOREIGNSEGMENT = 1;      // the frame of time step FOREIGNFRAME of this segment from the
+static const int FOREIGNFRAME = 2;        // first thread in the map is replaced by a foreign thread's
+static const int FOREIGNTHREAD = 1023;
+static const int MUXTHREADS = 3;         // doesn't divide the frames of a segment evenly
+
+static unsigned int threadid(int thread)
+{
+  return (thread*37 + 5) % 1000;
+}
+
+static void makepayload(std::vector<u8> & payload, int thread, int frame)
+{
+  unsigned int seed = thread*1000003 + frame;
+
+  payload.resize(PAYLOADBYTES);
+  for(int i=0;i<PAYLOADBYTES;i++)
+    payload[i] = rand_r(&seed) & 0xFF;
+}
+
+static unsigned int getsample(const u8 * data, long long index, int bits)
+{
+  unsigned int value = 0;
+
+  if(bits >= 8) {
+    memcpy(&value, data + index*(bits/8), bits/8);
+    return value;
+  }
+
+  return (data[(index*bits)/8] >> ((index*bits)%8)) & ((1 << bits) - 1);
+}
+
+static void fillsegment(u8 * buffer, int segment, int nthreads)
+{
+  std::vector<u8> payload;
+
+  for(int f=0;f<FRAMESPERSEGMENT;f++) {
+    int frame = segment*FRAMESPERSEGMENT + f;
+
+    for(int i=0;i<nthreads;i++) {
+      int thread = nthreads - 1 - i;
+      u8 * out = buffer + (f*nthreads + i)*FRAMEBYTES;
+      vdif_header * header = (vdif_header *)out;
+
+      memset(header, 0, VDIF_HEADER_BYTES);
+      setVDIFFrameSecond(header, STARTSECOND + frame/FRAMESPERSECOND);
+      setVDIFFrameNumber(header, frame%FRAMESPERSECOND);
+      setVDIFFrameBytes(header, FRAMEBYTES);
+      setVDIFThreadID(header, (segment == FOREIGNSEGMENT && f == FOREIGNFRAME && thread == 0)?FOREIGNTHREAD:threadid(thread));
+      makepayload(payload, thread, frame);
+      memcpy(out + VDIF_HEADER_BYTES, &payload[0], PAYLOADBYTES);
+    }
+  }
+}
+
+// runs all segments through a muxer, leaving the muxed frames in output; false if the muxer failed
+static bool runmuxer(int nthreads, int bits, bool iscomplex, bool generic, int muxthreads, std::vector<u8> & output)
+{
+  int outputframebytes = PAYLOADBYTES*nthreads + VDIF_HEADER_BYTES;
+  std::vector<int> tmap(nthreads);
+  bool ok = true;
+
+  for(int i=0;i<nthreads;i++)
+    tmap[i] = threadid(i);
+  if(generic)
+    setenv("DIFX_VDIF_CORNERTURN", "generic", 1);
+  else
+    unsetenv("DIFX_VDIF_CORNERTURN");
+  if(muxthreads > 1) {
+    char muxthreadsvalue[16];
+
+    snprintf(muxthreadsvalue, 16, "%d", muxthreads);
+    setenv("DIFX_MUX_THREADS", muxthreadsvalue, 1);
+  }
+  else
+    unsetenv("DIFX_MUX_THREADS");
+
+  //driven through the DataMuxer interface, as a datastream does
+  DataMuxer * muxer = new VDIFMuxer(0, 0, 0, nthreads, FRAMEBYTES, FRAMESPERSEGMENT*nthreads, FRAMESPERSECOND, bits, &tmap[0], iscomplex);
+  output.assign(NUMSEGMENTS*FRAMESPERSEGMENT*outputframebytes, 0);
+  for(int s=0;s<NUMSEGMENTS && ok;s++) {
+    fillsegment(muxer->getCurrentDemuxBuffer(), s, nthreads);
+    if(s == 0)
+      ok = muxer->initialise();
+    muxer->incrementReadCounter();
+    ok = ok && muxer->deinterlace(muxer->getSegmentBytes());
+    ok = ok && (muxer->multiplex(&output[s*FRAMESPERSEGMENT*outputframebytes]) == FRAMESPERSEGMENT*outputframebytes);
+  }
+  unsetenv("DIFX_VDIF_CORNERTURN");
+  unsetenv("DIFX_MUX_THREADS");
+  delete muxer;
+
+  return ok;
+}
+
+static int checklayout(int nthreads, int bits, bool iscomplex)
+{
+  int samplebits = (iscomplex)?2*bits:bits;
+  int outputframebytes = PAYLOADBYTES*nthreads + VDIF_HEADER_BYTES;
+  long long samplesperframe = PAYLOADBYTES*8LL/samplebits;
+  std::vector<u8> output, genericoutput, pooloutput, payload;
+  int failures = 0;
+
+  if(!runmuxer(nthreads, bits, iscomplex, false, 1, output)) {
+    std::cout << "FAIL: " << nthreads << " threads of " << bits << " bit " << ((iscomplex)?"complex":"real") << " samples could not be muxed" << std::endl;
+    return 1;
+  }
+
+  for(int frame=0;frame<NUMSEGMENTS*FRAMESPERSEGMENT;frame++) {
+    const u8 * out = &output[frame*outputframebytes];
+    const vdif_header * header = (const vdif_header *)out;
+    bool foreign = (frame == FOREIGNSEGMENT*FRAMESPERSEGMENT + FOREIGNFRAME);
+
+    if(getVDIFFrameNumber(header) != frame || getVDIFFrameBytes(header) != outputframebytes || getVDIFFrameInvalid(header) != ((foreign)?1:0)) {
+      std::cout << "FAIL: " << nthreads << " threads of " << samplebits << " bit samples: output frame " << frame << " has frame number " << getVDIFFrameNumber(header) << ", " << getVDIFFrameBytes(header) << " bytes, invalid=" << getVDIFFrameInvalid(header) << std::endl;
+      failures++;
+      continue;
+    }
+    if(foreign)
+      continue;
+    for(int t=0;t<nthreads && failures == 0;t++) {
+      makepayload(payload, t, frame);
+      for(long long i=0;i<samplesperframe;i++) {
+        if(getsample(out + VDIF_HEADER_BYTES, i*nthreads + t, samplebits) != getsample(&payload[0], i, samplebits)) {
+          std::cout << "FAIL: " << nthreads << " threads of " << samplebits << " bit samples: frame " << frame << " sample " << i << " of thread " << t << " is " << getsample(out + VDIF_HEADER_BYTES, i*nthreads + t, samplebits) << ", expected " << getsample(&payload[0], i, samplebits) << std::endl;
+          failures++;
+          break;
+        }
+      }
+    }
+  }
+
+  //the generic corner turner can only do layouts with a whole time step in a 32 bit word
+  if(nthreads*samplebits <= 32) {
+    if(!runmuxer(nthreads, bits, iscomplex, true, 1, genericoutput)) {
+      std::cout << "FAIL: the generic corner turner could not mux " << nthreads << " threads of " << samplebits << " bit samples" << std::endl;
+      failures++;
+    }
+    else {
+      for(int frame=0;frame<NUMSEGMENTS*FRAMESPERSEGMENT;frame++) {
+        if(frame == FOREIGNSEGMENT*FRAMESPERSEGMENT + FOREIGNFRAME)
+          continue; //an invalid frame's payload is left as it was
+        if(memcmp(&output[frame*outputframebytes], &genericoutput[frame*outputframebytes], outputframebytes) != 0) {
+          std::cout << "FAIL: " << nthreads << " threads of " << samplebits << " bit samples: frame " << frame << " differs from the generic corner turner's" << std::endl;
+          failures++;
+          break;
+        }
+      }
+    }
+  }
+
+  //sharing the corner turns over a pool of threads must not change a byte
+  if(!runmuxer(nthreads, bits, iscomplex, false, MUXTHREADS, pooloutput)) {
+    std::cout << "FAIL: " << nthreads << " threads of " << samplebits << " bit samples could not be muxed with " << MUXTHREADS << " muxing threads" << std::endl;
+    failures++;
+  }
+  else if(pooloutput != output) {
+    std::cout << "FAIL: " << nthreads << " threads of " << samplebits << " bit samples: the output with " << MUXTHREADS << " muxing threads differs" << std::endl;
+    failures++;
+  }
+
+  return failures;
+}
+
+int main(int argc, const char** argv)
+{
+  int failures = 0, nlayouts = 0;
+
+  for(int c=0;c<2;c++) {
+    for(int bits=1;bits<=16;bits*=2) {
+      for(int nthreads=1;nthreads<=64;nthreads*=2) {
+        int result = checklayout(nthreads, bits, (c == 1));
+
+        nlayouts++;
+        failures += result;
+      }
+    }
+  }
+  std::cout << "  " << nlayouts << " layouts checked" << std::endl;
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,166 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "architecture.h"
+#include "mk5unpacker.h"
+
+// Checks that Mk5Unpacker gives bit for bit the same samples and good sample counts as
+// mark5access, for every supported layout, at every SIMD level the host has, with frames
+// marked bad and unpack ranges that start and end part way through frames.
+
+static const int NUM_FRAMES = 12;
+static const int BAD_FRAME = 5;
+
+static int checklayout(bool mark5b, int nchan, int nbits)
+{
+  const int databytes = mark5b?10000:8000;
+  const int framebytes = databytes + (mark5b?16:32);
+  const int framesamples = databytes*8/(nchan*nbits);
+  const int starts[] = {0, 1, 7, framesamples - 3, 3*framesamples + 17, (BAD_FRAME-1)*framesamples + 5};
+  const int lengths[] = {8, 100, 2*framesamples + 13, 4*framesamples};
+  int numerrors = 0;
+  int log2chan, m5good, good, maxsamples;
+  char formatname[64];
+  u8 * data;
+  u32 * header;
+  f32 ** m5unpacked;
+  f32 ** unpacked;
+  cf32 * rotator;
+  cf32 * rotated;
+  struct mark5_stream * ms;
+  Mk5Unpacker * unpacker;
+
+  log2chan = 0;
+  while((1 << log2chan) < nchan)
+    log2chan++;
+  data = new u8[NUM_FRAMES*framebytes];
+  for(int i=0;i<NUM_FRAMES*framebytes;i++)
+    data[i] = rand() & 0xFF;
+  for(int f=0;f<NUM_FRAMES;f++)
+  {
+    header = (u32 *)(data + f*framebytes);
+    if(mark5b)
+    {
+      header[0] = (f == BAD_FRAME)?0x12345678:0xABADDEED;
+      header[1] = f;
+      header[2] = 0x56700001;
+      header[3] = 0;
+    }
+    else
+    {
+      header[0] = (f == BAD_FRAME)?0x80000001:1;
+      header[1] = (30 << 24) | f;
+      header[2] = (log2chan << 24) | (framebytes/8);
+      header[3] = ((nbits-1) << 26) | 0x4142;
+    }
+  }
+  if(mark5b)
+    sprintf(formatname, "Mark5B-%d-%d-%d", 32*nchan*nbits, nchan, nbits);
+  else
+    sprintf(formatname, "VDIF_%d-%d-%d-%d", databytes, 32*nchan*nbits, nchan, nbits);
+  ms = new_mark5_stream(new_mark5_stream_unpacker(0), new_mark5_format_generic_from_string(formatname));
+  if(ms == 0)
+  {
+    std::cout << "FAIL: mark5access could not make a stream for " << formatname << std::endl;
+    delete [] data;
+    return 1;
+  }
+
+  maxsamples = 4*framesamples;
+  unpacker = new Mk5Unpacker(mark5b?Configuration::MARK5B:Configuration::VDIF, nchan, nbits, framebytes, databytes, maxsamples);
+  m5unpacked = new f32*[nchan];
+  unpacked = new f32*[nchan];
+  for(int c=0;c<nchan;c++)
+  {
+    m5unpacked[c] = new f32[maxsamples];
+    unpacked[c] = new f32[maxsamples];
+  }
+  rotator = new cf32[maxsamples];
+  rotated = new cf32[maxsamples];
+  for(int i=0;i<maxsamples;i++)
+  {
+    rotator[i].re = rand()/(float)RAND_MAX - 0.5;
+    rotator[i].im = rand()/(float)RAND_MAX - 0.5;
+  }
+
+  for(int level=SIMD_LEVEL_SCALAR;level<=simdMaxLevel();level++)
+  {
+    simdSetLevel(level);
+    for(unsigned int s=0;s<sizeof(starts)/sizeof(int);s++)
+    {
+      for(unsigned int l=0;l<sizeof(lengths)/sizeof(int);l++)
+      {
+        m5good = mark5_unpack_with_offset(ms, data, starts[s], m5unpacked, lengths[l]);
+        good = unpacker->unpack(data, starts[s], unpacked, lengths[l]);
+        if(good != m5good)
+        {
+          std::cout << "FAIL: " << formatname << " at " << simdLevelName(level) << ", start " << starts[s] << ", length " << lengths[l] << ": " << good << " good samples, mark5access says " << m5good << std::endl;
+          numerrors++;
+        }
+        for(int c=0;c<nchan;c++)
+        {
+          if(memcmp(m5unpacked[c], unpacked[c], lengths[l]*sizeof(f32)) != 0)
+          {
+            std::cout << "FAIL: " << formatname << " at " << simdLevelName(level) << ", start " << starts[s] << ", length " << lengths[l] << ": channel " << c << " differs from mark5access" << std::endl;
+            numerrors++;
+          }
+          unpacker->unpackRotated(data, c, starts[s], rotator, rotated, lengths[l]);
+          for(int i=0;i<lengths[l];i++)
+          {
+            if(rotated[i].re != m5unpacked[c][i]*rotator[i].re || rotated[i].im != m5unpacked[c][i]*rotator[i].im)
+            {
+              std::cout << "FAIL: " << formatname << " at " << simdLevelName(level) << ", start " << starts[s] << ", length " << lengths[l] << ": rotated channel " << c << " differs at sample " << i << std::endl;
+              numerrors++;
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+  simdSetLevel(simdMaxLevel());
+
+  delete_mark5_stream(ms);
+  delete unpacker;
+  for(int c=0;c<nchan;c++)
+  {
+    delete [] m5unpacked[c];
+    delete [] unpacked[c];
+  }
+  delete [] m5unpacked;
+  delete [] unpacked;
+  delete [] rotator;
+  delete [] rotated;
+  delete [] data;
+
+  return numerrors;
+}
+
+int main(int argc, const char** argv)
+{
+  int numerrors = 0;
+  int numlayouts = 0;
+
+  for(int nbits=1;nbits<=8;nbits*=2)
+  {
+    for(int nchan=1;nchan<=16;nchan*=2)
+    {
+      if(Mk5Unpacker::isSupported(Configuration::VDIF, nchan, nbits, Configuration::REAL))
+      {
+        numerrors += checklayout(false, nchan, nbits);
+        numlayouts++;
+      }
+      if(Mk5Unpacker::isSupported(Configuration::MARK5B, nchan, nbits, Configuration::REAL))
+      {
+        numerrors += checklayout(true, nchan, nbits);
+        numlayouts++;
+      }
+    }
+  }
+
+  std::cout << "  " << numlayouts << " layouts checked against mark5access, " << numerrors << " failures" << std::endl;
+
+  std::cout << ((numerrors == 0)?"PASS":"FAIL") << std::endl;
+  return (numerrors == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
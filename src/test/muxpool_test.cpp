@@ -0,0 +1,221 @@
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
+#include "muxpool.h"
+
+// Muxes 16-thread VDIF segment by segment, as VDIFDataStream::dataRead does, once with single calls to
+// vdifmux and once with MuxPool::vdifmux sharing each segment over several threads, and requires the
+// two to agree byte for byte on every segment's output and on how much source each consumed.  The
+// frames of each thread are shuffled within a few frame times, some are dropped, one comes from a
+// thread not in the map, and one block of interloper bytes forces a segment back to a single call.
+// Then two threads mux the stream at the same time through the process's shared pool, which must give
+// each of them the same output as single calls.
+//   ./muxpool_test
+
+static const int NTHREADS = 16;
+static const int FRAMEBYTES = 1032;
+static const int FRAMESPERSECOND = 1000;
+static const int STARTSECOND = 1000;
+static const int NUMFRAMETIMES = 3000;
+static const int SHUFFLEFRAMES = 4;     // frames are shuffled within groups of this many frame times
+static const int SEGMENTFRAMES = 398;   // output frames per segment, parts of which end inside shuffled groups
+static const int NSORT = 32;
+static const int NGAP = 1000;
+static const int POOLTHREADS = 4;
+static const int INTERLOPERTIME = 1700; // interloper bytes are put in before this frame time...
+static const int INTERLOPERBYTES = 200;
+static const int FOREIGNTIME = 777;     // ...and a frame of this time comes from a foreign thread
+static const int FOREIGNTHREAD = 99;
+
+static bool dropped(int t, int thread)
+{
+  return (t*7 + thread*13) % 211 == 5;
+}
+
+static void makestream(std::vector<unsigned char> & stream)
+{
+  std::vector<int> times, threads;
+  unsigned int seed = 1;
+
+  for(int g=0;g<NUMFRAMETIMES;g+=SHUFFLEFRAMES) {
+    times.clear();
+    threads.clear();
+    for(int t=g;t<g+SHUFFLEFRAMES && t<NUMFRAMETIMES;t++) {
+      for(int i=0;i<NTHREADS;i++) {
+        if(dropped(t, i))
+          continue;
+        times.push_back(t);
+        threads.push_back(i);
+      }
+    }
+    if(g != 0) {
+      for(size_t i=times.size()-1;i>0;i--) {
+        size_t j = rand_r(&seed) % (i+1);
+        std::swap(times[i], times[j]);
+        std::swap(threads[i], threads[j]);
+      }
+    }
+    if(g == INTERLOPERTIME)
+      stream.insert(stream.end(), INTERLOPERBYTES, 0x55);
+    for(size_t i=0;i<times.size();i++) {
+      size_t offset = stream.size();
+      vdif_header * header;
+
+      stream.resize(offset + FRAMEBYTES);
+      header = (vdif_header *)&stream[offset];
+      memset(header, 0, VDIF_HEADER_BYTES);
+      setVDIFFrameSecond(header, STARTSECOND + times[i]/FRAMESPERSECOND);
+      setVDIFFrameNumber(header, times[i]%FRAMESPERSECOND);
+      setVDIFFrameBytes(header, FRAMEBYTES);
+      setVDIFThreadID(header, (times[i] == FOREIGNTIME && threads[i] == 3)?FOREIGNTHREAD:threads[i]);
+      for(int j=VDIF_HEADER_BYTES;j<FRAMEBYTES;j++)
+        stream[offset + j] = rand_r(&seed) & 0xFF;
+    }
+  }
+}
+
+typedef struct {
+  std::vector<unsigned char> output;
+  int destused, srcused;
+  int64_t startframe;
+} segmentresult;
+
+// muxes the whole stream, keeping track of the start frame as dataRead does
+static void muxstream(const std::vector<unsigned char> & stream, const struct vdif_mux * vm, MuxPool * pool, std::vector<segmentresult> & results, struct vdif_mux_statistics * stats)
+{
+  int destbytes = SEGMENTFRAMES*vm->outputFrameSize;
+  size_t index = 0;
+  int64_t startframe = -1;
+
+  resetvdifmuxstatistics(stats);
+  while(index + 2*FRAMEBYTES < stream.size()) {
+    segmentresult r;
+    int visible = destbytes*2;
+    int muxreturn;
+
+    if(index + visible > stream.size())
+      visible = stream.size() - index;
+    r.output.assign(destbytes, 0);
+    if(pool)
+      muxreturn = pool->vdifmux(&r.output[0], destbytes, &stream[index], visible, vm, startframe, stats);
+    else
+      muxreturn = vdifmux(&r.output[0], destbytes, &stream[index], visible, vm, startframe, stats);
+    if(muxreturn <= 0)
+      break;
+    r.destused = stats->destUsed;
+    r.srcused = stats->srcUsed;
+    r.startframe = stats->startFrameNumber;
+    r.output.resize(r.destused);
+    results.push_back(r);
+    if(abs(stats->srcUsed/(NTHREADS*FRAMEBYTES) - stats->nOutputFrame) < vm->nSort)
+      startframe = stats->startFrameNumber + stats->nOutputFrame;
+    else
+      startframe = -1;
+    index += stats->srcUsed;
+  }
+}
+
+// compares a run of muxstream with the single call results
+static int compare(const std::vector<segmentresult> & serial, const std::vector<segmentresult> & parallel, const char * how)
+{
+  int failures = 0;
+
+  if(serial.size() != parallel.size()) {
+    std::cout << "FAIL: " << parallel.size() << " segments were muxed " << how << ", " << serial.size() << " without" << std::endl;
+    failures++;
+  }
+  for(size_t s=0;s<serial.size() && s<parallel.size();s++) {
+    if(serial[s].destused != parallel[s].destused || serial[s].srcused != parallel[s].srcused || serial[s].startframe != parallel[s].startframe) {
+      std::cout << "FAIL: segment " << s << " used " << parallel[s].srcused << " source bytes for " << parallel[s].destused << " output bytes from frame " << parallel[s].startframe << " " << how << ", " << serial[s].srcused << " for " << serial[s].destused << " from frame " << serial[s].startframe << " without" << std::endl;
+      failures++;
+    }
+    else if(serial[s].output != parallel[s].output) {
+      std::cout << "FAIL: segment " << s << " has different output " << how << std::endl;
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+typedef struct {
+  const std::vector<unsigned char> * stream;
+  const struct vdif_mux * vm;
+  MuxPool * pool;
+  std::vector<segmentresult> results;
+  struct vdif_mux_statistics stats;
+} sharedrun;
+
+static void * runshared(void * arg)
+{
+  sharedrun * run = (sharedrun *)arg;
+
+  run->pool = MuxPool::acquireShared();
+  muxstream(*(run->stream), run->vm, run->pool, run->results, &(run->stats));
+
+  return 0;
+}
+
+int main(int argc, const char** argv)
+{
+  std::vector<unsigned char> stream;
+  std::vector<segmentresult> serial, parallel;
+  struct vdif_mux vm;
+  struct vdif_mux_statistics serialstats, parallelstats;
+  int threadids[NTHREADS];
+  int failures = 0;
+
+  for(int i=0;i<NTHREADS;i++)
+    threadids[i] = i;
+  if(configurevdifmux(&vm, FRAMEBYTES, FRAMESPERSECOND, 2, NTHREADS, threadids, NSORT, NGAP, VDIF_MUX_FLAG_RESPECTGRANULARITY) < 0) {
+    std::cout << "FAIL: could not configure the VDIF muxer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  makestream(stream);
+
+  MuxPool pool(POOLTHREADS);
+  muxstream(stream, &vm, 0, serial, &serialstats);
+  muxstream(stream, &vm, &pool, parallel, &parallelstats);
+
+  std::cout << "  " << serial.size() << " segments, " << pool.getNumParallelMuxes() << " muxed by " << pool.getNumThreads() << " threads, " << pool.getNumSerialMuxes() << " by one" << std::endl;
+  failures += compare(serial, parallel, "with the pool");
+  if(serialstats.nValidFrame != parallelstats.nValidFrame || serialstats.nWrongThread != parallelstats.nWrongThread || serialstats.nFillByte != parallelstats.nFillByte || serialstats.nGoodFrame != parallelstats.nGoodFrame || serialstats.nDuplicateFrame != parallelstats.nDuplicateFrame) {
+    std::cout << "FAIL: the statistics differ: nValidFrame " << parallelstats.nValidFrame << "/" << serialstats.nValidFrame << " nWrongThread " << parallelstats.nWrongThread << "/" << serialstats.nWrongThread << " nFillByte " << parallelstats.nFillByte << "/" << serialstats.nFillByte << " nGoodFrame " << parallelstats.nGoodFrame << "/" << serialstats.nGoodFrame << " nDuplicateFrame " << parallelstats.nDuplicateFrame << "/" << serialstats.nDuplicateFrame << " (with/without the pool)" << std::endl;
+    failures++;
+  }
+  if(pool.getNumParallelMuxes() == 0 || pool.getNumSerialMuxes() == 0)
+    std::cout << "Note: every segment was muxed the same way, so the comparison above covers only that way" << std::endl;
+
+  {
+    sharedrun runs[2];
+    pthread_t threads[2];
+    char poolthreads[16];
+
+    snprintf(poolthreads, 16, "%d", POOLTHREADS);
+    setenv("DIFX_MUX_THREADS", poolthreads, 1);
+    for(int i=0;i<2;i++) {
+      runs[i].stream = &stream;
+      runs[i].vm = &vm;
+      pthread_create(&(threads[i]), NULL, runshared, &(runs[i]));
+    }
+    for(int i=0;i<2;i++)
+      pthread_join(threads[i], NULL);
+    if(runs[0].pool == 0 || runs[0].pool != runs[1].pool) {
+      std::cout << "FAIL: the two threads were not given the same shared pool" << std::endl;
+      failures++;
+    }
+    else
+      std::cout << "  shared pool of " << runs[0].pool->getNumThreads() << " threads: " << runs[0].pool->getNumParallelMuxes() << " segments muxed in parallel by two callers" << std::endl;
+    for(int i=0;i<2;i++) {
+      failures += compare(serial, runs[i].results, "through the shared pool");
+      MuxPool::releaseShared(runs[i].pool);
+    }
+  }
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
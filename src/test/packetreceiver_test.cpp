@@ -0,0 +1,177 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "packetreceiver.h"
+
+// Sends packets over loopback UDP, each an 8 byte sequence number (the bytes to strip) followed by a
+// payload stamped with the same number, with packets of the wrong size mixed in, and checks that both
+// PacketReceiver::receive (batched, straight into the buffer) and receiveSingle (one recvfrom per
+// packet) place every good payload, in order, and nothing else.  A small batch size is used as well, so
+// rejected packets in the middle of a batch have to be squeezed out.  The sender waits for each round
+// to be received before sending the next, so no packets are lost to a full socket buffer.  Finally the
+// receiver is asked for more packets than are sent, and should return what it has when the socket
+// times out.
+//   ./packetreceiver_test
+
+static const int STRIPBYTES = 8;
+static const int PAYLOADBYTES = 8032;
+static const int PACKETSPERROUND = 20;
+static const int NUMROUNDS = 50;
+
+typedef struct {
+  int sock;
+  struct sockaddr_in address;
+  pthread_barrier_t barrier;
+  int numrounds, packetsperround;
+} senderinfo;
+
+static void stamp(char * packet, long long seq)
+{
+  memcpy(packet, &seq, sizeof(seq));
+  for(int i=0;i<PAYLOADBYTES;i+=sizeof(seq))
+    memcpy(packet + STRIPBYTES + i, &seq, sizeof(seq));
+}
+
+static void * sender(void * arg)
+{
+  senderinfo * info = (senderinfo *)arg;
+  char packet[STRIPBYTES + PAYLOADBYTES + 100];
+  long long seq = 0;
+
+  for(int r=0;r<info->numrounds;r++)
+  {
+    for(int p=0;p<info->packetsperround;p++)
+    {
+      //a short and a long packet every so often, which must be discarded
+      if((seq + r)%7 == 3)
+      {
+        stamp(packet, -1);
+        sendto(info->sock, packet, STRIPBYTES + PAYLOADBYTES - 4, 0, (struct sockaddr *)&(info->address), sizeof(info->address));
+        sendto(info->sock, packet, STRIPBYTES + PAYLOADBYTES + 100, 0, (struct sockaddr *)&(info->address), sizeof(info->address));
+      }
+      stamp(packet, seq++);
+      sendto(info->sock, packet, STRIPBYTES + PAYLOADBYTES, 0, (struct sockaddr *)&(info->address), sizeof(info->address));
+    }
+    pthread_barrier_wait(&(info->barrier));
+  }
+
+  return 0;
+}
+
+static int checkpayloads(const char * buffer, unsigned int bytes, long long firstseq, int expected)
+{
+  long long seq;
+
+  if(bytes != (unsigned int)expected*PAYLOADBYTES)
+  {
+    std::cout << "FAIL: received " << bytes << " bytes, expected " << expected*PAYLOADBYTES << std::endl;
+    return 1;
+  }
+  for(int p=0;p<expected;p++)
+  {
+    for(int i=0;i<PAYLOADBYTES;i+=sizeof(seq))
+    {
+      memcpy(&seq, buffer + p*PAYLOADBYTES + i, sizeof(seq));
+      if(seq != firstseq + p)
+      {
+        std::cout << "FAIL: payload " << firstseq + p << " contains " << seq << " at byte " << i << std::endl;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int runtest(int rxsock, senderinfo * info, int batchsize, bool single)
+{
+  PacketReceiver receiver(STRIPBYTES + PAYLOADBYTES, STRIPBYTES, batchsize);
+  char * buffer = new char[PACKETSPERROUND*PAYLOADBYTES + PAYLOADBYTES/2];
+  pthread_t thread;
+  unsigned int bytes;
+  int failures = 0;
+
+  info->numrounds = NUMROUNDS + 1;
+  info->packetsperround = PACKETSPERROUND;
+  pthread_create(&thread, 0, sender, info);
+  for(int r=0;r<NUMROUNDS;r++)
+  {
+    //the extra half payload of space must not be used
+    if(single)
+      bytes = receiver.receiveSingle(rxsock, buffer, PACKETSPERROUND*PAYLOADBYTES + PAYLOADBYTES/2);
+    else
+      bytes = receiver.receive(rxsock, buffer, PACKETSPERROUND*PAYLOADBYTES + PAYLOADBYTES/2);
+    failures += checkpayloads(buffer, bytes, (long long)r*PACKETSPERROUND, PACKETSPERROUND);
+    pthread_barrier_wait(&(info->barrier));
+  }
+
+  //ask for twice as many as the last round sends: the receiver should give up at the socket timeout
+  if(single)
+    bytes = receiver.receiveSingle(rxsock, buffer, PACKETSPERROUND*PAYLOADBYTES);
+  else
+    bytes = receiver.receive(rxsock, buffer, PACKETSPERROUND*PAYLOADBYTES);
+  pthread_barrier_wait(&(info->barrier));
+  pthread_join(thread, 0);
+  failures += checkpayloads(buffer, bytes, (long long)NUMROUNDS*PACKETSPERROUND, PACKETSPERROUND);
+  if(single)
+    bytes = receiver.receiveSingle(rxsock, buffer, PACKETSPERROUND*PAYLOADBYTES);
+  else
+    bytes = receiver.receive(rxsock, buffer, PACKETSPERROUND*PAYLOADBYTES);
+  failures += checkpayloads(buffer, bytes, 0, 0);
+
+  std::cout << "  " << (single?"recvfrom":"recvmmsg") << ", batch size " << batchsize << ": " << receiver.getNumPackets() << " packets accepted, " << receiver.getNumRejected() << " rejected in " << receiver.getNumCalls() << " system calls" << std::endl;
+  if(receiver.getNumPackets() != (NUMROUNDS+1)*PACKETSPERROUND)
+  {
+    std::cout << "FAIL: expected " << (NUMROUNDS+1)*PACKETSPERROUND << " packets to be accepted" << std::endl;
+    failures++;
+  }
+  delete [] buffer;
+
+  return failures;
+}
+
+int main(int argc, const char** argv)
+{
+  senderinfo info;
+  struct sockaddr_in address;
+  socklen_t addresslength = sizeof(address);
+  struct timeval tv;
+  int rxsock, bufbytes = 4*1024*1024;
+  int failures = 0;
+
+  rxsock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  if(rxsock < 0 || bind(rxsock, (struct sockaddr *)&address, sizeof(address)) != 0 || getsockname(rxsock, (struct sockaddr *)&address, &addresslength) != 0)
+  {
+    std::cout << "Could not open a loopback UDP socket" << std::endl;
+    return EXIT_FAILURE;
+  }
+  setsockopt(rxsock, SOL_SOCKET, SO_RCVBUF, &bufbytes, sizeof(bufbytes));
+  tv.tv_sec = 0;
+  tv.tv_usec = 200000;
+  setsockopt(rxsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  info.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  info.address = address;
+  pthread_barrier_init(&(info.barrier), 0, 2);
+
+  failures += runtest(rxsock, &info, PacketReceiver::DefaultBatchSize, false);
+  failures += runtest(rxsock, &info, 5, false);
+  failures += runtest(rxsock, &info, 1, false);
+  failures += runtest(rxsock, &info, 1, true);
+
+  pthread_barrier_destroy(&(info.barrier));
+  close(info.sock);
+  close(rxsock);
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,177 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "packetring.h"
+
+// Captures UDP packets sent over the loopback interface through a PacketRing, with one ring and with a
+// fanout group of several, stripping the Ethernet, IP and UDP headers as a raw VDIF datastream would.
+// First the packets are paced, and every payload must arrive once and in order (all the packets are one
+// flow, so the fanout hash keeps them on one ring).  Then they are sent as fast as possible, and the
+// sustained rate and the kernel's drop and ring-full counters are reported; every packet sent must be
+// either received or counted as dropped.
+// Needs root (or CAP_NET_RAW); exits with 77 (skipped) otherwise.
+//   ./packetring_test [<device>]
+
+static const int HEADERBYTES = 14 + 20 + 8;	// Ethernet (all zeros on lo), IPv4, UDP
+static const int PAYLOADBYTES = 8000;
+static const int PACKETBYTES = HEADERBYTES + PAYLOADBYTES;
+static const int PACEDPACKETS = 2000;
+static const int BLASTPACKETS = 200000;
+static const int SLOTPACKETS = 500;
+
+typedef struct {
+  int sock;
+  struct sockaddr_in address;
+  long long firstseq, numpackets;
+  bool paced;
+  volatile bool done;
+} senderinfo;
+
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static void * sender(void * arg)
+{
+  senderinfo * info = (senderinfo *)arg;
+  char packet[PAYLOADBYTES];
+
+  memset(packet, 0, PAYLOADBYTES);
+  usleep(20000); //let the receiver start waiting
+  for(long long i=0;i<info->numpackets;i++)
+  {
+    long long seq = info->firstseq + i;
+
+    memcpy(packet, &seq, sizeof(seq));
+    memcpy(packet + PAYLOADBYTES - sizeof(seq), &seq, sizeof(seq));
+    sendto(info->sock, packet, PAYLOADBYTES, 0, (struct sockaddr *)&(info->address), sizeof(info->address));
+    if(info->paced && i%20 == 19)
+      usleep(1000);
+  }
+  info->done = true;
+
+  return 0;
+}
+
+static int runtest(const char * device, int numrings, int txsock, struct sockaddr_in address)
+{
+  PacketRing ring(device, numrings);
+  senderinfo info;
+  pthread_t thread;
+  char * slot = new char[SLOTPACKETS*PAYLOADBYTES];
+  unsigned int bytes;
+  long long seq, expected = 0, received = 0;
+  int failures = 0;
+  double t0, dt;
+
+  if(!ring.isOpen())
+  {
+    delete [] slot;
+    return -1;
+  }
+
+  //paced: everything must arrive, in order
+  info.sock = txsock;
+  info.address = address;
+  info.firstseq = 0;
+  info.numpackets = PACEDPACKETS;
+  info.paced = true;
+  info.done = false;
+  pthread_create(&thread, 0, sender, &info);
+  do
+  {
+    bytes = ring.receive(slot, SLOTPACKETS*PAYLOADBYTES, PACKETBYTES, HEADERBYTES);
+    for(unsigned int p=0;p<bytes/PAYLOADBYTES;p++)
+    {
+      memcpy(&seq, slot + p*PAYLOADBYTES, sizeof(seq));
+      if(seq != expected || memcmp(slot + p*PAYLOADBYTES, slot + (p+1)*PAYLOADBYTES - sizeof(seq), sizeof(seq)) != 0)
+      {
+        if(failures == 0)
+          std::cout << "FAIL: payload " << expected << " arrived as " << seq << std::endl;
+        failures++;
+      }
+      expected = seq + 1;
+    }
+  } while(bytes > 0 || !info.done);
+  pthread_join(thread, 0);
+  if(ring.getNumPackets() != PACEDPACKETS)
+  {
+    std::cout << "FAIL: " << ring.getNumPackets() << " of " << PACEDPACKETS << " paced packets were received, " << ring.getNumDropped() << " dropped" << std::endl;
+    failures++;
+  }
+
+  //as fast as possible: measure
+  info.firstseq = PACEDPACKETS;
+  info.numpackets = BLASTPACKETS;
+  info.paced = false;
+  info.done = false;
+  t0 = now();
+  pthread_create(&thread, 0, sender, &info);
+  do
+  {
+    bytes = ring.receive(slot, SLOTPACKETS*PAYLOADBYTES, PACKETBYTES, HEADERBYTES);
+  } while(bytes > 0 || !info.done);
+  pthread_join(thread, 0);
+  dt = now() - t0 - 0.02 - PacketRing::PollTimeoutMs*1e-3;
+  received = ring.getNumPackets() - PACEDPACKETS;
+
+  std::cout << "  " << numrings << " ring(s) on " << device << ": " << received << " of " << BLASTPACKETS << " packets at " << received/dt << " packets/s (" << 8e-9*received*PACKETBYTES/dt << " Gbps); " << ring.getNumDropped() << " dropped by the kernel, ring full " << ring.getNumFreezes() << " times, " << ring.getNumRejected() << " other frames ignored" << std::endl;
+  if(received + ring.getNumDropped() != BLASTPACKETS)
+  {
+    std::cout << "FAIL: " << BLASTPACKETS - received - ring.getNumDropped() << " packets are unaccounted for" << std::endl;
+    failures++;
+  }
+  delete [] slot;
+
+  return failures;
+}
+
+int main(int argc, const char** argv)
+{
+  const char * device = (argc > 1)?argv[1]:"lo";
+  struct sockaddr_in address;
+  socklen_t addresslength = sizeof(address);
+  int sinksock, txsock, failures = 0, result;
+
+  //somewhere for the packets to go, so the kernel doesn't answer them
+  sinksock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  if(sinksock < 0 || bind(sinksock, (struct sockaddr *)&address, sizeof(address)) != 0 || getsockname(sinksock, (struct sockaddr *)&address, &addresslength) != 0)
+  {
+    std::cout << "Could not open a loopback UDP socket" << std::endl;
+    return EXIT_FAILURE;
+  }
+  txsock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+  for(int numrings=1;numrings<=2;numrings++)
+  {
+    result = runtest(device, numrings, txsock, address);
+    if(result < 0)
+    {
+      std::cout << "Could not open a packet ring on " << device << " (needs root or CAP_NET_RAW) - skipping" << std::endl;
+      close(txsock);
+      close(sinksock);
+      return 77;
+    }
+    failures += result;
+  }
+  close(txsock);
+  close(sinksock);
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
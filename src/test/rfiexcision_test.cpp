@@ -0,0 +1,151 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "architecture.h"
+#include "mode.h"
+
+// Injects synthetic RFI into a window of noise spectra and checks that Mode::exciseBandRFI
+// blanks exactly the affected FFTs and channels, at every SIMD level the host supports.
+//   ./rfiexcision_test
+
+static const int NUMFFTS = 128;          // a carrier is only caught when this exceeds 4*THRESHOLD^2
+static const int NUMCHANNELS = 1024;
+static const int CARRIERCHANNEL = 100;   // steady carrier: kurtosis well below zero
+static const int PULSEDCHANNEL = 500;    // intermittent: kurtosis well above zero
+static const int BURSTFFT = 7;           // broadband burst: one bright FFT
+static const f32 THRESHOLD = 5.0;
+
+static f32 gaussian()
+{
+  double u1 = (rand() + 1.0)/(RAND_MAX + 2.0);
+  double u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+  return sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+}
+
+// complex Gaussian noise with a bandpass, optionally with the injected RFI
+static void fillwindow(cf32 ** spectra, bool rfi)
+{
+  f32 gain, phase;
+
+  for(int n=0;n<NUMFFTS;n++)
+  {
+    for(int k=0;k<NUMCHANNELS;k++)
+    {
+      gain = 0.2 + sin(M_PI*(k + 0.5)/NUMCHANNELS);
+      spectra[n][k].re = gain*gaussian();
+      spectra[n][k].im = gain*gaussian();
+      if(rfi && k == CARRIERCHANNEL)
+      {
+        phase = 0.37*n;
+        spectra[n][k].re += 20.0*cos(phase);
+        spectra[n][k].im += 20.0*sin(phase);
+      }
+      if(rfi && k == PULSEDCHANNEL && (n == 3 || n == 4 || n == 20))
+      {
+        spectra[n][k].re *= 30.0;
+        spectra[n][k].im *= 30.0;
+      }
+      if(rfi && n == BURSTFFT)
+      {
+        spectra[n][k].re *= 1.5;
+        spectra[n][k].im *= 1.5;
+      }
+    }
+  }
+}
+
+static bool iszero(const cf32 * v, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    if(v[i].re != 0.0 || v[i].im != 0.0)
+      return false;
+  }
+  return true;
+}
+
+static int check(bool ok, const char * what)
+{
+  if(!ok)
+    std::cout << "FAIL: " << what << std::endl;
+  return ok?0:1;
+}
+
+static int testlevel()
+{
+  cf32 * spectra[NUMFFTS];
+  f32 weights[NUMFFTS];
+  f32 * s1 = vectorAlloc_f32(NUMCHANNELS);
+  f32 * s2 = vectorAlloc_f32(NUMCHANNELS);
+  f32 * sk = vectorAlloc_f32(NUMCHANNELS);
+  f32 * power = vectorAlloc_f32(2*NUMFFTS);
+  int failures = 0;
+  int blankedffts, blankedchannels;
+  bool allblanked;
+
+  for(int n=0;n<NUMFFTS;n++)
+    spectra[n] = vectorAlloc_cf32(NUMCHANNELS);
+
+  // with RFI: the burst FFT and both contaminated channels go, and very little else
+  fillwindow(spectra, true);
+  for(int n=0;n<NUMFFTS;n++)
+    weights[n] = 1.0;
+  weights[NUMFFTS-1] = 0.0; // an FFT with no data, which must be left out of the statistics
+  blankedffts = Mode::exciseBandRFI(spectra, weights, NUMFFTS, NUMCHANNELS, THRESHOLD, THRESHOLD, s1, s2, sk, power, &blankedchannels);
+  std::cout << "  with RFI: " << blankedffts << " FFTs and " << blankedchannels << " channels blanked" << std::endl;
+  failures += check(blankedffts == 1, "exactly one FFT blanked");
+  failures += check(weights[BURSTFFT] == 0.0 && iszero(spectra[BURSTFFT], NUMCHANNELS), "burst FFT blanked");
+  allblanked = true;
+  for(int n=0;n<NUMFFTS-1;n++)
+  {
+    if(spectra[n][CARRIERCHANNEL].re != 0.0 || spectra[n][PULSEDCHANNEL].re != 0.0)
+      allblanked = false;
+  }
+  failures += check(allblanked, "carrier and pulsed channels blanked in every FFT");
+  failures += check(blankedchannels >= 2 && blankedchannels <= 2 + NUMCHANNELS/100, "few clean channels blanked");
+  failures += check(weights[0] == (NUMCHANNELS - blankedchannels)/(f32)NUMCHANNELS, "weights reduced by the fraction of channels blanked");
+  failures += check(weights[NUMFFTS-1] == 0.0 && !iszero(spectra[NUMFFTS-1], NUMCHANNELS), "FFT without data untouched");
+
+  // clean noise: nothing (or next to nothing) is blanked
+  fillwindow(spectra, false);
+  for(int n=0;n<NUMFFTS;n++)
+    weights[n] = 1.0;
+  blankedffts = Mode::exciseBandRFI(spectra, weights, NUMFFTS, NUMCHANNELS, THRESHOLD, THRESHOLD, s1, s2, sk, power, &blankedchannels);
+  std::cout << "  clean: " << blankedffts << " FFTs and " << blankedchannels << " channels blanked" << std::endl;
+  failures += check(blankedffts == 0, "no clean FFT blanked");
+  failures += check(blankedchannels <= NUMCHANNELS/100, "few clean channels blanked");
+
+  // both tests off: nothing changes
+  fillwindow(spectra, true);
+  for(int n=0;n<NUMFFTS;n++)
+    weights[n] = 1.0;
+  blankedffts = Mode::exciseBandRFI(spectra, weights, NUMFFTS, NUMCHANNELS, 0.0, 0.0, s1, s2, sk, power, &blankedchannels);
+  failures += check(blankedffts == 0 && blankedchannels == 0 && weights[BURSTFFT] == 1.0 && !iszero(spectra[BURSTFFT], NUMCHANNELS), "nothing blanked with the thresholds off");
+
+  for(int n=0;n<NUMFFTS;n++)
+    vectorFree(spectra[n]);
+  vectorFree(s1);
+  vectorFree(s2);
+  vectorFree(sk);
+  vectorFree(power);
+
+  return failures;
+}
+
+int main(int argc, char** argv)
+{
+  const char * levelnames[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+  int failures = 0;
+
+  for(int level=SIMD_LEVEL_SCALAR;level<=simdMaxLevel();level++)
+  {
+    srand(12345);
+    simdSetLevel(level);
+    std::cout << levelnames[level] << ":" << std::endl;
+    failures += testlevel();
+  }
+  simdSetLevel(simdMaxLevel());
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
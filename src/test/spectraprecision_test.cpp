@@ -0,0 +1,198 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "architecture.h"
+#include "mode.h"
+
+// Measures the SNR lost by cross-multiplying station spectra packed to reduced precision (SPECTRA PRECISION
+// FLOAT16 or INT8) with Mode::packBandSpectra, on synthetic correlated noise, at every SIMD level the host
+// supports, cross-multiplied with the kernels Core::xmacTiledPacked uses.
+//   ./spectraprecision_test
+//
+// The visibility of each channel is normalised by the full precision autocorrelations, giving a correlation
+// coefficient r.  Its thermal noise is the scatter of the full precision r about the injected correlation,
+// and packing adds noise of mean square <|r_packed - r_full|^2> = eps times the thermal variance, so the SNR
+// falls by 1 - 1/sqrt(1 + eps).  For Gaussian noise INT8 quantises each part with a step of 1/24 of its
+// standard deviation, adding 1/(12*24^2) of each station's noise power: eps ~ 2.9e-4, a loss of ~1.5e-4.
+// FLOAT16 keeps 11 significant bits: eps ~ 1e-7.
+
+static const int NUMFFTS = 64;
+static const int NUMCHANNELS = 1000;     // not a multiple of the SIMD blocks, so the scalar tails run too
+static const f32 CORRELATION = 0.05;     // the fraction of each station's power that is common
+static const f32 AMPLITUDE = 3000.0;     // well beyond the half precision range once squared
+static const int LINECHANNEL = 300;      // a bright spectral line, 40 times the noise
+static const int EMPTYCHANNEL = 700;     // no data at all
+static const int EMPTYFFT = 9;           // an FFT without data
+static const f32 MAX_INT8_LOSS = 5.0e-4;
+static const f32 MAX_FLOAT16_LOSS = 1.0e-5;
+
+static f32 gaussian()
+{
+  double u1 = (rand() + 1.0)/(RAND_MAX + 2.0);
+  double u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+  return sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+}
+
+// two stations seeing a common signal in their own noise, through different bandpasses
+static void fillstations(cf32 ** spectra1, cf32 ** spectra2, f32 * weights)
+{
+  f32 common = sqrt(CORRELATION/2.0);
+  f32 independent = sqrt((1.0 - CORRELATION)/2.0);
+  f32 gain1, gain2, re, im;
+
+  for(int n=0;n<NUMFFTS;n++)
+  {
+    weights[n] = (n == EMPTYFFT)?0.0:1.0;
+    for(int k=0;k<NUMCHANNELS;k++)
+    {
+      gain1 = AMPLITUDE*(0.2 + sin(M_PI*(k + 0.5)/NUMCHANNELS));
+      gain2 = AMPLITUDE*(1.0 + 0.5*cos(3.0*M_PI*k/NUMCHANNELS));
+      if(k == LINECHANNEL)
+      {
+        gain1 *= 40.0;
+        gain2 *= 40.0;
+      }
+      if(k == EMPTYCHANNEL || n == EMPTYFFT)
+      {
+        gain1 = 0.0;
+        gain2 = 0.0;
+      }
+      re = common*gaussian();
+      im = common*gaussian();
+      spectra1[n][k].re = gain1*(re + independent*gaussian());
+      spectra1[n][k].im = gain1*(im + independent*gaussian());
+      spectra2[n][k].re = gain2*(re + independent*gaussian());
+      spectra2[n][k].im = gain2*(im + independent*gaussian());
+    }
+  }
+}
+
+static int check(bool ok, const char * what)
+{
+  if(!ok)
+    std::cout << "FAIL: " << what << std::endl;
+  return ok?0:1;
+}
+
+static int testprecision(Configuration::spectraprecision precision, cf32 ** spectra1, cf32 ** spectra2, f32 * weights, f32 maxloss)
+{
+  u8 * packed1[NUMFFTS];
+  u8 * packed2[NUMFFTS];
+  f32 * scales1 = vectorAlloc_f32(NUMCHANNELS);
+  f32 * scales2 = vectorAlloc_f32(NUMCHANNELS);
+  f32 * invscales = vectorAlloc_f32(NUMCHANNELS);
+  cf32 * power = vectorAlloc_cf32(NUMCHANNELS);
+  cf32 * auto1 = vectorAlloc_cf32(NUMCHANNELS);
+  cf32 * auto2 = vectorAlloc_cf32(NUMCHANNELS);
+  cf32 * fullvis = vectorAlloc_cf32(NUMCHANNELS);
+  cf32 * packedvis = vectorAlloc_cf32(NUMCHANNELS);
+  int packedbytes = (precision == Configuration::FLOAT16SPECTRA)?sizeof(cf16):sizeof(cs8);
+  int failures = 0;
+  int numused;
+  double norm, fullre, fullim, packedre, packedim, thermal, quantisation, meanfull, meanpacked, eps, loss;
+
+  for(int n=0;n<NUMFFTS;n++)
+  {
+    packed1[n] = vectorAlloc_u8(packedbytes*NUMCHANNELS);
+    packed2[n] = vectorAlloc_u8(packedbytes*NUMCHANNELS);
+  }
+  Mode::packBandSpectra(spectra1, weights, NUMFFTS, NUMCHANNELS, precision, packed1, scales1, invscales, power);
+  Mode::packBandSpectra(spectra2, weights, NUMFFTS, NUMCHANNELS, precision, packed2, scales2, invscales, power);
+
+  vectorZero_cf32(auto1, NUMCHANNELS);
+  vectorZero_cf32(auto2, NUMCHANNELS);
+  vectorZero_cf32(fullvis, NUMCHANNELS);
+  vectorZero_cf32(packedvis, NUMCHANNELS);
+  for(int n=0;n<NUMFFTS;n++)
+  {
+    vectorAddProductConj_cf32(spectra1[n], spectra1[n], auto1, NUMCHANNELS);
+    vectorAddProductConj_cf32(spectra2[n], spectra2[n], auto2, NUMCHANNELS);
+    vectorAddProductConj_cf32(spectra1[n], spectra2[n], fullvis, NUMCHANNELS);
+  }
+  if(precision == Configuration::FLOAT16SPECTRA)
+    vectorXmacScaled_cf16(packed1, packed2, NUMFFTS, 0, scales1, scales2, packedvis, NUMCHANNELS);
+  else
+    vectorXmacScaled_cs8(packed1, packed2, NUMFFTS, 0, scales1, scales2, packedvis, NUMCHANNELS);
+
+  numused = 0;
+  meanfull = 0.0;
+  meanpacked = 0.0;
+  thermal = 0.0;
+  quantisation = 0.0;
+  for(int k=0;k<NUMCHANNELS;k++)
+  {
+    if(k == EMPTYCHANNEL)
+      continue;
+    norm = 1.0/sqrt((double)auto1[k].re*auto2[k].re);
+    fullre = fullvis[k].re*norm;
+    fullim = fullvis[k].im*norm;
+    packedre = packedvis[k].re*norm;
+    packedim = packedvis[k].im*norm;
+    meanfull += fullre;
+    meanpacked += packedre;
+    thermal += (fullre - CORRELATION)*(fullre - CORRELATION) + fullim*fullim;
+    quantisation += (packedre - fullre)*(packedre - fullre) + (packedim - fullim)*(packedim - fullim);
+    numused++;
+  }
+  meanfull /= numused;
+  meanpacked /= numused;
+  eps = quantisation/thermal;
+  loss = 1.0 - 1.0/sqrt(1.0 + eps);
+  std::cout << "  " << ((precision == Configuration::FLOAT16SPECTRA)?"FLOAT16":"INT8") << ": correlation " << meanpacked << " (full precision " << meanfull << "), added noise " << eps << " of thermal, SNR loss " << loss << std::endl;
+  failures += check(loss < maxloss, "SNR loss within its bound");
+  failures += check(fabs(meanpacked - meanfull) < 0.01*sqrt(thermal/numused), "correlation recovered");
+  failures += check(scales1[EMPTYCHANNEL] == 0.0 && packedvis[EMPTYCHANNEL].re == 0.0 && packedvis[EMPTYCHANNEL].im == 0.0, "empty channel packs to zero");
+  norm = 1.0/sqrt((double)auto1[LINECHANNEL].re*auto2[LINECHANNEL].re);
+  failures += check(fabs(packedvis[LINECHANNEL].re - fullvis[LINECHANNEL].re)*norm < 0.1*sqrt(thermal/numused), "bright line channel kept");
+
+  for(int n=0;n<NUMFFTS;n++)
+  {
+    vectorFree(packed1[n]);
+    vectorFree(packed2[n]);
+  }
+  vectorFree(scales1);
+  vectorFree(scales2);
+  vectorFree(invscales);
+  vectorFree(power);
+  vectorFree(auto1);
+  vectorFree(auto2);
+  vectorFree(fullvis);
+  vectorFree(packedvis);
+
+  return failures;
+}
+
+int main(int argc, char** argv)
+{
+  const char * levelnames[] = { "scalar", "SSE2", "AVX2", "AVX-512" };
+  cf32 * spectra1[NUMFFTS];
+  cf32 * spectra2[NUMFFTS];
+  f32 weights[NUMFFTS];
+  int failures = 0;
+
+  for(int n=0;n<NUMFFTS;n++)
+  {
+    spectra1[n] = vectorAlloc_cf32(NUMCHANNELS);
+    spectra2[n] = vectorAlloc_cf32(NUMCHANNELS);
+  }
+
+  for(int level=SIMD_LEVEL_SCALAR;level<=simdMaxLevel();level++)
+  {
+    srand(12345);
+    simdSetLevel(level);
+    std::cout << levelnames[level] << ":" << std::endl;
+    fillstations(spectra1, spectra2, weights);
+    failures += testprecision(Configuration::FLOAT16SPECTRA, spectra1, spectra2, weights, MAX_FLOAT16_LOSS);
+    failures += testprecision(Configuration::INT8SPECTRA, spectra1, spectra2, weights, MAX_INT8_LOSS);
+  }
+  simdSetLevel(simdMaxLevel());
+
+  for(int n=0;n<NUMFFTS;n++)
+  {
+    vectorFree(spectra1[n]);
+    vectorFree(spectra2[n]);
+  }
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,270 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "packetreceiver.h"
+#include "vdifreassembler.h"
+
+// Sends 4-thread VDIF over loopback UDP, one frame per packet, shuffled within a few frame times, with
+// frames dropped, one duplicated, one sent long after its window, one from a thread not in the map and a
+// gap of several windows, and reassembles them as VDIFNetworkDataStream does: windows are filled from
+// batches of received frames until they close or the socket times out.  Every frame slot of every window
+// must hold the right frame time and thread, with the sent payload or, for a dropped frame, an invalid
+// frame of fill pattern, and the per-thread statistics must match the ones worked out from what was sent.
+//   ./vdifreassembler_test
+
+static const int NTHREADS = 4;
+static const int THREADIDS[NTHREADS] = {0, 1, 2, 3};
+static const int FOREIGNTHREAD = 7;
+static const int FRAMEBYTES = 1032;
+static const int FRAMESPERSECOND = 1000;
+static const int STARTSECOND = 1000;
+static const int NUMFRAMETIMES = 2500;
+static const int GAPSTART = 1500;	// frame times GAPSTART to GAPEND-1 are never sent
+static const int GAPEND = 1800;
+static const int WINDOWFRAMES = 100;
+static const int REORDERFRAMES = 20;
+static const int SHUFFLEFRAMES = 8;	// frames are shuffled within groups of this many frame times
+static const int DUPLICATETIME = 10;
+static const int LATETIME = 50;	// resent after frame time LATERESEND
+static const int LATERESEND = 400;
+static const uint32_t FILLWORD = 0x11223344;
+
+typedef struct {
+  int sock;
+  struct sockaddr_in address;
+  std::vector<std::vector<char> > *packets;
+} senderinfo;
+
+static void makeframe(std::vector<char> & frame, long long t, int threadid)
+{
+  vdif_header *vh;
+  uint32_t stamp = (uint32_t)(t*8 + threadid);
+
+  frame.assign(FRAMEBYTES, 0);
+  vh = reinterpret_cast<vdif_header *>(&frame[0]);
+  setVDIFFrameSecond(vh, STARTSECOND + t/FRAMESPERSECOND);
+  setVDIFFrameNumber(vh, t%FRAMESPERSECOND);
+  setVDIFThreadID(vh, threadid);
+  setVDIFFrameBytes(vh, FRAMEBYTES);
+  for(int i=VDIF_HEADER_BYTES;i<FRAMEBYTES;i+=4)
+    memcpy(&frame[i], &stamp, 4);
+}
+
+static bool dropped(long long t, int threadindex)
+{
+  //scattered losses, none at the end where a short final window couldn't show them
+  return t < NUMFRAMETIMES - 2*REORDERFRAMES && (t*7 + threadindex*13) % 97 == 5;
+}
+
+static void * sender(void * arg)
+{
+  senderinfo * info = (senderinfo *)arg;
+
+  usleep(20000);
+  for(size_t i=0;i<info->packets->size();i++)
+  {
+    sendto(info->sock, &(*info->packets)[i][0], FRAMEBYTES, 0, (struct sockaddr *)&(info->address), sizeof(info->address));
+    if(i%32 == 31)
+      usleep(200); //stay well within the socket buffer
+  }
+
+  return 0;
+}
+
+int main(int argc, const char** argv)
+{
+  std::vector<std::vector<char> > packets;
+  std::vector<long long> sendtimes;
+  std::vector<int> sendthreads;
+  long long expreceived[NTHREADS], expmissing[NTHREADS], expreordered[NTHREADS], lasttime[NTHREADS];
+  senderinfo info;
+  pthread_t thread;
+  struct sockaddr_in address;
+  socklen_t addresslength = sizeof(address);
+  struct timeval tv;
+  int rxsock, bufbytes = 16*1024*1024;
+  int failures = 0, nwindows = 0, ngaps = 0;
+  long long nexttime = 0;
+  char * window = new char[WINDOWFRAMES*NTHREADS*FRAMEBYTES];
+
+  //what to send, and in what order
+  unsigned int seed = 1;
+  for(long long g=0;g<NUMFRAMETIMES;g+=SHUFFLEFRAMES)
+  {
+    std::vector<long long> times;
+    std::vector<int> threads;
+
+    for(long long t=g;t<g+SHUFFLEFRAMES && t<NUMFRAMETIMES;t++)
+    {
+      if(t >= GAPSTART && t < GAPEND)
+        continue;
+      for(int i=0;i<NTHREADS;i++)
+      {
+        times.push_back(t);
+        threads.push_back(i);
+      }
+    }
+    //the first frames of the scan and after the gap start the windows, so they aren't shuffled
+    if(g != 0 && g != GAPEND && !times.empty())
+    {
+      for(size_t i=times.size()-1;i>0;i--)
+      {
+        size_t j = rand_r(&seed) % (i+1);
+        std::swap(times[i], times[j]);
+        std::swap(threads[i], threads[j]);
+      }
+    }
+    for(size_t i=0;i<times.size();i++)
+    {
+      if(dropped(times[i], threads[i]))
+        continue;
+      sendtimes.push_back(times[i]);
+      sendthreads.push_back(threads[i]);
+      if(times[i] == DUPLICATETIME && threads[i] == 1)
+      {
+        sendtimes.push_back(times[i]);
+        sendthreads.push_back(threads[i]);
+      }
+    }
+    if(g == LATERESEND)
+    {
+      sendtimes.push_back(LATETIME);
+      sendthreads.push_back(0);
+      sendtimes.push_back(g);
+      sendthreads.push_back(-1);
+    }
+  }
+  packets.resize(sendtimes.size());
+  for(size_t i=0;i<sendtimes.size();i++)
+    makeframe(packets[i], sendtimes[i], (sendthreads[i] < 0)?FOREIGNTHREAD:THREADIDS[sendthreads[i]]);
+
+  //the statistics the reassembler should arrive at
+  for(int i=0;i<NTHREADS;i++)
+  {
+    expreceived[i] = expmissing[i] = expreordered[i] = 0;
+    lasttime[i] = -1;
+    for(long long t=0;t<NUMFRAMETIMES;t++)
+      if(!(t >= GAPSTART && t < GAPEND) && dropped(t, i))
+        expmissing[i]++;
+  }
+  for(size_t i=0;i<sendtimes.size();i++)
+  {
+    int ti = sendthreads[i];
+
+    if(ti < 0)
+      continue;
+    expreceived[ti]++;
+    if(sendtimes[i] < lasttime[ti])
+      expreordered[ti]++;
+    else
+      lasttime[ti] = sendtimes[i];
+  }
+
+  rxsock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  if(rxsock < 0 || bind(rxsock, (struct sockaddr *)&address, sizeof(address)) != 0 || getsockname(rxsock, (struct sockaddr *)&address, &addresslength) != 0)
+  {
+    std::cout << "Could not open a loopback UDP socket" << std::endl;
+    return EXIT_FAILURE;
+  }
+  setsockopt(rxsock, SOL_SOCKET, SO_RCVBUF, &bufbytes, sizeof(bufbytes));
+  tv.tv_sec = 0;
+  tv.tv_usec = 200000;
+  setsockopt(rxsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  info.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  info.address = address;
+  info.packets = &packets;
+  pthread_create(&thread, 0, sender, &info);
+
+  PacketReceiver receiver(FRAMEBYTES, 0);
+  VDIFReassembler reassembler(FRAMEBYTES, FRAMESPERSECOND, NTHREADS, THREADIDS, REORDERFRAMES);
+  for(;;)
+  {
+    unsigned int bytes;
+
+    reassembler.startWindow(window, WINDOWFRAMES*NTHREADS*FRAMEBYTES);
+    while(!reassembler.placeStaged())
+    {
+      unsigned int staged = receiver.receive(rxsock, reassembler.getStagingBuffer(), reassembler.getStagingBytes());
+
+      if(staged == 0)
+        break;
+      reassembler.setStagedBytes(staged);
+    }
+    bytes = reassembler.finishWindow();
+    if(bytes == 0)
+      break;
+    nwindows++;
+
+    for(unsigned int s=0;s<bytes/FRAMEBYTES;s++)
+    {
+      const char * frame = window + s*FRAMEBYTES;
+      const vdif_header * vh = reinterpret_cast<const vdif_header *>(frame);
+      long long t = (long long)(getVDIFFrameSecond(vh) - STARTSECOND)*FRAMESPERSECOND + getVDIFFrameNumber(vh);
+      int ti = s%NTHREADS;
+      uint32_t word, expected;
+
+      if(s == 0 && t != nexttime)
+      {
+        if(nexttime == GAPSTART && t == GAPEND)
+          ngaps++;
+        else if(failures++ == 0)
+          std::cout << "FAIL: window " << nwindows << " starts at frame time " << t << ", expected " << nexttime << std::endl;
+        nexttime = t;
+      }
+      if(t != nexttime + s/NTHREADS || getVDIFThreadID(vh) != THREADIDS[ti])
+      {
+        if(failures++ == 0)
+          std::cout << "FAIL: window " << nwindows << " slot " << s << " holds frame time " << t << " thread " << getVDIFThreadID(vh) << std::endl;
+        continue;
+      }
+      memcpy(&word, frame + FRAMEBYTES - 4, 4);
+      expected = dropped(t, ti)?FILLWORD:(uint32_t)(t*8 + THREADIDS[ti]);
+      if(word != expected || getVDIFFrameInvalid(vh) != (dropped(t, ti)?1:0))
+      {
+        if(failures++ == 0)
+          std::cout << "FAIL: frame time " << t << " thread " << THREADIDS[ti] << " has payload " << word << " and invalid=" << getVDIFFrameInvalid(vh) << ", expected " << expected << std::endl;
+      }
+    }
+    nexttime += bytes/(NTHREADS*FRAMEBYTES);
+  }
+  pthread_join(thread, 0);
+
+  std::cout << "  " << packets.size() << " frames sent, " << nwindows << " windows, " << reassembler.getNumHeldOver() << " frames held over, " << reassembler.getNumSkipped() << " frame times skipped, " << reassembler.getNumForeign() << " foreign" << std::endl;
+  for(int i=0;i<NTHREADS;i++)
+  {
+    std::cout << "  thread " << THREADIDS[i] << ": " << reassembler.getNumReceived(i) << " received, " << reassembler.getNumMissing(i) << " missing, " << reassembler.getNumReordered(i) << " reordered, " << reassembler.getNumLate(i) << " late, " << reassembler.getNumDuplicate(i) << " duplicate" << std::endl;
+    if(reassembler.getNumReceived(i) != expreceived[i] || reassembler.getNumMissing(i) != expmissing[i] || reassembler.getNumReordered(i) != expreordered[i] ||
+       reassembler.getNumLate(i) != ((i == 0)?1:0) || reassembler.getNumDuplicate(i) != ((i == 1)?1:0))
+    {
+      std::cout << "FAIL: expected " << expreceived[i] << " received, " << expmissing[i] << " missing, " << expreordered[i] << " reordered, " << ((i == 0)?1:0) << " late, " << ((i == 1)?1:0) << " duplicate" << std::endl;
+      failures++;
+    }
+  }
+  if(nexttime != NUMFRAMETIMES || ngaps != 1 || reassembler.getNumForeign() != 1 || reassembler.getNumHeldOver() == 0 || reassembler.getNumSkipped() != GAPEND - GAPSTART)
+  {
+    std::cout << "FAIL: reassembly ended at frame time " << nexttime << " (expected " << NUMFRAMETIMES << ") with " << ngaps << " gaps (expected 1)" << std::endl;
+    failures++;
+  }
+  if(receiver.getNumPackets() != (long long)packets.size())
+    std::cout << "Note: " << packets.size() - receiver.getNumPackets() << " packets were lost in the socket buffer, so the counts above can't match" << std::endl;
+
+  close(info.sock);
+  close(rxsock);
+  delete [] window;
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "viswriter.h"
+
+// Writes records of varying length to several files through a VisWriter, the way Visibility::writedifx
+// does (one buffer per integration, one region of it per file, and a second buffer whose contents go
+// after the first in file 0), and checks every file byte for byte.  Runs with one and several writer
+// threads, with only two buffers so the writer has to recycle them, with direct I/O (which falls back
+// to buffered writes on file systems that don't support it), and with fewer files allowed open than
+// are written, so files are closed and reopened along the way.  After each run the files are also
+// checked to hold every integration ended before the last, before flush is called.
+//   ./viswriter_test [<directory>]
+// The files are written to a temporary directory under <directory> (default /tmp) and removed afterwards.
+
+static const int NUMFILES = 3;
+static const int NUMINTEGRATIONS = 60;
+static const int BUFFERBYTES = 3*1024*1024;
+
+// deterministic, and different for every record
+static void fillrecord(char * dest, int bytes, int integration, int file)
+{
+  for(int i=0;i<bytes;i++)
+    dest[i] = (char)((i*7 + integration*13 + file*101) & 0xff);
+}
+
+static int recordbytes(int integration, int file)
+{
+  return 1000 + ((integration*7919 + file*104729)%(BUFFERBYTES/NUMFILES - 2000));
+}
+
+static int autobytes(int integration)
+{
+  return (integration%3 == 0)?0:(500 + integration*37);
+}
+
+static int runtest(const char * directory, int numthreads, bool directio, int maxfiles)
+{
+  char filename[NUMFILES][256];
+  std::string expected[NUMFILES];
+  std::string contents;
+  char * buffer;
+  char * record;
+  int bytes, failures = 0;
+  long long synced[NUMFILES];
+  struct stat filestat;
+  FILE * f;
+  VisWriter * writer;
+
+  for(int i=0;i<NUMFILES;i++)
+  {
+    sprintf(filename[i], "%s/DIFX_00000_000000.s%04d.b0000", directory, i);
+    unlink(filename[i]);
+  }
+
+  writer = new VisWriter(2, BUFFERBYTES, numthreads, directio, maxfiles);
+  record = new char[BUFFERBYTES];
+  for(int t=0;t<NUMINTEGRATIONS;t++)
+  {
+    buffer = writer->acquireBuffer();
+    for(int i=0;i<NUMFILES;i++)
+    {
+      bytes = recordbytes(t, i);
+      fillrecord(buffer + i*(BUFFERBYTES/NUMFILES), bytes, t, i);
+      expected[i].append(buffer + i*(BUFFERBYTES/NUMFILES), bytes);
+      writer->queueWrite(buffer, i*(BUFFERBYTES/NUMFILES), bytes, filename[i]);
+    }
+    writer->releaseBuffer(buffer);
+
+    //the autocorrelations follow in a second buffer
+    buffer = writer->acquireBuffer();
+    bytes = autobytes(t);
+    fillrecord(buffer, bytes, t, NUMFILES);
+    expected[0].append(buffer, bytes);
+    writer->queueWrite(buffer, 0, bytes, filename[0]);
+    writer->releaseBuffer(buffer);
+    writer->endIntegration();
+    if(t == NUMINTEGRATIONS-2)
+    {
+      for(int i=0;i<NUMFILES;i++)
+        synced[i] = expected[i].size();
+    }
+  }
+
+  //every integration before the last must reach the file without a flush; give the writer time to catch up
+  for(int i=0;i<NUMFILES;i++)
+  {
+    for(int wait=0;wait<100 && (stat(filename[i], &filestat) != 0 || filestat.st_size < synced[i]);wait++)
+      usleep(100000);
+    if(stat(filename[i], &filestat) != 0 || filestat.st_size < synced[i])
+    {
+      std::cout << "FAIL: " << filename[i] << " holds less than the integrations ended before the last" << std::endl;
+      failures++;
+    }
+  }
+  writer->flush();
+
+  for(int i=0;i<NUMFILES;i++)
+  {
+    contents.clear();
+    f = fopen(filename[i], "r");
+    if(f == 0)
+    {
+      std::cout << "FAIL: " << filename[i] << " was not written" << std::endl;
+      failures++;
+      continue;
+    }
+    while((bytes = fread(record, 1, BUFFERBYTES, f)) > 0)
+      contents.append(record, bytes);
+    fclose(f);
+    unlink(filename[i]);
+    if(contents != expected[i])
+    {
+      std::cout << "FAIL: " << filename[i] << " has " << contents.size() << " bytes, expected " << expected[i].size();
+      if(contents.size() == expected[i].size())
+        std::cout << " but the contents differ";
+      std::cout << std::endl;
+      failures++;
+    }
+  }
+  std::cout << "  " << numthreads << " writer threads" << (directio?", direct I/O":"") << ", " << writer->getMaxOpenFiles() << " files open at most: " << writer->getBytesWritten() << " bytes written, " << writer->getStallTime() << " s waiting for a buffer" << std::endl;
+
+  delete writer;
+  delete [] record;
+
+  return failures;
+}
+
+int main(int argc, const char** argv)
+{
+  char directory[256];
+  int failures = 0;
+
+  snprintf(directory, 256, "%s/viswriter_test_XXXXXX", (argc > 1)?argv[1]:"/tmp");
+  if(mkdtemp(directory) == 0)
+  {
+    std::cout << "Could not create a directory under " << ((argc > 1)?argv[1]:"/tmp") << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  failures += runtest(directory, 1, false, 0);
+  failures += runtest(directory, NUMFILES, false, 0);
+  failures += runtest(directory, 1, true, 0);
+  failures += runtest(directory, NUMFILES, true, 0);
+  failures += runtest(directory, 1, false, NUMFILES-1);
+  failures += runtest(directory, 1, true, NUMFILES-1);
+  rmdir(directory);
+
+  std::cout << ((failures == 0)?"PASS":"FAIL") << std::endl;
+  return (failures == 0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
@@ -0,0 +1,205 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#include "uvshifter.h"
+#include "mode.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UVSHIFT_X86
+#include <immintrin.h>
+#define UVSHIFT_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+const int UVShifter::PHASE_CENTRE_BLOCK = 16;
+
+//Sums the products of a group of channels with the phasors of a block of phase centres.  phasors holds, for each
+//channel, PHASE_CENTRE_BLOCK real parts followed by PHASE_CENTRE_BLOCK imaginary parts
+static void sumGroup(const f32 * phasors, const cf32 * vis, int grouplength, f32 * sumre, f32 * sumim)
+{
+  const int B = UVShifter::PHASE_CENTRE_BLOCK;
+  f32 vre, vim;
+  const f32 * wre;
+  const f32 * wim;
+
+  for(int s=0;s<B;s++)
+  {
+    sumre[s] = 0.0;
+    sumim[s] = 0.0;
+  }
+  for(int c=0;c<grouplength;c++)
+  {
+    vre = vis[c].re;
+    vim = vis[c].im;
+    wre = &(phasors[2*c*B]);
+    wim = wre + B;
+    for(int s=0;s<B;s++)
+    {
+      sumre[s] += wre[s]*vre - wim[s]*vim;
+      sumim[s] += wre[s]*vim + wim[s]*vre;
+    }
+  }
+}
+
+#ifdef UVSHIFT_X86
+//As sumGroup, with the 16 phase centres held in two registers each for the real and imaginary sums
+UVSHIFT_AVX2 static void avx2SumGroup(const f32 * phasors, const cf32 * vis, int grouplength, f32 * sumre, f32 * sumim)
+{
+  __m256 re0 = _mm256_setzero_ps(), re1 = _mm256_setzero_ps(), im0 = _mm256_setzero_ps(), im1 = _mm256_setzero_ps();
+  __m256 vre, vim, wre0, wre1, wim0, wim1;
+
+  for(int c=0;c<grouplength;c++)
+  {
+    vre = _mm256_broadcast_ss(&(vis[c].re));
+    vim = _mm256_broadcast_ss(&(vis[c].im));
+    wre0 = _mm256_loadu_ps(phasors + 32*c);
+    wre1 = _mm256_loadu_ps(phasors + 32*c + 8);
+    wim0 = _mm256_loadu_ps(phasors + 32*c + 16);
+    wim1 = _mm256_loadu_ps(phasors + 32*c + 24);
+    re0 = _mm256_fnmadd_ps(wim0, vim, _mm256_fmadd_ps(wre0, vre, re0));
+    re1 = _mm256_fnmadd_ps(wim1, vim, _mm256_fmadd_ps(wre1, vre, re1));
+    im0 = _mm256_fmadd_ps(wim0, vre, _mm256_fmadd_ps(wre0, vim, im0));
+    im1 = _mm256_fmadd_ps(wim1, vre, _mm256_fmadd_ps(wre1, vim, im1));
+  }
+  _mm256_storeu_ps(sumre, re0);
+  _mm256_storeu_ps(sumre + 8, re1);
+  _mm256_storeu_ps(sumim, im0);
+  _mm256_storeu_ps(sumim + 8, im1);
+}
+#endif
+
+UVShifter::UVShifter(int maxpc, int maxstride, int maxnumstrides)
+  : maxphasecentres(maxpc), maxstridelength(maxstride), maxstrides(maxnumstrides), numphasecentres(0)
+{
+  startphases = vectorAlloc_f64(maxphasecentres);
+  phasesteps = vectorAlloc_f64(maxphasecentres);
+  stridephasors = vectorAlloc_cf32(PHASE_CENTRE_BLOCK*maxstridelength);
+  startphasors = vectorAlloc_cf32(PHASE_CENTRE_BLOCK*maxstrides);
+  shifted = vectorAlloc_cf32(maxstridelength*maxstrides);
+  transposedphasors = vectorAlloc_f32(2*PHASE_CENTRE_BLOCK*maxstridelength);
+}
+
+UVShifter::~UVShifter()
+{
+  vectorFree(startphases);
+  vectorFree(phasesteps);
+  vectorFree(stridephasors);
+  vectorFree(startphasors);
+  vectorFree(shifted);
+  vectorFree(transposedphasors);
+}
+
+void UVShifter::setPhaseCentres(const f64 * delays, int numpc, double lofrequency, double channelbandwidth, int numchannels, bool lowersideband)
+{
+  double edgefrequency;
+
+  //the lower sideband channels run up to the band edge, rather than away from it
+  edgefrequency = lofrequency;
+  if(lowersideband)
+    edgefrequency -= (numchannels-1)*channelbandwidth;
+  numphasecentres = numpc;
+  for(int s=0;s<numphasecentres;s++)
+  {
+    startphases[s] = delays[s]*edgefrequency;
+    phasesteps[s] = delays[s]*channelbandwidth;
+  }
+}
+
+void UVShifter::shiftAndAverage(int numstrides, int stridelength, int channelinc, const cf32 * const * vis, cf32 * const * out, int numvectors, int phasecentrestride)
+{
+  int blocklength, grouplength, numgroups, outoffset;
+  f32 scale;
+  f32 sumre[PHASE_CENTRE_BLOCK];
+  f32 sumim[PHASE_CENTRE_BLOCK];
+  cf32 start;
+  const cf32 * v;
+  cf32 * o;
+
+  grouplength = (channelinc < stridelength)?channelinc:stridelength;
+  numgroups = stridelength/grouplength;
+  scale = 1.0/channelinc;
+  for(int sblock=0;sblock<numphasecentres;sblock+=PHASE_CENTRE_BLOCK)
+  {
+    blocklength = (numphasecentres - sblock < PHASE_CENTRE_BLOCK)?numphasecentres - sblock:PHASE_CENTRE_BLOCK;
+
+    if(channelinc == 1)
+    {
+      //no averaging, so generate each phase centre's phasors across the whole band and multiply them into each vector
+      for(int s=0;s<blocklength;s++)
+      {
+        Mode::generateRotator(shifted, startphases[sblock+s], phasesteps[sblock+s], 0.0, numstrides*stridelength, Mode::ROTATOR_MAX_PHASE_ERROR);
+        for(int x=0;x<numstrides;x++)
+        {
+          for(int i=0;i<numvectors;i++)
+            vectorAddProduct_cf32(&(shifted[x*stridelength]), vis[x*numvectors + i], out[i] + (sblock+s)*phasecentrestride + x*stridelength, stridelength);
+        }
+      }
+      continue;
+    }
+
+    //the phasors within a stride, and the phasor at the start of each stride, for this block of phase centres
+    for(int s=0;s<blocklength;s++)
+    {
+      Mode::generateRotator(&(stridephasors[s*stridelength]), 0.0, phasesteps[sblock+s], 0.0, stridelength, Mode::ROTATOR_MAX_PHASE_ERROR);
+      Mode::generateRotator(&(startphasors[s*numstrides]), startphases[sblock+s], phasesteps[sblock+s]*stridelength, 0.0, numstrides, Mode::ROTATOR_MAX_PHASE_ERROR);
+    }
+
+    //averaging: each channel group is a (phase centre x channel) by (channel) product, done as a sum of outer products
+    //with the phase centres innermost, so the phasors are laid out by channel with the (split) phase centres contiguous
+    for(int c=0;c<stridelength;c++)
+    {
+      for(int s=0;s<PHASE_CENTRE_BLOCK;s++)
+      {
+        transposedphasors[2*c*PHASE_CENTRE_BLOCK + s] = (s < blocklength)?stridephasors[s*stridelength + c].re:0.0;
+        transposedphasors[(2*c+1)*PHASE_CENTRE_BLOCK + s] = (s < blocklength)?stridephasors[s*stridelength + c].im:0.0;
+      }
+    }
+    for(int x=0;x<numstrides;x++)
+    {
+      outoffset = (x*stridelength)/channelinc;
+      for(int i=0;i<numvectors;i++)
+      {
+        v = vis[x*numvectors + i];
+        for(int g=0;g<numgroups;g++)
+        {
+#ifdef UVSHIFT_X86
+          if(simdKernels.level >= SIMD_LEVEL_AVX2)
+            avx2SumGroup(&(transposedphasors[2*g*grouplength*PHASE_CENTRE_BLOCK]), v + g*grouplength, grouplength, sumre, sumim);
+          else
+#endif
+            sumGroup(&(transposedphasors[2*g*grouplength*PHASE_CENTRE_BLOCK]), v + g*grouplength, grouplength, sumre, sumim);
+          for(int s=0;s<blocklength;s++)
+          {
+            start = startphasors[s*numstrides + x];
+            o = out[i] + (sblock+s)*phasecentrestride + outoffset + g;
+            o->re += scale*(start.re*sumre[s] - start.im*sumim[s]);
+            o->im += scale*(start.re*sumim[s] + start.im*sumre[s]);
+          }
+        }
+      }
+    }
+  }
+}
+// vim: shiftwidth=2:softtabstop=2:expandtab
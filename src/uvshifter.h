@@ -0,0 +1,97 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef UVSHIFTER_H
+#define UVSHIFTER_H
+
+#include "architecture.h"
+
+/**
+ @class UVShifter
+ @brief Shifts the visibilities of one baseline and frequency to many phase centres and averages them in frequency
+
+ Shifting the visibilities to each phase centre and averaging them down in frequency is a (phase centres x channels)
+ matrix of phasors applied to the visibilities of each polarisation product (and pulsar bin).  Within every xmac
+ stride the phasors of a phase centre are the same run of unit phasors, rotated by a phase that depends on the
+ stride, so for a block of phase centres this is evaluated as a complex matrix product of that block's in-stride
+ phasors with each stride of visibilities, scaled by the per-stride phasor.  The phasors are generated by recurrence
+ (Mode::generateRotator) rather than sin/cos, and each block of phasors stays in cache while it is applied to all of
+ the visibilities, rather than the visibilities being streamed from memory once for every phase centre.
+ @author The DiFX developers
+ */
+class UVShifter
+{
+  public:
+ /**
+   * Constructor: allocates the phasor blocks
+   * @param maxphasecentres The largest number of phase centres that will be set
+   * @param maxstridelength The longest xmac stride
+   * @param maxstrides The largest number of xmac strides in a band
+  */
+  UVShifter(int maxphasecentres, int maxstridelength, int maxstrides);
+
+  ~UVShifter();
+
+ /**
+   * Sets the delays to shift by and the frequency axis for the next calls to shiftAndAverage
+   * @param delays The differential delay (us) to shift by for each phase centre
+   * @param numphasecentres The number of phase centres
+   * @param lofrequency The sky frequency (MHz) of the band edge
+   * @param channelbandwidth The width (MHz) of one channel
+   * @param numchannels The number of channels in the band
+   * @param lowersideband Whether the band is lower sideband
+  */
+  void setPhaseCentres(const f64 * delays, int numphasecentres, double lofrequency, double channelbandwidth, int numchannels, bool lowersideband);
+
+ /**
+   * Shifts each visibility vector to every phase centre, averages it in frequency and adds it to the output.  For
+   * phase centre s and vector v, out[v][s*phasecentrestride + g] has the mean of the shifted visibilities over channel
+   * group g added to it
+   * @param numstrides The number of xmac strides in the band
+   * @param stridelength The number of channels in an xmac stride
+   * @param channelinc The number of channels averaged into each output channel
+   * @param vis The visibilities, stridelength long, of stride x of vector v at vis[x*numvectors + v]
+   * @param out Where to add the output for the first phase centre, for each visibility vector
+   * @param numvectors The number of visibility vectors
+   * @param phasecentrestride The offset between the outputs of successive phase centres
+  */
+  void shiftAndAverage(int numstrides, int stridelength, int channelinc, const cf32 * const * vis, cf32 * const * out, int numvectors, int phasecentrestride);
+
+  ///The number of phase centres whose phasors are generated and applied together
+  static const int PHASE_CENTRE_BLOCK;
+
+  private:
+  int maxphasecentres, maxstridelength, maxstrides, numphasecentres;
+  f64 * startphases;
+  f64 * phasesteps;
+  cf32 * stridephasors; //[phase centre in block][channel in stride]
+  cf32 * startphasors; //[phase centre in block][stride]
+  cf32 * shifted; //[channel in band] for one phase centre, when not averaging
+  f32 * transposedphasors; //[channel in stride][re, im][phase centre in block]
+};
+
+#endif
+// vim: shiftwidth=2:softtabstop=2:expandtab
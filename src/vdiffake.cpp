@@ -141,7 +141,14 @@ int VDIFFakeDataStream::dataRead(int buffersegment)
 	bytesvisible = readbufferleftover + bytes;
 
 	// multiplex and corner turn the data
-	muxReturn = vdifmux(reinterpret_cast<unsigned char *>(&databuffer[buffersegment*(bufferbytes/numdatasegments)]), readbytes, readbuffer, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	if(muxpool)
+	{
+		muxReturn = muxpool->vdifmux(reinterpret_cast<unsigned char *>(&databuffer[buffersegment*(bufferbytes/numdatasegments)]), readbytes, readbuffer, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	}
+	else
+	{
+		muxReturn = vdifmux(reinterpret_cast<unsigned char *>(&databuffer[buffersegment*(bufferbytes/numdatasegments)]), readbytes, readbuffer, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	}
 
 	if(muxReturn <= 0)
 	{
@@ -73,6 +73,11 @@ VDIFDataStream::VDIFDataStream(const Configuration * conf, int snum, int id, int
 	nGap = 1000;	// a gap of this many frames will trigger an interruption of muxing
 	startOutputFrameNumber = -1;
 	memset(&vm, 0, sizeof(vm));
+	muxpool = MuxPool::acquireShared();
+	if(muxpool)
+	{
+		cinfo << startl << "VDIF multiplexing will be shared over " << muxpool->getNumThreads() << " threads" << endl;
+	}
 
 	nGapWarn = 0;
 	nExcessWarn = 0;
@@ -168,6 +173,12 @@ VDIFDataStream::~VDIFDataStream()
 		cwarn << startl << "More than 5 percent of data from this antenna were unwanted packets.  This could indicate a problem in the routing of data from the digital back end to the recorder." << endl;
 	}
 
+	if(muxpool)
+	{
+		cinfo << startl << "VDIF multiplexing over " << muxpool->getNumThreads() << " threads: " << muxpool->getNumParallelMuxes() << " segments muxed in parallel, " << muxpool->getNumSerialMuxes() << " by one thread" << endl;
+		MuxPool::releaseShared(muxpool);
+	}
+
 	//printvdifmuxstatistics(&vstats);
 	if(switchedpower)
 	{
@@ -748,7 +759,16 @@ int VDIFDataStream::dataRead(int buffersegment)
 	bytesvisible = muxend - muxindex;
 
 	// multiplex and corner turn the data
-	muxReturn = vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	// The pool's threads only read between muxindex and muxend, in slots locked above, and have all finished
+	// by the time it returns, so no slot is unlocked while any of them is still reading it.
+	if(muxpool)
+	{
+		muxReturn = muxpool->vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	}
+	else
+	{
+		muxReturn = vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	}
 
 	if(muxReturn <= 0)
 	{
@@ -30,6 +30,7 @@
 #include <vdifio.h>
 #include <pthread.h>
 #include "datastream.h"
+#include "muxpool.h"
 
 /**
 @class VDIFDataStream 
@@ -109,6 +110,7 @@ protected:
   int nSort, nGap;  // muxer tuning parameters
   struct vdif_mux vm;
   struct vdif_mux_statistics vstats;
+  MuxPool *muxpool;	// the process's shared pool, splitting each vdifmux over DIFX_MUX_THREADS threads; null if that is 1
   long long startOutputFrameNumber;
   int invalidtime;
   double jobEndMJD;
@@ -47,6 +47,7 @@ VDIFNetworkDataStream::VDIFNetworkDataStream(const Configuration * conf, int snu
 	VDIFDataStream(conf, snum, id, ncores, cids, bufferfactor, numsegments)
 {
 	int perr;
+	const char *ringenv, *ringmbenv, *reorderenv;
 
 	/* each data buffer segment contains an integer number of frames, 
 	 * because thats the way config determines max bytes
@@ -60,6 +61,8 @@ VDIFNetworkDataStream::VDIFNetworkDataStream(const Configuration * conf, int snu
 	readbufferslotsize = (bufferfactor/numsegments)*conf->getMaxDataBytes(streamnum)*21LL/10LL;
 	readbufferslotsize -= (readbufferslotsize % config->getFrameBytes(0, streamnum)); // make it a multiple of frame size
 	readbuffersize = readbufferslots * readbufferslotsize;
+	maxreadbufferslotsize = readbufferslotsize;
+	muxwindowbytes = 0;
 	// Note: the read buffer is allocated in vdiffile.cpp by VDIFDataStream::initialse()
 	// the above values override defaults for file-based VDIF
 
@@ -72,6 +75,34 @@ VDIFNetworkDataStream::VDIFNetworkDataStream(const Configuration * conf, int snu
 	networkthreadstop = false;
 	lockstart = lockend = lastslot = -2;
 	endindex = 0;
+	packetreceiver = 0;
+	packetring = 0;
+	reassembler = 0;
+	nrejectedreported = ndroppedreported = nmissingreported = 0;
+
+	/* raw packets can instead be captured through memory-mapped rings, the value being the number of rings */
+	ringenv = getenv("DIFX_PACKET_RING");
+	numpacketrings = (ringenv != 0) ? atoi(ringenv) : 0;
+
+	/* each ring is locked in memory where RLIMIT_MEMLOCK allows, so its size [MB] can be set too */
+	ringmbenv = getenv("DIFX_PACKET_RING_MB");
+	packetringblocks = PacketRing::DefaultNumBlocks;
+	if(ringmbenv != 0 && atoi(ringmbenv) > 0)
+	{
+		packetringblocks = (int)(atoi(ringmbenv)*1048576LL/PacketRing::DefaultBlockSize);
+		if(packetringblocks < PacketRing::MinNumBlocks)
+		{
+			packetringblocks = PacketRing::MinNumBlocks;
+		}
+	}
+	if(raw && numpacketrings > 0)
+	{
+		estimatedbytes += (long long)numpacketrings*packetringblocks*PacketRing::DefaultBlockSize;
+	}
+
+	/* raw frames can be placed in the read buffer by their time, tolerating this much reordering [ms] */
+	reorderenv = getenv("DIFX_VDIF_REORDER_MS");
+	reorderms = (reorderenv != 0) ? atoi(reorderenv) : 0;
 
 	perr = pthread_barrier_init(&networkthreadbarrier, 0, 2);
 	networkthreadmutex = new pthread_mutex_t[readbufferslots];
@@ -115,82 +146,163 @@ VDIFNetworkDataStream::~VDIFNetworkDataStream()
 	}
 	delete [] networkthreadmutex;
 	pthread_barrier_destroy(&networkthreadbarrier);
+	delete packetreceiver;
+	delete reassembler;
 }
 
 int VDIFNetworkDataStream::readrawnetworkVDIF(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes)
 {
-	const int MaxPacketSize = 20000;
-	int length;
-	int goodbytes = packetsize - stripbytes;
-	char *ptr0 = ptr;
-	char *end = ptr + bytestoread - goodbytes;
-	char workbuffer[MaxPacketSize];
-	const vdif_header *vh;
-
-	vh = reinterpret_cast<const vdif_header *>(workbuffer + stripbytes);
+	unsigned int bytes;
 
-	if(packetsize > MaxPacketSize)
+	if(packetsize > PacketReceiver::MaxPacketSize)
 	{
-		cfatal << startl << "Error: readrawnetworkVDIF wants to read packets of size " << packetsize << " where MaxPacketSize=" << MaxPacketSize << endl;
+		cfatal << startl << "Error: readrawnetworkVDIF wants to read packets of size " << packetsize << " where MaxPacketSize=" << PacketReceiver::MaxPacketSize << endl;
 		MPI_Abort(MPI_COMM_WORLD, 1);
 	}
 
-	*nread = 0;
+	if(packetring == 0 && (packetreceiver == 0 || packetreceiver->getPacketSize() != packetsize || packetreceiver->getPayloadSize() != packetsize - stripbytes))
+	{
+		delete packetreceiver;
+		packetreceiver = new PacketReceiver(packetsize, stripbytes);
+	}
 
-	while(ptr <= end)
+	if(reassembler)
 	{
-		length = recvfrom(sock, workbuffer, MaxPacketSize, 0, 0, 0);
-		if(length <= 0)
-		{
-			// timeout on read?
-			break;
-		}
-		else if(length == packetsize)
+		// frames are received in small batches and each is copied to its place in the window by its time and thread
+		reassembler->startWindow(ptr, bytestoread);
+		while(!reassembler->placeStaged())
 		{
-			memcpy(ptr, workbuffer + stripbytes, goodbytes);
-			ptr += goodbytes;
+			unsigned int staged;
 
-			if( (vh->frame == 0) && (vh->threadid == 0) && (vh->seconds % 10 == 0) )
+			if(packetring)
+			{
+				staged = packetring->receive(reassembler->getStagingBuffer(), reassembler->getStagingBytes(), packetsize, stripbytes);
+			}
+			else
+			{
+				staged = packetreceiver->receive(sock, reassembler->getStagingBuffer(), reassembler->getStagingBytes());
+			}
+			if(staged == 0)
 			{
-				/* first frame of the 10 second interval.  Compare with local clock time for kicks */
-				struct timespec ck;
-				double deltat;		// [sec]
+				break;	// timed out
+			}
+			reassembler->setStagedBytes(staged);
+		}
+		bytes = reassembler->finishWindow();
+	}
+	else if(packetring)
+	{
+		// payloads are copied straight from the kernel's ring into the read buffer slot
+		bytes = packetring->receive(ptr, bytestoread, packetsize, stripbytes);
+	}
+	else
+	{
+		// packets land directly in the read buffer slot, many per system call
+		bytes = packetreceiver->receive(sock, ptr, bytestoread);
+	}
+
+	for(const char *frame = ptr; frame < ptr + bytes; frame += packetsize - stripbytes)
+	{
+		const vdif_header *vh = reinterpret_cast<const vdif_header *>(frame);
+
+		if( (vh->frame == 0) && (vh->threadid == 0) && (vh->seconds % 10 == 0) && !vh->invalid )
+		{
+			/* first frame of the 10 second interval.  Compare with local clock time for kicks */
+			struct timespec ck;
+			double deltat;		// [sec]
 
 #ifdef __MACH__                 // OS X does not have clock_gettime, use gettimeofday
-				struct timeval now;
-				int status;
-				status = gettimeofday(&now, NULL);
-				ck.tv_sec = now.tv_sec;
-				ck.tv_nsec = now.tv_usec*1000;
+			struct timeval now;
+			int status;
+			status = gettimeofday(&now, NULL);
+			ck.tv_sec = now.tv_sec;
+			ck.tv_nsec = now.tv_usec*1000;
 #else
-				clock_gettime(CLOCK_REALTIME, &ck);
+			clock_gettime(CLOCK_REALTIME, &ck);
 #endif
-				deltat = (ck.tv_sec % 10) - (vh->seconds % 10);
-				deltat += ck.tv_nsec*1.0e-9;
-				if(deltat < -3.0)
-				{
-					deltat += 10.0;
-				}
-				if(deltat > 5)
-				{
-					deltat -= 10.0;
-				}
-				int p = cinfo.precision();
-				cinfo.precision(6);
-				cinfo << startl << "VDIF clock is " << deltat << " seconds behind system clock for antenna " << stationname << endl;
-				cinfo.precision(p);
+			deltat = (ck.tv_sec % 10) - (vh->seconds % 10);
+			deltat += ck.tv_nsec*1.0e-9;
+			if(deltat < -3.0)
+			{
+				deltat += 10.0;
+			}
+			if(deltat > 5)
+			{
+				deltat -= 10.0;
+			}
+			int p = cinfo.precision();
+			cinfo.precision(6);
+			cinfo << startl << "VDIF clock is " << deltat << " seconds behind system clock for antenna " << stationname << endl;
+			cinfo.precision(p);
+		}
+	}
+
+	if(packetring)
+	{
+		if(packetring->getNumRejected() > nrejectedreported)
+		{
+			long long n = packetring->getNumRejected();
+
+			/* report every time the count of rejected packets doubles */
+			if(nrejectedreported == 0 || n >= 2*nrejectedreported)
+			{
+				cwarn << startl << n << " frames not of size " << packetsize << " have been discarded (" << packetring->getNumPackets() << " accepted)" << endl;
+				nrejectedreported = n;
 			}
 		}
+		if(packetring->getNumDropped() > ndroppedreported)
+		{
+			long long n = packetring->getNumDropped();
+
+			/* likewise for frames the kernel had to drop because the rings were full */
+			if(ndroppedreported == 0 || n >= 2*ndroppedreported)
+			{
+				cwarn << startl << n << " frames have been dropped by the kernel; the packet rings filled " << packetring->getNumFreezes() << " times" << endl;
+				ndroppedreported = n;
+			}
+		}
+	}
+	else if(packetreceiver->getNumRejected() > nrejectedreported)
+	{
+		long long n = packetreceiver->getNumRejected();
+
+		/* report every time the count of rejected packets doubles */
+		if(nrejectedreported == 0 || n >= 2*nrejectedreported)
+		{
+			cwarn << startl << n << " packets not of size " << packetsize << " have been discarded (" << packetreceiver->getNumPackets() << " accepted)" << endl;
+			nrejectedreported = n;
+		}
+	}
+
+	if(reassembler && reassembler->getNumMissing() > nmissingreported)
+	{
+		long long n = reassembler->getNumMissing();
+
+		/* report every time the count of missing frames doubles */
+		if(nmissingreported == 0 || n >= 2*nmissingreported)
+		{
+			cwarn << startl << n << " VDIF frames never arrived and have been replaced by invalid frames" << endl;
+			nmissingreported = n;
+		}
 	}
 
 	if(nread)
 	{
-		*nread = ptr - ptr0;
+		*nread = bytes;
 	}
 
 	return 1;
 }
 
+void VDIFNetworkDataStream::reportReassembly() const
+{
+	for(int i = 0; i < reassembler->getNumThreads(); ++i)
+	{
+		cinfo << startl << "VDIF thread " << reassembler->getThreadId(i) << ": " << reassembler->getNumReceived(i) << " frames received, " << reassembler->getNumMissing(i) << " missing, " << reassembler->getNumReordered(i) << " out of order, " << reassembler->getNumLate(i) << " too late, " << reassembler->getNumDuplicate(i) << " duplicated" << endl;
+	}
+	cinfo << startl << "VDIF reassembly: " << reassembler->getNumWindows() << " windows, " << reassembler->getNumHeldOver() << " frames held over to the next window, " << reassembler->getNumSkipped() << " frame times skipped in gaps, " << reassembler->getNumForeign() << " frames of other threads discarded" << endl;
+}
+
 // this function implements the network reader.  It is continuously either filling data into a ring buffer or waiting for a mutex to clear.
 void VDIFNetworkDataStream::networkthreadfunction()
 {
@@ -220,6 +332,13 @@ void VDIFNetworkDataStream::networkthreadfunction()
 		/* Second barrier is after the locking of slot number 1 */
 		pthread_barrier_wait(&networkthreadbarrier);
 
+		if(raw && reorderms > 0 && !networkthreadstop)
+		{
+			/* a fresh reassembler for each scan, as the frame rate and threads may change */
+			reassembler = new VDIFReassembler(packetsize - stripbytes, framespersecond, nthreads, threads, (reorderms*framespersecond + 999)/1000, vm.frameGranularity);
+			nmissingreported = 0;
+		}
+
 		while(!networkthreadstop)
 		{
 			unsigned int bytes;
@@ -290,6 +409,12 @@ void VDIFNetworkDataStream::networkthreadfunction()
 			}
 		}
 		pthread_mutex_unlock(networkthreadmutex + (readbufferwriteslot % lockmod));
+		if(reassembler)
+		{
+			reportReassembly();
+			delete reassembler;
+			reassembler = 0;
+		}
 		if(networkthreadstop)
 		{
 			break;
@@ -355,6 +480,33 @@ void VDIFNetworkDataStream::initialiseFile(int configindex, int fileindex)
 
 	cinfo << startl << "VDIFNetworkDataStream::initialiseFile format=" << formatname << endl;
 
+	/* With reassembly every slot holds whole frame times with no frames missing, so each dataRead
+	 * consumes exactly the input frames of the output frames that fit in a segment.  Making the slots
+	 * a whole number of those lets dataRead step from slot to slot, and from the last slot back to the
+	 * first, without ever moving data to slot 0.  Safe to change here: the network thread is waiting
+	 * at the barrier below.
+	 */
+	readbufferslotsize = maxreadbufferslotsize;
+	muxwindowbytes = 0;
+	if(raw && reorderms > 0)
+	{
+		int outputframes = readbytes/vm.outputFrameSize;
+		unsigned int timebytes = nthreads*inputframebytes;
+
+		outputframes -= outputframes % vm.frameGranularity;
+		muxwindowbytes = outputframes*vm.nThread*vm.inputFrameSize;
+		if(muxwindowbytes > 0 && muxwindowbytes % timebytes == 0 && muxwindowbytes <= maxreadbufferslotsize)
+		{
+			readbufferslotsize = maxreadbufferslotsize - maxreadbufferslotsize % muxwindowbytes;
+		}
+		else
+		{
+			muxwindowbytes = 0;
+			readbufferslotsize = maxreadbufferslotsize - maxreadbufferslotsize % timebytes;
+		}
+		cinfo << startl << "VDIF frames will be reassembled in windows of " << readbufferslotsize/timebytes << " frame times, tolerating " << reorderms << " ms of reordering" << endl;
+	}
+
 	/* update all the configs to ensure that the nsincs and
 	 * headerbytes are correct
 	 */
@@ -387,7 +539,7 @@ int VDIFNetworkDataStream::dataRead(int buffersegment)
 
 	unsigned char *destination = reinterpret_cast<unsigned char *>(&databuffer[buffersegment*(bufferbytes/numdatasegments)]);
 	int n1, n2;	/* slot number range of data to be processed.  Either n1==n2 or n1+1==n2 */
-	unsigned int muxend, bytesvisible;
+	unsigned int muxend, bytesvisible, muxbytes;
 	int lockmod = readbufferslots - 1;
 	int muxReturn;
 
@@ -404,15 +556,18 @@ int VDIFNetworkDataStream::dataRead(int buffersegment)
 		pthread_mutex_lock(networkthreadmutex + (lockstart % lockmod));
 	}
 
+	// with reassembled slots, the exact input needed is known
+	muxbytes = (muxwindowbytes > 0) ? muxwindowbytes : readbytes;
+
 	n1 = muxindex / readbufferslotsize;
-	if(lastslot >= 0 && muxindex + readbytes > endindex && muxindex < endindex)
+	if(lastslot >= 0 && muxindex + muxbytes > endindex && muxindex < endindex)
 	{
 		// here fewer than readbytes remain so make sure n2 gets set properly
 		n2 = (endindex - 1) / readbufferslotsize;
 	}
 	else
 	{
-		n2 = (muxindex + readbytes - 1) / readbufferslotsize;
+		n2 = (muxindex + muxbytes - 1) / readbufferslotsize;
 	}
 
 	// note: it should be impossible for n2 >= readbufferslots because a previous memmove and slot shuffling should have prevented this.
@@ -421,9 +576,10 @@ int VDIFNetworkDataStream::dataRead(int buffersegment)
 		csevere << startl << "dataRead n2=" << n2 << " >= readbufferslots=" << readbufferslots << " muxindex=" << muxindex << " readbufferslotsize=" << readbufferslotsize << " n1=" << n1 << " n2=" << n2 << " endindex=" << endindex << " lastslot=" << lastslot << endl;
 	}
 
-	if(n2 > n1 && lockend != n2)
+	// lock every slot to be read that isn't already; after a read that ended exactly at the end of a slot that includes slot n1
+	while(lockend < n2)
 	{
-		lockend = n2;
+		++lockend;
 		pthread_mutex_lock(networkthreadmutex + (lockend % lockmod));
 	}
 
@@ -455,7 +611,14 @@ int VDIFNetworkDataStream::dataRead(int buffersegment)
 //cverbose << "About to mux " << readbytes << " from slot(s) " << n1 << "-" << n2 << endl;
 
 	// multiplex and corner turn the data
-	muxReturn = vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	if(muxpool)
+	{
+		muxReturn = muxpool->vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	}
+	else
+	{
+		muxReturn = vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	}
 
 	if(muxReturn <= 0)
 	{
@@ -623,19 +786,25 @@ int VDIFNetworkDataStream::dataRead(int buffersegment)
 			++lockstart;
 		}
 
-		if(lockstart == readbufferslots - 1 && lastslot != readbufferslots - 1)
+		// reassembled slots are only moved if the next read would run off the end of the buffer, which it shouldn't
+		if(lockstart == readbufferslots - 1 && lastslot != readbufferslots - 1 && (muxwindowbytes == 0 || muxindex + muxwindowbytes > readbufferslots*readbufferslotsize))
 		{
 			// Here it is time to move the data in the last slot to slot 0
 			// Geometry: |  slot 0  |  slot 1  |  slot 2  |  slot 3  |  slot 4  |  slot 5  |
 			// Before:   |          |dddddddddd|          |          |          |      dddd|
 			// After:    |      dddd|dddddddddd|          |          |          |          |
 
-			// Note! No need change locks here as slot 0 and slot readbufferslots - 1 share a lock
+			// Note! No need change locks here as slot 0 and slot readbufferslots - 1 share a lock,
+			// but if the last read ended exactly at the start of the last slot it isn't held yet
 
+			if(lockend < lockstart)
+			{
+				pthread_mutex_lock(networkthreadmutex + (lockstart % lockmod));
+			}
 			lockstart = 0;
 
 			int newstart = muxindex % readbufferslotsize;
-			memmove(readbuffer + newstart, readbuffer + muxindex, readbuffersize-muxindex);
+			memmove(readbuffer + newstart, readbuffer + muxindex, readbufferslots*readbufferslotsize-muxindex);
 			muxindex = newstart;
 
 			lockend = 0;
@@ -663,9 +832,26 @@ void VDIFNetworkDataStream::loopnetworkread()
 	}
 	else if(raw)
 	{
-		int v;
+		int v = 0;
 
-		v = openrawstream(ethernetdevice.c_str());
+		if(numpacketrings > 0)
+		{
+			packetring = new PacketRing(ethernetdevice.c_str(), numpacketrings, PacketRing::DefaultBlockSize, packetringblocks);
+			if(packetring->isOpen())
+			{
+				cinfo << startl << "Capturing raw packets on " << ethernetdevice << " through " << numpacketrings << " memory-mapped packet ring(s) of " << (long long)packetringblocks*PacketRing::DefaultBlockSize/1048576 << " MB" << endl;
+			}
+			else
+			{
+				cwarn << startl << "Cannot set up packet rings on " << ethernetdevice << "; using a raw socket instead" << endl;
+				delete packetring;
+				packetring = 0;
+			}
+		}
+		if(packetring == 0)
+		{
+			v = openrawstream(ethernetdevice.c_str());
+		}
 		if(v < 0)
 		{
 			cfatal << startl << "Cannot open raw socket.  Perhaps root permission is required." << endl;
@@ -756,7 +942,15 @@ cverbose << startl << "Out of inner read loop: keepreading=" << keepreading << "
 		}
 	}
 
-	closestream();
+	if(packetring)
+	{
+		delete packetring;
+		packetring = 0;
+	}
+	else
+	{
+		closestream();
+	}
 
 	//unlock the outstanding send lock
 	perr = pthread_mutex_unlock(&outstandingsendlock);
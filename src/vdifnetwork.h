@@ -35,6 +35,9 @@
 #include "config.h"
 
 #include "vdiffile.h"
+#include "packetreceiver.h"
+#include "packetring.h"
+#include "vdifreassembler.h"
 #include <difxmessage.h>
 
 #ifdef __APPLE__
@@ -52,6 +55,7 @@ protected:
 	static void *launchnetworkthreadfunction(void *self);
 	int readrawnetworkVDIF(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes);
 	void networkthreadfunction();
+	void reportReassembly() const;
 	virtual void loopnetworkread();
 
 private:
@@ -65,6 +69,15 @@ private:
 	unsigned int endindex, muxindex;
 	int readbufferwriteslot;
 	double jobEndMJD;
+	PacketReceiver *packetreceiver;	// for raw packets; owned by the network thread
+	PacketRing *packetring;		// replaces the raw socket if DIFX_PACKET_RING is set; owned by the network thread
+	int numpacketrings;
+	int packetringblocks;		// of PacketRing::DefaultBlockSize each; set by DIFX_PACKET_RING_MB
+	VDIFReassembler *reassembler;	// places raw frames by time if DIFX_VDIF_REORDER_MS is set; owned by the network thread
+	int reorderms;
+	unsigned int maxreadbufferslotsize;	// as allocated; reassembly may use slots a little shorter
+	unsigned int muxwindowbytes;		// input consumed by each dataRead when slots hold reassembled windows, else 0
+	long long nrejectedreported, ndroppedreported, nmissingreported;
 
 	// network parameters
 	int sock;
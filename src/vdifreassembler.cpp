@@ -0,0 +1,364 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+#include "vdifreassembler.h"
+#include "alert.h"
+
+#ifdef WORDS_BIGENDIAN
+#define FILL_PATTERN 0x44332211UL
+#else
+#define FILL_PATTERN 0x11223344UL
+#endif
+
+VDIFReassembler::VDIFReassembler(int framebytes, int framespersecond, int nthreads, const int *threadids, int reorderframes, int alignframes, int stagingframes) :
+	framebytes(framebytes), framespersecond(framespersecond), nthreads(nthreads), reorderframes(reorderframes), alignframes(alignframes), stagingframes(stagingframes)
+{
+	if(framebytes < VDIF_HEADER_BYTES || framebytes % 4 != 0 || framespersecond <= 0 || nthreads <= 0)
+	{
+		cfatal << startl << "VDIFReassembler: cannot reassemble " << nthreads << " threads of " << framespersecond << " frames per second of " << framebytes << " bytes" << endl;
+	}
+	if(this->reorderframes < 0)
+	{
+		this->reorderframes = 0;
+	}
+	if(this->alignframes < 1)
+	{
+		this->alignframes = 1;
+	}
+	if(this->stagingframes < 1)
+	{
+		this->stagingframes = 1;
+	}
+
+	this->threadids = new int[nthreads];
+	for(int i = 0; i <= VDIF_MAX_THREAD_ID; ++i)
+	{
+		threadindex[i] = -1;
+	}
+	for(int i = 0; i < nthreads; ++i)
+	{
+		this->threadids[i] = threadids[i];
+		if(threadids[i] >= 0 && threadids[i] <= VDIF_MAX_THREAD_ID)
+		{
+			threadindex[threadids[i]] = i;
+		}
+	}
+
+	fillframe = new char[framebytes];
+	for(int i = 0; i < framebytes/4; ++i)
+	{
+		reinterpret_cast<uint32_t *>(fillframe)[i] = FILL_PATTERN;
+	}
+	havetemplate = false;
+
+	dest = 0;
+	anchored = closed = false;
+	windowstart = latest = 0;
+	windowframes = maxwindowslots = 0;
+	nplaced = 0;
+	present = 0;
+
+	spillslots = this->reorderframes*nthreads;
+	spill = new char[spillslots > 0 ? (size_t)spillslots*framebytes : 1];
+	spillpresent = new unsigned char[spillslots > 0 ? spillslots : 1];
+	memset(spillpresent, 0, spillslots > 0 ? spillslots : 1);
+	nspilled = 0;
+
+	staging = new char[(size_t)this->stagingframes*framebytes];
+	nstaged = nextstaged = 0;
+
+	nreceived = new long long[nthreads];
+	nmissing = new long long[nthreads];
+	nreordered = new long long[nthreads];
+	nlate = new long long[nthreads];
+	nduplicate = new long long[nthreads];
+	lasttime = new long long[nthreads];
+	for(int i = 0; i < nthreads; ++i)
+	{
+		nreceived[i] = nmissing[i] = nreordered[i] = nlate[i] = nduplicate[i] = 0;
+		lasttime[i] = -1;
+	}
+	nforeign = nheldover = nskipped = nwindows = 0;
+}
+
+VDIFReassembler::~VDIFReassembler()
+{
+	delete [] threadids;
+	delete [] fillframe;
+	delete [] present;
+	delete [] spill;
+	delete [] spillpresent;
+	delete [] staging;
+	delete [] nreceived;
+	delete [] nmissing;
+	delete [] nreordered;
+	delete [] nlate;
+	delete [] nduplicate;
+	delete [] lasttime;
+}
+
+void VDIFReassembler::setStagedBytes(unsigned int bytes)
+{
+	nstaged = bytes/framebytes;
+	if(nstaged > stagingframes)
+	{
+		nstaged = stagingframes;
+	}
+	nextstaged = 0;
+}
+
+void VDIFReassembler::startWindow(char *dest, unsigned int windowbytes)
+{
+	int windowslots;
+
+	this->dest = dest;
+	if(anchored)
+	{
+		windowstart += windowframes;
+	}
+	windowframes = windowbytes/(nthreads*framebytes);
+	windowslots = windowframes*nthreads;
+	if(windowslots > maxwindowslots)
+	{
+		delete [] present;
+		present = new unsigned char[windowslots];
+		maxwindowslots = windowslots;
+	}
+	memset(present, 0, windowslots);
+	nplaced = 0;
+	latest = windowstart;
+	closed = false;
+
+	// the held over frames come first in this window; a window must be able to hold them all
+	if(reorderframes > windowframes)
+	{
+		reorderframes = windowframes;
+	}
+	if(nspilled > 0)
+	{
+		for(int s = 0; s < spillslots; ++s)
+		{
+			if(spillpresent[s])
+			{
+				if(s < windowslots)
+				{
+					memcpy(dest + (size_t)s*framebytes, spill + (size_t)s*framebytes, framebytes);
+					present[s] = 1;
+					++nplaced;
+					if(windowstart + s/nthreads + 1 > latest)
+					{
+						latest = windowstart + s/nthreads + 1;
+					}
+				}
+				spillpresent[s] = 0;
+			}
+		}
+		nspilled = 0;
+		if(nplaced == windowslots)
+		{
+			closed = true;
+		}
+	}
+}
+
+int VDIFReassembler::place(const char *frame)
+{
+	const vdif_header *vh = reinterpret_cast<const vdif_header *>(frame);
+	int tid = getVDIFThreadID(vh);
+	int ti = threadindex[tid];
+	long long t;
+	int s;
+
+	if(ti < 0)
+	{
+		++nforeign;
+
+		return 1;
+	}
+
+	t = frameTime(vh);
+	if(!havetemplate)
+	{
+		memcpy(fillframe, frame, VDIF_HEADER_BYTES);
+		havetemplate = true;
+	}
+	if(!anchored || (nplaced == 0 && t >= windowstart + windowframes))
+	{
+		// first frame of the scan, or the first after a gap longer than a window: start the window here
+		long long start = t - getVDIFFrameNumber(vh) % alignframes;
+
+		if(anchored)
+		{
+			nskipped += start - windowstart;
+		}
+		windowstart = latest = start;
+		anchored = true;
+	}
+	else if(t >= windowstart + windowframes + reorderframes)
+	{
+		// too far ahead for anything more to be expected in this window; the frame starts the next one
+		closed = true;
+
+		return 0;
+	}
+
+	++nreceived[ti];
+	if(t < lasttime[ti])
+	{
+		++nreordered[ti];
+	}
+	else
+	{
+		lasttime[ti] = t;
+	}
+
+	if(t < windowstart)
+	{
+		++nlate[ti];
+
+		return 1;
+	}
+	if(t < windowstart + windowframes)
+	{
+		s = (t - windowstart)*nthreads + ti;
+		if(present[s])
+		{
+			++nduplicate[ti];
+
+			return 1;
+		}
+		memcpy(dest + (size_t)s*framebytes, frame, framebytes);
+		present[s] = 1;
+		++nplaced;
+		if(t + 1 > latest)
+		{
+			latest = t + 1;
+		}
+		if(nplaced == windowframes*nthreads)
+		{
+			closed = true;
+		}
+
+		return 1;
+	}
+
+	// a frame of the next window, held over until this one closes
+	s = (t - windowstart - windowframes)*nthreads + ti;
+	if(spillpresent[s])
+	{
+		++nduplicate[ti];
+
+		return 1;
+	}
+	memcpy(spill + (size_t)s*framebytes, frame, framebytes);
+	spillpresent[s] = 1;
+	++nspilled;
+	++nheldover;
+
+	return 1;
+}
+
+bool VDIFReassembler::placeStaged()
+{
+	while(!closed && nextstaged < nstaged)
+	{
+		if(place(staging + (size_t)nextstaged*framebytes) == 0)
+		{
+			break;
+		}
+		++nextstaged;
+	}
+
+	return closed;
+}
+
+void VDIFReassembler::fillFrame(char *frame, long long t, int threadindex) const
+{
+	vdif_header *vh = reinterpret_cast<vdif_header *>(frame);
+
+	memcpy(frame, fillframe, framebytes);
+	setVDIFFrameSecond(vh, t/framespersecond);
+	setVDIFFrameNumber(vh, t%framespersecond);
+	setVDIFThreadID(vh, threadids[threadindex]);
+	setVDIFFrameInvalid(vh, 1);
+}
+
+unsigned int VDIFReassembler::finishWindow()
+{
+	long long end;
+
+	if(nspilled > 0)
+	{
+		closed = true;	// the held over frames are due in the next window
+	}
+	if(closed)
+	{
+		end = windowstart + windowframes;
+	}
+	else if(nplaced > 0)
+	{
+		end = latest;
+	}
+	else
+	{
+		windowframes = 0;	// nothing was received, so the next window starts at the same frame time
+
+		return 0;
+	}
+
+	for(long long t = windowstart; t < end; ++t)
+	{
+		for(int ti = 0; ti < nthreads; ++ti)
+		{
+			int s = (t - windowstart)*nthreads + ti;
+
+			if(!present[s])
+			{
+				fillFrame(dest + (size_t)s*framebytes, t, ti);
+				++nmissing[ti];
+			}
+		}
+	}
+	++nwindows;
+
+	return (end - windowstart)*nthreads*framebytes;
+}
+
+long long VDIFReassembler::getNumMissing() const
+{
+	long long n = 0;
+
+	for(int i = 0; i < nthreads; ++i)
+	{
+		n += nmissing[i];
+	}
+
+	return n;
+}
@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef VDIFREASSEMBLER_H
+#define VDIFREASSEMBLER_H
+
+#include <vdifio.h>
+
+/* Reassembles VDIF frames received one per packet into windows of the read
+ * buffer in which every frame has a fixed place: frame f of second s on the
+ * thread with index i of the thread map goes to frame slot
+ * ((s*framespersecond + f) - windowstart)*nthreads + i.  Reordering
+ * therefore costs nothing, and frames that never arrive are replaced by
+ * frames with the invalid bit set and the payload set to the fill pattern,
+ * so a window always holds whole, sorted frame times and the multiplexer
+ * never has to resynchronise.
+ *
+ * A window is closed as soon as it is complete, or when a frame arrives
+ * more than reorderframes frame times beyond its end; frames for the first
+ * reorderframes frame times of the next window are held over until then.
+ * Frames are received in batches into a staging area; frames that arrive
+ * after their window was closed are discarded and counted as late.
+ *
+ * Statistics are kept for each thread: frames received, frames filled in
+ * as missing, frames that arrived after a later frame of the same thread
+ * (reordered), late frames and duplicates.
+ */
+
+class VDIFReassembler
+{
+public:
+	VDIFReassembler(int framebytes, int framespersecond, int nthreads, const int *threadids, int reorderframes, int alignframes = 1, int stagingframes = DefaultStagingFrames);
+	~VDIFReassembler();
+
+	/* Where the next batch of frames should be received, and how much room there is */
+	char *getStagingBuffer() const { return staging; }
+	unsigned int getStagingBytes() const { return (unsigned int)stagingframes*framebytes; }
+	void setStagedBytes(unsigned int bytes);
+
+	/* Starts a window of windowbytes (a whole number of frame times) at dest,
+	 * placing any frames held over from the previous window */
+	void startWindow(char *dest, unsigned int windowbytes);
+
+	/* Places staged frames until they run out or the window closes; returns
+	 * true once the window is closed.  Frames not yet placed stay staged. */
+	bool placeStaged();
+
+	/* Fills in the missing frames of the window and returns its length in
+	 * bytes: the whole window if it was closed, otherwise (e.g. the socket
+	 * timed out) up to the latest frame time received */
+	unsigned int finishWindow();
+
+	int getNumThreads() const { return nthreads; }
+	int getThreadId(int i) const { return threadids[i]; }
+	long long getNumReceived(int i) const { return nreceived[i]; }
+	long long getNumMissing(int i) const { return nmissing[i]; }
+	long long getNumReordered(int i) const { return nreordered[i]; }
+	long long getNumLate(int i) const { return nlate[i]; }
+	long long getNumDuplicate(int i) const { return nduplicate[i]; }
+	long long getNumMissing() const;
+	long long getNumForeign() const { return nforeign; }		// frames of threads not in the map
+	long long getNumHeldOver() const { return nheldover; }
+	long long getNumSkipped() const { return nskipped; }		// frame times skipped over in gaps longer than a window
+	long long getNumWindows() const { return nwindows; }
+
+	static const int DefaultStagingFrames = 64;
+
+private:
+	int place(const char *frame);	// 1 if the frame was used, 0 if it closed the window
+	long long frameTime(const vdif_header *vh) const { return (long long)getVDIFFrameSecond(vh)*framespersecond + getVDIFFrameNumber(vh); }
+	void fillFrame(char *frame, long long t, int threadindex) const;
+
+	int framebytes, framespersecond, nthreads, reorderframes, alignframes;
+	int *threadids;
+	int threadindex[VDIF_MAX_THREAD_ID+1];	// thread id -> index in threadids, or -1
+	char *fillframe;			// a frame of fill pattern, its header set from the first frame received
+	bool havetemplate;
+
+	/* the window being filled */
+	char *dest;
+	bool anchored, closed;
+	long long windowstart, latest;		// first frame time of the window; one past the latest placed
+	int windowframes, maxwindowslots;	// frame times in the window; size of present
+	int nplaced;
+	unsigned char *present;			// per frame slot of the window
+
+	/* frames of the next window received before this one closed */
+	char *spill;
+	unsigned char *spillpresent;
+	int spillslots, nspilled;
+
+	char *staging;
+	int stagingframes, nstaged, nextstaged;
+
+	long long *nreceived, *nmissing, *nreordered, *nlate, *nduplicate;
+	long long *lasttime;			// latest frame time seen on each thread
+	long long nforeign, nheldover, nskipped, nwindows;
+};
+
+#endif
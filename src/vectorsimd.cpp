@@ -0,0 +1,1227 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+/** \file vectorsimd.cpp
+ *  \brief SSE2/AVX2/AVX-512 implementations of the hot vector kernels, selected at runtime
+ *
+ *  Each kernel exists at every level; the simdKernels table is pointed at the best level the
+ *  host supports when the program starts.  Results match the scalar kernels to within float
+ *  rounding (the FMA levels round the complex products once rather than twice).
+ */
+
+#include <cmath>
+#include <cstring>
+#include "architecture.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#define SIMD_SSE2   __attribute__((target("sse2")))
+#define SIMD_AVX2   __attribute__((target("avx2,fma,f16c")))
+#define SIMD_AVX512 __attribute__((target("avx512f")))
+#endif
+
+//Beyond this the vector range reduction loses precision, so such blocks are done with the libm calls
+static const f32 SINCOS_MAX_ARG = 8192.0;
+
+//Cephes single precision sin/cos constants
+static const f32 FOUR_OVER_PI = 1.27323954473516;
+static const f32 SINCOS_DP1 = 0.78515625;
+static const f32 SINCOS_DP2 = 2.4187564849853515625e-4;
+static const f32 SINCOS_DP3 = 3.77489497744594108e-8;
+static const f32 SIN_P0 = -1.9515295891e-4;
+static const f32 SIN_P1 = 8.3321608736e-3;
+static const f32 SIN_P2 = -1.6666654611e-1;
+static const f32 COS_P0 = 2.443315711809948e-5;
+static const f32 COS_P1 = -1.388731625493765e-3;
+static const f32 COS_P2 = 4.166664568298827e-2;
+
+//Packed spectra saturate here, so they never hold an infinity
+static const f32 MAX_F16 = 65504.0;
+static const f32 MAX_S8 = 127.0;
+
+//------------------------------------------------------------------------------------------------
+// Scalar kernels (used for the tails of the vector kernels, and on hosts without SSE2)
+//------------------------------------------------------------------------------------------------
+
+static vecStatus scalarMul_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    f32 re = src1[i].re*src2[i].re - src1[i].im*src2[i].im;
+    f32 im = src1[i].re*src2[i].im + src1[i].im*src2[i].re;
+    dest[i].re = re;
+    dest[i].im = im;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarMul_32fc_I(const cf32 *src, cf32 *srcdest, int length)
+{
+  return scalarMul_32fc(src, srcdest, srcdest, length);
+}
+
+static vecStatus scalarMul_32f32fc(const f32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    dest[i].re = src1[i]*src2[i].re;
+    dest[i].im = src1[i]*src2[i].im;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarAddProduct_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    accumulator[i].re += src1[i].re*src2[i].re - src1[i].im*src2[i].im;
+    accumulator[i].im += src1[i].re*src2[i].im + src1[i].im*src2[i].re;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarMulConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    f32 re = src1[i].re*src2[i].re + src1[i].im*src2[i].im;
+    f32 im = src1[i].im*src2[i].re - src1[i].re*src2[i].im;
+    dest[i].re = re;
+    dest[i].im = im;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarAddProductConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    accumulator[i].re += src1[i].re*src2[i].re + src1[i].im*src2[i].im;
+    accumulator[i].im += src1[i].im*src2[i].re - src1[i].re*src2[i].im;
+  }
+  return vecNoErr;
+}
+
+//IEEE half precision bits from a single precision value, rounding to nearest even.  Callers
+//saturate first, so only zeros, subnormals and normals need handling
+static inline u16 scalarFloatToHalf(f32 value)
+{
+  u32 bits, sign, mantissa, half, remainder, midpoint;
+  int exponent, shift;
+
+  memcpy(&bits, &value, sizeof(bits));
+  sign = (bits >> 16) & 0x8000;
+  exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+  mantissa = bits & 0x7fffff;
+  if(exponent <= 0) //half precision subnormal (or zero)
+  {
+    if(exponent < -10)
+      return sign;
+    mantissa |= 0x800000;
+    shift = 14 - exponent;
+    half = mantissa >> shift;
+    remainder = mantissa & ((1u << shift) - 1);
+    midpoint = 1u << (shift - 1);
+  }
+  else
+  {
+    half = (exponent << 10) | (mantissa >> 13);
+    remainder = mantissa & 0x1fff;
+    midpoint = 0x1000;
+  }
+  if(remainder > midpoint || (remainder == midpoint && (half & 1)))
+    half++; //a carry out of the mantissa correctly bumps the exponent
+  return sign | half;
+}
+
+static inline f32 scalarHalfToFloat(u16 half)
+{
+  u32 bits = ((u32)(half & 0x7fff)) << 13;
+  f32 value;
+
+  //rebias the exponent by multiplying by 2^112, which also normalises subnormals
+  memcpy(&value, &bits, sizeof(value));
+  value *= 5.192296858534828e33f;
+  return (half & 0x8000)?-value:value;
+}
+
+static vecStatus scalarPack_32fc16fc(const cf32 *src, const f32 *invscale, cf16 *dest, int length)
+{
+  f32 re, im;
+  for(int i=0;i<length;i++)
+  {
+    re = src[i].re*invscale[i];
+    im = src[i].im*invscale[i];
+    re = (re > MAX_F16)?MAX_F16:((re < -MAX_F16)?-MAX_F16:re);
+    im = (im > MAX_F16)?MAX_F16:((im < -MAX_F16)?-MAX_F16:im);
+    dest[i].re = scalarFloatToHalf(re);
+    dest[i].im = scalarFloatToHalf(im);
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarPack_32fc8sc(const cf32 *src, const f32 *invscale, cs8 *dest, int length)
+{
+  f32 re, im;
+  for(int i=0;i<length;i++)
+  {
+    re = src[i].re*invscale[i];
+    im = src[i].im*invscale[i];
+    re = (re > MAX_S8)?MAX_S8:((re < -MAX_S8)?-MAX_S8:re);
+    im = (im > MAX_S8)?MAX_S8:((im < -MAX_S8)?-MAX_S8:im);
+    dest[i].re = (signed char)lrintf(re);
+    dest[i].im = (signed char)lrintf(im);
+  }
+  return vecNoErr;
+}
+
+//accumulator += scale1*scale2*(the sum over k of src1[k]*conj(src2[k])), where src1[k] and src2[k] are packed
+//spectra starting offset values in.  Each channel is summed over all the vectors before it is scaled
+static vecStatus scalarXmacScaled_16fc(const u8 * const *src1, const u8 * const *src2, int numvectors, int offset, const f32 *scale1, const f32 *scale2, cf32 *accumulator, int length)
+{
+  const cf16 *a, *b;
+  f32 re1, im1, re2, im2, sumre, sumim, scale;
+  for(int i=0;i<length;i++)
+  {
+    sumre = 0.0;
+    sumim = 0.0;
+    for(int k=0;k<numvectors;k++)
+    {
+      a = (const cf16*)src1[k] + offset + i;
+      b = (const cf16*)src2[k] + offset + i;
+      re1 = scalarHalfToFloat(a->re);
+      im1 = scalarHalfToFloat(a->im);
+      re2 = scalarHalfToFloat(b->re);
+      im2 = scalarHalfToFloat(b->im);
+      sumre += re1*re2 + im1*im2;
+      sumim += im1*re2 - re1*im2;
+    }
+    scale = scale1[i]*scale2[i];
+    accumulator[i].re += scale*sumre;
+    accumulator[i].im += scale*sumim;
+  }
+  return vecNoErr;
+}
+
+//the integer sums are exact for up to 66000 vectors (each product is at most 2*127^2)
+static vecStatus scalarXmacScaled_8sc(const u8 * const *src1, const u8 * const *src2, int numvectors, int offset, const f32 *scale1, const f32 *scale2, cf32 *accumulator, int length)
+{
+  const cs8 *a, *b;
+  s32 sumre, sumim;
+  f32 scale;
+  for(int i=0;i<length;i++)
+  {
+    sumre = 0;
+    sumim = 0;
+    for(int k=0;k<numvectors;k++)
+    {
+      a = (const cs8*)src1[k] + offset + i;
+      b = (const cs8*)src2[k] + offset + i;
+      sumre += a->re*b->re + a->im*b->im;
+      sumim += a->im*b->re - a->re*b->im;
+    }
+    scale = scale1[i]*scale2[i];
+    accumulator[i].re += scale*sumre;
+    accumulator[i].im += scale*sumim;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarKurtosis_32fc(const cf32 *src, f32 *s1, f32 *s2, int length)
+{
+  f32 power;
+  for(int i=0;i<length;i++)
+  {
+    power = src[i].re*src[i].re + src[i].im*src[i].im;
+    s1[i] += power;
+    s2[i] += power*power;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarConj_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    dest[i].re = src[i].re;
+    dest[i].im = -src[i].im;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarConj_32fc_I(cf32 *srcdest, int length)
+{
+  return scalarConj_32fc(srcdest, srcdest, length);
+}
+
+static vecStatus scalarConjFlip_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    dest[i].re = src[length-1-i].re;
+    dest[i].im = -src[length-1-i].im;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarRealToCplx_32f(const f32 *real, const f32 *imag, cf32 *complx, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    complx[i].re = (real)?real[i]:0.0;
+    complx[i].im = (imag)?imag[i]:0.0;
+  }
+  return vecNoErr;
+}
+
+static vecStatus scalarSinCos_32f(const f32 *src, f32 *sin, f32 *cos, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    sin[i] = sinf(src[i]);
+    cos[i] = cosf(src[i]);
+  }
+  return vecNoErr;
+}
+
+#ifdef SIMD_X86
+
+//------------------------------------------------------------------------------------------------
+// SSE2 kernels: 2 complex / 4 real values per register
+//------------------------------------------------------------------------------------------------
+
+SIMD_SSE2 static inline __m128 sse2CMul(__m128 a, __m128 b)
+{
+  const __m128 negre = _mm_castsi128_ps(_mm_set_epi32(0, 0x80000000, 0, 0x80000000));
+  __m128 bre = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,2,0,0));
+  __m128 bim = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,3,1,1));
+  __m128 aswap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+  return _mm_add_ps(_mm_mul_ps(a, bre), _mm_xor_ps(_mm_mul_ps(aswap, bim), negre));
+}
+
+SIMD_SSE2 static vecStatus sse2Mul_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-2;i+=2)
+    _mm_storeu_ps((f32*)(dest+i), sse2CMul(_mm_loadu_ps((const f32*)(src1+i)), _mm_loadu_ps((const f32*)(src2+i))));
+  return scalarMul_32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_SSE2 static vecStatus sse2Mul_32fc_I(const cf32 *src, cf32 *srcdest, int length)
+{
+  return sse2Mul_32fc(src, srcdest, srcdest, length);
+}
+
+SIMD_SSE2 static vecStatus sse2Mul_32f32fc(const f32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m128 re = _mm_loadu_ps(src1+i);
+    _mm_storeu_ps((f32*)(dest+i), _mm_mul_ps(_mm_unpacklo_ps(re, re), _mm_loadu_ps((const f32*)(src2+i))));
+    _mm_storeu_ps((f32*)(dest+i+2), _mm_mul_ps(_mm_unpackhi_ps(re, re), _mm_loadu_ps((const f32*)(src2+i+2))));
+  }
+  return scalarMul_32f32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_SSE2 static vecStatus sse2AddProduct_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i<=length-2;i+=2)
+  {
+    __m128 prod = sse2CMul(_mm_loadu_ps((const f32*)(src1+i)), _mm_loadu_ps((const f32*)(src2+i)));
+    _mm_storeu_ps((f32*)(accumulator+i), _mm_add_ps(_mm_loadu_ps((const f32*)(accumulator+i)), prod));
+  }
+  return scalarAddProduct_32fc(src1+i, src2+i, accumulator+i, length-i);
+}
+
+//a*conj(b)
+SIMD_SSE2 static inline __m128 sse2CMulConj(__m128 a, __m128 b)
+{
+  const __m128 negim = _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0, 0x80000000, 0));
+  __m128 bre = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,2,0,0));
+  __m128 bim = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,3,1,1));
+  __m128 aswap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+  return _mm_add_ps(_mm_mul_ps(a, bre), _mm_xor_ps(_mm_mul_ps(aswap, bim), negim));
+}
+
+SIMD_SSE2 static vecStatus sse2MulConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-2;i+=2)
+    _mm_storeu_ps((f32*)(dest+i), sse2CMulConj(_mm_loadu_ps((const f32*)(src1+i)), _mm_loadu_ps((const f32*)(src2+i))));
+  return scalarMulConj_32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_SSE2 static vecStatus sse2AddProductConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i<=length-2;i+=2)
+  {
+    __m128 prod = sse2CMulConj(_mm_loadu_ps((const f32*)(src1+i)), _mm_loadu_ps((const f32*)(src2+i)));
+    _mm_storeu_ps((f32*)(accumulator+i), _mm_add_ps(_mm_loadu_ps((const f32*)(accumulator+i)), prod));
+  }
+  return scalarAddProductConj_32fc(src1+i, src2+i, accumulator+i, length-i);
+}
+
+//4 half precision values, zero extended into 32 bit lanes, to single precision (as scalarHalfToFloat)
+SIMD_SSE2 static inline __m128 sse2HalfToFloat(__m128i h)
+{
+  const __m128i absmask = _mm_set1_epi32(0x7fff);
+  const __m128 rebias = _mm_castsi128_ps(_mm_set1_epi32(0x77800000)); //2^112
+  __m128 value = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, absmask), 13)), rebias);
+  return _mm_or_ps(value, _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(absmask, h), 16)));
+}
+
+//accumulator += (s1*s2)*sum for 4 channels, from their sums in two registers of 2 complex values
+SIMD_SSE2 static inline void sse2AccumulateScaled(__m128 sum0, __m128 sum1, const f32 *scale1, const f32 *scale2, cf32 *accumulator)
+{
+  __m128 scale = _mm_mul_ps(_mm_loadu_ps(scale1), _mm_loadu_ps(scale2));
+  _mm_storeu_ps((f32*)accumulator, _mm_add_ps(_mm_loadu_ps((const f32*)accumulator), _mm_mul_ps(sum0, _mm_unpacklo_ps(scale, scale))));
+  _mm_storeu_ps((f32*)(accumulator+2), _mm_add_ps(_mm_loadu_ps((const f32*)(accumulator+2)), _mm_mul_ps(sum1, _mm_unpackhi_ps(scale, scale))));
+}
+
+//SSE2 has no conversion to half precision; packing is done once per station spectrum rather than once
+//per baseline, so the scalar packing is used at this level
+SIMD_SSE2 static vecStatus sse2XmacScaled_16fc(const u8 * const *src1, const u8 * const *src2, int numvectors, int offset, const f32 *scale1, const f32 *scale2, cf32 *accumulator, int length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const cf16 *a, *b;
+  __m128 sum0, sum1;
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    sum0 = _mm_setzero_ps();
+    sum1 = _mm_setzero_ps();
+    for(int k=0;k<numvectors;k++)
+    {
+      a = (const cf16*)src1[k] + offset + i;
+      b = (const cf16*)src2[k] + offset + i;
+      __m128i ha = _mm_loadu_si128((const __m128i*)a);
+      __m128i hb = _mm_loadu_si128((const __m128i*)b);
+      sum0 = _mm_add_ps(sum0, sse2CMulConj(sse2HalfToFloat(_mm_unpacklo_epi16(ha, zero)), sse2HalfToFloat(_mm_unpacklo_epi16(hb, zero))));
+      sum1 = _mm_add_ps(sum1, sse2CMulConj(sse2HalfToFloat(_mm_unpackhi_epi16(ha, zero)), sse2HalfToFloat(_mm_unpackhi_epi16(hb, zero))));
+    }
+    sse2AccumulateScaled(sum0, sum1, scale1+i, scale2+i, accumulator+i);
+  }
+  return scalarXmacScaled_16fc(src1, src2, numvectors, offset+i, scale1+i, scale2+i, accumulator+i, length-i);
+}
+
+SIMD_SSE2 static vecStatus sse2Pack_32fc8sc(const cf32 *src, const f32 *invscale, cs8 *dest, int length)
+{
+  const __m128 maxval = _mm_set1_ps(MAX_S8);
+  const __m128 minval = _mm_set1_ps(-MAX_S8);
+  __m128i words[4];
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    for(int j=0;j<4;j++)
+    {
+      __m128 scale = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(invscale+i+2*j));
+      __m128 v = _mm_mul_ps(_mm_loadu_ps((const f32*)(src+i+2*j)), _mm_unpacklo_ps(scale, scale));
+      words[j] = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(v, maxval), minval));
+    }
+    _mm_storeu_si128((__m128i*)(dest+i), _mm_packs_epi16(_mm_packs_epi32(words[0], words[1]), _mm_packs_epi32(words[2], words[3])));
+  }
+  return scalarPack_32fc8sc(src+i, invscale+i, dest+i, length-i);
+}
+
+//the 16 bit (re,im) pairs of b arranged so that madd with a gives the imaginary parts of a*conj(b): (-b.im,b.re)
+SIMD_SSE2 static inline __m128i sse2ConjSwap16(__m128i b)
+{
+  const __m128i negre = _mm_set1_epi32(0x0000ffff);
+  __m128i bswap = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+  return _mm_sub_epi16(_mm_xor_si128(bswap, negre), negre);
+}
+
+//8 channels at a time, with the real and imaginary sums held exactly as 32 bit integers (madd of the sign
+//extended pairs) until all the vectors are summed
+SIMD_SSE2 static vecStatus sse2XmacScaled_8sc(const u8 * const *src1, const u8 * const *src2, int numvectors, int offset, const f32 *scale1, const f32 *scale2, cf32 *accumulator, int length)
+{
+  const cs8 *pa, *pb;
+  __m128i re0, im0, re1, im1;
+  __m128 re, im;
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    re0 = _mm_setzero_si128();
+    im0 = _mm_setzero_si128();
+    re1 = _mm_setzero_si128();
+    im1 = _mm_setzero_si128();
+    for(int k=0;k<numvectors;k++)
+    {
+      pa = (const cs8*)src1[k] + offset + i;
+      pb = (const cs8*)src2[k] + offset + i;
+      __m128i a = _mm_loadu_si128((const __m128i*)pa);
+      __m128i b = _mm_loadu_si128((const __m128i*)pb);
+      //sign extend the bytes to 16 bits
+      __m128i alo = _mm_srai_epi16(_mm_unpacklo_epi8(a, a), 8);
+      __m128i blo = _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8);
+      __m128i ahi = _mm_srai_epi16(_mm_unpackhi_epi8(a, a), 8);
+      __m128i bhi = _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8);
+      re0 = _mm_add_epi32(re0, _mm_madd_epi16(alo, blo));
+      im0 = _mm_add_epi32(im0, _mm_madd_epi16(alo, sse2ConjSwap16(blo)));
+      re1 = _mm_add_epi32(re1, _mm_madd_epi16(ahi, bhi));
+      im1 = _mm_add_epi32(im1, _mm_madd_epi16(ahi, sse2ConjSwap16(bhi)));
+    }
+    re = _mm_cvtepi32_ps(re0);
+    im = _mm_cvtepi32_ps(im0);
+    sse2AccumulateScaled(_mm_unpacklo_ps(re, im), _mm_unpackhi_ps(re, im), scale1+i, scale2+i, accumulator+i);
+    re = _mm_cvtepi32_ps(re1);
+    im = _mm_cvtepi32_ps(im1);
+    sse2AccumulateScaled(_mm_unpacklo_ps(re, im), _mm_unpackhi_ps(re, im), scale1+i+4, scale2+i+4, accumulator+i+4);
+  }
+  return scalarXmacScaled_8sc(src1, src2, numvectors, offset+i, scale1+i, scale2+i, accumulator+i, length-i);
+}
+
+//the powers of 4 complex values, in order, from two registers of 2
+SIMD_SSE2 static inline __m128 sse2Power(__m128 a, __m128 b)
+{
+  __m128 sqa = _mm_mul_ps(a, a);
+  __m128 sqb = _mm_mul_ps(b, b);
+  return _mm_add_ps(_mm_shuffle_ps(sqa, sqb, _MM_SHUFFLE(2,0,2,0)), _mm_shuffle_ps(sqa, sqb, _MM_SHUFFLE(3,1,3,1)));
+}
+
+SIMD_SSE2 static vecStatus sse2Kurtosis_32fc(const cf32 *src, f32 *s1, f32 *s2, int length)
+{
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m128 power = sse2Power(_mm_loadu_ps((const f32*)(src+i)), _mm_loadu_ps((const f32*)(src+i+2)));
+    _mm_storeu_ps(s1+i, _mm_add_ps(_mm_loadu_ps(s1+i), power));
+    _mm_storeu_ps(s2+i, _mm_add_ps(_mm_loadu_ps(s2+i), _mm_mul_ps(power, power)));
+  }
+  return scalarKurtosis_32fc(src+i, s1+i, s2+i, length-i);
+}
+
+SIMD_SSE2 static vecStatus sse2Conj_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  const __m128 negim = _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0, 0x80000000, 0));
+  int i;
+  for(i=0;i<=length-2;i+=2)
+    _mm_storeu_ps((f32*)(dest+i), _mm_xor_ps(_mm_loadu_ps((const f32*)(src+i)), negim));
+  return scalarConj_32fc(src+i, dest+i, length-i);
+}
+
+SIMD_SSE2 static vecStatus sse2Conj_32fc_I(cf32 *srcdest, int length)
+{
+  return sse2Conj_32fc(srcdest, srcdest, length);
+}
+
+SIMD_SSE2 static vecStatus sse2ConjFlip_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  const __m128 negim = _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0, 0x80000000, 0));
+  int i;
+  for(i=0;i<=length-2;i+=2)
+  {
+    __m128 v = _mm_loadu_ps((const f32*)(src+length-2-i));
+    _mm_storeu_ps((f32*)(dest+i), _mm_xor_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1,0,3,2)), negim));
+  }
+  for(;i<length;i++)
+  {
+    dest[i].re = src[length-1-i].re;
+    dest[i].im = -src[length-1-i].im;
+  }
+  return vecNoErr;
+}
+
+SIMD_SSE2 static vecStatus sse2RealToCplx_32f(const f32 *real, const f32 *imag, cf32 *complx, int length)
+{
+  const __m128 zero = _mm_setzero_ps();
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m128 re = (real)?_mm_loadu_ps(real+i):zero;
+    __m128 im = (imag)?_mm_loadu_ps(imag+i):zero;
+    _mm_storeu_ps((f32*)(complx+i), _mm_unpacklo_ps(re, im));
+    _mm_storeu_ps((f32*)(complx+i+2), _mm_unpackhi_ps(re, im));
+  }
+  return scalarRealToCplx_32f((real)?real+i:0, (imag)?imag+i:0, complx+i, length-i);
+}
+
+SIMD_SSE2 static vecStatus sse2SinCos_32f(const f32 *src, f32 *sin, f32 *cos, int length)
+{
+  const __m128 signmask = _mm_set1_ps(-0.0f);
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m128 x = _mm_loadu_ps(src+i);
+    __m128 ax = _mm_andnot_ps(signmask, x);
+    if(_mm_movemask_ps(_mm_cmpgt_ps(ax, _mm_set1_ps(SINCOS_MAX_ARG))))
+    {
+      scalarSinCos_32f(src+i, sin+i, cos+i, 4);
+      continue;
+    }
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(ax, _mm_set1_ps(FOUR_OVER_PI)));
+    j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+    __m128 signsin = _mm_xor_ps(_mm_and_ps(x, signmask), _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+    __m128 signcos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    __m128 polymask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    ax = _mm_sub_ps(ax, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP1)));
+    ax = _mm_sub_ps(ax, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP2)));
+    ax = _mm_sub_ps(ax, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP3)));
+    __m128 z = _mm_mul_ps(ax, ax);
+    __m128 yc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_P0), z), _mm_set1_ps(COS_P1));
+    yc = _mm_add_ps(_mm_mul_ps(yc, z), _mm_set1_ps(COS_P2));
+    yc = _mm_mul_ps(_mm_mul_ps(yc, z), z);
+    yc = _mm_add_ps(_mm_sub_ps(yc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+    __m128 ys = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_P0), z), _mm_set1_ps(SIN_P1));
+    ys = _mm_add_ps(_mm_mul_ps(ys, z), _mm_set1_ps(SIN_P2));
+    ys = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ys, z), ax), ax);
+    __m128 s = _mm_or_ps(_mm_and_ps(polymask, ys), _mm_andnot_ps(polymask, yc));
+    __m128 c = _mm_or_ps(_mm_and_ps(polymask, yc), _mm_andnot_ps(polymask, ys));
+    _mm_storeu_ps(sin+i, _mm_xor_ps(s, signsin));
+    _mm_storeu_ps(cos+i, _mm_xor_ps(c, signcos));
+  }
+  return scalarSinCos_32f(src+i, sin+i, cos+i, length-i);
+}
+
+//------------------------------------------------------------------------------------------------
+// AVX2 + FMA kernels: 4 complex / 8 real values per register
+//------------------------------------------------------------------------------------------------
+
+SIMD_AVX2 static inline __m256 avx2CMul(__m256 a, __m256 b)
+{
+  __m256 aswap = _mm256_permute_ps(a, _MM_SHUFFLE(2,3,0,1));
+  return _mm256_fmaddsub_ps(a, _mm256_moveldup_ps(b), _mm256_mul_ps(aswap, _mm256_movehdup_ps(b)));
+}
+
+SIMD_AVX2 static vecStatus avx2Mul_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-4;i+=4)
+    _mm256_storeu_ps((f32*)(dest+i), avx2CMul(_mm256_loadu_ps((const f32*)(src1+i)), _mm256_loadu_ps((const f32*)(src2+i))));
+  return scalarMul_32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_AVX2 static vecStatus avx2Mul_32fc_I(const cf32 *src, cf32 *srcdest, int length)
+{
+  return avx2Mul_32fc(src, srcdest, srcdest, length);
+}
+
+SIMD_AVX2 static vecStatus avx2Mul_32f32fc(const f32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    __m256 re = _mm256_loadu_ps(src1+i);
+    __m256 lo = _mm256_unpacklo_ps(re, re);
+    __m256 hi = _mm256_unpackhi_ps(re, re);
+    _mm256_storeu_ps((f32*)(dest+i), _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), _mm256_loadu_ps((const f32*)(src2+i))));
+    _mm256_storeu_ps((f32*)(dest+i+4), _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), _mm256_loadu_ps((const f32*)(src2+i+4))));
+  }
+  return scalarMul_32f32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_AVX2 static vecStatus avx2AddProduct_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m256 prod = avx2CMul(_mm256_loadu_ps((const f32*)(src1+i)), _mm256_loadu_ps((const f32*)(src2+i)));
+    _mm256_storeu_ps((f32*)(accumulator+i), _mm256_add_ps(_mm256_loadu_ps((const f32*)(accumulator+i)), prod));
+  }
+  return scalarAddProduct_32fc(src1+i, src2+i, accumulator+i, length-i);
+}
+
+//a*conj(b)
+SIMD_AVX2 static inline __m256 avx2CMulConj(__m256 a, __m256 b)
+{
+  __m256 aswap = _mm256_permute_ps(a, _MM_SHUFFLE(2,3,0,1));
+  return _mm256_fmsubadd_ps(a, _mm256_moveldup_ps(b), _mm256_mul_ps(aswap, _mm256_movehdup_ps(b)));
+}
+
+SIMD_AVX2 static vecStatus avx2MulConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-4;i+=4)
+    _mm256_storeu_ps((f32*)(dest+i), avx2CMulConj(_mm256_loadu_ps((const f32*)(src1+i)), _mm256_loadu_ps((const f32*)(src2+i))));
+  return scalarMulConj_32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_AVX2 static vecStatus avx2AddProductConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m256 prod = avx2CMulConj(_mm256_loadu_ps((const f32*)(src1+i)), _mm256_loadu_ps((const f32*)(src2+i)));
+    _mm256_storeu_ps((f32*)(accumulator+i), _mm256_add_ps(_mm256_loadu_ps((const f32*)(accumulator+i)), prod));
+  }
+  return scalarAddProductConj_32fc(src1+i, src2+i, accumulator+i, length-i);
+}
+
+//each of 4 per channel scales, for the real and imaginary parts of 4 complex values
+SIMD_AVX2 static inline __m256 avx2DuplicateScales(const f32 *invscale)
+{
+  return _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(invscale)), _mm256_set_epi32(3,3,2,2,1,1,0,0));
+}
+
+SIMD_AVX2 static vecStatus avx2Pack_32fc16fc(const cf32 *src, const f32 *invscale, cf16 *dest, int length)
+{
+  const __m256 maxval = _mm256_set1_ps(MAX_F16);
+  const __m256 minval = _mm256_set1_ps(-MAX_F16);
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m256 v = _mm256_mul_ps(_mm256_loadu_ps((const f32*)(src+i)), avx2DuplicateScales(invscale+i));
+    v = _mm256_max_ps(_mm256_min_ps(v, maxval), minval);
+    _mm_storeu_si128((__m128i*)(dest+i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+  }
+  return scalarPack_32fc16fc(src+i, invscale+i, dest+i, length-i);
+}
+
+SIMD_AVX2 static vecStatus avx2Pack_32fc8sc(const cf32 *src, const f32 *invscale, cs8 *dest, int length)
+{
+  const __m256 maxval = _mm256_set1_ps(MAX_S8);
+  const __m256 minval = _mm256_set1_ps(-MAX_S8);
+  __m256i words[4], packed;
+  int i;
+  for(i=0;i<=length-16;i+=16)
+  {
+    for(int j=0;j<4;j++)
+    {
+      __m256 v = _mm256_mul_ps(_mm256_loadu_ps((const f32*)(src+i+4*j)), avx2DuplicateScales(invscale+i+4*j));
+      words[j] = _mm256_cvtps_epi32(_mm256_max_ps(_mm256_min_ps(v, maxval), minval));
+    }
+    //the in-lane packs leave each register's 4 byte groups in lanes, in the order 0,4,1,5,2,6,3,7 of the results
+    packed = _mm256_packs_epi16(_mm256_packs_epi32(words[0], words[1]), _mm256_packs_epi32(words[2], words[3]));
+    packed = _mm256_permutevar8x32_epi32(packed, _mm256_set_epi32(7,3,6,2,5,1,4,0));
+    _mm256_storeu_si256((__m256i*)(dest+i), packed);
+  }
+  return scalarPack_32fc8sc(src+i, invscale+i, dest+i, length-i);
+}
+
+//accumulator += (s1*s2)*sum for 4 channels
+SIMD_AVX2 static inline void avx2AccumulateScaled(__m256 sum, const f32 *scale1, const f32 *scale2, cf32 *accumulator)
+{
+  __m128 scale = _mm_mul_ps(_mm_loadu_ps(scale1), _mm_loadu_ps(scale2));
+  __m256 scales = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(scale), _mm256_set_epi32(3,3,2,2,1,1,0,0));
+  _mm256_storeu_ps((f32*)accumulator, _mm256_fmadd_ps(sum, scales, _mm256_loadu_ps((const f32*)accumulator)));
+}
+
+//16 channels at a time.  a*conj(b) is kept as two sums, a*b.re and swap(a)*b.im, which are combined (negating
+//the imaginary part of the second) only once all the vectors are summed, leaving 2 FMAs per 4 channels per vector
+SIMD_AVX2 static vecStatus avx2XmacScaled_16fc(const u8 * const *src1, const u8 * const *src2, int numvectors, int offset, const f32 *scale1, const f32 *scale2, cf32 *accumulator, int length)
+{
+  const __m256 negim = _mm256_setr_ps(1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f);
+  const cf16 *pa, *pb;
+  __m256 sumre[4], sumim[4];
+  int i;
+  for(i=0;i<=length-16;i+=16)
+  {
+    for(int j=0;j<4;j++)
+    {
+      sumre[j] = _mm256_setzero_ps();
+      sumim[j] = _mm256_setzero_ps();
+    }
+    for(int k=0;k<numvectors;k++)
+    {
+      pa = (const cf16*)src1[k] + offset + i;
+      pb = (const cf16*)src2[k] + offset + i;
+      for(int j=0;j<4;j++)
+      {
+        __m256 a = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pa+4*j)));
+        __m256 b = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pb+4*j)));
+        sumre[j] = _mm256_fmadd_ps(a, _mm256_moveldup_ps(b), sumre[j]);
+        sumim[j] = _mm256_fmadd_ps(_mm256_permute_ps(a, _MM_SHUFFLE(2,3,0,1)), _mm256_movehdup_ps(b), sumim[j]);
+      }
+    }
+    for(int j=0;j<4;j++)
+      avx2AccumulateScaled(_mm256_fmadd_ps(sumim[j], negim, sumre[j]), scale1+i+4*j, scale2+i+4*j, accumulator+i+4*j);
+  }
+  return scalarXmacScaled_16fc(src1, src2, numvectors, offset+i, scale1+i, scale2+i, accumulator+i, length-i);
+}
+
+//as sse2XmacScaled_8sc, 16 channels at a time; the in-lane interleave of the sums leaves them in the order 0,1,4,5,2,3,6,7
+SIMD_AVX2 static vecStatus avx2XmacScaled_8sc(const u8 * const *src1, const u8 * const *src2, int numvectors, int offset, const f32 *scale1, const f32 *scale2, cf32 *accumulator, int length)
+{
+  const __m256i negre = _mm256_set1_epi32(0x0001ffff);
+  const cs8 *pa, *pb;
+  __m256i sumre[2], sumim[2];
+  int i;
+  for(i=0;i<=length-16;i+=16)
+  {
+    for(int j=0;j<2;j++)
+    {
+      sumre[j] = _mm256_setzero_si256();
+      sumim[j] = _mm256_setzero_si256();
+    }
+    for(int k=0;k<numvectors;k++)
+    {
+      pa = (const cs8*)src1[k] + offset + i;
+      pb = (const cs8*)src2[k] + offset + i;
+      for(int j=0;j<2;j++)
+      {
+        __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(pa+8*j)));
+        __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(pb+8*j)));
+        __m256i bswap = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(b, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+        sumre[j] = _mm256_add_epi32(sumre[j], _mm256_madd_epi16(a, b));
+        sumim[j] = _mm256_add_epi32(sumim[j], _mm256_madd_epi16(a, _mm256_sign_epi16(bswap, negre)));
+      }
+    }
+    for(int j=0;j<2;j++)
+    {
+      __m256 re = _mm256_cvtepi32_ps(sumre[j]);
+      __m256 im = _mm256_cvtepi32_ps(sumim[j]);
+      __m256 lo = _mm256_unpacklo_ps(re, im);
+      __m256 hi = _mm256_unpackhi_ps(re, im);
+      avx2AccumulateScaled(_mm256_permute2f128_ps(lo, hi, 0x20), scale1+i+8*j, scale2+i+8*j, accumulator+i+8*j);
+      avx2AccumulateScaled(_mm256_permute2f128_ps(lo, hi, 0x31), scale1+i+8*j+4, scale2+i+8*j+4, accumulator+i+8*j+4);
+    }
+  }
+  return scalarXmacScaled_8sc(src1, src2, numvectors, offset+i, scale1+i, scale2+i, accumulator+i, length-i);
+}
+
+//the powers of 8 complex values, in order, from two registers of 4: the in-lane shuffles leave the
+//64 bit pairs of powers in the order 0,2,1,3
+SIMD_AVX2 static inline __m256 avx2Power(__m256 a, __m256 b)
+{
+  __m256 sqa = _mm256_mul_ps(a, a);
+  __m256 sqb = _mm256_mul_ps(b, b);
+  __m256 power = _mm256_add_ps(_mm256_shuffle_ps(sqa, sqb, _MM_SHUFFLE(2,0,2,0)), _mm256_shuffle_ps(sqa, sqb, _MM_SHUFFLE(3,1,3,1)));
+  return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(power), _MM_SHUFFLE(3,1,2,0)));
+}
+
+SIMD_AVX2 static vecStatus avx2Kurtosis_32fc(const cf32 *src, f32 *s1, f32 *s2, int length)
+{
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    __m256 power = avx2Power(_mm256_loadu_ps((const f32*)(src+i)), _mm256_loadu_ps((const f32*)(src+i+4)));
+    _mm256_storeu_ps(s1+i, _mm256_add_ps(_mm256_loadu_ps(s1+i), power));
+    _mm256_storeu_ps(s2+i, _mm256_fmadd_ps(power, power, _mm256_loadu_ps(s2+i)));
+  }
+  return scalarKurtosis_32fc(src+i, s1+i, s2+i, length-i);
+}
+
+SIMD_AVX2 static vecStatus avx2Conj_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  const __m256 negim = _mm256_castsi256_ps(_mm256_set_epi32(0x80000000, 0, 0x80000000, 0, 0x80000000, 0, 0x80000000, 0));
+  int i;
+  for(i=0;i<=length-4;i+=4)
+    _mm256_storeu_ps((f32*)(dest+i), _mm256_xor_ps(_mm256_loadu_ps((const f32*)(src+i)), negim));
+  return scalarConj_32fc(src+i, dest+i, length-i);
+}
+
+SIMD_AVX2 static vecStatus avx2Conj_32fc_I(cf32 *srcdest, int length)
+{
+  return avx2Conj_32fc(srcdest, srcdest, length);
+}
+
+SIMD_AVX2 static vecStatus avx2ConjFlip_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  const __m256 negim = _mm256_castsi256_ps(_mm256_set_epi32(0x80000000, 0, 0x80000000, 0, 0x80000000, 0, 0x80000000, 0));
+  int i;
+  for(i=0;i<=length-4;i+=4)
+  {
+    __m256d v = _mm256_castps_pd(_mm256_loadu_ps((const f32*)(src+length-4-i)));
+    _mm256_storeu_ps((f32*)(dest+i), _mm256_xor_ps(_mm256_castpd_ps(_mm256_permute4x64_pd(v, _MM_SHUFFLE(0,1,2,3))), negim));
+  }
+  for(;i<length;i++)
+  {
+    dest[i].re = src[length-1-i].re;
+    dest[i].im = -src[length-1-i].im;
+  }
+  return vecNoErr;
+}
+
+SIMD_AVX2 static vecStatus avx2RealToCplx_32f(const f32 *real, const f32 *imag, cf32 *complx, int length)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    __m256 re = (real)?_mm256_loadu_ps(real+i):zero;
+    __m256 im = (imag)?_mm256_loadu_ps(imag+i):zero;
+    __m256 lo = _mm256_unpacklo_ps(re, im);
+    __m256 hi = _mm256_unpackhi_ps(re, im);
+    _mm256_storeu_ps((f32*)(complx+i), _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps((f32*)(complx+i+4), _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+  return scalarRealToCplx_32f((real)?real+i:0, (imag)?imag+i:0, complx+i, length-i);
+}
+
+SIMD_AVX2 static vecStatus avx2SinCos_32f(const f32 *src, f32 *sin, f32 *cos, int length)
+{
+  const __m256 signmask = _mm256_set1_ps(-0.0f);
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    __m256 x = _mm256_loadu_ps(src+i);
+    __m256 ax = _mm256_andnot_ps(signmask, x);
+    if(_mm256_movemask_ps(_mm256_cmp_ps(ax, _mm256_set1_ps(SINCOS_MAX_ARG), _CMP_GT_OQ)))
+    {
+      scalarSinCos_32f(src+i, sin+i, cos+i, 8);
+      continue;
+    }
+    __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(ax, _mm256_set1_ps(FOUR_OVER_PI)));
+    j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(j);
+    __m256 signsin = _mm256_xor_ps(_mm256_and_ps(x, signmask), _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29)));
+    __m256 signcos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+    __m256 polymask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+    ax = _mm256_fnmadd_ps(y, _mm256_set1_ps(SINCOS_DP1), ax);
+    ax = _mm256_fnmadd_ps(y, _mm256_set1_ps(SINCOS_DP2), ax);
+    ax = _mm256_fnmadd_ps(y, _mm256_set1_ps(SINCOS_DP3), ax);
+    __m256 z = _mm256_mul_ps(ax, ax);
+    __m256 yc = _mm256_fmadd_ps(_mm256_set1_ps(COS_P0), z, _mm256_set1_ps(COS_P1));
+    yc = _mm256_fmadd_ps(yc, z, _mm256_set1_ps(COS_P2));
+    yc = _mm256_mul_ps(_mm256_mul_ps(yc, z), z);
+    yc = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), yc), _mm256_set1_ps(1.0f));
+    __m256 ys = _mm256_fmadd_ps(_mm256_set1_ps(SIN_P0), z, _mm256_set1_ps(SIN_P1));
+    ys = _mm256_fmadd_ps(ys, z, _mm256_set1_ps(SIN_P2));
+    ys = _mm256_fmadd_ps(_mm256_mul_ps(ys, z), ax, ax);
+    __m256 s = _mm256_blendv_ps(yc, ys, polymask);
+    __m256 c = _mm256_blendv_ps(ys, yc, polymask);
+    _mm256_storeu_ps(sin+i, _mm256_xor_ps(s, signsin));
+    _mm256_storeu_ps(cos+i, _mm256_xor_ps(c, signcos));
+  }
+  return sse2SinCos_32f(src+i, sin+i, cos+i, length-i);
+}
+
+//------------------------------------------------------------------------------------------------
+// AVX-512F kernels: 8 complex / 16 real values per register.  AVX-512F has no float logical
+// operations, so sign manipulation is done on the integer view of the registers
+//------------------------------------------------------------------------------------------------
+
+SIMD_AVX512 static inline __m512 avx512Xor(__m512 a, __m512i b)
+{
+  return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), b));
+}
+
+SIMD_AVX512 static inline __m512 avx512CMul(__m512 a, __m512 b)
+{
+  __m512 aswap = _mm512_permute_ps(a, _MM_SHUFFLE(2,3,0,1));
+  return _mm512_fmaddsub_ps(a, _mm512_moveldup_ps(b), _mm512_mul_ps(aswap, _mm512_movehdup_ps(b)));
+}
+
+SIMD_AVX512 static vecStatus avx512Mul_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-8;i+=8)
+    _mm512_storeu_ps((f32*)(dest+i), avx512CMul(_mm512_loadu_ps((const f32*)(src1+i)), _mm512_loadu_ps((const f32*)(src2+i))));
+  return avx2Mul_32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_AVX512 static vecStatus avx512Mul_32fc_I(const cf32 *src, cf32 *srcdest, int length)
+{
+  return avx512Mul_32fc(src, srcdest, srcdest, length);
+}
+
+SIMD_AVX512 static vecStatus avx512Mul_32f32fc(const f32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  const __m512i duplo = _mm512_set_epi32(7, 7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0, 0);
+  const __m512i duphi = _mm512_set_epi32(15, 15, 14, 14, 13, 13, 12, 12, 11, 11, 10, 10, 9, 9, 8, 8);
+  int i;
+  for(i=0;i<=length-16;i+=16)
+  {
+    __m512 re = _mm512_loadu_ps(src1+i);
+    _mm512_storeu_ps((f32*)(dest+i), _mm512_mul_ps(_mm512_permutexvar_ps(duplo, re), _mm512_loadu_ps((const f32*)(src2+i))));
+    _mm512_storeu_ps((f32*)(dest+i+8), _mm512_mul_ps(_mm512_permutexvar_ps(duphi, re), _mm512_loadu_ps((const f32*)(src2+i+8))));
+  }
+  return avx2Mul_32f32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_AVX512 static vecStatus avx512AddProduct_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    __m512 prod = avx512CMul(_mm512_loadu_ps((const f32*)(src1+i)), _mm512_loadu_ps((const f32*)(src2+i)));
+    _mm512_storeu_ps((f32*)(accumulator+i), _mm512_add_ps(_mm512_loadu_ps((const f32*)(accumulator+i)), prod));
+  }
+  return avx2AddProduct_32fc(src1+i, src2+i, accumulator+i, length-i);
+}
+
+//a*conj(b)
+SIMD_AVX512 static inline __m512 avx512CMulConj(__m512 a, __m512 b)
+{
+  __m512 aswap = _mm512_permute_ps(a, _MM_SHUFFLE(2,3,0,1));
+  return _mm512_fmsubadd_ps(a, _mm512_moveldup_ps(b), _mm512_mul_ps(aswap, _mm512_movehdup_ps(b)));
+}
+
+SIMD_AVX512 static vecStatus avx512MulConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i<=length-8;i+=8)
+    _mm512_storeu_ps((f32*)(dest+i), avx512CMulConj(_mm512_loadu_ps((const f32*)(src1+i)), _mm512_loadu_ps((const f32*)(src2+i))));
+  return avx2MulConj_32fc(src1+i, src2+i, dest+i, length-i);
+}
+
+SIMD_AVX512 static vecStatus avx512AddProductConj_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    __m512 prod = avx512CMulConj(_mm512_loadu_ps((const f32*)(src1+i)), _mm512_loadu_ps((const f32*)(src2+i)));
+    _mm512_storeu_ps((f32*)(accumulator+i), _mm512_add_ps(_mm512_loadu_ps((const f32*)(accumulator+i)), prod));
+  }
+  return avx2AddProductConj_32fc(src1+i, src2+i, accumulator+i, length-i);
+}
+
+//the powers of 16 complex values, in order, from two registers of 8: the in-lane shuffles leave each
+//128 bit lane holding two powers from the first register followed by two from the second
+SIMD_AVX512 static inline __m512 avx512Power(__m512 a, __m512 b)
+{
+  const __m512i order = _mm512_set_epi32(15, 14, 11, 10, 7, 6, 3, 2, 13, 12, 9, 8, 5, 4, 1, 0);
+  __m512 sqa = _mm512_mul_ps(a, a);
+  __m512 sqb = _mm512_mul_ps(b, b);
+  __m512 power = _mm512_add_ps(_mm512_shuffle_ps(sqa, sqb, _MM_SHUFFLE(2,0,2,0)), _mm512_shuffle_ps(sqa, sqb, _MM_SHUFFLE(3,1,3,1)));
+  return _mm512_permutexvar_ps(order, power);
+}
+
+SIMD_AVX512 static vecStatus avx512Kurtosis_32fc(const cf32 *src, f32 *s1, f32 *s2, int length)
+{
+  int i;
+  for(i=0;i<=length-16;i+=16)
+  {
+    __m512 power = avx512Power(_mm512_loadu_ps((const f32*)(src+i)), _mm512_loadu_ps((const f32*)(src+i+8)));
+    _mm512_storeu_ps(s1+i, _mm512_add_ps(_mm512_loadu_ps(s1+i), power));
+    _mm512_storeu_ps(s2+i, _mm512_fmadd_ps(power, power, _mm512_loadu_ps(s2+i)));
+  }
+  return avx2Kurtosis_32fc(src+i, s1+i, s2+i, length-i);
+}
+
+SIMD_AVX512 static vecStatus avx512Conj_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  const __m512i negim = _mm512_set1_epi64(0x8000000000000000LL);
+  int i;
+  for(i=0;i<=length-8;i+=8)
+    _mm512_storeu_ps((f32*)(dest+i), avx512Xor(_mm512_loadu_ps((const f32*)(src+i)), negim));
+  return avx2Conj_32fc(src+i, dest+i, length-i);
+}
+
+SIMD_AVX512 static vecStatus avx512Conj_32fc_I(cf32 *srcdest, int length)
+{
+  return avx512Conj_32fc(srcdest, srcdest, length);
+}
+
+SIMD_AVX512 static vecStatus avx512ConjFlip_32fc(const cf32 *src, cf32 *dest, int length)
+{
+  const __m512i negim = _mm512_set1_epi64(0x8000000000000000LL);
+  const __m512i reverse = _mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+  int i;
+  for(i=0;i<=length-8;i+=8)
+  {
+    __m512d v = _mm512_castps_pd(_mm512_loadu_ps((const f32*)(src+length-8-i)));
+    _mm512_storeu_ps((f32*)(dest+i), avx512Xor(_mm512_castpd_ps(_mm512_permutexvar_pd(reverse, v)), negim));
+  }
+  for(;i<length;i++)
+  {
+    dest[i].re = src[length-1-i].re;
+    dest[i].im = -src[length-1-i].im;
+  }
+  return vecNoErr;
+}
+
+SIMD_AVX512 static vecStatus avx512RealToCplx_32f(const f32 *real, const f32 *imag, cf32 *complx, int length)
+{
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512i interleavelo = _mm512_set_epi32(23, 7, 22, 6, 21, 5, 20, 4, 19, 3, 18, 2, 17, 1, 16, 0);
+  const __m512i interleavehi = _mm512_set_epi32(31, 15, 30, 14, 29, 13, 28, 12, 27, 11, 26, 10, 25, 9, 24, 8);
+  int i;
+  for(i=0;i<=length-16;i+=16)
+  {
+    __m512 re = (real)?_mm512_loadu_ps(real+i):zero;
+    __m512 im = (imag)?_mm512_loadu_ps(imag+i):zero;
+    _mm512_storeu_ps((f32*)(complx+i), _mm512_permutex2var_ps(re, interleavelo, im));
+    _mm512_storeu_ps((f32*)(complx+i+8), _mm512_permutex2var_ps(re, interleavehi, im));
+  }
+  return avx2RealToCplx_32f((real)?real+i:0, (imag)?imag+i:0, complx+i, length-i);
+}
+
+SIMD_AVX512 static vecStatus avx512SinCos_32f(const f32 *src, f32 *sin, f32 *cos, int length)
+{
+  int i;
+  for(i=0;i<=length-16;i+=16)
+  {
+    __m512 x = _mm512_loadu_ps(src+i);
+    __m512 ax = _mm512_abs_ps(x);
+    if(_mm512_cmp_ps_mask(ax, _mm512_set1_ps(SINCOS_MAX_ARG), _CMP_GT_OQ))
+    {
+      scalarSinCos_32f(src+i, sin+i, cos+i, 16);
+      continue;
+    }
+    __m512i j = _mm512_cvttps_epi32(_mm512_mul_ps(ax, _mm512_set1_ps(FOUR_OVER_PI)));
+    j = _mm512_and_epi32(_mm512_add_epi32(j, _mm512_set1_epi32(1)), _mm512_set1_epi32(~1));
+    __m512 y = _mm512_cvtepi32_ps(j);
+    __m512i signsin = _mm512_xor_si512(_mm512_and_epi32(_mm512_castps_si512(x), _mm512_set1_epi32(0x80000000)), _mm512_slli_epi32(_mm512_and_epi32(j, _mm512_set1_epi32(4)), 29));
+    __m512i signcos = _mm512_slli_epi32(_mm512_andnot_epi32(_mm512_sub_epi32(j, _mm512_set1_epi32(2)), _mm512_set1_epi32(4)), 29);
+    __mmask16 polymask = _mm512_cmpeq_epi32_mask(_mm512_and_epi32(j, _mm512_set1_epi32(2)), _mm512_setzero_si512());
+    ax = _mm512_fnmadd_ps(y, _mm512_set1_ps(SINCOS_DP1), ax);
+    ax = _mm512_fnmadd_ps(y, _mm512_set1_ps(SINCOS_DP2), ax);
+    ax = _mm512_fnmadd_ps(y, _mm512_set1_ps(SINCOS_DP3), ax);
+    __m512 z = _mm512_mul_ps(ax, ax);
+    __m512 yc = _mm512_fmadd_ps(_mm512_set1_ps(COS_P0), z, _mm512_set1_ps(COS_P1));
+    yc = _mm512_fmadd_ps(yc, z, _mm512_set1_ps(COS_P2));
+    yc = _mm512_mul_ps(_mm512_mul_ps(yc, z), z);
+    yc = _mm512_add_ps(_mm512_fnmadd_ps(z, _mm512_set1_ps(0.5f), yc), _mm512_set1_ps(1.0f));
+    __m512 ys = _mm512_fmadd_ps(_mm512_set1_ps(SIN_P0), z, _mm512_set1_ps(SIN_P1));
+    ys = _mm512_fmadd_ps(ys, z, _mm512_set1_ps(SIN_P2));
+    ys = _mm512_fmadd_ps(_mm512_mul_ps(ys, z), ax, ax);
+    __m512 s = _mm512_mask_blend_ps(polymask, yc, ys);
+    __m512 c = _mm512_mask_blend_ps(polymask, ys, yc);
+    _mm512_storeu_ps(sin+i, avx512Xor(s, signsin));
+    _mm512_storeu_ps(cos+i, avx512Xor(c, signcos));
+  }
+  return avx2SinCos_32f(src+i, sin+i, cos+i, length-i);
+}
+
+#endif /* SIMD_X86 */
+
+//------------------------------------------------------------------------------------------------
+// Dispatch
+//------------------------------------------------------------------------------------------------
+
+//constant initialised, so the scalar kernels are in place before any static constructor runs
+SIMDKernels simdKernels = { SIMD_LEVEL_SCALAR, scalarMul_32fc, scalarMul_32fc_I, scalarMul_32f32fc, scalarAddProduct_32fc,
+                            scalarConj_32fc, scalarConj_32fc_I, scalarConjFlip_32fc, scalarRealToCplx_32f,
+                            scalarSinCos_32f, scalarKurtosis_32fc, scalarMulConj_32fc, scalarAddProductConj_32fc,
+                            scalarPack_32fc16fc, scalarPack_32fc8sc, scalarXmacScaled_16fc, scalarXmacScaled_8sc };
+
+int simdMaxLevel()
+{
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return SIMD_LEVEL_AVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+    return SIMD_LEVEL_AVX2;
+  if(__builtin_cpu_supports("sse2"))
+    return SIMD_LEVEL_SSE2;
+#endif
+  return SIMD_LEVEL_SCALAR;
+}
+
+bool simdSetLevel(int level)
+{
+  if(level < SIMD_LEVEL_SCALAR || level > simdMaxLevel())
+    return false;
+
+  switch(level) {
+#ifdef SIMD_X86
+    case SIMD_LEVEL_SSE2:
+      simdKernels.mul_32fc = sse2Mul_32fc;
+      simdKernels.mul_32fc_I = sse2Mul_32fc_I;
+      simdKernels.mul_32f32fc = sse2Mul_32f32fc;
+      simdKernels.addproduct_32fc = sse2AddProduct_32fc;
+      simdKernels.conj_32fc = sse2Conj_32fc;
+      simdKernels.conj_32fc_I = sse2Conj_32fc_I;
+      simdKernels.conjflip_32fc = sse2ConjFlip_32fc;
+      simdKernels.realtocplx_32f = sse2RealToCplx_32f;
+      simdKernels.sincos_32f = sse2SinCos_32f;
+      simdKernels.kurtosis_32fc = sse2Kurtosis_32fc;
+      simdKernels.mulconj_32fc = sse2MulConj_32fc;
+      simdKernels.addproductconj_32fc = sse2AddProductConj_32fc;
+      simdKernels.pack_32fc16fc = scalarPack_32fc16fc;
+      simdKernels.pack_32fc8sc = sse2Pack_32fc8sc;
+      simdKernels.xmacscaled_16fc = sse2XmacScaled_16fc;
+      simdKernels.xmacscaled_8sc = sse2XmacScaled_8sc;
+      break;
+    case SIMD_LEVEL_AVX2:
+      simdKernels.mul_32fc = avx2Mul_32fc;
+      simdKernels.mul_32fc_I = avx2Mul_32fc_I;
+      simdKernels.mul_32f32fc = avx2Mul_32f32fc;
+      simdKernels.addproduct_32fc = avx2AddProduct_32fc;
+      simdKernels.conj_32fc = avx2Conj_32fc;
+      simdKernels.conj_32fc_I = avx2Conj_32fc_I;
+      simdKernels.conjflip_32fc = avx2ConjFlip_32fc;
+      simdKernels.realtocplx_32f = avx2RealToCplx_32f;
+      simdKernels.sincos_32f = avx2SinCos_32f;
+      simdKernels.kurtosis_32fc = avx2Kurtosis_32fc;
+      simdKernels.mulconj_32fc = avx2MulConj_32fc;
+      simdKernels.addproductconj_32fc = avx2AddProductConj_32fc;
+      simdKernels.pack_32fc16fc = avx2Pack_32fc16fc;
+      simdKernels.pack_32fc8sc = avx2Pack_32fc8sc;
+      simdKernels.xmacscaled_16fc = avx2XmacScaled_16fc;
+      simdKernels.xmacscaled_8sc = avx2XmacScaled_8sc;
+      break;
+    case SIMD_LEVEL_AVX512:
+      simdKernels.mul_32fc = avx512Mul_32fc;
+      simdKernels.mul_32fc_I = avx512Mul_32fc_I;
+      simdKernels.mul_32f32fc = avx512Mul_32f32fc;
+      simdKernels.addproduct_32fc = avx512AddProduct_32fc;
+      simdKernels.conj_32fc = avx512Conj_32fc;
+      simdKernels.conj_32fc_I = avx512Conj_32fc_I;
+      simdKernels.conjflip_32fc = avx512ConjFlip_32fc;
+      simdKernels.realtocplx_32f = avx512RealToCplx_32f;
+      simdKernels.sincos_32f = avx512SinCos_32f;
+      simdKernels.kurtosis_32fc = avx512Kurtosis_32fc;
+      simdKernels.mulconj_32fc = avx512MulConj_32fc;
+      simdKernels.addproductconj_32fc = avx512AddProductConj_32fc;
+      //the packed spectra are bound by memory bandwidth, which wider registers don't help
+      simdKernels.pack_32fc16fc = avx2Pack_32fc16fc;
+      simdKernels.pack_32fc8sc = avx2Pack_32fc8sc;
+      simdKernels.xmacscaled_16fc = avx2XmacScaled_16fc;
+      simdKernels.xmacscaled_8sc = avx2XmacScaled_8sc;
+      break;
+#endif
+    default:
+      simdKernels.mul_32fc = scalarMul_32fc;
+      simdKernels.mul_32fc_I = scalarMul_32fc_I;
+      simdKernels.mul_32f32fc = scalarMul_32f32fc;
+      simdKernels.addproduct_32fc = scalarAddProduct_32fc;
+      simdKernels.conj_32fc = scalarConj_32fc;
+      simdKernels.conj_32fc_I = scalarConj_32fc_I;
+      simdKernels.conjflip_32fc = scalarConjFlip_32fc;
+      simdKernels.realtocplx_32f = scalarRealToCplx_32f;
+      simdKernels.sincos_32f = scalarSinCos_32f;
+      simdKernels.kurtosis_32fc = scalarKurtosis_32fc;
+      simdKernels.mulconj_32fc = scalarMulConj_32fc;
+      simdKernels.addproductconj_32fc = scalarAddProductConj_32fc;
+      simdKernels.pack_32fc16fc = scalarPack_32fc16fc;
+      simdKernels.pack_32fc8sc = scalarPack_32fc8sc;
+      simdKernels.xmacscaled_16fc = scalarXmacScaled_16fc;
+      simdKernels.xmacscaled_8sc = scalarXmacScaled_8sc;
+      break;
+  }
+  simdKernels.level = level;
+  return true;
+}
+
+const char * simdLevelName(int level)
+{
+  switch(level) {
+    case SIMD_LEVEL_SSE2:
+      return "SSE2";
+    case SIMD_LEVEL_AVX2:
+      return "AVX2";
+    case SIMD_LEVEL_AVX512:
+      return "AVX-512";
+    default:
+      return "scalar";
+  }
+}
+
+//pick the best kernels for this host at startup
+static bool simdinitialised = simdSetLevel(simdMaxLevel());
+
+// vim: shiftwidth=2:softtabstop=2:expandtab
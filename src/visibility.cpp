@@ -43,8 +43,8 @@
 #include <difxmessage.h>
 #include "alert.h"
 
-Visibility::Visibility(Configuration * conf, int id, int numvis, char * dbuffer, int dbufferlen, int eseconds, int scan, int scanstartsec, int startns, const string * pnames)
-  : config(conf), visID(id), currentscan(scan), currentstartseconds(scanstartsec), currentstartns(startns), numvisibilities(numvis), executeseconds(eseconds), todiskbufferlength(dbufferlen), polnames(pnames), todiskbuffer(dbuffer)
+Visibility::Visibility(Configuration * conf, int id, int numvis, VisWriter * vwriter, int dbufferlen, int eseconds, int scan, int scanstartsec, int startns, const string * pnames)
+  : config(conf), visID(id), currentscan(scan), currentstartseconds(scanstartsec), currentstartns(startns), numvisibilities(numvis), executeseconds(eseconds), todiskbufferlength(dbufferlen), polnames(pnames), viswriter(vwriter), todiskbuffer(0)
 {
   int status, binloop, maxbinloop = 1;
 
@@ -178,14 +178,14 @@ Visibility::~Visibility()
   }
 }
 
-bool Visibility::addData(cf32* subintresults)
+bool Visibility::addData(cf32* subintresults, int numsubints)
 {
   int status;
 
   status = vectorAdd_cf32_I(subintresults, results, resultlength);
   if(status != vecNoErr)
     csevere << startl << "Error copying results in Vis. " << visID << endl;
-  currentsubints++;
+  currentsubints += numsubints;
 
   if(currentsubints>subintsthisintegration)
     cwarn << startl << "Somehow Visibility " << visID << " ended up with " << currentsubints << " subintegrations - was expecting only " << subintsthisintegration << endl;
@@ -744,6 +744,7 @@ void Visibility::writedifx(int dumpmjd, double dumpseconds)
     binloop = 1;
 
   numfiles = binloop*model->getNumPhaseCentres(currentscan);
+  todiskbuffer = viswriter->acquireBuffer();
   for(int f=0;f<numfiles;f++)
   {
     todiskmemptrs[f] = f*(todiskbufferlength/numfiles);
@@ -809,26 +810,24 @@ void Visibility::writedifx(int dumpmjd, double dumpseconds)
     }
   }
 
-  //now write all the different files out to disk, one hit per file
+  //now hand all the different files to the writer, one hit per file
   filecount = 0;
   for(int s=0;s<model->getNumPhaseCentres(currentscan);s++)
   {
     for(int b=0;b<binloop;b++)
     {
       sprintf(filename, "%s/DIFX_%05d_%06d.s%04d.b%04d", config->getOutputFilename().c_str(), expermjd, experseconds, s, b);
-      output.open(filename, ios::app);
-      output.write(&(todiskbuffer[filecount*(todiskbufferlength/numfiles)]), todiskmemptrs[filecount]-filecount*(todiskbufferlength/numfiles));
-      output.close();
-      if(!output)
-         csevere << startl << "Error trying to write more data to " << filename << " : " << strerror(errno) << "!!" << endl;
+      viswriter->queueWrite(todiskbuffer, filecount*(todiskbufferlength/numfiles), todiskmemptrs[filecount]-filecount*(todiskbufferlength/numfiles), filename);
       filecount++;
     }
   }
+  viswriter->releaseBuffer(todiskbuffer);
 
   if(model->getNumPhaseCentres(currentscan) == 1)
     sourceindex = model->getPhaseCentreSourceIndex(currentscan, 0);
   else
     sourceindex = model->getPointingCentreSourceIndex(currentscan);
+  todiskbuffer = viswriter->acquireBuffer();
   todiskmemptrs[0] = 0;
 
   //now each autocorrelation visibility point if necessary
@@ -884,14 +883,13 @@ void Visibility::writedifx(int dumpmjd, double dumpseconds)
 
   if(todiskmemptrs[0] > 0)
   {
-    //write out the autocorrelations, all in one hit
+    //write out the autocorrelations, all in one hit (queued behind the cross correlations for the same file)
     sprintf(filename, "%s/DIFX_%05d_%06d.s%04d.b%04d", config->getOutputFilename().c_str(), expermjd, experseconds, 0, 0);
-    output.open(filename, ios::app);
-    output.write(todiskbuffer, todiskmemptrs[0]);
-    output.close();
-    if(!output)
-      csevere << startl << "Error trying to write more data to " << filename << " : " << strerror(errno) << "!!" << endl;
+    viswriter->queueWrite(todiskbuffer, 0, todiskmemptrs[0], filename);
   }
+  viswriter->releaseBuffer(todiskbuffer);
+  todiskbuffer = 0;
+  viswriter->endIntegration();
 
 
 /* Pulse cal data format is described here.
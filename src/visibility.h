@@ -30,6 +30,7 @@
 #include <string>
 #include "architecture.h"
 #include "datastream.h"
+#include "viswriter.h"
 
 /**
 @class Visibility 
@@ -48,8 +49,8 @@ public:
   * @param conf The configuration object, containing all information about the duration and setup of this correlation
   * @param id This Datastream's MPI id
   * @param numvis The number of Visibilities in the array
-  * @param dbuffer A buffer to use when writing to disk (one shared between all visibilities)
-  * @param dbufferlen The length of the disk writing buffer
+  * @param vwriter The writer that DiFX output is handed to (one shared between all visibilities)
+  * @param dbufferlen The length of each of the writer's buffers
   * @param eseconds The length of the correlation, in seconds
   * @param scan The scan on which we will start
   * @param scanstartsec The number of seconds from the start of this scan
@@ -57,7 +58,7 @@ public:
   * @param pnames The names of the polarisation products eg {RR, LL, RL, LR} or {XX, YY, XY, YX}
   */
 
-  Visibility(Configuration * conf, int id, int numvis, char * dbuffer, int dbufferlen, int eseconds, int scan, int scanstartsec, int startns, const string * pnames);
+  Visibility(Configuration * conf, int id, int numvis, VisWriter * vwriter, int dbufferlen, int eseconds, int scan, int scanstartsec, int startns, const string * pnames);
 
   ~Visibility();
 
@@ -69,11 +70,12 @@ public:
   inline bool configuredOK() const { return configuredok; }
 
  /**
-  * Adds one sub-integration to the accumulator
+  * Adds one sub-integration (or the sum of several, from an Aggregator) to the accumulator
   * @param subintresults The sub-integration to be added
+  * @param numsubints The number of sub-integrations summed in subintresults
   * @return Whether this integration period is now complete
   */
-  bool addData(cf32* subintresults);
+  bool addData(cf32* subintresults, int numsubints = 1);
 
  /**
   * For all datastreams with pulse cal extraction enabled, write some comments to the beginning of the pulse cal file
@@ -200,7 +202,8 @@ private:
   f32 ***  baselineshiftdecorrs;
   std::string * telescopenames;
   cf32 * results;
-  char * todiskbuffer;
+  VisWriter * viswriter;
+  char * todiskbuffer; //the writer buffer being filled, only valid inside writedifx
   int * todiskmemptrs;
   f32 * floatresults;
   f32 *** binweightsums;
@@ -0,0 +1,517 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE //for O_DIRECT
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "viswriter.h"
+#include "alert.h"
+
+const int VisWriter::DIRECT_ALIGNMENT = 4096;
+const int VisWriter::DIRECT_STAGE_BYTES = 4*1024*1024;
+const int VisWriter::MAX_OPEN_FILES = 128;
+
+VisWriter::VisWriter(int nbuffers, int bufferbytes, int nthreads, bool directio, int maxfiles)
+  : numbuffers(nbuffers), bufferbytes(bufferbytes), numthreads(nthreads), directio(directio)
+{
+  int perr;
+  pthread_attr_t attr;
+  struct rlimit filelimit;
+
+  if(numbuffers < 1)
+    numbuffers = 1;
+  if(numthreads < 1)
+    numthreads = 1;
+  outstandingwrites = 0;
+  byteswritten = 0;
+  stalltime = 0.0;
+  keepwriting = true;
+
+  //a direct I/O file can take two descriptors, and the rest of mpifxcorr needs some too
+  if(maxfiles <= 0)
+    maxfiles = MAX_OPEN_FILES;
+  if(getrlimit(RLIMIT_NOFILE, &filelimit) == 0 && filelimit.rlim_cur != RLIM_INFINITY && (rlim_t)maxfiles > filelimit.rlim_cur/4)
+    maxfiles = filelimit.rlim_cur/4;
+  maxfilesperthread = maxfiles/numthreads;
+  if(maxfilesperthread < 1)
+    maxfilesperthread = 1;
+
+  buffers = new char*[numbuffers];
+  pendingwrites = new int[numbuffers];
+  held = new bool[numbuffers];
+  for(int i=0;i<numbuffers;i++)
+  {
+    //aligned so that a buffer could be handed to the kernel directly
+    if(posix_memalign((void**)&(buffers[i]), DIRECT_ALIGNMENT, bufferbytes) != 0)
+      cfatal << startl << "VisWriter could not allocate " << numbuffers << " buffers of " << bufferbytes << " bytes!!!" << endl;
+    pendingwrites[i] = 0;
+    held[i] = false;
+  }
+  estimatedbytes = ((long long)numbuffers)*bufferbytes;
+  if(directio)
+    estimatedbytes += ((long long)getMaxOpenFiles())*DIRECT_STAGE_BYTES;
+
+  pthread_mutex_init(&writerlock, NULL);
+  pthread_cond_init(&buffercond, NULL);
+  pthread_cond_init(&idlecond, NULL);
+  queues = new std::deque<writerequest>[numthreads];
+  queueconds = new pthread_cond_t[numthreads];
+  openfiles = new std::vector<writefile*>[numthreads];
+  usecounts = new long long[numthreads];
+  writerthreads = new pthread_t[numthreads];
+  writerinfos = new writerinfo[numthreads];
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for(int i=0;i<numthreads;i++)
+  {
+    pthread_cond_init(&(queueconds[i]), NULL);
+    usecounts[i] = 0;
+    writerinfos[i].writer = this;
+    writerinfos[i].threadid = i;
+    perr = pthread_create(&(writerthreads[i]), &attr, VisWriter::launchWriterThread, (void *)(&(writerinfos[i])));
+    if(perr != 0)
+      csevere << startl << "VisWriter: Error in launching writer thread " << i << "!!!" << endl;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+VisWriter::~VisWriter()
+{
+  int perr;
+
+  flush();
+  pthread_mutex_lock(&writerlock);
+  keepwriting = false;
+  for(int i=0;i<numthreads;i++)
+    pthread_cond_signal(&(queueconds[i]));
+  pthread_mutex_unlock(&writerlock);
+  for(int i=0;i<numthreads;i++)
+  {
+    perr = pthread_join(writerthreads[i], NULL);
+    if(perr != 0)
+      csevere << startl << "VisWriter: Error in closing writer thread " << i << "!!!" << endl;
+    pthread_cond_destroy(&(queueconds[i]));
+  }
+  pthread_cond_destroy(&buffercond);
+  pthread_cond_destroy(&idlecond);
+  pthread_mutex_destroy(&writerlock);
+
+  for(int i=0;i<numbuffers;i++)
+    free(buffers[i]);
+  delete [] buffers;
+  delete [] pendingwrites;
+  delete [] held;
+  delete [] queues;
+  delete [] queueconds;
+  delete [] openfiles;
+  delete [] usecounts;
+  delete [] writerthreads;
+  delete [] writerinfos;
+}
+
+char * VisWriter::acquireBuffer()
+{
+  int found = -1;
+  double t0 = 0.0;
+
+  pthread_mutex_lock(&writerlock);
+  while(found < 0)
+  {
+    for(int i=0;i<numbuffers && found<0;i++)
+    {
+      if(!held[i] && pendingwrites[i] == 0)
+        found = i;
+    }
+    if(found < 0)
+    {
+      //every buffer is still waiting on storage - this is the only place the caller stalls
+      if(t0 == 0.0)
+        t0 = now();
+      pthread_cond_wait(&buffercond, &writerlock);
+    }
+  }
+  held[found] = true;
+  if(t0 != 0.0)
+    stalltime += now() - t0;
+  pthread_mutex_unlock(&writerlock);
+
+  return buffers[found];
+}
+
+void VisWriter::queueWrite(char * buffer, int offset, int bytes, const char * filename)
+{
+  writerequest request;
+  writefile * file;
+  std::map<std::string, writefile*>::iterator it;
+
+  if(bytes <= 0)
+    return;
+
+  pthread_mutex_lock(&writerlock);
+  request.buffer = -1;
+  for(int i=0;i<numbuffers;i++)
+  {
+    if(buffers[i] == buffer)
+      request.buffer = i;
+  }
+  if(request.buffer < 0 || !held[request.buffer])
+  {
+    pthread_mutex_unlock(&writerlock);
+    csevere << startl << "VisWriter was asked to write " << filename << " from a buffer that was not acquired - ignoring!!!" << endl;
+    return;
+  }
+  it = files.find(filename);
+  if(it != files.end())
+    file = it->second;
+  else
+  {
+    file = new writefile;
+    file->name = new char[strlen(filename)+1];
+    strcpy(file->name, filename);
+    file->fd = -1;
+    file->tailfd = -1;
+    file->direct = false;
+    file->unsynced = false;
+    file->offset = 0;
+    file->stage = 0;
+    file->stagebytes = 0;
+    file->syncedbytes = 0;
+    file->thread = files.size()%numthreads;
+    file->lastuse = 0;
+    files[filename] = file;
+  }
+  if(directio && !file->unsynced)
+  {
+    file->unsynced = true;
+    unsyncedfiles.push_back(file);
+  }
+  request.offset = offset;
+  request.bytes = bytes;
+  request.file = file;
+  pendingwrites[request.buffer]++;
+  outstandingwrites++;
+  queues[file->thread].push_back(request);
+  pthread_cond_signal(&(queueconds[file->thread]));
+  pthread_mutex_unlock(&writerlock);
+}
+
+void VisWriter::releaseBuffer(char * buffer)
+{
+  pthread_mutex_lock(&writerlock);
+  for(int i=0;i<numbuffers;i++)
+  {
+    if(buffers[i] == buffer)
+      held[i] = false;
+  }
+  pthread_cond_broadcast(&buffercond);
+  pthread_mutex_unlock(&writerlock);
+}
+
+void VisWriter::endIntegration()
+{
+  writerequest request;
+
+  pthread_mutex_lock(&writerlock);
+  //queued behind the writes to each file, so only what they leave staged is written out
+  request.buffer = -1;
+  request.offset = 0;
+  request.bytes = 0;
+  for(unsigned int i=0;i<unsyncedfiles.size();i++)
+  {
+    request.file = unsyncedfiles[i];
+    request.file->unsynced = false;
+    outstandingwrites++;
+    queues[request.file->thread].push_back(request);
+    pthread_cond_signal(&(queueconds[request.file->thread]));
+  }
+  unsyncedfiles.clear();
+  pthread_mutex_unlock(&writerlock);
+}
+
+void VisWriter::flush()
+{
+  pthread_mutex_lock(&writerlock);
+  while(outstandingwrites > 0)
+    pthread_cond_wait(&idlecond, &writerlock);
+
+  //the writer threads are idle, so the files can be closed from here
+  for(std::map<std::string, writefile*>::iterator it=files.begin();it!=files.end();++it)
+  {
+    closeFile(it->second);
+    delete [] it->second->name;
+    delete it->second;
+  }
+  files.clear();
+  unsyncedfiles.clear();
+  for(int i=0;i<numthreads;i++)
+    openfiles[i].clear();
+  pthread_mutex_unlock(&writerlock);
+}
+
+void * VisWriter::launchWriterThread(void * arg)
+{
+  writerinfo * info = (writerinfo *)arg;
+
+  info->writer->loopwrite(info->threadid);
+
+  return 0;
+}
+
+void VisWriter::loopwrite(int threadid)
+{
+  writerequest request;
+
+  pthread_mutex_lock(&writerlock);
+  while(true)
+  {
+    while(queues[threadid].empty() && keepwriting)
+      pthread_cond_wait(&(queueconds[threadid]), &writerlock);
+    if(queues[threadid].empty())
+      break;
+    request = queues[threadid].front();
+    queues[threadid].pop_front();
+    pthread_mutex_unlock(&writerlock);
+
+    //only this thread ever touches this file while writes to it are outstanding
+    if(request.buffer < 0)
+      syncFile(request.file);
+    else
+      writeData(threadid, request.file, buffers[request.buffer] + request.offset, request.bytes);
+
+    pthread_mutex_lock(&writerlock);
+    if(request.buffer >= 0)
+    {
+      byteswritten += request.bytes;
+      pendingwrites[request.buffer]--;
+      if(pendingwrites[request.buffer] == 0 && !held[request.buffer])
+        pthread_cond_broadcast(&buffercond);
+    }
+    outstandingwrites--;
+    if(outstandingwrites == 0)
+      pthread_cond_broadcast(&idlecond);
+  }
+  pthread_mutex_unlock(&writerlock);
+}
+
+void VisWriter::writeData(int threadid, writefile * file, const char * data, int bytes)
+{
+  int tocopy;
+
+  if(file->fd < 0)
+    openFile(threadid, file);
+  if(file->fd < 0)
+    return;
+  file->lastuse = ++usecounts[threadid];
+
+  if(!file->direct)
+  {
+    writeFully(file->fd, data, bytes, -1, file->name);
+    return;
+  }
+
+  //O_DIRECT needs aligned offsets, lengths and memory, so gather the records into whole staging blocks
+  while(bytes > 0)
+  {
+    tocopy = DIRECT_STAGE_BYTES - file->stagebytes;
+    if(tocopy > bytes)
+      tocopy = bytes;
+    memcpy(file->stage + file->stagebytes, data, tocopy);
+    file->stagebytes += tocopy;
+    data += tocopy;
+    bytes -= tocopy;
+    if(file->stagebytes == DIRECT_STAGE_BYTES)
+    {
+      writeFully(file->fd, file->stage, DIRECT_STAGE_BYTES, file->offset, file->name);
+      file->offset += DIRECT_STAGE_BYTES;
+      file->stagebytes = 0;
+      file->syncedbytes = 0;
+    }
+  }
+}
+
+void VisWriter::syncFile(writefile * file)
+{
+  //a partial block can't go through O_DIRECT, so write it through the page cache; the whole block overwrites it later
+  if(!file->direct || file->stagebytes == file->syncedbytes)
+    return;
+  if(file->tailfd < 0)
+  {
+    file->tailfd = open(file->name, O_WRONLY);
+    if(file->tailfd < 0)
+    {
+      csevere << startl << "VisWriter could not reopen " << file->name << " : " << strerror(errno) << "!!" << endl;
+      return;
+    }
+  }
+  if(writeFully(file->tailfd, file->stage + file->syncedbytes, file->stagebytes - file->syncedbytes, file->offset + file->syncedbytes, file->name))
+    file->syncedbytes = file->stagebytes;
+}
+
+void VisWriter::openFile(int threadid, writefile * file)
+{
+  struct stat filestat;
+  std::vector<writefile*> & threadfiles = openfiles[threadid];
+  unsigned int oldest;
+
+  //make room by closing the file this thread has gone longest without writing to
+  if(threadfiles.size() >= (unsigned int)maxfilesperthread)
+  {
+    oldest = 0;
+    for(unsigned int i=1;i<threadfiles.size();i++)
+    {
+      if(threadfiles[i]->lastuse < threadfiles[oldest]->lastuse)
+        oldest = i;
+    }
+    closeFile(threadfiles[oldest]);
+    threadfiles.erase(threadfiles.begin() + oldest);
+  }
+
+  if(directio)
+  {
+    file->fd = open(file->name, O_WRONLY|O_CREAT|O_DIRECT, 0644);
+    if(file->fd >= 0 && fstat(file->fd, &filestat) == 0 &&
+       posix_memalign((void**)&(file->stage), DIRECT_ALIGNMENT, DIRECT_STAGE_BYTES) == 0)
+    {
+      //a file closed before (or by an earlier job) may end in a partial block, which goes back into the stage
+      file->offset = filestat.st_size - filestat.st_size%DIRECT_ALIGNMENT;
+      file->stagebytes = filestat.st_size%DIRECT_ALIGNMENT;
+      file->syncedbytes = file->stagebytes;
+      if(readTail(file))
+      {
+        file->direct = true;
+        threadfiles.push_back(file);
+        return;
+      }
+      free(file->stage);
+      file->stage = 0;
+      file->stagebytes = 0;
+      file->syncedbytes = 0;
+    }
+    if(file->lastuse == 0) //not again each time it is reopened
+      cwarn << startl << "VisWriter could not use direct I/O for " << file->name << " - writing it through the page cache" << endl;
+    if(file->fd >= 0)
+      close(file->fd);
+  }
+  file->direct = false;
+  file->fd = open(file->name, O_WRONLY|O_CREAT|O_APPEND, 0644);
+  if(file->fd < 0)
+    csevere << startl << "VisWriter could not open " << file->name << " : " << strerror(errno) << "!!" << endl;
+  else
+    threadfiles.push_back(file);
+}
+
+bool VisWriter::readTail(writefile * file)
+{
+  int fd, toread;
+  ssize_t bytesread;
+
+  if(file->stagebytes == 0)
+    return true;
+  fd = open(file->name, O_RDONLY);
+  if(fd < 0)
+    return false;
+  toread = file->stagebytes;
+  while(toread > 0)
+  {
+    bytesread = pread(fd, file->stage + file->stagebytes - toread, toread, file->offset + file->stagebytes - toread);
+    if(bytesread < 0 && errno == EINTR)
+      continue;
+    if(bytesread <= 0)
+      break;
+    toread -= bytesread;
+  }
+  close(fd);
+
+  return (toread == 0);
+}
+
+void VisWriter::closeFile(writefile * file)
+{
+  if(file->direct)
+  {
+    syncFile(file);
+    free(file->stage);
+    file->stage = 0;
+    file->stagebytes = 0;
+    file->syncedbytes = 0;
+    file->direct = false;
+  }
+  if(file->tailfd >= 0)
+  {
+    close(file->tailfd);
+    file->tailfd = -1;
+  }
+  if(file->fd >= 0)
+  {
+    if(close(file->fd) != 0)
+      csevere << startl << "Error trying to close " << file->name << " : " << strerror(errno) << "!!" << endl;
+    file->fd = -1;
+  }
+}
+
+bool VisWriter::writeFully(int fd, const char * data, int bytes, long long offset, const char * filename)
+{
+  ssize_t written;
+
+  while(bytes > 0)
+  {
+    if(offset < 0)
+      written = write(fd, data, bytes);
+    else
+      written = pwrite(fd, data, bytes, offset);
+    if(written < 0 && errno == EINTR)
+      continue;
+    if(written <= 0)
+    {
+      csevere << startl << "Error trying to write more data to " << filename << " : " << strerror(errno) << "!!" << endl;
+      return false;
+    }
+    data += written;
+    bytes -= written;
+    if(offset >= 0)
+      offset += written;
+  }
+
+  return true;
+}
+
+double VisWriter::now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+// vim: shiftwidth=2:softtabstop=2:expandtab
@@ -0,0 +1,198 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef VISWRITER_H
+#define VISWRITER_H
+
+#include <pthread.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+
+/**
+@class VisWriter
+@brief Writes DiFX output files from a pool of buffers on background threads, so slow storage does not stall the FxManager
+
+Visibility::writedifx formats each integration into a buffer obtained from acquireBuffer, queues the part of the buffer
+belonging to each output file with queueWrite, and gives the buffer back with releaseBuffer.  The buffer returns to
+the pool once every write from it has completed.  The writing thread of the FxManager therefore only waits for storage
+when all of the buffers are in flight at once.
+
+Each output file (one per phase centre and pulsar bin) is always written by the same writer thread, so the records in
+a file stay in the order they were queued while different files are written in parallel.  Files are opened on first use
+and stay open until flush, except that each writer thread keeps no more than its share of the open file limit open at
+once, closing the file it wrote least recently to make room.  With direct I/O the data are staged in aligned blocks and
+written with O_DIRECT, bypassing the page cache; whatever is left in a block at the end of each integration is written
+through the page cache, and written again as part of the whole block once it fills.  If a file cannot be opened for
+direct I/O (tmpfs, for example) it is written normally.
+
+@author The DiFX developers
+*/
+class VisWriter{
+public:
+ /**
+  * Constructor: Allocates the buffers and launches the writer threads
+  * @param nbuffers The number of buffers that can be in flight at once
+  * @param bufferbytes The length of each buffer, in bytes
+  * @param nthreads The number of writer threads
+  * @param directio Whether to bypass the page cache with O_DIRECT
+  * @param maxfiles The most files open at once, or 0 for MAX_OPEN_FILES (either is also held to a quarter of RLIMIT_NOFILE)
+  */
+  VisWriter(int nbuffers, int bufferbytes, int nthreads, bool directio, int maxfiles);
+
+ /**
+  * Destructor: Flushes any outstanding writes and stops the writer threads
+  */
+  ~VisWriter();
+
+ /**
+  * Returns a free buffer, waiting for one of the queued writes to complete if all are in flight
+  * @return A buffer of getBufferBytes() bytes
+  */
+  char * acquireBuffer();
+
+ /**
+  * Queues part of a buffer to be appended to a file.  Writes to the same file are made in the order they are queued
+  * @param buffer A buffer returned by acquireBuffer that has not yet been released
+  * @param offset The offset into the buffer, in bytes
+  * @param bytes The number of bytes to write
+  * @param filename The file to append to
+  */
+  void queueWrite(char * buffer, int offset, int bytes, const char * filename);
+
+ /**
+  * Hands a buffer back; it is reused once every write queued from it has completed
+  * @param buffer The buffer returned by acquireBuffer
+  */
+  void releaseBuffer(char * buffer);
+
+ /**
+  * Marks the end of an integration: once the writes queued so far are done, any data still staged for direct I/O is
+  * written out too, so that no more than the integration in flight is lost if the job dies.  Does not wait
+  */
+  void endIntegration();
+
+ /**
+  * Waits until every queued write has completed, then closes the files
+  */
+  void flush();
+
+ /**
+  * @return The length of each buffer, in bytes
+  */
+  inline int getBufferBytes() const { return bufferbytes; }
+
+ /**
+  * @return The total time spent waiting in acquireBuffer for a free buffer, in seconds
+  */
+  inline double getStallTime() const { return stalltime; }
+
+ /**
+  * @return The total number of bytes written so far
+  */
+  inline long long getBytesWritten() const { return byteswritten; }
+
+ /**
+  * Returns the estimated number of bytes used by the VisWriter
+  * @return Estimated memory size of the VisWriter (bytes)
+  */
+  inline long long getEstimatedBytes() const { return estimatedbytes; }
+
+ /**
+  * @return The most files that can be open at once
+  */
+  inline int getMaxOpenFiles() const { return maxfilesperthread*numthreads; }
+
+  ///Alignment of buffers, file offsets and lengths for O_DIRECT
+  static const int DIRECT_ALIGNMENT;
+  ///Size of the aligned block each file is staged in for O_DIRECT
+  static const int DIRECT_STAGE_BYTES;
+  ///Default limit on the number of files open at once
+  static const int MAX_OPEN_FILES;
+
+private:
+  ///One output file
+  typedef struct {
+    char * name;
+    int fd;
+    int tailfd; //without O_DIRECT, for the partial block at the end of an integration
+    bool direct;
+    bool unsynced; //written since the last endIntegration
+    long long offset;
+    char * stage;
+    int stagebytes;
+    int syncedbytes; //bytes of the stage already written through tailfd
+    int thread;
+    long long lastuse;
+  } writefile;
+
+  ///A part of a buffer waiting to be written to a file
+  typedef struct {
+    int buffer; //-1 to write out what is staged for the file instead
+
+    int offset;
+    int bytes;
+    writefile * file;
+  } writerequest;
+
+  ///Information passed to a writer thread
+  typedef struct {
+    VisWriter * writer;
+    int threadid;
+  } writerinfo;
+
+  static void * launchWriterThread(void * arg);
+  void loopwrite(int threadid);
+  void writeData(int threadid, writefile * file, const char * data, int bytes);
+  void syncFile(writefile * file);
+  void openFile(int threadid, writefile * file);
+  bool readTail(writefile * file);
+  void closeFile(writefile * file);
+  bool writeFully(int fd, const char * data, int bytes, long long offset, const char * filename);
+  static double now();
+
+  int numbuffers, bufferbytes, numthreads, outstandingwrites, maxfilesperthread;
+  bool directio, keepwriting;
+  long long estimatedbytes, byteswritten;
+  double stalltime;
+  char ** buffers;
+  int * pendingwrites; //queued writes still to complete from each buffer
+  bool * held; //buffer acquired and not yet released
+  std::map<std::string, writefile*> files;
+  std::vector<writefile*> unsyncedfiles;
+  std::deque<writerequest> * queues; //one per writer thread
+  std::vector<writefile*> * openfiles; //the files each writer thread has open; touched only by that thread, or by flush once idle
+  long long * usecounts; //writes made by each writer thread, to find the file it used least recently
+  pthread_t * writerthreads;
+  writerinfo * writerinfos;
+  pthread_mutex_t writerlock;
+  pthread_cond_t buffercond, idlecond;
+  pthread_cond_t * queueconds;
+};
+
+#endif
+// vim: shiftwidth=2:softtabstop=2:expandtab
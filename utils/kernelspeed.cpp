@@ -0,0 +1,2354 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by the DiFX developers                             *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+// Single-process timing of the inner correlator kernels, run against
+// synthetic data.  Each test prints the time taken by the existing code
+// path and by its replacement, so the two can be compared on the target
+// hardware without setting up a correlation.
+
+#include <mpi.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+#include <cmath>
+#include <sstream>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "architecture.h"
+#include "core.h"
+#include "mode.h"
+#include "mk5unpacker.h"
+#include "uvshifter.h"
+#include "polyco.h"
+
+static double now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+
+  return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+static void fillrandom(cf32 * v, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    v[i].re = rand()/(float)RAND_MAX - 0.5;
+    v[i].im = rand()/(float)RAND_MAX - 0.5;
+  }
+}
+
+static double maxdifference(const cf32 * a, const cf32 * b, int length)
+{
+  double d, maxd = 0.0;
+
+  for(int i=0;i<length;i++)
+  {
+    d = fabs(a[i].re - b[i].re) + fabs(a[i].im - b[i].im);
+    if(d > maxd)
+      maxd = d;
+  }
+
+  return maxd;
+}
+
+// Compares the per-baseline vectorAddProductConj loop previously used in
+// Core::processdata with the tiled Core::xmacTiled, for a dual polarisation
+// array with all four polarisation products on every baseline
+static int xmacspeed(int argc, char **argv)
+{
+  int numstations = 32;
+  int numchannels = 128;
+  int numffts = 8;
+  int numiterations = 20;
+  int tilelength = Core::XMAC_TILE_LENGTH;
+  int numbaselines, numproducts, product;
+  cf32 *** spectra; //[station*2+pol][fft][channel]
+  cf32 ** loopresults;
+  cf32 ** tiledresults;
+  const cf32 ** vis1;
+  const cf32 ** vis2;
+  double t0, tloop, ttiled, maxd;
+
+  if(argc > 0) numstations = atoi(argv[0]);
+  if(argc > 1) numchannels = atoi(argv[1]);
+  if(argc > 2) numffts = atoi(argv[2]);
+  if(argc > 3) numiterations = atoi(argv[3]);
+  if(argc > 4) tilelength = atoi(argv[4]);
+  if(numstations < 2 || numchannels < 1 || numffts < 1 || numiterations < 1 || tilelength < 1)
+  {
+    fprintf(stderr, "Bad xmac parameters\n");
+    return EXIT_FAILURE;
+  }
+
+  numbaselines = numstations*(numstations-1)/2;
+  numproducts = numbaselines*4;
+
+  spectra = new cf32**[numstations*2];
+  for(int s=0;s<numstations*2;s++)
+  {
+    spectra[s] = new cf32*[numffts];
+    for(int k=0;k<numffts;k++)
+    {
+      spectra[s][k] = vectorAlloc_cf32(numchannels);
+      fillrandom(spectra[s][k], numchannels);
+    }
+  }
+  loopresults = new cf32*[numproducts];
+  tiledresults = new cf32*[numproducts];
+  for(int p=0;p<numproducts;p++)
+  {
+    loopresults[p] = vectorAlloc_cf32(numchannels);
+    tiledresults[p] = vectorAlloc_cf32(numchannels);
+    vectorZero_cf32(loopresults[p], numchannels);
+    vectorZero_cf32(tiledresults[p], numchannels);
+  }
+  vis1 = new const cf32*[numproducts*numffts];
+  vis2 = new const cf32*[numproducts*numffts];
+
+  //baseline, then FFT, then polarisation product, as in the original processdata loop
+  t0 = now();
+  for(int n=0;n<numiterations;n++)
+  {
+    product = 0;
+    for(int s1=0;s1<numstations;s1++)
+    {
+      for(int s2=s1+1;s2<numstations;s2++)
+      {
+        for(int k=0;k<numffts;k++)
+        {
+          for(int p=0;p<4;p++)
+            vectorAddProductConj_cf32(spectra[s1*2+p/2][k], spectra[s2*2+p%2][k], loopresults[product+p], numchannels);
+        }
+        product += 4;
+      }
+    }
+  }
+  tloop = now() - t0;
+
+  //the tiled kernel, including the cost of building the pointer tables each time
+  t0 = now();
+  for(int n=0;n<numiterations;n++)
+  {
+    product = 0;
+    for(int s1=0;s1<numstations;s1++)
+    {
+      for(int s2=s1+1;s2<numstations;s2++)
+      {
+        for(int p=0;p<4;p++)
+        {
+          for(int k=0;k<numffts;k++)
+          {
+            vis1[product*numffts + k] = spectra[s1*2+p/2][k];
+            vis2[product*numffts + k] = spectra[s2*2+p%2][k];
+          }
+          product++;
+        }
+      }
+    }
+    Core::xmacTiled(vis1, vis2, tiledresults, numproducts, numffts, numchannels, tilelength);
+  }
+  ttiled = now() - t0;
+
+  maxd = 0.0;
+  for(int p=0;p<numproducts;p++)
+  {
+    double d = maxdifference(loopresults[p], tiledresults[p], numchannels);
+    if(d > maxd)
+      maxd = d;
+  }
+
+  printf("xmac: %d stations, %d baselines, %d channels, %d FFTs, tile %d\n", numstations, numbaselines, numchannels, numffts, tilelength);
+  printf("  baseline loop : %8.3f ms per call, %8.3f GFLOPS\n", 1.0e3*tloop/numiterations, 8.0e-9*numproducts*numffts*(double)numchannels*numiterations/tloop);
+  printf("  tiled         : %8.3f ms per call, %8.3f GFLOPS\n", 1.0e3*ttiled/numiterations, 8.0e-9*numproducts*numffts*(double)numchannels*numiterations/ttiled);
+  printf("  speedup %.2f, max difference %g\n", tloop/ttiled, maxd);
+
+  for(int p=0;p<numproducts;p++)
+  {
+    vectorFree(loopresults[p]);
+    vectorFree(tiledresults[p]);
+  }
+  delete [] loopresults;
+  delete [] tiledresults;
+  for(int s=0;s<numstations*2;s++)
+  {
+    for(int k=0;k<numffts;k++)
+      vectorFree(spectra[s][k]);
+    delete [] spectra[s];
+  }
+  delete [] spectra;
+  delete [] vis1;
+  delete [] vis2;
+
+  return EXIT_SUCCESS;
+}
+
+// Compares the plain FFT channelisation used by Mode::process with the
+// polyphase filterbank front end (window and fold, then the same FFT), at
+// equal channel counts.  Also reports how much of a tone placed midway
+// between two channels leaks into channels further away, for each method
+static int filterbankspeed(int argc, char **argv)
+{
+  int numchannels = 256;
+  int numffts = 20000;
+  int taps = Mode::FILTERBANK_TAPS;
+  int fftchannels, order, fftbuffersize, status;
+  f32 * samples;
+  f32 * window;
+  f32 * folded;
+  cf32 * complexsamples;
+  cf32 * spectrum;
+  f32 * fftleakage;
+  f32 * pfbleakage;
+  u8 * fftbuffer;
+  vecFFTSpecC_cf32 * fftspec;
+  double t0, tfft, tpfb;
+
+  if(argc > 0) numchannels = atoi(argv[0]);
+  if(argc > 1) numffts = atoi(argv[1]);
+  if(argc > 2) taps = atoi(argv[2]);
+  if(numchannels < 2 || (numchannels & (numchannels-1)) || numffts < 1 || taps < 1)
+  {
+    fprintf(stderr, "Bad filterbank parameters (numChannels must be a power of 2)\n");
+    return EXIT_FAILURE;
+  }
+
+  fftchannels = 2*numchannels;
+  order = 0;
+  while((fftchannels >> order) != 1)
+    order++;
+  status = vectorInitFFTC_cf32(&fftspec, order, vecFFT_NoReNorm, vecAlgHintFast, &fftbuffersize, &fftbuffer);
+  if(status != vecNoErr)
+  {
+    fprintf(stderr, "Error in FFT initialisation\n");
+    return EXIT_FAILURE;
+  }
+
+  //enough samples for every FFT, plus the filterbank overhang
+  samples = vectorAlloc_f32(fftchannels*(numffts + taps));
+  for(int i=0;i<fftchannels*(numffts + taps);i++)
+    samples[i] = rand()/(float)RAND_MAX - 0.5;
+  window = vectorAlloc_f32(taps*fftchannels);
+  folded = vectorAlloc_f32(fftchannels);
+  complexsamples = vectorAlloc_cf32(fftchannels);
+  spectrum = vectorAlloc_cf32(fftchannels);
+  fftleakage = vectorAlloc_f32(numchannels);
+  pfbleakage = vectorAlloc_f32(numchannels);
+  Mode::generateFilterbankWindow(window, taps, fftchannels, 1);
+
+  t0 = now();
+  for(int n=0;n<numffts;n++)
+  {
+    vectorRealToComplex_f32(&(samples[n*fftchannels]), NULL, complexsamples, fftchannels);
+    vectorFFT_CtoC_cf32(complexsamples, spectrum, fftspec, fftbuffer);
+  }
+  tfft = now() - t0;
+
+  t0 = now();
+  for(int n=0;n<numffts;n++)
+  {
+    Mode::filterbankFold(window, samples, n*fftchannels, folded, taps, fftchannels);
+    vectorRealToComplex_f32(folded, NULL, complexsamples, fftchannels);
+    vectorFFT_CtoC_cf32(complexsamples, spectrum, fftspec, fftbuffer);
+  }
+  tpfb = now() - t0;
+
+  //response to a tone midway between channels numchannels/4 and numchannels/4+1
+  for(int i=0;i<fftchannels*taps;i++)
+    samples[i] = cos(TWO_PI*(numchannels/4 + 0.5)*i/fftchannels);
+  vectorRealToComplex_f32(&(samples[(taps-1)*fftchannels/2]), NULL, complexsamples, fftchannels);
+  vectorFFT_CtoC_cf32(complexsamples, spectrum, fftspec, fftbuffer);
+  vectorMagnitude_cf32(spectrum, fftleakage, numchannels);
+  Mode::filterbankFold(window, samples, 0, folded, taps, fftchannels);
+  vectorRealToComplex_f32(folded, NULL, complexsamples, fftchannels);
+  vectorFFT_CtoC_cf32(complexsamples, spectrum, fftspec, fftbuffer);
+  vectorMagnitude_cf32(spectrum, pfbleakage, numchannels);
+
+  printf("filterbank: %d channels, %d FFTs, %d taps\n", numchannels, numffts, taps);
+  printf("  plain FFT  : %8.3f us per FFT, %8.2f Msamples/s\n", 1.0e6*tfft/numffts, 1.0e-6*numffts*(double)fftchannels/tfft);
+  printf("  filterbank : %8.3f us per FFT, %8.2f Msamples/s\n", 1.0e6*tpfb/numffts, 1.0e-6*numffts*(double)fftchannels/tpfb);
+  printf("  leakage of a mid-channel tone relative to its peak (dB)\n");
+  printf("  channels from tone   plain FFT   filterbank\n");
+  for(int i=1;i<=16 && numchannels/4+i<numchannels;i*=2)
+  {
+    printf("  %18.1f %11.1f %12.1f\n", i+0.5, 20*log10(fftleakage[numchannels/4+1+i]/fftleakage[numchannels/4+1]),
+           20*log10(pfbleakage[numchannels/4+1+i]/pfbleakage[numchannels/4+1]));
+  }
+
+  vectorFreeFFTC_cf32(fftspec);
+  vectorFree(fftbuffer);
+  vectorFree(samples);
+  vectorFree(window);
+  vectorFree(folded);
+  vectorFree(complexsamples);
+  vectorFree(spectrum);
+  vectorFree(fftleakage);
+  vectorFree(pfbleakage);
+
+  return EXIT_SUCCESS;
+}
+
+// Compares the recurrence-generated fringe rotator (Mode::generateRotator) with
+// the sin/cos based generation it replaced, for every FFT of a subintegration
+// with a realistic delay model.  Both are checked against the phase evaluated
+// exactly in double precision; fails if the recurrence is worse than sin/cos
+// by more than maxPhaseError
+static int rotatorspeed(int argc, char **argv)
+{
+  int numchannels = 128;
+  int stridelength = 16;
+  int numffts = 20000;
+  double maxphaseerror = 1.0e-6;
+  int fftchannels, numstrides, order;
+  double lofreq, sampletime, delay, rate, a, b, c, quadstep, phase, err, maxerrsincos, maxerrrecur;
+  double t0, tsincos, trecur;
+  f64 * subphase;
+  f64 * stepphase;
+  f32 * subarg;
+  f32 * subsin;
+  f32 * subcos;
+  f32 * steparg;
+  f32 * stepsin;
+  f32 * stepcos;
+  cf32 * subcplx;
+  cf32 * stepcplx;
+  cf32 * quadcplx;
+  cf32 * sincosrotator;
+  cf32 * recurrotator;
+
+  if(argc > 0) numchannels = atoi(argv[0]);
+  if(argc > 1) stridelength = atoi(argv[1]);
+  if(argc > 2) numffts = atoi(argv[2]);
+  if(argc > 3) maxphaseerror = atof(argv[3]);
+  order = (argc > 4)?atoi(argv[4]):1;
+  fftchannels = 2*numchannels;
+  if(numchannels < 1 || stridelength < 1 || fftchannels%stridelength != 0 || numffts < 1 || order < 1 || order > 2)
+  {
+    fprintf(stderr, "Bad rotator parameters (strideLength must divide 2*numChannels, order must be 1 or 2)\n");
+    return EXIT_FAILURE;
+  }
+  numstrides = fftchannels/stridelength;
+
+  subphase = vectorAlloc_f64(stridelength);
+  stepphase = vectorAlloc_f64(numstrides);
+  subarg = vectorAlloc_f32(stridelength);
+  subsin = vectorAlloc_f32(stridelength);
+  subcos = vectorAlloc_f32(stridelength);
+  steparg = vectorAlloc_f32(numstrides);
+  stepsin = vectorAlloc_f32(numstrides);
+  stepcos = vectorAlloc_f32(numstrides);
+  subcplx = vectorAlloc_cf32(stridelength);
+  quadcplx = vectorAlloc_cf32(stridelength);
+  stepcplx = vectorAlloc_cf32(numstrides);
+  sincosrotator = vectorAlloc_cf32(fftchannels);
+  recurrotator = vectorAlloc_cf32(fftchannels);
+
+  //16 MHz bandwidth at 8.4 GHz, with a delay of a few ms changing at 3 us/s (roughly the geometric rate on a long baseline)
+  lofreq = 8400.25;
+  sampletime = 1.0/32.0;
+  rate = 3.0e-6;
+  tsincos = 0.0;
+  trecur = 0.0;
+  maxerrsincos = 0.0;
+  maxerrrecur = 0.0;
+  for(int n=0;n<numffts;n++)
+  {
+    //delay (us) over this FFT as for Mode::process: linear a*x + b, or quadratic a*x^2 + b*x + c with x = 0..1
+    delay = 2345.678 + rate*n*fftchannels*sampletime;
+    if(order == 1)
+    {
+      a = rate*fftchannels*sampletime;
+      b = delay - int(delay);
+      c = 0.0;
+    }
+    else
+    {
+      a = 1.0e-9;
+      b = rate*fftchannels*sampletime;
+      c = delay - int(delay);
+    }
+
+    //the previous method: phases in double, reduced and converted to float, then sin/cos
+    t0 = now();
+    for(int j=0;j<stridelength;j++)
+      subphase[j] = (double(j)/fftchannels*((order==1)?a:b + a*stridelength/double(fftchannels)) + ((order==1)?b:c))*lofreq;
+    for(int k=0;k<numstrides;k++)
+      stepphase[k] = (order==1)?double(k*stridelength)/fftchannels*a*lofreq:(double(k*stridelength)/fftchannels*b + pow(double(k*stridelength)/fftchannels, 2)*a)*lofreq;
+    for(int j=0;j<stridelength;j++)
+      subarg[j] = -TWO_PI*(subphase[j] - int(subphase[j]));
+    for(int k=0;k<numstrides;k++)
+      steparg[k] = -TWO_PI*(stepphase[k] - int(stepphase[k]));
+    vectorSinCos_f32(subarg, subsin, subcos, stridelength);
+    vectorSinCos_f32(steparg, stepsin, stepcos, numstrides);
+    vectorRealToComplex_f32(subcos, subsin, subcplx, stridelength);
+    vectorRealToComplex_f32(stepcos, stepsin, stepcplx, numstrides);
+    if(order == 2)
+    {
+      for(int j=0;j<stridelength;j++)
+        subarg[j] = -TWO_PI*(double(j)/fftchannels*2*a*stridelength/fftchannels*lofreq);
+      vectorSinCos_f32(subarg, subsin, subcos, stridelength);
+      vectorRealToComplex_f32(subcos, subsin, quadcplx, stridelength);
+    }
+    for(int k=0;k<numstrides;k++)
+    {
+      vectorMulC_cf32(subcplx, stepcplx[k], &(sincosrotator[k*stridelength]), stridelength);
+      if(order == 2)
+        vectorMul_cf32_I(quadcplx, subcplx, stridelength);
+    }
+    tsincos += now() - t0;
+
+    //the recurrence, as now used by Mode::process
+    t0 = now();
+    if(order == 1)
+    {
+      Mode::generateRotator(recurrotator, -b*lofreq, -a*lofreq/fftchannels, 0.0, stridelength, maxphaseerror);
+      Mode::generateRotator(stepcplx, 0.0, -a*lofreq*stridelength/fftchannels, 0.0, numstrides, maxphaseerror);
+      for(int k=1;k<numstrides;k++)
+        vectorMulC_cf32(recurrotator, stepcplx[k], &(recurrotator[k*stridelength]), stridelength);
+    }
+    else
+    {
+      quadstep = 2*a*lofreq*stridelength/(double(fftchannels)*double(fftchannels));
+      Mode::generateRotator(subcplx, -c*lofreq, -(b + a*stridelength/double(fftchannels))*lofreq/fftchannels, 0.0, stridelength, maxphaseerror);
+      Mode::generateRotator(quadcplx, 0.0, -quadstep, 0.0, stridelength, maxphaseerror);
+      Mode::generateRotator(stepcplx, 0.0, -b*lofreq*stridelength/fftchannels, -a*lofreq*stridelength*stridelength/(double(fftchannels)*double(fftchannels)), numstrides, maxphaseerror);
+      for(int k=0;k<numstrides;k++)
+      {
+        vectorMulC_cf32(subcplx, stepcplx[k], &(recurrotator[k*stridelength]), stridelength);
+        vectorMul_cf32_I(quadcplx, subcplx, stridelength);
+      }
+    }
+    trecur += now() - t0;
+
+    //compare both with the phase model evaluated exactly (piecewise linear within each stride for order 2)
+    for(int k=0;k<numstrides;k++)
+    {
+      for(int j=0;j<stridelength;j++)
+      {
+        if(order == 1)
+          phase = (double(k*stridelength + j)/fftchannels*a + b)*lofreq;
+        else
+          phase = (double(j)/fftchannels*(b + a*stridelength/double(fftchannels)*(1 + 2*k)) + c)*lofreq + stepphase[k];
+        phase = -TWO_PI*(phase - floor(phase));
+        err = fabs(remainder(atan2(sincosrotator[k*stridelength+j].im, sincosrotator[k*stridelength+j].re) - phase, TWO_PI));
+        if(err > maxerrsincos)
+          maxerrsincos = err;
+        err = fabs(remainder(atan2(recurrotator[k*stridelength+j].im, recurrotator[k*stridelength+j].re) - phase, TWO_PI));
+        if(err > maxerrrecur)
+          maxerrrecur = err;
+      }
+    }
+  }
+
+  printf("rotator: order %d, %d channels, stride %d, %d FFTs, phase error bound %g rad\n", order, numchannels, stridelength, numffts, maxphaseerror);
+  printf("  sin/cos    : %8.3f us per FFT, max phase error %.3g rad\n", 1.0e6*tsincos/numffts, maxerrsincos);
+  printf("  recurrence : %8.3f us per FFT, max phase error %.3g rad\n", 1.0e6*trecur/numffts, maxerrrecur);
+
+  vectorFree(subphase);
+  vectorFree(stepphase);
+  vectorFree(subarg);
+  vectorFree(subsin);
+  vectorFree(subcos);
+  vectorFree(steparg);
+  vectorFree(stepsin);
+  vectorFree(stepcos);
+  vectorFree(subcplx);
+  vectorFree(quadcplx);
+  vectorFree(stepcplx);
+  vectorFree(sincosrotator);
+  vectorFree(recurrotator);
+
+  if(maxerrrecur > maxerrsincos + maxphaseerror)
+  {
+    printf("  FAILED: recurrence phase error exceeds that of sin/cos by more than the bound\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Compares the separate stages previously used for real VDIF and Mark5B data
+// (mark5access unpack of all bands, then per band real to complex, fringe
+// rotation and FFT) with the fused decode and rotate of
+// Mk5Unpacker::unpackRotated followed by the same FFT.  The FFT inputs are the same
+// products either way, so the spectra agree to within rounding (the two paths
+// may be compiled differently, to fused multiply-adds for instance); this also
+// checks the native decoder's levels and bit layout against mark5access.  The unpack
+// alone is also timed, mark5access against Mk5Unpacker::unpack
+static int fusedspeed(int argc, char **argv)
+{
+  const double bandwidth = 16.0;
+  const int numframes = 64;
+  const char * formatname = "VDIF";
+  int nbits = 2;
+  int numbands = 4;
+  int numchannels = 1024;
+  int numffts = 2000;
+  int fftchannels, order, fftbuffersize, status, databytes, framebytes, payloadoffset, framesamples, totalsamples, startsample;
+  int mbps, log2bands;
+  bool ismark5b;
+  char mk5formatname[64];
+  u8 * data;
+  u32 * header;
+  f32 ** unpacked;
+  f32 ** nativeunpacked;
+  Mk5Unpacker * unpacker;
+  cf32 * rotator;
+  cf32 * complexsamples;
+  cf32 * spectrum;
+  cf32 ** separateoutput;
+  cf32 ** fusedoutput;
+  u8 * fftbuffer;
+  vecFFTSpecC_cf32 * fftspec;
+  struct mark5_stream * ms;
+  double t0, tseparate, tfused, tmark5access, tnative, diff, maxdiff;
+  int unpackmismatches;
+
+  if(argc > 0) formatname = argv[0];
+  if(argc > 1) nbits = atoi(argv[1]);
+  if(argc > 2) numbands = atoi(argv[2]);
+  if(argc > 3) numchannels = atoi(argv[3]);
+  if(argc > 4) numffts = atoi(argv[4]);
+  ismark5b = (strcasecmp(formatname, "MARK5B") == 0);
+  if((!ismark5b && strcasecmp(formatname, "VDIF") != 0) || !Mk5Unpacker::isSupported(ismark5b?Configuration::MARK5B:Configuration::VDIF, numbands, nbits, Configuration::REAL) ||
+     numchannels < 2 || (numchannels & (numchannels-1)) || numffts < 1)
+  {
+    fprintf(stderr, "Bad fused parameters (VDIF with 1, 2, 4 or 8 bits or MARK5B with 1 or 2 bits; up to 16 bands; numChannels a power of 2)\n");
+    return EXIT_FAILURE;
+  }
+
+  fftchannels = 2*numchannels;
+  order = 0;
+  while((fftchannels >> order) != 1)
+    order++;
+  status = vectorInitFFTC_cf32(&fftspec, order, vecFFT_NoReNorm, vecAlgHintFast, &fftbuffersize, &fftbuffer);
+  if(status != vecNoErr)
+  {
+    fprintf(stderr, "Error in FFT initialisation\n");
+    return EXIT_FAILURE;
+  }
+
+  //random frames with valid headers
+  mbps = int(2*numbands*bandwidth*nbits + 0.5);
+  if(ismark5b)
+  {
+    databytes = 10000;
+    payloadoffset = 16;
+    sprintf(mk5formatname, "Mark5B-%d-%d-%d", mbps, numbands, nbits);
+  }
+  else
+  {
+    databytes = 8000;
+    payloadoffset = 32;
+    sprintf(mk5formatname, "VDIF_%d-%d-%d-%d", databytes, mbps, numbands, nbits);
+  }
+  framebytes = databytes + payloadoffset;
+  log2bands = 0;
+  while((1 << log2bands) < numbands)
+    log2bands++;
+  framesamples = databytes*8/(numbands*nbits);
+  totalsamples = numframes*framesamples;
+  if(totalsamples < 2*fftchannels)
+  {
+    fprintf(stderr, "numChannels is too large for the %d test frames\n", numframes);
+    vectorFreeFFTC_cf32(fftspec);
+    vectorFree(fftbuffer);
+    return EXIT_FAILURE;
+  }
+  data = vectorAlloc_u8(numframes*framebytes);
+  for(int i=0;i<numframes*framebytes;i++)
+    data[i] = rand() & 0xFF;
+  for(int f=0;f<numframes;f++)
+  {
+    header = (u32 *)(data + f*framebytes);
+    if(ismark5b)
+    {
+      header[0] = 0xABADDEED;
+      header[1] = f;
+      header[2] = 0x56700001;
+      header[3] = 0;
+    }
+    else
+    {
+      header[0] = 1;
+      header[1] = (30 << 24) | f;
+      header[2] = (log2bands << 24) | (framebytes/8);
+      header[3] = ((nbits-1) << 26) | 0x4142;
+    }
+  }
+
+  ms = new_mark5_stream(new_mark5_stream_unpacker(0), new_mark5_format_generic_from_string(mk5formatname));
+  if(ms == 0 || ms->framesamples != framesamples)
+  {
+    fprintf(stderr, "Could not create a mark5access stream for %s\n", mk5formatname);
+    vectorFreeFFTC_cf32(fftspec);
+    vectorFree(fftbuffer);
+    vectorFree(data);
+    return EXIT_FAILURE;
+  }
+
+  unpacker = new Mk5Unpacker(ismark5b?Configuration::MARK5B:Configuration::VDIF, numbands, nbits, framebytes, databytes, totalsamples);
+  unpacker->checkFrames(data, 0, totalsamples);
+  unpacked = new f32*[numbands];
+  nativeunpacked = new f32*[numbands];
+  separateoutput = new cf32*[numbands];
+  fusedoutput = new cf32*[numbands];
+  for(int b=0;b<numbands;b++)
+  {
+    unpacked[b] = vectorAlloc_f32(fftchannels);
+    nativeunpacked[b] = vectorAlloc_f32(fftchannels);
+    separateoutput[b] = vectorAlloc_cf32(numchannels);
+    fusedoutput[b] = vectorAlloc_cf32(numchannels);
+  }
+  rotator = vectorAlloc_cf32(fftchannels);
+  complexsamples = vectorAlloc_cf32(fftchannels);
+  spectrum = vectorAlloc_cf32(fftchannels);
+  Mode::generateRotator(rotator, 0.123, 0.0173, 0.0, fftchannels, Mode::ROTATOR_MAX_PHASE_ERROR);
+
+  //the separate stages, as Mode::process used them
+  tseparate = 0.0;
+  tfused = 0.0;
+  maxdiff = 0.0;
+  for(int n=0;n<numffts;n++)
+  {
+    //deliberately not aligned with the frames
+    startsample = (n*(fftchannels + 7))%(totalsamples - fftchannels);
+
+    t0 = now();
+    mark5_unpack_with_offset(ms, data, startsample, unpacked, fftchannels);
+    for(int b=0;b<numbands;b++)
+    {
+      vectorRealToComplex_f32(unpacked[b], NULL, complexsamples, fftchannels);
+      vectorMul_cf32_I(rotator, complexsamples, fftchannels);
+      vectorFFT_CtoC_cf32(complexsamples, spectrum, fftspec, fftbuffer);
+      vectorCopy_cf32(spectrum, separateoutput[b], numchannels);
+    }
+    tseparate += now() - t0;
+
+    t0 = now();
+    for(int b=0;b<numbands;b++)
+    {
+      unpacker->unpackRotated(data, b, startsample, rotator, complexsamples, fftchannels);
+      vectorFFT_CtoC_cf32(complexsamples, spectrum, fftspec, fftbuffer);
+      vectorCopy_cf32(spectrum, fusedoutput[b], numchannels);
+    }
+    tfused += now() - t0;
+
+    for(int b=0;b<numbands;b++)
+    {
+      diff = maxdifference(separateoutput[b], fusedoutput[b], numchannels);
+      if(diff > maxdiff)
+        maxdiff = diff;
+    }
+  }
+
+  //the unpack on its own
+  tmark5access = 0.0;
+  tnative = 0.0;
+  unpackmismatches = 0;
+  for(int n=0;n<numffts;n++)
+  {
+    startsample = (n*(fftchannels + 7))%(totalsamples - fftchannels);
+
+    t0 = now();
+    mark5_unpack_with_offset(ms, data, startsample, unpacked, fftchannels);
+    tmark5access += now() - t0;
+
+    t0 = now();
+    unpacker->unpack(data, startsample, nativeunpacked, fftchannels);
+    tnative += now() - t0;
+
+    for(int b=0;b<numbands;b++)
+    {
+      if(memcmp(unpacked[b], nativeunpacked[b], fftchannels*sizeof(f32)) != 0)
+        unpackmismatches++;
+    }
+  }
+
+  printf("fused: %s %d bit, %d bands, %d channels, %d FFTs\n", ismark5b?"Mark5B":"VDIF", nbits, numbands, numchannels, numffts);
+  printf("  separate stages : %8.3f us per FFT per band, %8.2f Msamples/s\n", 1.0e6*tseparate/(numffts*numbands), 1.0e-6*numffts*numbands*(double)fftchannels/tseparate);
+  printf("  fused decode    : %8.3f us per FFT per band, %8.2f Msamples/s\n", 1.0e6*tfused/(numffts*numbands), 1.0e-6*numffts*numbands*(double)fftchannels/tfused);
+  printf("  max spectral difference %g\n", maxdiff);
+  printf("  unpack only, mark5access : %8.3f us per FFT, %8.2f Msamples/s\n", 1.0e6*tmark5access/numffts, 1.0e-6*numffts*numbands*(double)fftchannels/tmark5access);
+  printf("  unpack only, native      : %8.3f us per FFT, %8.2f Msamples/s\n", 1.0e6*tnative/numffts, 1.0e-6*numffts*numbands*(double)fftchannels/tnative);
+
+  delete_mark5_stream(ms);
+  for(int b=0;b<numbands;b++)
+  {
+    vectorFree(unpacked[b]);
+    vectorFree(nativeunpacked[b]);
+    vectorFree(separateoutput[b]);
+    vectorFree(fusedoutput[b]);
+  }
+  delete [] unpacked;
+  delete [] nativeunpacked;
+  delete [] separateoutput;
+  delete [] fusedoutput;
+  delete unpacker;
+  vectorFree(rotator);
+  vectorFree(complexsamples);
+  vectorFree(spectrum);
+  vectorFree(data);
+  vectorFreeFFTC_cf32(fftspec);
+  vectorFree(fftbuffer);
+
+  if(maxdiff > 0.0 || unpackmismatches > 0)
+  {
+    printf("  FAILED: native decode does not match mark5access\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+static const char * vectorprimitives[] = {"Mul_cf32", "Mul_cf32_I", "AddProduct_cf32", "Conj_cf32",
+                                          "ConjFlip_cf32", "RealToComplex_f32", "Mul_f32cf32", "MulConj_cf32",
+                                          "AddProductConj_cf32", "SinCos_f32", 0};
+
+// Runs one primitive either through the SIMD kernel table at its current
+// level, or (IPP builds only) through the IPP function the vector macro maps to
+static vecStatus runvectorprimitive(int primitive, bool useipp, cf32 * a, cf32 * b, cf32 * c, f32 * x, f32 * s, f32 * co, int length)
+{
+#if (ARCH == INTEL)
+  if(useipp)
+  {
+    switch(primitive) {
+      case 0: return vectorMul_cf32(a, b, c, length);
+      case 1: return vectorMul_cf32_I(b, c, length);
+      case 2: return vectorAddProduct_cf32(a, b, c, length);
+      case 3: return vectorConj_cf32(a, c, length);
+      case 4: return vectorConjFlip_cf32(a, c, length);
+      case 5: return vectorRealToComplex_f32(x, NULL, c, length);
+      case 6: return vectorMul_f32cf32(x, b, c, length);
+      case 7: return vectorMulConj_cf32(a, b, c, length);
+      case 8: return vectorAddProductConj_cf32(a, b, c, length);
+      default: return vectorSinCos_f32(x, s, co, length);
+    }
+  }
+#endif
+  switch(primitive) {
+    case 0: return simdKernels.mul_32fc(a, b, c, length);
+    case 1: return simdKernels.mul_32fc_I(b, c, length);
+    case 2: return simdKernels.addproduct_32fc(a, b, c, length);
+    case 3: return simdKernels.conj_32fc(a, c, length);
+    case 4: return simdKernels.conjflip_32fc(a, c, length);
+    case 5: return simdKernels.realtocplx_32f(x, NULL, c, length);
+    case 6: return simdKernels.mul_32f32fc(x, b, c, length);
+    case 7: return simdKernels.mulconj_32fc(a, b, c, length);
+    case 8: return simdKernels.addproductconj_32fc(a, b, c, length);
+    default: return simdKernels.sincos_32f(x, s, co, length);
+  }
+}
+
+// Times each of the SIMD dispatched vector primitives at every SIMD level
+// the host supports (and against IPP, when built with it), at the vector
+// lengths typical of Mode::process and Core::processdata
+static int vectorspeed(int argc, char **argv)
+{
+  static const int defaultlengths[] = {32, 256, 2048, 16384};
+  int numlengths = (argc > 0) ? argc : 4;
+  int maxlevel = simdMaxLevel();
+  int initiallevel = simdKernels.level;
+  int * lengths = new int[numlengths];
+  int maxlength, numiterations;
+  cf32 *a, *b, *c;
+  f32 *x, *s, *co;
+  double t0;
+
+  maxlength = 0;
+  for(int l=0;l<numlengths;l++)
+  {
+    lengths[l] = (argc > 0) ? atoi(argv[l]) : defaultlengths[l];
+    if(lengths[l] < 1)
+    {
+      fprintf(stderr, "Bad vector length %s\n", argv[l]);
+      delete [] lengths;
+      return EXIT_FAILURE;
+    }
+    if(lengths[l] > maxlength)
+      maxlength = lengths[l];
+  }
+
+  a = vectorAlloc_cf32(maxlength);
+  b = vectorAlloc_cf32(maxlength);
+  c = vectorAlloc_cf32(maxlength);
+  x = vectorAlloc_f32(maxlength);
+  s = vectorAlloc_f32(maxlength);
+  co = vectorAlloc_f32(maxlength);
+  fillrandom(a, maxlength);
+  fillrandom(c, maxlength);
+  //unit phasors and phases within +-pi, like the fringe rotators, so repeated in-place products stay bounded
+  for(int i=0;i<maxlength;i++)
+  {
+    x[i] = TWO_PI*(rand()/(float)RAND_MAX - 0.5);
+    b[i].re = cos(x[i]);
+    b[i].im = sin(x[i]);
+  }
+
+  printf("vector primitives: ns per element, host supports up to %s\n", simdLevelName(maxlevel));
+  printf("  %-18s %7s", "primitive", "length");
+#if (ARCH == INTEL)
+  printf(" %8s", "IPP");
+#endif
+  for(int level=SIMD_LEVEL_SCALAR;level<=maxlevel;level++)
+    printf(" %8s", simdLevelName(level));
+  printf("\n");
+  for(int p=0;vectorprimitives[p]!=0;p++)
+  {
+    for(int l=0;l<numlengths;l++)
+    {
+      numiterations = 1 + 20000000/lengths[l];
+      printf("  %-18s %7d", vectorprimitives[p], lengths[l]);
+#if (ARCH == INTEL)
+      t0 = now();
+      for(int n=0;n<numiterations;n++)
+        runvectorprimitive(p, true, a, b, c, x, s, co, lengths[l]);
+      printf(" %8.3f", 1.0e9*(now() - t0)/((double)numiterations*lengths[l]));
+#endif
+      for(int level=SIMD_LEVEL_SCALAR;level<=maxlevel;level++)
+      {
+        simdSetLevel(level);
+        t0 = now();
+        for(int n=0;n<numiterations;n++)
+          runvectorprimitive(p, false, a, b, c, x, s, co, lengths[l]);
+        printf(" %8.3f", 1.0e9*(now() - t0)/((double)numiterations*lengths[l]));
+      }
+      printf("\n");
+    }
+  }
+  simdSetLevel(initiallevel);
+
+  vectorFree(a);
+  vectorFree(b);
+  vectorFree(c);
+  vectorFree(x);
+  vectorFree(s);
+  vectorFree(co);
+  delete [] lengths;
+
+  return EXIT_SUCCESS;
+}
+
+//the order 1 path of Model::calculateDelayInterpolator, for a quintic delay polynomial
+static void phasecentreinterpolate(const f64 * poly, double t, double timespan, f64 * delaycoeffs)
+{
+  f64 tpowerarray[6];
+  f64 delaysamples[3];
+  double sampletimes[3] = {t, t + timespan/2.0, t + timespan};
+
+  for(int n=0;n<3;n++)
+  {
+    tpowerarray[0] = 1.0;
+    for(int i=0;i<5;i++)
+      tpowerarray[i+1] = tpowerarray[i]*sampletimes[n];
+    vectorDotProduct_f64(tpowerarray, poly, 6, &(delaysamples[n]));
+  }
+  delaycoeffs[0] = delaysamples[2]-delaysamples[0];
+  delaycoeffs[1] = delaysamples[0] + (delaysamples[1] - (delaycoeffs[0]/2.0 + delaysamples[0]))/3.0;
+}
+
+//the differential delay of one baseline and phase centre, as worked out by Core::uvshiftAndAverageBaselineFreq
+static void phasecentredifferential(const f64 * pointing1, const f64 * pointing2, const f64 * phasecentre1, const f64 * phasecentre2, double * differentialdelay)
+{
+  double applieddelay1, applieddelay2;
+
+  applieddelay1 = phasecentre1[1] - pointing1[1];
+  applieddelay2 = phasecentre2[1] - pointing2[1];
+  applieddelay1 += applieddelay1*pointing1[0];
+  applieddelay2 += applieddelay2*pointing2[0];
+  differentialdelay[1] = applieddelay2 - applieddelay1;
+  differentialdelay[0] = phasecentre2[0] + pointing1[0] - (phasecentre1[0] + pointing2[0]);
+}
+
+// Compares working out the multi-field phase centre delays for every baseline
+// and frequency (the delay model evaluated for both antennas at every phase
+// centre, as Core::uvshiftAndAverageBaselineFreq used to) with evaluating it once
+// per antenna and phase centre into a table and differencing from the table, as
+// Core::calculatephasecentredelays now does.  Times one cross-correlation
+// averaging interval for each number of phase centres given, and checks that
+// the differential delays are identical
+static int phasecentrespeed(int argc, char **argv)
+{
+  static const int defaultphasecentres[] = {1, 10, 100, 500, 1000};
+  int numstations = 20;
+  int numfreqs = 16;
+  int numlists = 5;
+  int numbaselines, maxphasecentres, numphasecentres, numiterations, mismatches;
+  double t, t0, tperbaseline, tperantenna;
+  double differentialdelay[2];
+  f64 * polys;
+  f64 * table;
+  f64 * results;
+  f64 * pointing1;
+  f64 * pointing2;
+  f64 ** phasecentredelay1;
+  f64 ** phasecentredelay2;
+  f64 ** perbaselinedelay;
+
+  if(argc > 0) numstations = atoi(argv[0]);
+  if(argc > 1) numfreqs = atoi(argv[1]);
+  if(argc > 2) numlists = argc - 2;
+  if(numstations < 2 || numfreqs < 1)
+  {
+    fprintf(stderr, "Bad phasecentre parameters\n");
+    return EXIT_FAILURE;
+  }
+  maxphasecentres = 0;
+  for(int l=0;l<numlists;l++)
+  {
+    numphasecentres = (argc > 2) ? atoi(argv[l+2]) : defaultphasecentres[l];
+    if(numphasecentres < 1)
+    {
+      fprintf(stderr, "Bad number of phase centres %s\n", argv[l+2]);
+      return EXIT_FAILURE;
+    }
+    if(numphasecentres > maxphasecentres)
+      maxphasecentres = numphasecentres;
+  }
+  numbaselines = numstations*(numstations-1)/2;
+
+  //a delay polynomial per antenna and source (0 = pointing centre), a few ms with a geometric rate of a few us/s
+  polys = vectorAlloc_f64(numstations*(maxphasecentres+1)*6);
+  for(int i=0;i<numstations*(maxphasecentres+1);i++)
+  {
+    polys[i*6] = 5000.0*(rand()/(double)RAND_MAX - 0.5);
+    polys[i*6+1] = 3.0*(rand()/(double)RAND_MAX - 0.5);
+    polys[i*6+2] = 1.0e-4*(rand()/(double)RAND_MAX - 0.5);
+    polys[i*6+3] = 1.0e-8*(rand()/(double)RAND_MAX - 0.5);
+    polys[i*6+4] = 1.0e-12*(rand()/(double)RAND_MAX - 0.5);
+    polys[i*6+5] = 1.0e-16*(rand()/(double)RAND_MAX - 0.5);
+  }
+  table = vectorAlloc_f64(numstations*(maxphasecentres+1)*2);
+  results = vectorAlloc_f64(numbaselines*numfreqs*maxphasecentres*2);
+  pointing1 = vectorAlloc_f64(2);
+  pointing2 = vectorAlloc_f64(2);
+
+  printf("phasecentre: %d stations (%d baselines), %d frequencies, us per averaging interval\n", numstations, numbaselines, numfreqs);
+  printf("  %12s %14s %14s %8s\n", "phasecentres", "per baseline", "per antenna", "speedup");
+  for(int l=0;l<numlists;l++)
+  {
+    numphasecentres = (argc > 2) ? atoi(argv[l+2]) : defaultphasecentres[l];
+    numiterations = 1 + 2000000/(numbaselines*numfreqs*(numphasecentres+1));
+    mismatches = 0;
+
+    //the previous method: both antennas' delays for every baseline and frequency, into freshly allocated arrays
+    t0 = now();
+    for(int n=0;n<numiterations;n++)
+    {
+      t = 12.5 + 0.001*n;
+      for(int b=0;b<numbaselines;b++)
+      {
+        int ant1 = 0, ant2 = b;
+        while(ant2 >= numstations - ant1 - 1)
+          ant2 -= numstations - (ant1++) - 1;
+        ant2 += ant1 + 1;
+        for(int f=0;f<numfreqs;f++)
+        {
+          phasecentredelay1 = new f64*[numphasecentres];
+          phasecentredelay2 = new f64*[numphasecentres];
+          perbaselinedelay = new f64*[numphasecentres];
+          for(int s=0;s<numphasecentres;s++)
+          {
+            phasecentredelay1[s] = new f64[2];
+            phasecentredelay2[s] = new f64[2];
+            perbaselinedelay[s] = new f64[2];
+          }
+          phasecentreinterpolate(&(polys[ant1*(maxphasecentres+1)*6]), t, 0.000001, pointing1);
+          phasecentreinterpolate(&(polys[ant2*(maxphasecentres+1)*6]), t, 0.000001, pointing2);
+          for(int s=0;s<numphasecentres;s++)
+          {
+            phasecentreinterpolate(&(polys[(ant1*(maxphasecentres+1) + s + 1)*6]), t, 0.000001, phasecentredelay1[s]);
+            phasecentreinterpolate(&(polys[(ant2*(maxphasecentres+1) + s + 1)*6]), t, 0.000001, phasecentredelay2[s]);
+            phasecentredifferential(pointing1, pointing2, phasecentredelay1[s], phasecentredelay2[s], perbaselinedelay[s]);
+            results[((b*numfreqs + f)*numphasecentres + s)*2] = perbaselinedelay[s][0];
+            results[((b*numfreqs + f)*numphasecentres + s)*2 + 1] = perbaselinedelay[s][1];
+          }
+          for(int s=0;s<numphasecentres;s++)
+          {
+            delete [] phasecentredelay1[s];
+            delete [] phasecentredelay2[s];
+            delete [] perbaselinedelay[s];
+          }
+          delete [] phasecentredelay1;
+          delete [] phasecentredelay2;
+          delete [] perbaselinedelay;
+        }
+      }
+    }
+    tperbaseline = (now() - t0)/numiterations;
+
+    //the table: each antenna and phase centre once, then differenced for every baseline and frequency
+    t0 = now();
+    for(int n=0;n<numiterations;n++)
+    {
+      t = 12.5 + 0.001*n;
+      for(int a=0;a<numstations;a++)
+      {
+        for(int s=0;s<=numphasecentres;s++)
+          phasecentreinterpolate(&(polys[(a*(maxphasecentres+1) + s)*6]), t, 0.000001, &(table[(a*(numphasecentres+1) + s)*2]));
+      }
+      for(int b=0;b<numbaselines;b++)
+      {
+        int ant1 = 0, ant2 = b;
+        while(ant2 >= numstations - ant1 - 1)
+          ant2 -= numstations - (ant1++) - 1;
+        ant2 += ant1 + 1;
+        for(int f=0;f<numfreqs;f++)
+        {
+          for(int s=0;s<numphasecentres;s++)
+          {
+            phasecentredifferential(&(table[ant1*(numphasecentres+1)*2]), &(table[ant2*(numphasecentres+1)*2]), &(table[(ant1*(numphasecentres+1) + s + 1)*2]), &(table[(ant2*(numphasecentres+1) + s + 1)*2]), differentialdelay);
+            if(n == numiterations-1 && (differentialdelay[0] != results[((b*numfreqs + f)*numphasecentres + s)*2] || differentialdelay[1] != results[((b*numfreqs + f)*numphasecentres + s)*2 + 1]))
+              mismatches++;
+          }
+        }
+      }
+    }
+    tperantenna = (now() - t0)/numiterations;
+
+    printf("  %12d %14.1f %14.1f %7.1fx\n", numphasecentres, 1.0e6*tperbaseline, 1.0e6*tperantenna, tperbaseline/tperantenna);
+    if(mismatches > 0)
+    {
+      printf("  FAILED: %d differential delays differ between the two methods\n", mismatches);
+      return EXIT_FAILURE;
+    }
+  }
+
+  vectorFree(polys);
+  vectorFree(table);
+  vectorFree(results);
+  vectorFree(pointing1);
+  vectorFree(pointing2);
+
+  return EXIT_SUCCESS;
+}
+
+//the shift and average to one phase centre as Core::uvshiftAndAverageBaselineFreq used to do it, adding into
+//out[(phase centre*numproducts + product)*numoutputs + output channel]
+static void sincosuvshift(double delay, int s, double lofrequency, const f64 * chanfreqs, f32 * argument, cf32 * rotator, cf32 * rotated, const cf32 * vis, cf32 * out, int numchannels, int xmacstridelen, int rotatestridelen, int channelinc, int numproducts)
+{
+  int numstrides = numchannels/xmacstridelen;
+  int rotatesperstride = xmacstridelen/rotatestridelen;
+  int rotatorlength = rotatestridelen + numstrides*rotatesperstride;
+  int stridestoaverage = (channelinc/xmacstridelen > 0)?channelinc/xmacstridelen:1;
+  int averagesperstride = (xmacstridelen/channelinc > 0)?xmacstridelen/channelinc:1;
+  int averagelength = xmacstridelen/averagesperstride;
+  double turns, edgeturns;
+  cf32 meanresult;
+
+  edgeturns = delay*lofrequency;
+  edgeturns -= floor(edgeturns);
+  for(int r=0;r<rotatestridelen;r++)
+  {
+    turns = delay*chanfreqs[r] + edgeturns;
+    argument[r] = (turns-floor(turns))*TWO_PI;
+  }
+  for(int r=rotatestridelen;r<rotatorlength;r++)
+  {
+    turns = delay*chanfreqs[r];
+    argument[r] = (turns-floor(turns))*TWO_PI;
+  }
+  vectorSinCos_f32(argument, &(argument[rotatorlength]), &(argument[2*rotatorlength]), rotatorlength);
+  vectorRealToComplex_f32(&(argument[2*rotatorlength]), &(argument[rotatorlength]), rotator, rotatorlength);
+  for(int x=0;x<numstrides;x++)
+  {
+    for(int k=0;k<numproducts;k++)
+    {
+      const cf32 * src = &(vis[(x*numproducts + k)*xmacstridelen]);
+      cf32 * dest = &(out[(s*numproducts + k)*(numchannels/channelinc) + (x*xmacstridelen)/channelinc]);
+      for(int r=0;r<rotatesperstride;r++)
+      {
+        vectorMul_cf32(rotator, &(src[r*rotatestridelen]), &(rotated[r*rotatestridelen]), rotatestridelen);
+        vectorMulC_cf32_I(rotator[rotatestridelen+r+x*rotatesperstride], &(rotated[r*rotatestridelen]), rotatestridelen);
+      }
+      if(channelinc == 1)
+        vectorAdd_cf32_I(rotated, dest, xmacstridelen);
+      else
+      {
+        for(int a=0;a<averagesperstride;a++)
+        {
+          vectorMean_cf32(rotated + a*averagelength, averagelength, &meanresult, vecAlgHintFast);
+          dest[a].re += meanresult.re/stridestoaverage;
+          dest[a].im += meanresult.im/stridestoaverage;
+        }
+      }
+    }
+  }
+}
+
+// Compares shifting one baseline and frequency to many phase centres and
+// averaging in frequency the way Core::uvshiftAndAverageBaselineFreq used to
+// (a sin/cos rotator per phase centre, then rotate and average each
+// polarisation product) with the blocked UVShifter engine, for each number of
+// phase centres given, both averaging channelInc channels and not averaging.
+// Both are checked against the shift and average done in double precision;
+// the errors are relative to the rms output amplitude
+static int uvshiftspeed(int argc, char **argv)
+{
+  static const int defaultphasecentres[] = {1, 10, 100, 1000};
+  const double lofrequency = 8400.0;
+  const double bandwidth = 32.0;
+  int numchannels = 4096;
+  int xmacstridelen = 128;
+  int rotatestridelen = 16;
+  int channelinc = 16;
+  int numproducts = 4;
+  int numlists = 4;
+  int maxphasecentres, numphasecentres, numstrides, rotatesperstride, rotatorlength, numoutputs, numiterations, averaging;
+  double channelbandwidth, stepbandwidth, phase, sumre, sumim, rms, err, maxerrold, maxerrnew;
+  double t0, told, tnew;
+  f64 * delays;
+  f64 * chanfreqs;
+  f32 * argument;
+  cf32 * rotator;
+  cf32 * rotated;
+  cf32 * vis;
+  cf32 * oldout;
+  cf32 * newout;
+  const cf32 ** shiftvis;
+  cf32 ** shiftout;
+  UVShifter * shifter;
+
+  if(argc > 0) numchannels = atoi(argv[0]);
+  if(argc > 1) xmacstridelen = atoi(argv[1]);
+  if(argc > 2) rotatestridelen = atoi(argv[2]);
+  if(argc > 3) channelinc = atoi(argv[3]);
+  if(argc > 4) numproducts = atoi(argv[4]);
+  if(argc > 5) numlists = argc - 5;
+  if(numchannels < 1 || xmacstridelen < 1 || rotatestridelen < 1 || channelinc < 1 || numproducts < 1 || numchannels%xmacstridelen != 0 || xmacstridelen%rotatestridelen != 0 || (channelinc < xmacstridelen && xmacstridelen%channelinc != 0) || (channelinc > xmacstridelen && channelinc%xmacstridelen != 0) || numchannels%channelinc != 0)
+  {
+    fprintf(stderr, "Bad uvshift parameters (strides and channelInc must divide each other and numChannels)\n");
+    return EXIT_FAILURE;
+  }
+  maxphasecentres = 0;
+  for(int l=0;l<numlists;l++)
+  {
+    numphasecentres = (argc > 5) ? atoi(argv[l+5]) : defaultphasecentres[l];
+    if(numphasecentres < 1)
+    {
+      fprintf(stderr, "Bad number of phase centres %s\n", argv[l+5]);
+      return EXIT_FAILURE;
+    }
+    if(numphasecentres > maxphasecentres)
+      maxphasecentres = numphasecentres;
+  }
+  numstrides = numchannels/xmacstridelen;
+  rotatesperstride = xmacstridelen/rotatestridelen;
+  rotatorlength = rotatestridelen + numstrides*rotatesperstride;
+  channelbandwidth = bandwidth/numchannels;
+  stepbandwidth = rotatestridelen*channelbandwidth;
+
+  //visibilities laid out as in threadcrosscorrs: [stride][product][channel]; delays within the FFT window
+  vis = vectorAlloc_cf32(numchannels*numproducts);
+  fillrandom(vis, numchannels*numproducts);
+  delays = vectorAlloc_f64(maxphasecentres);
+  for(int s=0;s<maxphasecentres;s++)
+    delays[s] = 0.5*(numchannels/bandwidth)*(rand()/(double)RAND_MAX - 0.5);
+  chanfreqs = vectorAlloc_f64(rotatorlength);
+  argument = vectorAlloc_f32(3*rotatorlength);
+  rotator = vectorAlloc_cf32(rotatorlength);
+  rotated = vectorAlloc_cf32(xmacstridelen);
+  oldout = vectorAlloc_cf32(maxphasecentres*numproducts*numchannels);
+  newout = vectorAlloc_cf32(maxphasecentres*numproducts*numchannels);
+  shiftvis = new const cf32*[numstrides*numproducts];
+  shiftout = new cf32*[numproducts];
+  shifter = new UVShifter(maxphasecentres, xmacstridelen, numstrides);
+  for(int c=0;c<rotatestridelen;c++)
+    chanfreqs[c] = c*channelbandwidth;
+  for(int c=0;c<numstrides*rotatesperstride;c++)
+    chanfreqs[rotatestridelen+c] = c*stepbandwidth;
+  for(int x=0;x<numstrides;x++)
+  {
+    for(int k=0;k<numproducts;k++)
+      shiftvis[x*numproducts + k] = &(vis[(x*numproducts + k)*xmacstridelen]);
+  }
+
+  printf("uvshift: %d channels, xmac stride %d, rotate stride %d, %d products, us per baseline-frequency\n", numchannels, xmacstridelen, rotatestridelen, numproducts);
+  printf("  %9s %12s %12s %12s %8s %12s %12s\n", "averaging", "phasecentres", "sin/cos", "blocked", "speedup", "err sin/cos", "err blocked");
+  //every number of phase centres is run both with the averaging asked for and without any
+  for(int m=0;m<((channelinc > 1)?2:1);m++)
+  {
+    averaging = (m == 0)?channelinc:1;
+    numoutputs = numchannels/averaging;
+    for(int k=0;k<numproducts;k++)
+      shiftout[k] = &(newout[k*numoutputs]);
+    for(int l=0;l<numlists;l++)
+    {
+      numphasecentres = (argc > 5) ? atoi(argv[l+5]) : defaultphasecentres[l];
+      numiterations = 1 + 2000/numphasecentres;
+
+      t0 = now();
+      for(int n=0;n<numiterations;n++)
+      {
+        for(int s=0;s<numphasecentres;s++)
+          sincosuvshift(delays[s], s, lofrequency, chanfreqs, argument, rotator, rotated, vis, oldout, numchannels, xmacstridelen, rotatestridelen, averaging, numproducts);
+      }
+      told = (now() - t0)/numiterations;
+
+      t0 = now();
+      for(int n=0;n<numiterations;n++)
+      {
+        shifter->setPhaseCentres(delays, numphasecentres, lofrequency, channelbandwidth, numchannels, false);
+        shifter->shiftAndAverage(numstrides, xmacstridelen, averaging, shiftvis, shiftout, numproducts, numproducts*numoutputs);
+      }
+      tnew = (now() - t0)/numiterations;
+
+      //one more pass of each from zero, to check against the shift and average in double precision
+      vectorZero_cf32(oldout, numphasecentres*numproducts*numoutputs);
+      vectorZero_cf32(newout, numphasecentres*numproducts*numoutputs);
+      for(int s=0;s<numphasecentres;s++)
+        sincosuvshift(delays[s], s, lofrequency, chanfreqs, argument, rotator, rotated, vis, oldout, numchannels, xmacstridelen, rotatestridelen, averaging, numproducts);
+      shifter->shiftAndAverage(numstrides, xmacstridelen, averaging, shiftvis, shiftout, numproducts, numproducts*numoutputs);
+      rms = 0.0;
+      maxerrold = 0.0;
+      maxerrnew = 0.0;
+      for(int s=0;s<numphasecentres;s++)
+      {
+        for(int k=0;k<numproducts;k++)
+        {
+          for(int o=0;o<numoutputs;o++)
+          {
+            sumre = 0.0;
+            sumim = 0.0;
+            for(int c=o*averaging;c<(o+1)*averaging;c++)
+            {
+              const cf32 * v = &(vis[((c/xmacstridelen)*numproducts + k)*xmacstridelen + c%xmacstridelen]);
+              phase = delays[s]*(lofrequency + c*channelbandwidth);
+              phase = TWO_PI*(phase - floor(phase));
+              sumre += cos(phase)*v->re - sin(phase)*v->im;
+              sumim += cos(phase)*v->im + sin(phase)*v->re;
+            }
+            sumre /= averaging;
+            sumim /= averaging;
+            rms += sumre*sumre + sumim*sumim;
+            err = hypot(oldout[(s*numproducts + k)*numoutputs + o].re - sumre, oldout[(s*numproducts + k)*numoutputs + o].im - sumim);
+            if(err > maxerrold)
+              maxerrold = err;
+            err = hypot(newout[(s*numproducts + k)*numoutputs + o].re - sumre, newout[(s*numproducts + k)*numoutputs + o].im - sumim);
+            if(err > maxerrnew)
+              maxerrnew = err;
+          }
+        }
+      }
+      rms = sqrt(rms/(numphasecentres*numproducts*numoutputs));
+      printf("  %9d %12d %12.1f %12.1f %7.1fx %12.3g %12.3g\n", averaging, numphasecentres, 1.0e6*told, 1.0e6*tnew, told/tnew, maxerrold/rms, maxerrnew/rms);
+    }
+  }
+
+  delete shifter;
+  delete [] shiftvis;
+  delete [] shiftout;
+  vectorFree(vis);
+  vectorFree(delays);
+  vectorFree(chanfreqs);
+  vectorFree(argument);
+  vectorFree(rotator);
+  vectorFree(rotated);
+  vectorFree(oldout);
+  vectorFree(newout);
+
+  return EXIT_SUCCESS;
+}
+
+//Polyco::getBins as it was, a linear scan of the bin breakpoints for every channel
+class LinearScanPolyco : public Polyco
+{
+  public:
+  LinearScanPolyco(string filename, istream * polycofile, int nbins, int maxchans, double * bphases, double * bweights, double calcmins)
+    : Polyco(filename, polycofile, 0, 0, nbins, maxchans, bphases, bweights, calcmins) {}
+
+  void getBinsLinearScan(double offsetmins, int ** bins) const
+  {
+    double averagephase, modulophase;
+    double dt = dt0 + offsetmins;
+
+    for(int i=1;i<numcoefficients;i++)
+      timepowerarray[i] = dt*timepowerarray[i-1];
+    vectorDotProduct_f64(timepowerarray, phasecoefficientarray, numcoefficients, &averagephase);
+    for(int i=0;i<numfreqs;i++)
+    {
+      if(computefor[i])
+      {
+        vectorAddC_f64(dmPhaseOffsets[i], averagephase, absolutephases, numchannels[i]);
+        for(int j=0;j<numchannels[i];j++)
+        {
+          modulophase = absolutephases[j] - floor(absolutephases[j]);
+          if(modulophase < binphases[0] || modulophase >= binphases[numbins-1])
+            bins[i][j] = 0;
+          else
+          {
+            for(int k=numbins-1;k>0;k--)
+            {
+              if(modulophase < binphases[k] && modulophase >= binphases[k-1])
+                bins[i][j] = k;
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+// Compares the pulsar binning previously done for every FFT in Core::processdata
+// (a linear scan of the bin breakpoints for each channel in Polyco::getBins, then
+// each channel added into its bin one at a time) with the phase cell lookup of
+// Polyco::getBins and the accumulation of each run of channels sharing a bin
+// (Core::calculatebinruns and Core::accumulatebinrun).  Uses a synthetic polyco for a millisecond pulsar with
+// equal width bins across a few subbands; the bins and the accumulated spectra
+// must be identical
+static int pulsarbinspeed(int argc, char **argv)
+{
+  int numbins = 1024;
+  int numchannels = 4096;
+  double dm = 10.0;
+  int xmacstridelength = 128;
+  const int numfreqs = 4;
+  const int numiterations = 200;
+  int binmismatches, accummismatches, numruns, binrunlength, destbin;
+  double t0, tscan, tlookup, tscatter, truns, tbinruns, fftmins, offsetmins;
+  double freqs[numfreqs], bws[numfreqs];
+  int nchans[numfreqs];
+  bool compute[numfreqs];
+  double * binphases;
+  double * binweights;
+  int ** scanbins;
+  int ** lookupbins;
+  s32 * binruns;
+  cf32 * vis;
+  cf32 * scatteraccum;
+  cf32 * runaccum;
+  char polycotext[1024];
+
+  if(argc > 0) numbins = atoi(argv[0]);
+  if(argc > 1) numchannels = atoi(argv[1]);
+  if(argc > 2) dm = atof(argv[2]);
+  if(argc > 3) xmacstridelength = atoi(argv[3]);
+  if(numbins < 2 || numchannels < 1 || xmacstridelength < 1 || numchannels%xmacstridelength != 0)
+  {
+    fprintf(stderr, "Bad pulsarbin parameters\n");
+    return EXIT_FAILURE;
+  }
+
+  //a 173.7 Hz pulsar observed in four 32 MHz subbands from 1376 MHz, with the phase given entirely by f0
+  sprintf(polycotext, "J0437-4715   1-Jan-20  120000.00   58849.500000000   %.4f   0.000  -6.000\n"
+          "   0.000000    173.6879458121843  7   60   3  1408.000\n"
+          " 0.00000000000000000D+00  0.00000000000000000D+00  0.00000000000000000D+00\n", dm);
+  istringstream polycofile(polycotext);
+  binphases = new double[numbins];
+  binweights = new double[numbins];
+  for(int i=0;i<numbins;i++)
+  {
+    binphases[i] = (i+1.0)/numbins;
+    binweights[i] = 1.0;
+  }
+  LinearScanPolyco polyco("synthetic", &polycofile, numbins, numchannels, binphases, binweights, 1.0);
+  scanbins = new int*[numfreqs];
+  lookupbins = new int*[numfreqs];
+  for(int i=0;i<numfreqs;i++)
+  {
+    freqs[i] = 1376.0 + 32.0*i;
+    bws[i] = 32.0;
+    nchans[i] = numchannels;
+    compute[i] = true;
+    scanbins[i] = vectorAlloc_s32(numchannels);
+    lookupbins[i] = vectorAlloc_s32(numchannels);
+  }
+  if(!polyco.initialisedOK() || !polyco.setFrequencyValues(numfreqs, freqs, bws, nchans, compute))
+  {
+    fprintf(stderr, "Could not set up the synthetic polyco\n");
+    return EXIT_FAILURE;
+  }
+  polyco.setTime(58849, 0.5);
+  fftmins = numchannels/(32.0e6*60.0);
+
+  vis = vectorAlloc_cf32(numchannels);
+  binruns = vectorAlloc_s32(numchannels);
+  scatteraccum = vectorAlloc_cf32(numbins*numchannels);
+  runaccum = vectorAlloc_cf32(numbins*numchannels);
+  vectorZero_cf32(scatteraccum, numbins*numchannels);
+  vectorZero_cf32(runaccum, numbins*numchannels);
+  fillrandom(vis, numchannels);
+
+  //bin lookup, for every subband
+  binmismatches = 0;
+  t0 = now();
+  for(int n=0;n<numiterations;n++)
+    polyco.getBinsLinearScan(n*fftmins, scanbins);
+  tscan = (now() - t0)/numiterations;
+  t0 = now();
+  for(int n=0;n<numiterations;n++)
+    polyco.getBins(n*fftmins, lookupbins);
+  tlookup = (now() - t0)/numiterations;
+  for(int n=0;n<numiterations;n+=numiterations/10)
+  {
+    offsetmins = n*fftmins;
+    polyco.getBinsLinearScan(offsetmins, scanbins);
+    polyco.getBins(offsetmins, lookupbins);
+    for(int i=0;i<numfreqs;i++)
+    {
+      for(int j=0;j<numchannels;j++)
+      {
+        if(scanbins[i][j] != lookupbins[i][j])
+          binmismatches++;
+      }
+    }
+  }
+
+  //accumulation of the lowest subband, one xmac stride at a time, into [bin][channel].  The runs are worked out
+  //once per FFT and subband and then used for every baseline and polarisation product, so are timed separately
+  tscatter = 0.0;
+  truns = 0.0;
+  tbinruns = 0.0;
+  numruns = 0;
+  for(int n=0;n<numiterations;n++)
+  {
+    polyco.getBins(n*fftmins, lookupbins);
+    t0 = now();
+    for(int xmacstart=0;xmacstart<numchannels;xmacstart+=xmacstridelength)
+    {
+      for(int l=0;l<xmacstridelength;l++)
+      {
+        destbin = lookupbins[0][xmacstart+l];
+        scatteraccum[destbin*numchannels + xmacstart + l].re += vis[xmacstart+l].re;
+        scatteraccum[destbin*numchannels + xmacstart + l].im += vis[xmacstart+l].im;
+      }
+    }
+    tscatter += now() - t0;
+    t0 = now();
+    Core::calculatebinruns(lookupbins[0], binruns, numchannels, xmacstridelength);
+    tbinruns += now() - t0;
+    t0 = now();
+    for(int xmacstart=0;xmacstart<numchannels;xmacstart+=xmacstridelength)
+    {
+      for(int l=0;l<xmacstridelength;l+=binrunlength)
+      {
+        destbin = lookupbins[0][xmacstart+l];
+        binrunlength = binruns[xmacstart+l];
+        Core::accumulatebinrun(&(vis[xmacstart+l]), &(runaccum[destbin*numchannels + xmacstart + l]), binrunlength);
+        numruns++;
+      }
+    }
+    truns += now() - t0;
+  }
+  tbinruns /= numiterations;
+  tscatter /= numiterations;
+  truns /= numiterations;
+  accummismatches = 0;
+  for(int i=0;i<numbins*numchannels;i++)
+  {
+    if(scatteraccum[i].re != runaccum[i].re || scatteraccum[i].im != runaccum[i].im)
+      accummismatches++;
+  }
+
+  printf("pulsarbin: %d bins, %d subbands of %d channels, DM %.1f, xmac stride %d, mean run %.1f channels\n", numbins, numfreqs, numchannels, dm, xmacstridelength, ((double)numiterations*numchannels)/numruns);
+  printf("  %-28s %12s %12s %8s %10s\n", "stage", "old (us)", "new (us)", "speedup", "mismatch");
+  printf("  %-28s %12.1f %12.1f %7.1fx %10d\n", "getBins (all subbands)", tscan*1e6, tlookup*1e6, tscan/tlookup, binmismatches);
+  printf("  %-28s %12s %12.1f\n", "bin runs (one subband)", "", tbinruns*1e6);
+  printf("  %-28s %12.1f %12.1f %7.1fx %10d\n", "accumulate (one product)", tscatter*1e6, truns*1e6, tscatter/truns, accummismatches);
+
+  for(int i=0;i<numfreqs;i++)
+  {
+    vectorFree(scanbins[i]);
+    vectorFree(lookupbins[i]);
+  }
+  delete [] scanbins;
+  delete [] lookupbins;
+  delete [] binphases;
+  delete [] binweights;
+  vectorFree(vis);
+  vectorFree(binruns);
+  vectorFree(scatteraccum);
+  vectorFree(runaccum);
+
+  return (binmismatches == 0 && accummismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//the scrunched pulsar accumulation space [freq][stride][baseline][source][polproduct][bin][channel] as
+//Core::createPulsarVaryingSpace used to build it, with an allocation for every pointer table and accumulator
+static cf32 ******* treepulsarspace(int numfreqs, int numstrides, int numbaselines, int numproducts, int numbins, int xmaclength)
+{
+  cf32 ******* space = new cf32******[numfreqs];
+
+  for(int f=0;f<numfreqs;f++)
+  {
+    space[f] = new cf32*****[numstrides];
+    for(int x=0;x<numstrides;x++)
+    {
+      space[f][x] = new cf32****[numbaselines];
+      for(int i=0;i<numbaselines;i++)
+      {
+        space[f][x][i] = new cf32***[1];
+        space[f][x][i][0] = new cf32**[numproducts];
+        for(int j=0;j<numproducts;j++)
+        {
+          space[f][x][i][0][j] = new cf32*[numbins];
+          for(int k=0;k<numbins;k++)
+          {
+            space[f][x][i][0][j][k] = vectorAlloc_cf32(xmaclength);
+            vectorZero_cf32(space[f][x][i][0][j][k], xmaclength);
+          }
+        }
+      }
+    }
+  }
+  return space;
+}
+
+static void freetreepulsarspace(cf32 ******* space, int numfreqs, int numstrides, int numbaselines, int numproducts, int numbins)
+{
+  for(int f=0;f<numfreqs;f++)
+  {
+    for(int x=0;x<numstrides;x++)
+    {
+      for(int i=0;i<numbaselines;i++)
+      {
+        for(int j=0;j<numproducts;j++)
+        {
+          for(int k=0;k<numbins;k++)
+            vectorFree(space[f][x][i][0][j][k]);
+          delete [] space[f][x][i][0][j];
+        }
+        delete [] space[f][x][i][0];
+        delete [] space[f][x][i];
+      }
+      delete [] space[f][x];
+    }
+    delete [] space[f];
+  }
+  delete [] space;
+}
+
+//the same space laid out in an arena the way Core::allocateConfigSpecificThreadSpace does it: the pointer tables
+//first and then the accumulators, with all the bins of a polarisation product following one another
+static cf32 ******* arenapulsarspace(u8 * arena, size_t pointerbytes, int numfreqs, int numstrides, int numbaselines, int numproducts, int numbins, int xmaclength)
+{
+  size_t pointeroffset = 0;
+  size_t dataoffset = pointerbytes;
+  cf32 ******* space = (cf32*******)Core::carveArena(arena, pointeroffset, sizeof(cf32******)*numfreqs);
+
+  for(int f=0;f<numfreqs;f++)
+  {
+    space[f] = (cf32******)Core::carveArena(arena, pointeroffset, sizeof(cf32*****)*numstrides);
+    for(int x=0;x<numstrides;x++)
+    {
+      space[f][x] = (cf32*****)Core::carveArena(arena, pointeroffset, sizeof(cf32****)*numbaselines);
+      for(int i=0;i<numbaselines;i++)
+      {
+        space[f][x][i] = (cf32****)Core::carveArena(arena, pointeroffset, sizeof(cf32***));
+        space[f][x][i][0] = (cf32***)Core::carveArena(arena, pointeroffset, sizeof(cf32**)*numproducts);
+        for(int j=0;j<numproducts;j++)
+        {
+          space[f][x][i][0][j] = (cf32**)Core::carveArena(arena, pointeroffset, sizeof(cf32*)*numbins);
+          vectorZero_u8(arena + dataoffset, numbins*Core::arenaBytes(sizeof(cf32)*xmaclength));
+          for(int k=0;k<numbins;k++)
+            space[f][x][i][0][j][k] = (cf32*)Core::carveArena(arena, dataoffset, sizeof(cf32)*xmaclength);
+        }
+      }
+    }
+  }
+  return space;
+}
+
+//scales every accumulator by its bin weight, as Core::uvshiftAndAverage does to the scrunched pulsar space
+static void sweeppulsarspace(cf32 ******* space, int numfreqs, int numstrides, int numbaselines, int numproducts, int numbins, int xmaclength)
+{
+  for(int f=0;f<numfreqs;f++)
+    for(int x=0;x<numstrides;x++)
+      for(int i=0;i<numbaselines;i++)
+        for(int j=0;j<numproducts;j++)
+          for(int k=0;k<numbins;k++)
+            vectorMulC_f32_I(0.5f + k/(2.0f*numbins), (f32*)(space[f][x][i][0][j][k]), 2*xmaclength);
+}
+
+// Compares building the scrunched pulsar accumulation space of one processing thread
+// as a tree of separate allocations (as Core::createPulsarVaryingSpace did) with laying
+// it out in a single arena (Core::allocateConfigSpecificThreadSpace).  Times the first
+// allocation, a change to a config of the same shape (a full free and rebuild for the
+// tree, a relayout in place for the arena), one sweep over every accumulator and the
+// final free.  Each method runs in its own process so that its peak RSS can be reported
+static int arenaspeed(int argc, char **argv)
+{
+  int numstations = 6;
+  int numfreqs = 8;
+  int numchannels = 256;
+  int xmaclength = 32;
+  int numbins = 256;
+  const int numproducts = 4;
+  int numbaselines, numstrides, childstatus;
+  size_t pointerbytes, databytes;
+  double t0, talloc, treconfig, tsweep, tfree;
+  pid_t child;
+  struct rusage usage;
+  cf32 ******* space;
+  u8 * arena;
+
+  if(argc > 0) numstations = atoi(argv[0]);
+  if(argc > 1) numfreqs = atoi(argv[1]);
+  if(argc > 2) numchannels = atoi(argv[2]);
+  if(argc > 3) xmaclength = atoi(argv[3]);
+  if(argc > 4) numbins = atoi(argv[4]);
+  if(numstations < 2 || numfreqs < 1 || xmaclength < 1 || numchannels%xmaclength != 0 || numbins < 1)
+  {
+    fprintf(stderr, "Bad arena parameters\n");
+    return EXIT_FAILURE;
+  }
+  numbaselines = numstations*(numstations-1)/2;
+  numstrides = numchannels/xmaclength;
+
+  //the arena size, worked out the way Core::configArenaBytes does
+  pointerbytes = Core::arenaBytes(sizeof(void*)*numfreqs) + numfreqs*(Core::arenaBytes(sizeof(void*)*numstrides) + numstrides*(Core::arenaBytes(sizeof(void*)*numbaselines) + numbaselines*(Core::arenaBytes(sizeof(void*)) + Core::arenaBytes(sizeof(void*)*numproducts) + numproducts*Core::arenaBytes(sizeof(void*)*numbins))));
+  databytes = ((size_t)numfreqs)*numstrides*numbaselines*numproducts*numbins*Core::arenaBytes(sizeof(cf32)*xmaclength);
+
+  printf("arena: %d baselines, %d frequencies of %d channels, xmac stride %d, %d bins, %d products: %.1f MB of accumulators in %ld allocations\n", numbaselines, numfreqs, numchannels, xmaclength, numbins, numproducts, ((double)numfreqs)*numchannels*numbaselines*numproducts*numbins*sizeof(cf32)/1048576.0, ((long)numfreqs)*numstrides*numbaselines*(2 + numproducts*(1 + numbins)) + numfreqs*(1 + numstrides) + 1);
+  printf("  %-8s %12s %12s %12s %12s %14s\n", "method", "alloc (ms)", "reconfig (ms)", "sweep (ms)", "free (ms)", "peak RSS (MB)");
+  fflush(stdout);
+  for(int method=0;method<2;method++)
+  {
+    child = fork();
+    if(child < 0)
+    {
+      fprintf(stderr, "Could not fork\n");
+      return EXIT_FAILURE;
+    }
+    if(child == 0)
+    {
+      if(method == 0)
+      {
+        t0 = now();
+        space = treepulsarspace(numfreqs, numstrides, numbaselines, numproducts, numbins, xmaclength);
+        talloc = now() - t0;
+        t0 = now();
+        freetreepulsarspace(space, numfreqs, numstrides, numbaselines, numproducts, numbins);
+        space = treepulsarspace(numfreqs, numstrides, numbaselines, numproducts, numbins, xmaclength);
+        treconfig = now() - t0;
+        t0 = now();
+        sweeppulsarspace(space, numfreqs, numstrides, numbaselines, numproducts, numbins, xmaclength);
+        tsweep = now() - t0;
+        t0 = now();
+        freetreepulsarspace(space, numfreqs, numstrides, numbaselines, numproducts, numbins);
+        tfree = now() - t0;
+      }
+      else
+      {
+        t0 = now();
+        arena = vectorAlloc_u8(pointerbytes + databytes);
+        space = arenapulsarspace(arena, pointerbytes, numfreqs, numstrides, numbaselines, numproducts, numbins, xmaclength);
+        talloc = now() - t0;
+        t0 = now();
+        space = arenapulsarspace(arena, pointerbytes, numfreqs, numstrides, numbaselines, numproducts, numbins, xmaclength);
+        treconfig = now() - t0;
+        t0 = now();
+        sweeppulsarspace(space, numfreqs, numstrides, numbaselines, numproducts, numbins, xmaclength);
+        tsweep = now() - t0;
+        t0 = now();
+        vectorFree(arena);
+        tfree = now() - t0;
+      }
+      printf("  %-8s %12.1f %12.1f %12.1f %12.1f", (method == 0)?"tree":"arena", talloc*1e3, treconfig*1e3, tsweep*1e3, tfree*1e3);
+      fflush(stdout);
+      _exit(EXIT_SUCCESS);
+    }
+    if(wait4(child, &childstatus, 0, &usage) != child || !WIFEXITED(childstatus) || WEXITSTATUS(childstatus) != EXIT_SUCCESS)
+    {
+      fprintf(stderr, "\nThe %s test process failed\n", (method == 0)?"tree":"arena");
+      return EXIT_FAILURE;
+    }
+    printf(" %14.1f\n", usage.ru_maxrss/1024.0);
+    fflush(stdout);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+//Mode::calculateAndAverageKurtosis as it was, a chain of whole array passes and then the frequency average
+static void chainedkurtosis(f32 * s1, f32 * s2, f32 * sk, int numchannels, int maxchannels, int numblocks)
+{
+  int kchanavg;
+
+  vectorSquare_f32_I(s1, numchannels);
+  vectorMulC_f32_I((f32)numblocks, s2, numchannels);
+  vectorDivide_f32(s1, s2, sk, numchannels);
+  vectorAddC_f32_I(-1.0, sk, numchannels);
+  vectorMulC_f32_I((f32)numblocks/(numblocks - 1.0), sk, numchannels);
+  vectorAddC_f32_I(-1.0, sk, numchannels);
+  if(maxchannels < numchannels)
+  {
+    kchanavg = numchannels/maxchannels;
+    vectorMulC_f32_I(1.0/((f32)kchanavg), sk, numchannels);
+    for(int j=0;j<maxchannels;j++)
+    {
+      sk[j] = sk[j*kchanavg];
+      for(int k=1;k<kchanavg;k++)
+        sk[j] += sk[j*kchanavg + k];
+    }
+  }
+}
+
+// Measures what spectral kurtosis adds to the station-based work of Mode::process
+// (the FFT and the fractional sample correction of each band), with the s1/s2
+// accumulation done as the separate magnitude/square/add passes previously used
+// and with the fused vectorKurtosisAccumulate_cf32.  Also compares the chained
+// finalisation with Mode::finaliseKurtosis, which must agree to rounding
+static int kurtosisspeed(int argc, char **argv)
+{
+  int numchannels = 4096;
+  int numbands = 8;
+  int numffts = 2000;
+  int maxchannels = 256;
+  int fftchannels, order, fftbuffersize, status;
+  double t0, toff, tchained, tfused, tchainedaccum, tfusedaccum, tchainedfinal, tfusedfinal, d, maxd;
+  cf32 * complexsamples;
+  cf32 * spectra;
+  cf32 * rotator;
+  f32 * kscratch;
+  f32 * s1;
+  f32 * s2;
+  f32 * chaineds1;
+  f32 * chaineds2;
+  f32 * chainedsk;
+  f32 * fusedsk;
+  u8 * fftbuffer;
+  vecFFTSpecC_cf32 * fftspec;
+
+  if(argc > 0) numchannels = atoi(argv[0]);
+  if(argc > 1) numbands = atoi(argv[1]);
+  if(argc > 2) numffts = atoi(argv[2]);
+  if(argc > 3) maxchannels = atoi(argv[3]);
+  if(numchannels < 2 || (numchannels & (numchannels-1)) || numbands < 1 || numffts < 2 || maxchannels < 1 || maxchannels > numchannels || numchannels%maxchannels != 0)
+  {
+    fprintf(stderr, "Bad kurtosis parameters (numChannels must be a power of 2 and a multiple of maxChannels)\n");
+    return EXIT_FAILURE;
+  }
+
+  fftchannels = 2*numchannels;
+  order = 0;
+  while((fftchannels >> order) != 1)
+    order++;
+  status = vectorInitFFTC_cf32(&fftspec, order, vecFFT_NoReNorm, vecAlgHintFast, &fftbuffersize, &fftbuffer);
+  if(status != vecNoErr)
+  {
+    fprintf(stderr, "Error in FFT initialisation\n");
+    return EXIT_FAILURE;
+  }
+  complexsamples = vectorAlloc_cf32(fftchannels);
+  spectra = vectorAlloc_cf32(numbands*fftchannels);
+  rotator = vectorAlloc_cf32(numchannels);
+  kscratch = vectorAlloc_f32(numchannels);
+  s1 = vectorAlloc_f32(numbands*numchannels);
+  s2 = vectorAlloc_f32(numbands*numchannels);
+  chaineds1 = vectorAlloc_f32(numbands*numchannels);
+  chaineds2 = vectorAlloc_f32(numbands*numchannels);
+  chainedsk = vectorAlloc_f32(numchannels);
+  fusedsk = vectorAlloc_f32(numchannels);
+  fillrandom(complexsamples, fftchannels);
+  Mode::generateRotator(rotator, 0.1, 0.3/numchannels, 0.0, numchannels, Mode::ROTATOR_MAX_PHASE_ERROR);
+  vectorZero_f32(s1, numbands*numchannels);
+  vectorZero_f32(s2, numbands*numchannels);
+  vectorZero_f32(chaineds1, numbands*numchannels);
+  vectorZero_f32(chaineds2, numbands*numchannels);
+
+  //the station-based work alone, then with each way of accumulating the kurtosis, over the same spectra
+  t0 = now();
+  for(int n=0;n<numffts;n++)
+  {
+    for(int b=0;b<numbands;b++)
+    {
+      complexsamples[(n+b)%fftchannels].re += 0.25;
+      vectorFFT_CtoC_cf32(complexsamples, &(spectra[b*fftchannels]), fftspec, fftbuffer);
+      vectorMul_cf32_I(rotator, &(spectra[b*fftchannels]), numchannels);
+    }
+  }
+  toff = now() - t0;
+  t0 = now();
+  for(int n=0;n<numffts;n++)
+  {
+    for(int b=0;b<numbands;b++)
+    {
+      complexsamples[(n+b)%fftchannels].re += 0.25;
+      vectorFFT_CtoC_cf32(complexsamples, &(spectra[b*fftchannels]), fftspec, fftbuffer);
+      vectorMagnitude_cf32(&(spectra[b*fftchannels]), kscratch, numchannels);
+      vectorSquare_f32_I(kscratch, numchannels);
+      vectorAdd_f32_I(kscratch, &(chaineds1[b*numchannels]), numchannels);
+      vectorSquare_f32_I(kscratch, numchannels);
+      vectorAdd_f32_I(kscratch, &(chaineds2[b*numchannels]), numchannels);
+      vectorMul_cf32_I(rotator, &(spectra[b*fftchannels]), numchannels);
+    }
+  }
+  tchained = now() - t0;
+  t0 = now();
+  for(int n=0;n<numffts;n++)
+  {
+    for(int b=0;b<numbands;b++)
+    {
+      complexsamples[(n+b)%fftchannels].re -= 0.25;
+      vectorFFT_CtoC_cf32(complexsamples, &(spectra[b*fftchannels]), fftspec, fftbuffer);
+      vectorKurtosisAccumulate_cf32(&(spectra[b*fftchannels]), &(s1[b*numchannels]), &(s2[b*numchannels]), numchannels);
+      vectorMul_cf32_I(rotator, &(spectra[b*fftchannels]), numchannels);
+    }
+  }
+  tfused = now() - t0;
+
+  //the accumulation alone, on the spectra left by the last FFT of each band
+  t0 = now();
+  for(int n=0;n<numffts;n++)
+  {
+    for(int b=0;b<numbands;b++)
+    {
+      vectorMagnitude_cf32(&(spectra[b*fftchannels]), kscratch, numchannels);
+      vectorSquare_f32_I(kscratch, numchannels);
+      vectorAdd_f32_I(kscratch, &(chaineds1[b*numchannels]), numchannels);
+      vectorSquare_f32_I(kscratch, numchannels);
+      vectorAdd_f32_I(kscratch, &(chaineds2[b*numchannels]), numchannels);
+    }
+  }
+  tchainedaccum = now() - t0;
+  t0 = now();
+  for(int n=0;n<numffts;n++)
+  {
+    for(int b=0;b<numbands;b++)
+      vectorKurtosisAccumulate_cf32(&(spectra[b*fftchannels]), &(s1[b*numchannels]), &(s2[b*numchannels]), numchannels);
+  }
+  tfusedaccum = now() - t0;
+
+  //the finalisation of one band, checked on accumulators that both methods fill identically
+  tchainedfinal = 0.0;
+  tfusedfinal = 0.0;
+  for(int b=0;b<numbands;b++)
+  {
+    vectorCopy_f32(&(s1[b*numchannels]), chaineds1, numchannels);
+    vectorCopy_f32(&(s2[b*numchannels]), chaineds2, numchannels);
+    t0 = now();
+    chainedkurtosis(chaineds1, chaineds2, chainedsk, numchannels, maxchannels, numffts);
+    tchainedfinal += now() - t0;
+    t0 = now();
+    Mode::finaliseKurtosis(&(s1[b*numchannels]), &(s2[b*numchannels]), fusedsk, maxchannels, numchannels/maxchannels, numffts);
+    tfusedfinal += now() - t0;
+  }
+  maxd = 0.0;
+  for(int j=0;j<maxchannels;j++)
+  {
+    d = fabs(chainedsk[j] - fusedsk[j]);
+    if(d > maxd)
+      maxd = d;
+  }
+
+  printf("kurtosis: %d bands of %d channels, %d FFTs, averaged to %d channels\n", numbands, numchannels, numffts, maxchannels);
+  printf("  %-26s %12s %10s\n", "station-based work", "us per FFT", "overhead");
+  printf("  %-26s %12.3f %10s\n", "kurtosis off", 1.0e6*toff/(numffts*numbands), "");
+  printf("  %-26s %12.3f %9.1f%%\n", "kurtosis, separate passes", 1.0e6*tchained/(numffts*numbands), 100.0*(tchained - toff)/toff);
+  printf("  %-26s %12.3f %9.1f%%\n", "kurtosis, fused", 1.0e6*tfused/(numffts*numbands), 100.0*(tfused - toff)/toff);
+  printf("  accumulation alone: separate passes %.3f us, fused %.3f us per FFT\n", 1.0e6*tchainedaccum/(numffts*numbands), 1.0e6*tfusedaccum/(numffts*numbands));
+  printf("  finalisation per band: chained %.3f us, single pass %.3f us, largest difference %.3g\n", 1.0e6*tchainedfinal/numbands, 1.0e6*tfusedfinal/numbands, maxd);
+
+  vectorFreeFFTC_cf32(fftspec);
+  vectorFree(fftbuffer);
+  vectorFree(complexsamples);
+  vectorFree(spectra);
+  vectorFree(rotator);
+  vectorFree(kscratch);
+  vectorFree(s1);
+  vectorFree(s2);
+  vectorFree(chaineds1);
+  vectorFree(chaineds2);
+  vectorFree(chainedsk);
+  vectorFree(fusedsk);
+
+  return (maxd < 1.0e-3) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//complex Gaussian noise, for tests whose statistics matter
+static void fillgaussian(cf32 * v, int length)
+{
+  double u1, u2;
+
+  for(int i=0;i<length;i++)
+  {
+    u1 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    v[i].re = sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+    v[i].im = sqrt(-2.0*log(u1))*sin(2.0*M_PI*u2);
+  }
+}
+
+// Per-FFT cost of online RFI excision (Mode::exciseBandRFI) over a window of
+// buffered noise spectra, with each of the two tests alone and both together,
+// against the cost of the FFT that produced each spectrum
+static int rfiexcisionspeed(int argc, char **argv)
+{
+  int numchannels = 4096;
+  int numffts = 128;
+  int numwindows = 20;
+  int fftchannels, order, fftbuffersize, status, blankedffts, blankedchannels;
+  double t0, tfft, texcise;
+  f32 skthreshold, fftthreshold;
+  cf32 * complexsamples;
+  cf32 * fftout;
+  cf32 ** spectra;
+  f32 * weights;
+  f32 * s1;
+  f32 * s2;
+  f32 * sk;
+  f32 * power;
+  u8 * fftbuffer;
+  vecFFTSpecC_cf32 * fftspec;
+
+  if(argc > 0) numchannels = atoi(argv[0]);
+  if(argc > 1) numffts = atoi(argv[1]);
+  if(argc > 2) numwindows = atoi(argv[2]);
+  if(numchannels < 2 || (numchannels & (numchannels-1)) || numffts < 1 || numwindows < 1)
+  {
+    fprintf(stderr, "Bad rfiexcision parameters (numChannels must be a power of 2)\n");
+    return EXIT_FAILURE;
+  }
+
+  fftchannels = 2*numchannels;
+  order = 0;
+  while((fftchannels >> order) != 1)
+    order++;
+  status = vectorInitFFTC_cf32(&fftspec, order, vecFFT_NoReNorm, vecAlgHintFast, &fftbuffersize, &fftbuffer);
+  if(status != vecNoErr)
+  {
+    fprintf(stderr, "Error in FFT initialisation\n");
+    return EXIT_FAILURE;
+  }
+  complexsamples = vectorAlloc_cf32(fftchannels);
+  fftout = vectorAlloc_cf32(fftchannels);
+  spectra = new cf32*[numffts];
+  for(int n=0;n<numffts;n++)
+    spectra[n] = vectorAlloc_cf32(numchannels);
+  weights = vectorAlloc_f32(numffts);
+  s1 = vectorAlloc_f32(numchannels);
+  s2 = vectorAlloc_f32(numchannels);
+  sk = vectorAlloc_f32(numchannels);
+  power = vectorAlloc_f32(2*numffts);
+  fillrandom(complexsamples, fftchannels);
+
+  t0 = now();
+  for(int n=0;n<numwindows*numffts;n++)
+  {
+    complexsamples[n%fftchannels].re += 0.25;
+    vectorFFT_CtoC_cf32(complexsamples, fftout, fftspec, fftbuffer);
+  }
+  tfft = (now() - t0)/(numwindows*numffts);
+
+  printf("rfiexcision: windows of %d FFTs of %d channels; the FFT takes %.3f us\n", numffts, numchannels, 1.0e6*tfft);
+  printf("  %-14s %12s %10s %8s %10s\n", "tests", "us per FFT", "of FFT", "FFTs", "channels");
+  for(int test=0;test<3;test++)
+  {
+    skthreshold = (test != 1)?5.0:0.0;
+    fftthreshold = (test != 0)?5.0:0.0;
+    texcise = 0.0;
+    blankedffts = 0;
+    blankedchannels = 0;
+    for(int w=0;w<numwindows;w++)
+    {
+      for(int n=0;n<numffts;n++)
+      {
+        fillgaussian(spectra[n], numchannels);
+        weights[n] = 1.0;
+      }
+      t0 = now();
+      blankedffts += Mode::exciseBandRFI(spectra, weights, numffts, numchannels, skthreshold, fftthreshold, s1, s2, sk, power, &status);
+      texcise += now() - t0;
+      blankedchannels += status;
+    }
+    texcise /= numwindows*numffts;
+    printf("  %-14s %12.3f %9.1f%% %8d %10d\n", (test == 0)?"kurtosis":((test == 1)?"FFT power":"both"), 1.0e6*texcise, 100.0*texcise/tfft, blankedffts, blankedchannels);
+  }
+
+  vectorFreeFFTC_cf32(fftspec);
+  vectorFree(fftbuffer);
+  vectorFree(complexsamples);
+  vectorFree(fftout);
+  for(int n=0;n<numffts;n++)
+    vectorFree(spectra[n]);
+  delete [] spectra;
+  vectorFree(weights);
+  vectorFree(s1);
+  vectorFree(s2);
+  vectorFree(sk);
+  vectorFree(power);
+
+  return EXIT_SUCCESS;
+}
+
+// Compares the station spectra handling previously used by Mode::process and
+// Core::processdata, which wrote a conjugated copy of every buffered spectrum
+// and multiplied by that, with conjugating inside vectorAddProductConj_cf32.
+// Two stations each produce numBands spectra per FFT; each is autocorrelated
+// and every band is cross-multiplied, over numBufferedFFTs buffered FFTs.  The
+// memory saved is the conjugated copy of every buffered spectrum
+static int conjmacspeed(int argc, char **argv)
+{
+  int numchannels = 4096;
+  int numbands = 8;
+  int numbufferedffts = 40;
+  int numiterations = 10;
+  int numspectra;
+  double t0, tcopy, tfused, maxd, d;
+  cf32 *** spectra; //[station*numbands+band][fft][channel]
+  cf32 *** conjspectra;
+  cf32 ** copyresults; //autocorrelations of both stations, then cross products
+  cf32 ** fusedresults;
+
+  if(argc > 0) numchannels = atoi(argv[0]);
+  if(argc > 1) numbands = atoi(argv[1]);
+  if(argc > 2) numbufferedffts = atoi(argv[2]);
+  if(argc > 3) numiterations = atoi(argv[3]);
+  if(numchannels < 1 || numbands < 1 || numbufferedffts < 1 || numiterations < 1)
+  {
+    fprintf(stderr, "Bad conjmac parameters\n");
+    return EXIT_FAILURE;
+  }
+
+  numspectra = 2*numbands;
+  spectra = new cf32**[numspectra];
+  conjspectra = new cf32**[numspectra];
+  for(int s=0;s<numspectra;s++)
+  {
+    spectra[s] = new cf32*[numbufferedffts];
+    conjspectra[s] = new cf32*[numbufferedffts];
+    for(int k=0;k<numbufferedffts;k++)
+    {
+      spectra[s][k] = vectorAlloc_cf32(numchannels);
+      conjspectra[s][k] = vectorAlloc_cf32(numchannels);
+      fillrandom(spectra[s][k], numchannels);
+    }
+  }
+  copyresults = new cf32*[numspectra + numbands];
+  fusedresults = new cf32*[numspectra + numbands];
+  for(int r=0;r<numspectra+numbands;r++)
+  {
+    copyresults[r] = vectorAlloc_cf32(numchannels);
+    fusedresults[r] = vectorAlloc_cf32(numchannels);
+    vectorZero_cf32(copyresults[r], numchannels);
+    vectorZero_cf32(fusedresults[r], numchannels);
+  }
+
+  //conjugated copies, written as each FFT is processed and read back for the autocorrelations and cross products
+  t0 = now();
+  for(int n=0;n<numiterations;n++)
+  {
+    for(int k=0;k<numbufferedffts;k++)
+    {
+      for(int s=0;s<numspectra;s++)
+      {
+        vectorConj_cf32(spectra[s][k], conjspectra[s][k], numchannels);
+        vectorAddProduct_cf32(spectra[s][k], conjspectra[s][k], copyresults[s], numchannels);
+      }
+    }
+    for(int b=0;b<numbands;b++)
+    {
+      for(int k=0;k<numbufferedffts;k++)
+        vectorAddProduct_cf32(spectra[b][k], conjspectra[numbands+b][k], copyresults[numspectra+b], numchannels);
+    }
+  }
+  tcopy = now() - t0;
+
+  //conjugating in the multiply-accumulate
+  t0 = now();
+  for(int n=0;n<numiterations;n++)
+  {
+    for(int k=0;k<numbufferedffts;k++)
+    {
+      for(int s=0;s<numspectra;s++)
+        vectorAddProductConj_cf32(spectra[s][k], spectra[s][k], fusedresults[s], numchannels);
+    }
+    for(int b=0;b<numbands;b++)
+    {
+      for(int k=0;k<numbufferedffts;k++)
+        vectorAddProductConj_cf32(spectra[b][k], spectra[numbands+b][k], fusedresults[numspectra+b], numchannels);
+    }
+  }
+  tfused = now() - t0;
+
+  maxd = 0.0;
+  for(int r=0;r<numspectra+numbands;r++)
+  {
+    d = maxdifference(copyresults[r], fusedresults[r], numchannels);
+    if(d > maxd)
+      maxd = d;
+  }
+
+  printf("conjmac: 2 stations, %d bands, %d channels, %d buffered FFTs, %s\n", numbands, numchannels, numbufferedffts, simdLevelName(simdKernels.level));
+  printf("  conjugated copy : %8.3f us per FFT\n", 1.0e6*tcopy/(numiterations*numbufferedffts));
+  printf("  conjugate in mac: %8.3f us per FFT\n", 1.0e6*tfused/(numiterations*numbufferedffts));
+  printf("  speedup %.2f, max difference %g, %.1f MB per station no longer allocated\n", tcopy/tfused, maxd, numbands*numbufferedffts*(double)numchannels*sizeof(cf32)/1048576.0);
+
+  for(int s=0;s<numspectra;s++)
+  {
+    for(int k=0;k<numbufferedffts;k++)
+    {
+      vectorFree(spectra[s][k]);
+      vectorFree(conjspectra[s][k]);
+    }
+    delete [] spectra[s];
+    delete [] conjspectra[s];
+  }
+  delete [] spectra;
+  delete [] conjspectra;
+  for(int r=0;r<numspectra+numbands;r++)
+  {
+    vectorFree(copyresults[r]);
+    vectorFree(fusedresults[r]);
+  }
+  delete [] copyresults;
+  delete [] fusedresults;
+
+  return EXIT_SUCCESS;
+}
+
+// Compares cross-multiplying station spectra held in single precision (Core::xmacTiled)
+// with packing them to FLOAT16 or INT8 (Mode::packBandSpectra) and cross-multiplying
+// the packed spectra (Core::xmacTiledPacked), for a dual polarisation array with all
+// four polarisation products on every baseline.  Reports the size of the spectra the X
+// stage reads, the time to pack them (once per station) and to cross-multiply them,
+// and the rms difference from the single precision visibilities relative to their rms
+static int spectraprecisionspeed(int argc, char **argv)
+{
+  static const Configuration::spectraprecision precisions[] = {Configuration::FLOAT32SPECTRA, Configuration::FLOAT16SPECTRA, Configuration::INT8SPECTRA};
+  static const char * precisionnames[] = {"FLOAT32", "FLOAT16", "INT8"};
+  static const int packedbytes[] = {sizeof(cf32), sizeof(cf16), sizeof(cs8)};
+  int numstations = 32;
+  int numchannels = 4096;
+  int numffts = 8;
+  int numiterations = 5;
+  int numbaselines, numproducts, product;
+  cf32 *** spectra; //[station*2+pol][fft][channel]
+  u8 *** packed;    //[station*2+pol][fft]
+  f32 ** scales;    //[station*2+pol][channel]
+  f32 * weights;
+  f32 * invscales;
+  cf32 * power;
+  cf32 ** fullresults;
+  cf32 ** results;
+  const cf32 ** vis1;
+  const cf32 ** vis2;
+  const u8 ** packedvis1;
+  const u8 ** packedvis2;
+  const f32 ** scales1;
+  const f32 ** scales2;
+  double t0, tpack, txmac, tfull, diff, rms, mbytes;
+
+  if(argc > 0) numstations = atoi(argv[0]);
+  if(argc > 1) numchannels = atoi(argv[1]);
+  if(argc > 2) numffts = atoi(argv[2]);
+  if(argc > 3) numiterations = atoi(argv[3]);
+  if(numstations < 2 || numchannels < 1 || numffts < 1 || numiterations < 1)
+  {
+    fprintf(stderr, "Bad spectraprecision parameters\n");
+    return EXIT_FAILURE;
+  }
+
+  numbaselines = numstations*(numstations-1)/2;
+  numproducts = numbaselines*4;
+  spectra = new cf32**[numstations*2];
+  packed = new u8**[numstations*2];
+  scales = new f32*[numstations*2];
+  for(int s=0;s<numstations*2;s++)
+  {
+    spectra[s] = new cf32*[numffts];
+    packed[s] = new u8*[numffts];
+    scales[s] = vectorAlloc_f32(numchannels);
+    for(int k=0;k<numffts;k++)
+    {
+      spectra[s][k] = vectorAlloc_cf32(numchannels);
+      packed[s][k] = vectorAlloc_u8(sizeof(cf16)*numchannels);
+      fillrandom(spectra[s][k], numchannels);
+    }
+  }
+  weights = vectorAlloc_f32(numffts);
+  for(int k=0;k<numffts;k++)
+    weights[k] = 1.0;
+  invscales = vectorAlloc_f32(numchannels);
+  power = vectorAlloc_cf32(numchannels);
+  fullresults = new cf32*[numproducts];
+  results = new cf32*[numproducts];
+  for(int p=0;p<numproducts;p++)
+  {
+    fullresults[p] = vectorAlloc_cf32(numchannels);
+    results[p] = vectorAlloc_cf32(numchannels);
+  }
+  vis1 = new const cf32*[numproducts*numffts];
+  vis2 = new const cf32*[numproducts*numffts];
+  packedvis1 = new const u8*[numproducts*numffts];
+  packedvis2 = new const u8*[numproducts*numffts];
+  scales1 = new const f32*[numproducts];
+  scales2 = new const f32*[numproducts];
+  product = 0;
+  for(int s1=0;s1<numstations;s1++)
+  {
+    for(int s2=s1+1;s2<numstations;s2++)
+    {
+      for(int p=0;p<4;p++)
+      {
+        for(int k=0;k<numffts;k++)
+        {
+          vis1[product*numffts + k] = spectra[s1*2+p/2][k];
+          vis2[product*numffts + k] = spectra[s2*2+p%2][k];
+          packedvis1[product*numffts + k] = packed[s1*2+p/2][k];
+          packedvis2[product*numffts + k] = packed[s2*2+p%2][k];
+        }
+        scales1[product] = scales[s1*2+p/2];
+        scales2[product] = scales[s2*2+p%2];
+        product++;
+      }
+    }
+  }
+
+  printf("spectraprecision: %d stations, %d baselines, %d channels, %d FFTs, %s\n", numstations, numbaselines, numchannels, numffts, simdLevelName(simdKernels.level));
+  printf("  %-8s %10s %14s %14s %10s %12s\n", "spectra", "MB", "pack (ms)", "xmac (ms)", "speedup", "rms diff");
+  tfull = 0.0;
+  for(int i=0;i<3;i++)
+  {
+    for(int p=0;p<numproducts;p++)
+      vectorZero_cf32(results[p], numchannels);
+    tpack = 0.0;
+    txmac = 0.0;
+    for(int n=0;n<numiterations;n++)
+    {
+      if(precisions[i] != Configuration::FLOAT32SPECTRA)
+      {
+        t0 = now();
+        for(int s=0;s<numstations*2;s++)
+          Mode::packBandSpectra(spectra[s], weights, numffts, numchannels, precisions[i], packed[s], scales[s], invscales, power);
+        tpack += now() - t0;
+      }
+      t0 = now();
+      if(precisions[i] == Configuration::FLOAT32SPECTRA)
+        Core::xmacTiled(vis1, vis2, results, numproducts, numffts, numchannels, Core::XMAC_TILE_LENGTH);
+      else
+        Core::xmacTiledPacked(packedvis1, packedvis2, scales1, scales2, results, precisions[i], numproducts, numffts, numchannels, Core::XMAC_TILE_LENGTH);
+      txmac += now() - t0;
+    }
+    if(precisions[i] == Configuration::FLOAT32SPECTRA)
+    {
+      tfull = txmac;
+      for(int p=0;p<numproducts;p++)
+        vectorCopy_cf32(results[p], fullresults[p], numchannels);
+    }
+    diff = 0.0;
+    rms = 0.0;
+    for(int p=0;p<numproducts;p++)
+    {
+      for(int c=0;c<numchannels;c++)
+      {
+        diff += (results[p][c].re - fullresults[p][c].re)*(results[p][c].re - fullresults[p][c].re) + (results[p][c].im - fullresults[p][c].im)*(results[p][c].im - fullresults[p][c].im);
+        rms += fullresults[p][c].re*fullresults[p][c].re + fullresults[p][c].im*fullresults[p][c].im;
+      }
+    }
+    mbytes = numstations*2.0*numffts*numchannels*packedbytes[i]/1048576.0;
+    printf("  %-8s %10.1f %14.3f %14.3f %10.2f %12.3g\n", precisionnames[i], mbytes, 1.0e3*tpack/numiterations, 1.0e3*txmac/numiterations, tfull/(txmac + tpack), sqrt(diff/rms));
+  }
+
+  for(int s=0;s<numstations*2;s++)
+  {
+    for(int k=0;k<numffts;k++)
+    {
+      vectorFree(spectra[s][k]);
+      vectorFree(packed[s][k]);
+    }
+    delete [] spectra[s];
+    delete [] packed[s];
+    vectorFree(scales[s]);
+  }
+  delete [] spectra;
+  delete [] packed;
+  delete [] scales;
+  for(int p=0;p<numproducts;p++)
+  {
+    vectorFree(fullresults[p]);
+    vectorFree(results[p]);
+  }
+  delete [] fullresults;
+  delete [] results;
+  delete [] vis1;
+  delete [] vis2;
+  delete [] packedvis1;
+  delete [] packedvis2;
+  delete [] scales1;
+  delete [] scales2;
+  vectorFree(weights);
+  vectorFree(invscales);
+  vectorFree(power);
+
+  return EXIT_SUCCESS;
+}
+
+typedef struct {
+  const char * name;
+  const char * args;
+  int (*run)(int argc, char **argv);
+} speedtest;
+
+static const speedtest speedtests[] = {
+  {"xmac", "[numStations] [numChannels] [numFFTs] [numIterations] [tileLength]", xmacspeed},
+  {"filterbank", "[numChannels] [numFFTs] [numTaps]", filterbankspeed},
+  {"vector", "[length1] [length2] ...", vectorspeed},
+  {"rotator", "[numChannels] [strideLength] [numFFTs] [maxPhaseError] [fringeRotOrder]", rotatorspeed},
+  {"fused", "[VDIF|MARK5B] [nBits] [numBands] [numChannels] [numFFTs]", fusedspeed},
+  {"phasecentre", "[numStations] [numFreqs] [numPhaseCentres1] [numPhaseCentres2] ...", phasecentrespeed},
+  {"uvshift", "[numChannels] [xmacStride] [rotateStride] [channelInc] [numProducts] [numPhaseCentres1] ...", uvshiftspeed},
+  {"pulsarbin", "[numBins] [numChannels] [DM] [xmacStride]", pulsarbinspeed},
+  {"arena", "[numStations] [numFreqs] [numChannels] [xmacStride] [numBins]", arenaspeed},
+  {"kurtosis", "[numChannels] [numBands] [numFFTs] [maxChannels]", kurtosisspeed},
+  {"rfiexcision", "[numChannels] [numFFTs] [numWindows]", rfiexcisionspeed},
+  {"conjmac", "[numChannels] [numBands] [numBufferedFFTs] [numIterations]", conjmacspeed},
+  {"spectraprecision", "[numStations] [numChannels] [numFFTs] [numIterations]", spectraprecisionspeed},
+  {0, 0, 0}
+};
+
+static void usage(const char *pgm)
+{
+  fprintf(stderr, "Usage: %s <test> [test parameters]\n\n", pgm);
+  fprintf(stderr, "Available tests:\n");
+  for(int i=0;speedtests[i].name!=0;i++)
+    fprintf(stderr, "  %s %s\n", speedtests[i].name, speedtests[i].args);
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for(int i=0;speedtests[i].name!=0;i++)
+  {
+    if(strcmp(argv[1], speedtests[i].name) == 0)
+      return speedtests[i].run(argc-2, argv+2);
+  }
+
+  usage(argv[0]);
+
+  return EXIT_FAILURE;
+}
+// vim: shiftwidth=2:softtabstop=2:expandtab
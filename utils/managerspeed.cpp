@@ -0,0 +1,203 @@
+#include <mpi.h>
+#include <cstdlib>
+#include <cstdio>
+#include "architecture.h"
+#include "aggregator.h"
+#include "mpifxcorr.h"
+
+// Measures how many subintegration results per second the FxManager rank can absorb, first with every
+// core sending its full result straight to the manager (as mpifxcorr does by default), then with the
+// results going through Aggregators (as mpifxcorr -a<CoresPerAggregator> does).  The manager adds every
+// result it receives into an accumulation buffer, as FxManager does into its Visibility, so the
+// figures include the reduction as well as the receives.
+
+void coresend(int rank, int numcores, int numsubints, int subintsperint, int resultlength, int aggregatorid, cf32 *result, MPI_Comm comm)
+{
+	int header[Aggregator::HEADER_LENGTH];
+
+	header[0] = 0;
+	header[4] = 1;
+	for(int s = rank-1; s < numsubints; s += numcores)
+	{
+		header[1] = s;
+		header[2] = 0;
+		header[3] = s/subintsperint;
+		if(aggregatorid < 0)
+		{
+			MPI_Send(result, resultlength*2, MPI_FLOAT, fxcorr::MANAGERID, CR_VALIDVIS, comm);
+		}
+		else
+		{
+			MPI_Send(header, Aggregator::HEADER_LENGTH, MPI_INT, aggregatorid, CR_AGGREGATEHEADER, comm);
+			MPI_Send(result, resultlength*2, MPI_FLOAT, aggregatorid, CR_VALIDVIS, comm);
+			MPI_Send(result, 0, MPI_FLOAT, fxcorr::MANAGERID, CR_VALIDVIS, comm);
+		}
+	}
+	if(aggregatorid >= 0)
+	{
+		MPI_Send(header, 0, MPI_INT, aggregatorid, CR_TERMINATE, comm);
+	}
+}
+
+void managerreceive(int numsubints, int numaggregators, int resultlength, cf32 *buffer, cf32 *accumulator, MPI_Comm comm)
+{
+	int header[Aggregator::HEADER_LENGTH];
+	int notices = 0, finished = 0, count;
+	long long messages = 0, bytes = 0;
+	MPI_Status status;
+	double t0 = MPI_Wtime();
+	double dt;
+
+	while(notices < numsubints || finished < numaggregators)
+	{
+		MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
+		if(status.MPI_TAG == CR_AGGREGATEHEADER || status.MPI_TAG == CR_TERMINATE)
+		{
+			MPI_Recv(header, Aggregator::HEADER_LENGTH, MPI_INT, status.MPI_SOURCE, MPI_ANY_TAG, comm, &status);
+			if(status.MPI_TAG == CR_TERMINATE)
+			{
+				finished++;
+				continue;
+			}
+		}
+		else
+		{
+			notices++;
+		}
+		MPI_Recv(buffer, resultlength*2, MPI_FLOAT, status.MPI_SOURCE, CR_VALIDVIS, comm, &status);
+		MPI_Get_count(&status, MPI_FLOAT, &count);
+		if(count > 0)
+		{
+			vectorAdd_cf32_I(buffer, accumulator, count/2);
+			messages++;
+			bytes += count*sizeof(f32);
+		}
+	}
+	dt = MPI_Wtime() - t0;
+
+	printf("\t%lld results received in %.3f s : %.1f subints/s, %.1f MB/s at the manager\n", messages, dt, numsubints/dt, 1e-6*bytes/dt);
+}
+
+int main(int argc, char **argv)
+{
+	MPI_Comm world, return_comm;
+	int numprocs, rank;
+	int NumSubints = 1024;
+	double ResultMByte = 4.0;
+	int CoresPerAggregator = 4;
+	int numcores, numaggregators, subintsperint, resultlength, aggregatorid;
+	int *coreids;
+	cf32 *buffer;
+	cf32 *accumulator;
+	Aggregator *aggregator;
+
+	MPI_Init(&argc, &argv);
+	world = MPI_COMM_WORLD;
+	MPI_Comm_size(world, &numprocs);
+	MPI_Comm_rank(world, &rank);
+	MPI_Comm_dup(world, &return_comm);
+
+	if(argc > 1)
+	{
+		NumSubints = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		ResultMByte = atof(argv[2]);
+	}
+	if(argc > 3)
+	{
+		CoresPerAggregator = atoi(argv[3]);
+	}
+
+	//same split as mpifxcorr -a<CoresPerAggregator>: the aggregators are the last ranks
+	numcores = numprocs - 1;
+	numaggregators = (CoresPerAggregator > 0) ? (numcores + CoresPerAggregator)/(CoresPerAggregator + 1) : 0;
+	if(2*numaggregators > numcores)
+	{
+		numaggregators = numcores/2;
+	}
+	numcores -= numaggregators;
+
+	if(numaggregators < 1 || NumSubints < 1 || ResultMByte <= 0.0)
+	{
+		if(rank == 0)
+		{
+			printf("Sorry, need at least 3 processes\n");
+			printf("This program should be invoked in a manner similar to:\n");
+			printf("mpirun -H host1,host2,...,hostN %s [<numSubints>] [<resultMByte>] [<coresPerAggregator>]\n", argv[0]);
+			printf("  where\n"
+			       "    numSubints         : number of subintegration results the cores send (e.g., %d)\n"
+			       "    resultMByte        : size of each result (e.g., %.1f)\n"
+			       "    coresPerAggregator : as for mpifxcorr -a (e.g., %d)\n", NumSubints, ResultMByte, CoresPerAggregator);
+		}
+		MPI_Finalize();
+
+		return EXIT_FAILURE;
+	}
+
+	resultlength = (int)(ResultMByte*1048576/sizeof(cf32));
+	subintsperint = numcores;
+	coreids = new int[numcores];
+	for(int i = 0; i < numcores; i++)
+	{
+		coreids[i] = i + 1;
+	}
+	buffer = vectorAlloc_cf32(resultlength);
+	accumulator = vectorAlloc_cf32(resultlength);
+	vectorZero_cf32(buffer, resultlength);
+	vectorZero_cf32(accumulator, resultlength);
+
+	if(rank == 0)
+	{
+		printf("%d cores, %d aggregators, %d subints of %.2f MB, %d subints per integration\n", numcores, numaggregators, NumSubints, ResultMByte, subintsperint);
+	}
+
+	for(int pass = 0; pass < 2; pass++)
+	{
+		MPI_Barrier(world);
+		if(rank == 0)
+		{
+			printf(pass == 0 ? "Direct to the manager:\n" : "Through the aggregators:\n");
+			managerreceive(NumSubints, pass == 0 ? 0 : numaggregators, resultlength, buffer, accumulator, return_comm);
+		}
+		else if(rank <= numcores)
+		{
+			aggregatorid = -1;
+			if(pass == 1)
+			{
+				aggregatorid = numcores + 1 + Aggregator::getAggregatorIndex(rank-1, numcores, numaggregators);
+			}
+			coresend(rank, numcores, NumSubints, subintsperint, resultlength, aggregatorid, buffer, return_comm);
+		}
+		else if(pass == 1)
+		{
+			int a = rank - numcores - 1;
+			int firstcore = 0, groupcores = 0;
+
+			for(int i = 0; i < numcores; i++)
+			{
+				if(Aggregator::getAggregatorIndex(i, numcores, numaggregators) == a)
+				{
+					if(groupcores == 0)
+					{
+						firstcore = i;
+					}
+					groupcores++;
+				}
+			}
+			aggregator = new Aggregator(rank, groupcores, &coreids[firstcore], resultlength, subintsperint + 2, return_comm);
+			aggregator->execute();
+			delete aggregator;
+		}
+	}
+
+	vectorFree(buffer);
+	vectorFree(accumulator);
+	delete [] coreids;
+
+	MPI_Comm_free(&return_comm);
+	MPI_Finalize();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+#include "architecture.h"
+#include "datamuxer.h"
+#include "vdifio.h"
+
+// Measures how fast VDIFMuxer corner turns multi-thread VDIF into single-thread VDIF for each layout:
+// 2 to 64 threads of 1 to 32 bit samples (a 32 bit sample being a complex 16 bit one).  Frames of
+// random data are generated locally and pushed through the muxer as a datastream does, and the
+// multiplex step is timed with the corner turner the muxer picks by default, with the hand-written
+// turners it had before the SIMD ones (DIFX_VDIF_CORNERTURN=nosimd) and with the generic turner
+// (DIFX_VDIF_CORNERTURN=generic); the last two can't do layouts with more than 32 bits per time step.
+// Rates are of muxed data, in MB/s.
+
+double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+// returns the rate in MB/s, or 0 if the muxer could not do this layout
+double runmux(const char *turner, int nthreads, int bits, int payloadbytes, int framespersegment, double seconds)
+{
+	const int FramesPerSecond = 25600;
+	int framebytes = payloadbytes + VDIF_HEADER_BYTES;
+	int outputbytes = framespersegment*(payloadbytes*nthreads + VDIF_HEADER_BYTES);
+	int *tmap = new int[nthreads];
+	u8 *output = vectorAlloc_u8(outputbytes);
+	DataMuxer *muxer;
+	long long segments = 0, frame = 0;
+	unsigned int seed = 1;
+	double t0, muxtime = 0.0;
+	bool ok = true;
+
+	for(int i = 0; i < nthreads; i++)
+	{
+		tmap[i] = i;
+	}
+	if(turner)
+	{
+		setenv("DIFX_VDIF_CORNERTURN", turner, 1);
+	}
+	else
+	{
+		unsetenv("DIFX_VDIF_CORNERTURN");
+	}
+	if(bits == 32)
+	{
+		muxer = new VDIFMuxer(0, 0, 0, nthreads, framebytes, framespersegment*nthreads, FramesPerSecond, 16, tmap, true);
+	}
+	else
+	{
+		muxer = new VDIFMuxer(0, 0, 0, nthreads, framebytes, framespersegment*nthreads, FramesPerSecond, bits, tmap);
+	}
+
+	while(ok && (muxtime < seconds || segments < 2))
+	{
+		u8 *segment = muxer->getCurrentDemuxBuffer();
+
+		for(int f = 0; f < framespersegment; f++)
+		{
+			for(int i = 0; i < nthreads; i++)
+			{
+				vdif_header *header = (vdif_header *)(segment + (f*nthreads + i)*framebytes);
+
+				if(segments < DataMuxer::DEMUX_BUFFER_FACTOR)
+				{
+					// the demux buffers are reused in turn, so only the first of each needs data
+					for(int j = VDIF_HEADER_BYTES; j < framebytes; j++)
+					{
+						((u8 *)header)[j] = rand_r(&seed) & 0xFF;
+					}
+				}
+				memset(header, 0, VDIF_HEADER_BYTES);
+				setVDIFFrameSecond(header, (frame + f)/FramesPerSecond);
+				setVDIFFrameNumber(header, (frame + f)%FramesPerSecond);
+				setVDIFFrameBytes(header, framebytes);
+				setVDIFThreadID(header, i);
+			}
+		}
+		frame += framespersegment;
+		if(segments == 0)
+		{
+			ok = muxer->initialise();
+		}
+		muxer->incrementReadCounter();
+		ok = ok && muxer->deinterlace(muxer->getSegmentBytes());
+		t0 = now();
+		ok = ok && (muxer->multiplex(output) == outputbytes);
+		muxtime += now() - t0;
+		segments++;
+	}
+	unsetenv("DIFX_VDIF_CORNERTURN");
+
+	delete muxer;
+	vectorFree(output);
+	delete [] tmap;
+
+	return ok ? 1e-6*segments*framespersegment*payloadbytes*nthreads/muxtime : 0.0;
+}
+
+void printrate(double rate)
+{
+	if(rate > 0.0)
+	{
+		printf(" %10.1f", rate);
+	}
+	else
+	{
+		printf(" %10s", "-");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int PayloadBytes = 8000;
+	int SegmentBytes = 8000000;
+	double Seconds = 0.2;
+
+	if(argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+	{
+		printf("This program should be invoked in a manner similar to:\n");
+		printf("%s [<payloadBytes>] [<segmentBytes>] [<seconds>]\n", argv[0]);
+		printf("  where\n"
+		       "    payloadBytes : data bytes in each input frame, a multiple of 8 (e.g., %d)\n"
+		       "    segmentBytes : approximate size of each segment muxed at once (e.g., %d)\n"
+		       "    seconds      : time spent muxing for each layout and corner turner (e.g., %.1f)\n", PayloadBytes, SegmentBytes, Seconds);
+
+		return EXIT_FAILURE;
+	}
+	if(argc > 1)
+	{
+		PayloadBytes = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		SegmentBytes = atoi(argv[2]);
+	}
+	if(argc > 3)
+	{
+		Seconds = atof(argv[3]);
+	}
+
+	printf("Muxing %d byte frames, about %d bytes at a time; rates in MB/s\n", PayloadBytes, SegmentBytes);
+	printf("threads bits    default     nosimd    generic\n");
+	for(int bits = 1; bits <= 32; bits *= 2)
+	{
+		for(int nthreads = 2; nthreads <= 64; nthreads *= 2)
+		{
+			int framespersegment = SegmentBytes/(PayloadBytes*nthreads);
+
+			if(framespersegment < 1)
+			{
+				framespersegment = 1;
+			}
+			printf("%7d %4d", nthreads, bits);
+			printrate(runmux(0, nthreads, bits, PayloadBytes, framespersegment, Seconds));
+			if(nthreads*bits <= 32)
+			{
+				printrate(runmux("nosimd", nthreads, bits, PayloadBytes, framespersegment, Seconds));
+				printrate(runmux("generic", nthreads, bits, PayloadBytes, framespersegment, Seconds));
+			}
+			else
+			{
+				printrate(0.0);
+				printrate(0.0);
+			}
+			printf("\n");
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
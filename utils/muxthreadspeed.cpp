@@ -0,0 +1,268 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+#include "architecture.h"
+#include "datamuxer.h"
+#include "muxpool.h"
+#include "vdifio.h"
+
+// Measures how multiplexing of multi-thread VDIF scales with the number of threads sharing it
+// (DIFX_MUX_THREADS).  A few segments of 2 bit multi-thread VDIF with random payloads are generated
+// locally, each thread's frames slightly out of order as in a multi-file recording, and muxed over
+// and over in two ways: by libvdifio's vdifmux segment by segment as VDIFDataStream does (through
+// MuxPool::vdifmux when more than one thread is used), and by VDIFMuxer as Mk5DataStream does.
+// Rates are of input data, in MB/s.
+
+double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+void makeframe(unsigned char *frame, int framebytes, long long t, int thread, int framespersecond, unsigned int *seed)
+{
+	vdif_header *header = (vdif_header *)frame;
+
+	for(int j = VDIF_HEADER_BYTES; j < framebytes; j++)
+	{
+		frame[j] = rand_r(seed) & 0xFF;
+	}
+	memset(header, 0, VDIF_HEADER_BYTES);
+	setVDIFFrameSecond(header, t/framespersecond);
+	setVDIFFrameNumber(header, t%framespersecond);
+	setVDIFFrameBytes(header, framebytes);
+	setVDIFThreadID(header, thread);
+}
+
+// returns the rate in MB/s, or 0 if vdifmux failed
+double runvdifmux(int muxthreads, int nthreads, int payloadbytes, int framespersegment, int numsegments, double seconds)
+{
+	const int FramesPerSecond = 25600;
+	int framebytes = payloadbytes + VDIF_HEADER_BYTES;
+	long long streambytes = (long long)framebytes*nthreads*framespersegment*numsegments;
+	unsigned char *stream = new unsigned char[streambytes];
+	int *threadids = new int[nthreads];
+	struct vdif_mux vm;
+	struct vdif_mux_statistics stats;
+	MuxPool *pool = 0;
+	unsigned char *output;
+	unsigned int seed = 1;
+	long long consumed = 0;
+	double t0, muxtime = 0.0;
+	bool ok = true;
+
+	for(int i = 0; i < nthreads; i++)
+	{
+		threadids[i] = i;
+	}
+	// frames of neighbouring frame times are swapped now and then
+	for(long long t = 0; t < (long long)framespersegment*numsegments; t++)
+	{
+		for(int i = 0; i < nthreads; i++)
+		{
+			long long ft = t;
+
+			if(t % 2 == 1 && (t*nthreads + i) % 5 == 0)
+			{
+				ft = t - 1;
+			}
+			else if(t % 2 == 0 && t + 1 < (long long)framespersegment*numsegments && ((t + 1)*nthreads + i) % 5 == 0)
+			{
+				ft = t + 1;
+			}
+			makeframe(stream + (t*nthreads + i)*framebytes, framebytes, ft, i, FramesPerSecond, &seed);
+		}
+	}
+	configurevdifmux(&vm, framebytes, FramesPerSecond, 2, nthreads, threadids, 32, FramesPerSecond/4, VDIF_MUX_FLAG_RESPECTGRANULARITY);
+	resetvdifmuxstatistics(&stats);
+	output = new unsigned char[framespersegment*vm.outputFrameSize];
+	if(muxthreads > 1)
+	{
+		pool = new MuxPool(muxthreads);
+	}
+
+	while(ok && muxtime < seconds)
+	{
+		long long index = 0;
+		int64_t start = -1;
+
+		// as VDIFDataStream::dataRead, with twice a segment's worth of data visible
+		while(ok && index + 2LL*framebytes*nthreads*framespersegment <= streambytes)
+		{
+			int destbytes = framespersegment*vm.outputFrameSize;
+			int visible = 2*framebytes*nthreads*framespersegment;
+			int r;
+
+			t0 = now();
+			if(pool)
+			{
+				r = pool->vdifmux(output, destbytes, stream + index, visible, &vm, start, &stats);
+			}
+			else
+			{
+				r = vdifmux(output, destbytes, stream + index, visible, &vm, start, &stats);
+			}
+			muxtime += now() - t0;
+			ok = (r > 0 && stats.srcUsed > 0);
+			start = stats.startFrameNumber + stats.nOutputFrame;
+			index += stats.srcUsed;
+			consumed += stats.srcUsed;
+		}
+	}
+
+	if(pool)
+	{
+		if(pool->getNumParallelMuxes() == 0)
+		{
+			fprintf(stderr, "Warning: no segment was muxed in parallel with %d threads\n", muxthreads);
+		}
+		delete pool;
+	}
+	delete [] output;
+	delete [] threadids;
+	delete [] stream;
+
+	return ok ? 1e-6*consumed/muxtime : 0.0;
+}
+
+// returns the rate in MB/s, or 0 if the muxer failed
+double runvdifmuxer(int muxthreads, int nthreads, int payloadbytes, int framespersegment, double seconds)
+{
+	const int FramesPerSecond = 25600;
+	int framebytes = payloadbytes + VDIF_HEADER_BYTES;
+	int outputbytes = framespersegment*(payloadbytes*nthreads + VDIF_HEADER_BYTES);
+	int *tmap = new int[nthreads];
+	u8 *output = vectorAlloc_u8(outputbytes);
+	DataMuxer *muxer;
+	long long segments = 0, frame = 0;
+	unsigned int seed = 1;
+	double t0, muxtime = 0.0;
+	char muxthreadsvalue[16];
+	bool ok = true;
+
+	for(int i = 0; i < nthreads; i++)
+	{
+		tmap[i] = i;
+	}
+	snprintf(muxthreadsvalue, 16, "%d", muxthreads);
+	setenv("DIFX_MUX_THREADS", muxthreadsvalue, 1);
+	muxer = new VDIFMuxer(0, 0, 0, nthreads, framebytes, framespersegment*nthreads, FramesPerSecond, 2, tmap);
+	unsetenv("DIFX_MUX_THREADS");
+
+	while(ok && (muxtime < seconds || segments < 2))
+	{
+		u8 *segment = muxer->getCurrentDemuxBuffer();
+
+		for(int f = 0; f < framespersegment; f++)
+		{
+			for(int i = 0; i < nthreads; i++)
+			{
+				u8 *out = segment + (f*nthreads + i)*framebytes;
+
+				if(segments < DataMuxer::DEMUX_BUFFER_FACTOR)
+				{
+					makeframe(out, framebytes, frame + f, i, FramesPerSecond, &seed);
+				}
+				else
+				{
+					setVDIFFrameSecond((vdif_header *)out, (frame + f)/FramesPerSecond);
+					setVDIFFrameNumber((vdif_header *)out, (frame + f)%FramesPerSecond);
+				}
+			}
+		}
+		frame += framespersegment;
+		if(segments == 0)
+		{
+			ok = muxer->initialise();
+		}
+		muxer->incrementReadCounter();
+		ok = ok && muxer->deinterlace(muxer->getSegmentBytes());
+		t0 = now();
+		ok = ok && (muxer->multiplex(output) == outputbytes);
+		muxtime += now() - t0;
+		segments++;
+	}
+
+	delete muxer;
+	vectorFree(output);
+	delete [] tmap;
+
+	return ok ? 1e-6*segments*framespersegment*framebytes*nthreads/muxtime : 0.0;
+}
+
+void printrate(double rate)
+{
+	if(rate > 0.0)
+	{
+		printf(" %10.1f", rate);
+	}
+	else
+	{
+		printf(" %10s", "-");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int NThreads = 16;
+	int PayloadBytes = 8000;
+	int SegmentBytes = 32000000;
+	int MaxMuxThreads = 8;
+	double Seconds = 1.0;
+	int framespersegment;
+
+	if(argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+	{
+		printf("This program should be invoked in a manner similar to:\n");
+		printf("%s [<nThreads>] [<payloadBytes>] [<segmentBytes>] [<maxMuxThreads>] [<seconds>]\n", argv[0]);
+		printf("  where\n"
+		       "    nThreads      : number of VDIF threads in the data (e.g., %d)\n"
+		       "    payloadBytes  : data bytes in each input frame, a multiple of 8 (e.g., %d)\n"
+		       "    segmentBytes  : approximate size of each segment muxed at once (e.g., %d)\n"
+		       "    maxMuxThreads : muxing is timed with 1, 2, 4, ... up to this many threads (e.g., %d)\n"
+		       "    seconds       : time spent muxing for each number of threads (e.g., %.1f)\n", NThreads, PayloadBytes, SegmentBytes, MaxMuxThreads, Seconds);
+
+		return EXIT_FAILURE;
+	}
+	if(argc > 1)
+	{
+		NThreads = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		PayloadBytes = atoi(argv[2]);
+	}
+	if(argc > 3)
+	{
+		SegmentBytes = atoi(argv[3]);
+	}
+	if(argc > 4)
+	{
+		MaxMuxThreads = atoi(argv[4]);
+	}
+	if(argc > 5)
+	{
+		Seconds = atof(argv[5]);
+	}
+
+	framespersegment = SegmentBytes/(PayloadBytes*NThreads);
+	if(framespersegment < 1)
+	{
+		framespersegment = 1;
+	}
+	printf("Muxing %d threads of %d byte frames, %d frames per thread at a time; rates in MB/s\n", NThreads, PayloadBytes, framespersegment);
+	printf("muxthreads    vdifmux  VDIFMuxer\n");
+	for(int muxthreads = 1; muxthreads <= MaxMuxThreads; muxthreads *= 2)
+	{
+		printf("%10d", muxthreads);
+		printrate(runvdifmux(muxthreads, NThreads, PayloadBytes, framespersegment, 4, Seconds));
+		printrate(runvdifmuxer(muxthreads, NThreads, PayloadBytes, framespersegment, Seconds));
+		printf("\n");
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "packetreceiver.h"
+
+// Measures how fast raw VDIF packets can be received, with one recvfrom() and copy per packet (the
+// previous VDIFNetworkDataStream path) and with PacketReceiver's batched recvmmsg() straight into the
+// buffer.  A sender thread sends packets over loopback UDP, optionally rate limited, while the
+// receiver fills read buffer slots in turn, as the network thread does.  Packets the receiver could
+// not keep up with are lost in the socket buffer and reported as loss.  On a machine with few cores the
+// sender and receiver compete for the CPU, so the receiver's CPU time per packet is reported as well.
+
+typedef struct {
+	int sock;
+	struct sockaddr_in address;
+	long long numpackets;
+	int packetsize;
+	double rate;	// packets per second, or 0 for as fast as possible
+	long long sent;
+	volatile int done;
+} senderinfo;
+
+double cputime()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+void *sender(void *arg)
+{
+	senderinfo *info = (senderinfo *)arg;
+	char *packet = new char[info->packetsize];
+	double t0 = now();
+
+	memset(packet, 0, info->packetsize);
+	info->sent = 0;
+	for(long long i = 0; i < info->numpackets; i++)
+	{
+		if(info->rate > 0.0 && i % 16 == 0)
+		{
+			// pace in short bursts, sleeping rather than spinning so the receiver gets the CPU
+			double dt = t0 + i/info->rate - now();
+
+			if(dt > 0)
+			{
+				struct timespec ts;
+
+				ts.tv_sec = (time_t)dt;
+				ts.tv_nsec = (long)((dt - ts.tv_sec)*1e9);
+				nanosleep(&ts, 0);
+			}
+		}
+		memcpy(packet, &i, sizeof(i));
+		if(sendto(info->sock, packet, info->packetsize, 0, (struct sockaddr *)&(info->address), sizeof(info->address)) == info->packetsize)
+		{
+			info->sent++;
+		}
+	}
+	info->done = 1;
+	delete [] packet;
+
+	return 0;
+}
+
+void runreceive(const char *mode, bool batched, int rxsock, senderinfo *info, int stripbytes, char *readbuffer, int numslots, unsigned int slotsize)
+{
+	PacketReceiver receiver(info->packetsize, stripbytes);
+	pthread_t thread;
+	unsigned int bytes;
+	int slot = 0;
+	double t0, dt, cpu0, cpu;
+
+	info->done = 0;
+	t0 = now();
+	cpu0 = cputime();
+	pthread_create(&thread, 0, sender, info);
+	for(;;)
+	{
+		if(batched)
+		{
+			bytes = receiver.receive(rxsock, readbuffer + slot*slotsize, slotsize);
+		}
+		else
+		{
+			bytes = receiver.receiveSingle(rxsock, readbuffer + slot*slotsize, slotsize);
+		}
+		slot = (slot + 1) % numslots;
+		if(bytes < slotsize && info->done)
+		{
+			break;	// timed out after the sender finished
+		}
+	}
+	cpu = cputime() - cpu0;
+	pthread_join(thread, 0);
+	dt = now() - t0 - 0.1;	// less the final socket timeout
+
+	printf("\t%-9s: %lld of %lld packets received in %.2f s : %.0f packets/s, %.2f Gbps, %.2f%% lost, %.1f packets per system call, %.2f us receiver CPU per packet\n", mode, receiver.getNumPackets(), info->sent, dt, receiver.getNumPackets()/dt, 8e-9*receiver.getNumPackets()*info->packetsize/dt, 100.0*(info->sent - receiver.getNumPackets())/info->sent, (double)receiver.getNumPackets()/receiver.getNumCalls(), 1e6*cpu/receiver.getNumPackets());
+}
+
+int main(int argc, char **argv)
+{
+	long long NumPackets = 500000;
+	int PacketSize = 8032;
+	int StripBytes = 8;
+	double RateGbps = 0.0;
+	int numslots = 8;
+	unsigned int slotsize;
+	char *readbuffer;
+	senderinfo info;
+	struct sockaddr_in address;
+	socklen_t addresslength = sizeof(address);
+	struct timeval tv;
+	int rxsock, bufbytes = 32*1024*1024;
+
+	if(argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+	{
+		printf("This program should be invoked in a manner similar to:\n");
+		printf("%s [<numPackets>] [<packetBytes>] [<stripBytes>] [<rateGbps>]\n", argv[0]);
+		printf("  where\n"
+		       "    numPackets  : number of packets to send (e.g., %lld)\n"
+		       "    packetBytes : size of each packet, including the stripped bytes (e.g., %d)\n"
+		       "    stripBytes  : bytes stripped from the start of each packet (e.g., %d)\n"
+		       "    rateGbps    : send rate, or 0 for as fast as possible (e.g., %.1f)\n", NumPackets, PacketSize, StripBytes, RateGbps);
+
+		return EXIT_FAILURE;
+	}
+	if(argc > 1)
+	{
+		NumPackets = atoll(argv[1]);
+	}
+	if(argc > 2)
+	{
+		PacketSize = atoi(argv[2]);
+	}
+	if(argc > 3)
+	{
+		StripBytes = atoi(argv[3]);
+	}
+	if(argc > 4)
+	{
+		RateGbps = atof(argv[4]);
+	}
+
+	rxsock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+	if(rxsock < 0 || bind(rxsock, (struct sockaddr *)&address, sizeof(address)) != 0 || getsockname(rxsock, (struct sockaddr *)&address, &addresslength) != 0)
+	{
+		printf("Could not open a loopback UDP socket\n");
+
+		return EXIT_FAILURE;
+	}
+	setsockopt(rxsock, SOL_SOCKET, SO_RCVBUF, (char *) &bufbytes, sizeof(bufbytes));	// as DataStream::openstream
+	tv.tv_sec = 0;
+	tv.tv_usec = 100000;
+	setsockopt(rxsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	info.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	info.address = address;
+	info.numpackets = NumPackets;
+	info.packetsize = PacketSize;
+	info.rate = RateGbps*1e9/(8.0*PacketSize);
+
+	slotsize = 1000*(PacketSize - StripBytes);
+	readbuffer = new char[numslots*slotsize];
+	memset(readbuffer, 0, numslots*slotsize);
+
+	printf("%lld packets of %d bytes (%d stripped) over loopback, sent %s", NumPackets, PacketSize, StripBytes, (RateGbps > 0.0) ? "at " : "as fast as possible\n");
+	if(RateGbps > 0.0)
+	{
+		printf("%.2f Gbps\n", RateGbps);
+	}
+
+	runreceive("recvfrom", false, rxsock, &info, StripBytes, readbuffer, numslots, slotsize);
+	runreceive("recvmmsg", true, rxsock, &info, StripBytes, readbuffer, numslots, slotsize);
+
+	delete [] readbuffer;
+	close(info.sock);
+	close(rxsock);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	// for F_SETPIPE_SZ
+#endif
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "viswriter.h"
+
+// Emulates the FxManager write thread producing one integration of DiFX output every period, and
+// measures how long it is held up writing each one: first with a synchronous open/append/close per file
+// (as Visibility::writedifx used to do), then through a VisWriter.  The output goes either to files in
+// a directory (e.g. a tmpfs) or, with a throttle, to FIFOs in that directory drained at a fixed rate,
+// which stands in for slow storage.
+
+typedef struct {
+	char filename[256];
+	double rate;
+	volatile int stop;
+} throttleinfo;
+
+double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+void sleepuntil(double t)
+{
+	double dt = t - now();
+	struct timespec ts;
+
+	if(dt > 0)
+	{
+		ts.tv_sec = (time_t)dt;
+		ts.tv_nsec = (long)((dt - ts.tv_sec)*1e9);
+		nanosleep(&ts, 0);
+	}
+}
+
+// drains a FIFO at a fixed rate
+void *throttledreader(void *arg)
+{
+	throttleinfo *info = (throttleinfo *)arg;
+	static const int CHUNK = 1048576;
+	char *buffer = new char[CHUNK];
+	long long total = 0;
+	ssize_t n;
+	int fd;
+	double t0;
+
+	fd = open(info->filename, O_RDWR | O_NONBLOCK);	// read-write, so the reader never sees end of file
+	fcntl(fd, F_SETPIPE_SZ, CHUNK);
+	t0 = now();
+	while(!info->stop)
+	{
+		n = read(fd, buffer, CHUNK);
+		if(n <= 0)
+		{
+			usleep(1000);
+			continue;
+		}
+		total += n;
+		sleepuntil(t0 + total/info->rate);
+	}
+	close(fd);
+	delete [] buffer;
+
+	return 0;
+}
+
+void runintegrations(const char *mode, VisWriter *writer, char *syncbuffer, int numfiles, char filenames[][256], int NumIntegrations, int IntegrationBytes, double Period)
+{
+	std::ofstream output;
+	char *buffer;
+	int filebytes = IntegrationBytes/numfiles;
+	double t0, t, dt, stall = 0.0, maxstall = 0.0;
+
+	t0 = now();
+	for(int i = 0; i < NumIntegrations; i++)
+	{
+		sleepuntil(t0 + i*Period);
+		t = now();
+		if(writer == 0)
+		{
+			buffer = syncbuffer;
+		}
+		else
+		{
+			buffer = writer->acquireBuffer();
+		}
+		memset(buffer, i & 0xff, IntegrationBytes);	// stands in for the formatting in writedifx
+		for(int f = 0; f < numfiles; f++)
+		{
+			if(writer == 0)
+			{
+				output.open(filenames[f], std::ios::app);
+				output.write(buffer + f*filebytes, filebytes);
+				output.close();
+			}
+			else
+			{
+				writer->queueWrite(buffer, f*filebytes, filebytes, filenames[f]);
+			}
+		}
+		if(writer != 0)
+		{
+			writer->releaseBuffer(buffer);
+			writer->endIntegration();
+		}
+		dt = now() - t;
+		stall += dt;
+		if(dt > maxstall)
+		{
+			maxstall = dt;
+		}
+	}
+	dt = now() - t0;
+	if(writer != 0)
+	{
+		writer->flush();
+	}
+
+	printf("\t%-12s: %.1f ms mean, %.1f ms max per integration in the write thread; %.2f s for %d integrations (%.2f s with the final flush)\n", mode, 1e3*stall/NumIntegrations, 1e3*maxstall, dt, NumIntegrations, now() - t0);
+}
+
+int main(int argc, char **argv)
+{
+	int NumIntegrations = 50;
+	double IntegrationMByte = 16.0;
+	double PeriodMs = 100.0;
+	double ThrottleMBps = 0.0;
+	int NumFiles = 1;
+	int NumBuffers = 4;
+	int integrationbytes;
+	char (*filenames)[256];
+	char *syncbuffer;
+	throttleinfo *throttles = 0;
+	pthread_t *throttlethreads = 0;
+	VisWriter *writer;
+
+	if(argc < 2)
+	{
+		printf("This program should be invoked in a manner similar to:\n");
+		printf("%s <directory> [<numIntegrations>] [<integrationMByte>] [<periodMs>] [<throttleMBps>] [<numFiles>] [<numBuffers>]\n", argv[0]);
+		printf("  where\n"
+		       "    directory       : where to write (e.g., /dev/shm)\n"
+		       "    numIntegrations : number of integrations to write (e.g., %d)\n"
+		       "    integrationMByte: output size of each integration (e.g., %.1f)\n"
+		       "    periodMs        : time between integrations (e.g., %.1f)\n"
+		       "    throttleMBps    : if > 0, write to FIFOs drained at this rate instead of files (e.g., %.1f)\n"
+		       "    numFiles        : number of phase centre/pulsar bin files (e.g., %d)\n"
+		       "    numBuffers      : VisWriter buffers, as DIFX_WRITE_BUFFERS (e.g., %d)\n",
+		       NumIntegrations, IntegrationMByte, PeriodMs, ThrottleMBps, NumFiles, NumBuffers);
+
+		return EXIT_FAILURE;
+	}
+	if(argc > 2)
+	{
+		NumIntegrations = atoi(argv[2]);
+	}
+	if(argc > 3)
+	{
+		IntegrationMByte = atof(argv[3]);
+	}
+	if(argc > 4)
+	{
+		PeriodMs = atof(argv[4]);
+	}
+	if(argc > 5)
+	{
+		ThrottleMBps = atof(argv[5]);
+	}
+	if(argc > 6)
+	{
+		NumFiles = atoi(argv[6]);
+	}
+	if(argc > 7)
+	{
+		NumBuffers = atoi(argv[7]);
+	}
+
+	integrationbytes = (int)(IntegrationMByte*1048576);
+	filenames = new char[NumFiles][256];
+	for(int f = 0; f < NumFiles; f++)
+	{
+		sprintf(filenames[f], "%s/writespeed.s%04d", argv[1], f);
+		unlink(filenames[f]);
+	}
+	if(ThrottleMBps > 0.0)
+	{
+		throttles = new throttleinfo[NumFiles];
+		throttlethreads = new pthread_t[NumFiles];
+		for(int f = 0; f < NumFiles; f++)
+		{
+			if(mkfifo(filenames[f], 0644) != 0)
+			{
+				printf("Could not create FIFO %s\n", filenames[f]);
+
+				return EXIT_FAILURE;
+			}
+			strcpy(throttles[f].filename, filenames[f]);
+			throttles[f].rate = ThrottleMBps*1048576/NumFiles;
+			throttles[f].stop = 0;
+			pthread_create(&throttlethreads[f], 0, throttledreader, &throttles[f]);
+		}
+	}
+
+	printf("%d integrations of %.1f MB every %.1f ms (%.1f MB/s) to %d %s in %s", NumIntegrations, IntegrationMByte, PeriodMs, IntegrationMByte*1e3/PeriodMs, NumFiles, (ThrottleMBps > 0.0) ? "FIFOs" : "files", argv[1]);
+	if(ThrottleMBps > 0.0)
+	{
+		printf(" drained at %.1f MB/s", ThrottleMBps);
+	}
+	printf("\n");
+
+	syncbuffer = new char[integrationbytes];
+	runintegrations("synchronous", 0, syncbuffer, NumFiles, filenames, NumIntegrations, integrationbytes, 1e-3*PeriodMs);
+	writer = new VisWriter(NumBuffers, integrationbytes, NumFiles, false, 0);
+	runintegrations("VisWriter", writer, 0, NumFiles, filenames, NumIntegrations, integrationbytes, 1e-3*PeriodMs);
+	delete writer;
+
+	if(ThrottleMBps > 0.0)
+	{
+		for(int f = 0; f < NumFiles; f++)
+		{
+			throttles[f].stop = 1;
+			pthread_join(throttlethreads[f], 0);
+		}
+		delete [] throttles;
+		delete [] throttlethreads;
+	}
+	for(int f = 0; f < NumFiles; f++)
+	{
+		unlink(filenames[f]);
+	}
+	delete [] filenames;
+	delete [] syncbuffer;
+
+	return EXIT_SUCCESS;
+}